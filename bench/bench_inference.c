@@ -0,0 +1,163 @@
+/**
+ * Quantized MobileNet v1 inference benchmark.
+ *
+ * Reports model and label load times, single-image latency of the network alone and of
+ * the full path from a decoded 640x480 image, and the throughput of one
+ * model per CPU running concurrently. Every thread must produce the same
+ * output as the single-threaded run; the benchmark exits non-zero otherwise.
+ *
+ * The model is read from bin/models (extracted by `make bench`) or from the
+ * path given as the first argument. Without it the benchmark is skipped.
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/img_utils.h"
+#include "../include/model_utils.h"
+
+#define MODEL_PATH "bin/models/mobilenet_v1_1.0_224_quant.tflite"
+#define LABELS_PATH "models/labels_mobilenet_quant_v1_224.txt"
+#define RUNS 30
+#define THREAD_RUNS 10
+
+typedef struct {
+    const char *path;
+    const unsigned char *input;
+    const unsigned char *expected;
+    int count;
+    int ok;
+} worker;
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Smooth gradients with a few edges, so every layer sees varied activations
+static Image* make_image(int width, int height)
+{
+    Image *img = img_new(width, height);
+    if (!img) return NULL;
+
+    for (int y = 0; y < height; y++) {
+        pixel *row = img_row(img, y);
+        for (int x = 0; x < width; x++) {
+            int band = ((x / 40) + (y / 30)) & 1;
+            row[x].R = (unsigned char)((x * 255) / width);
+            row[x].G = (unsigned char)((y * 255) / height);
+            row[x].B = (unsigned char)(band ? 200 : 40);
+            row[x].A = 255;
+        }
+    }
+    return img;
+}
+
+static void report(const char *name, double *samples, int n)
+{
+    qsort(samples, n, sizeof(double), compare_double);
+    double total = 0.0;
+    for (int i = 0; i < n; i++) total += samples[i];
+    printf("  %-24s p50 %7.2f ms  min %7.2f ms  %7.1f images/s\n",
+           name, samples[n / 2] * 1e3, samples[0] * 1e3, n / total);
+}
+
+static void* run_worker(void *arg)
+{
+    worker *w = (worker *)arg;
+    Model *model = model_load(w->path);
+    w->ok = model != NULL;
+    for (int i = 0; w->ok && i < THREAD_RUNS; i++) {
+        memcpy(model_input(model), w->input, (size_t)224 * 224 * 3);
+        model_invoke(model);
+        w->ok = memcmp(model_output(model, NULL), w->expected, w->count) == 0;
+    }
+    model_free(model);
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : MODEL_PATH;
+    if (access(path, R_OK) != 0) {
+        printf("inference: %s not found, skipped\n", path);
+        return 0;
+    }
+
+    double start = now_seconds();
+    Model *model = model_load(path);
+    if (!model) return 1;
+    printf("inference %s, load %.3f ms\n", path, (now_seconds() - start) * 1e3);
+
+    start = now_seconds();
+    model_labels *labels = model_labels_load(LABELS_PATH);
+    double labels_seconds = now_seconds() - start;
+    if (labels) {
+        printf("  %d labels, load %.3f ms\n", model_labels_count(labels), labels_seconds * 1e3);
+    }
+
+    int height, width, channels;
+    model_input_shape(model, &height, &width, &channels);
+    Image *img = make_image(640, 480);
+    if (!img || height != 224 || width != 224 || channels != 3) return 1;
+
+    model_prediction top[5];
+    double samples[RUNS];
+    for (int i = 0; i < RUNS; i++) {
+        start = now_seconds();
+        model_classify(model, img, 5, top);
+        samples[i] = now_seconds() - start;
+    }
+    report("image to top-5", samples, RUNS);
+    if (labels) printf("  top-1 of the test image: %s (%.3f)\n", model_labels_name(labels, top[0].index), top[0].score);
+
+    unsigned char *input = (unsigned char *)malloc((size_t)height * width * channels);
+    memcpy(input, model_input(model), (size_t)height * width * channels);
+    for (int i = 0; i < RUNS; i++) {
+        start = now_seconds();
+        model_invoke(model);
+        samples[i] = now_seconds() - start;
+    }
+    report("invoke", samples, RUNS);
+
+    int count;
+    const unsigned char *output = model_output(model, &count);
+
+    // One model per CPU, all running at once
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = cpus < 1 ? 1 : (int)cpus;
+    pthread_t *ids = (pthread_t *)malloc(sizeof(pthread_t) * threads);
+    worker *workers = (worker *)malloc(sizeof(worker) * threads);
+    start = now_seconds();
+    for (int t = 0; t < threads; t++) {
+        workers[t] = (worker){ path, input, output, count, 0 };
+        pthread_create(&ids[t], NULL, run_worker, &workers[t]);
+    }
+    int fails = 0;
+    for (int t = 0; t < threads; t++) {
+        pthread_join(ids[t], NULL);
+        fails += !workers[t].ok;
+    }
+    double elapsed = now_seconds() - start;
+    printf("  %-24s %d threads %18.1f images/s%s\n", "concurrent models", threads,
+           threads * THREAD_RUNS / elapsed, fails ? "  MISMATCH" : "");
+
+    free(workers);
+    free(ids);
+    free(input);
+    model_labels_free(labels);
+    img_free(img);
+    model_free(model);
+    return fails ? 1 : 0;
+}
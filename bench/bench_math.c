@@ -0,0 +1,164 @@
+/**
+ * Trigonometry micro-benchmark.
+ *
+ * Compares libm, the original Taylor-series sin/cos, the table-driven
+ * sincos_approx() and the vectorized float batch kernels on speed (ns per
+ * angle) and maximum absolute error against libm. Exits non-zero when an
+ * implementation exceeds its documented error bound.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../internal/math/math_utils.h"
+
+#define COUNT 4096
+#define ROUNDS 500
+
+#define TABLE_ERROR_BOUND 2e-15
+#define BATCH_ERROR_BOUND 3e-7
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// The 7th-order Taylor implementation sin_approx/cos_approx used before the table
+static double legacy_power(double x, int n)
+{
+    double result = 1;
+    while (n > 0) {
+        if (n % 2 == 1) result *= x;
+        x *= x;
+        n /= 2;
+    }
+    return result;
+}
+
+static double legacy_reduce(double degrees)
+{
+    double x = degrees * (M_PI / 180.0) + M_PI;
+    double y = 2 * M_PI;
+    double remainder = x - (y * (long long)(x / y));
+    if (remainder * y < 0) remainder += y;
+    return remainder - M_PI;
+}
+
+static double legacy_sin(double degrees)
+{
+    double x = legacy_reduce(degrees);
+    return x - legacy_power(x, 3) / 6 + legacy_power(x, 5) / 120 - legacy_power(x, 7) / 5040;
+}
+
+static double legacy_cos(double degrees)
+{
+    double x = legacy_reduce(degrees);
+    return 1 - legacy_power(x, 2) / 2 + legacy_power(x, 4) / 24 - legacy_power(x, 6) / 720;
+}
+
+static double degrees[COUNT];
+static float radians[COUNT];
+static float out_s[COUNT], out_c[COUNT];
+static volatile double sink;
+
+static void report(const char *name, double seconds, double max_error)
+{
+    printf("  %-16s %7.2f ns/angle   max abs error %.3g\n", name, seconds * 1e9 / ((double)COUNT * ROUNDS), max_error);
+}
+
+int main(void)
+{
+    srand(1);
+    for (int i = 0; i < COUNT; i++) {
+        degrees[i] = ((double)rand() / RAND_MAX - 0.5) * 720.0;
+        radians[i] = (float)to_radians(degrees[i]);
+    }
+
+    double t0, acc, err;
+    printf("sin+cos of %d angles in [-360, 360] degrees\n", COUNT);
+
+    // libm
+    acc = 0;
+    t0 = now_seconds();
+    for (int r = 0; r < ROUNDS; r++)
+        for (int i = 0; i < COUNT; i++) acc += sin(to_radians(degrees[i])) + cos(to_radians(degrees[i]));
+    sink = acc;
+    report("libm", now_seconds() - t0, 0.0);
+
+    // Original Taylor series
+    acc = 0;
+    t0 = now_seconds();
+    for (int r = 0; r < ROUNDS; r++)
+        for (int i = 0; i < COUNT; i++) acc += legacy_sin(degrees[i]) + legacy_cos(degrees[i]);
+    sink = acc;
+    double legacy_time = now_seconds() - t0;
+    err = 0;
+    for (int i = 0; i < COUNT; i++) {
+        double rad = to_radians(degrees[i]);
+        err = fmax(err, fmax(fabs(legacy_sin(degrees[i]) - sin(rad)), fabs(legacy_cos(degrees[i]) - cos(rad))));
+    }
+    report("taylor (old)", legacy_time, err);
+
+    // Table-driven sincos
+    acc = 0;
+    t0 = now_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < COUNT; i++) {
+            double s, c;
+            sincos_approx(degrees[i], &s, &c);
+            acc += s + c;
+        }
+    }
+    sink = acc;
+    double table_time = now_seconds() - t0;
+    double table_err = 0;
+    for (int i = 0; i < COUNT; i++) {
+        double s, c, rad = to_radians(degrees[i]);
+        sincos_approx(degrees[i], &s, &c);
+        table_err = fmax(table_err, fmax(fabs(s - sin(rad)), fabs(c - cos(rad))));
+    }
+    report("sincos_approx", table_time, table_err);
+
+    // libm float, one call at a time
+    acc = 0;
+    t0 = now_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < COUNT; i++) {
+            out_s[i] = sinf(radians[i]);
+            out_c[i] = cosf(radians[i]);
+        }
+        acc += out_s[r % COUNT] + out_c[r % COUNT];
+    }
+    sink = acc;
+    report("libm sinf+cosf", now_seconds() - t0, 0.0);
+
+    // Vectorized batch
+    acc = 0;
+    t0 = now_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        sincosf_batch(radians, out_s, out_c, COUNT);
+        acc += out_s[r % COUNT] + out_c[r % COUNT];
+    }
+    sink = acc;
+    double batch_time = now_seconds() - t0;
+    double batch_err = 0;
+    for (int i = 0; i < COUNT; i++) {
+        batch_err = fmax(batch_err, fmax(fabs(out_s[i] - sin((double)radians[i])),
+                                         fabs(out_c[i] - cos((double)radians[i]))));
+    }
+    report("sincosf_batch", batch_time, batch_err);
+
+    int ok = 1;
+    if (table_err > TABLE_ERROR_BOUND) {
+        printf("FAIL: sincos_approx error %.3g exceeds %.3g\n", table_err, TABLE_ERROR_BOUND);
+        ok = 0;
+    }
+    if (batch_err > BATCH_ERROR_BOUND) {
+        printf("FAIL: sincosf_batch error %.3g exceeds %.3g\n", batch_err, BATCH_ERROR_BOUND);
+        ok = 0;
+    }
+    return ok ? 0 : 1;
+}
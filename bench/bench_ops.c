@@ -0,0 +1,704 @@
+/**
+ * Image operation benchmark suite.
+ *
+ * Runs every image operation over a matrix of synthetic images from 64x64 to
+ * 8K. Each case is warmed up, then timed over repeated trials until both a
+ * minimum trial count and a minimum run time are reached. The suite reports
+ * source Mpix/s at the median and p50/p99 latency per call.
+ *
+ * Options:
+ *   --json FILE        write the results as JSON
+ *   --baseline FILE    compare against a JSON file from an earlier run
+ *   --threshold PCT    p50 slowdown that counts as a regression (default 10)
+ *   --filter TEXT      run only the cases whose name contains TEXT
+ *   --scaling          instead report the speedup of the multi-threaded
+ *                      operations on a 4K image with 1 to 16 threads
+ *
+ * A missing baseline file is skipped. The suite exits non-zero when any case
+ * fails or is slower than the baseline by more than the threshold.
+ */
+#include <png.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/data_augmentation.h"
+#include "../include/img_utils.h"
+
+#define WARMUP_SECONDS 0.05
+#define MIN_SAMPLE_SECONDS 50e-6 // Fast operations are repeated until one sample takes this long
+#define MIN_TRIALS 5
+#define MIN_SECONDS 0.25
+#define MAX_SECONDS 1.0 // Slow cases stop here once they have a few trials
+#define MAX_TRIALS 1000
+#define DEFAULT_THRESHOLD 10.0
+#define PNG_PATH "/tmp/neuro-lens-bench-ops.png"
+#define CACHE_DIR "/tmp/neuro-lens-bench-cache"
+#define PAM_PATH "/tmp/neuro-lens-bench-ops.pam"
+#define BMP_PATH "/tmp/neuro-lens-bench-ops.bmp"
+#define SCALING_SIZE 4 // Index of the 4K entry in sizes
+#define AUG_BATCH 8     // Images per augment_batch call, all drawn from the source
+
+typedef struct {
+    int width, height;
+    const char *label;
+} bench_size;
+
+static const bench_size sizes[] = {
+    { 64, 64, "64x64" },
+    { 256, 256, "256x256" },
+    { 1024, 1024, "1024x1024" },
+    { 1920, 1080, "1080p" },
+    { 3840, 2160, "4k" },
+    { 7680, 4320, "8k" },
+};
+
+// Per-size inputs and outputs shared by the cases
+typedef struct {
+    Image *src;     // Photo-like RGBA8 source, never modified
+    Image *work;    // Scratch copy for in-place operations
+    Image *half;    // Half-size resize target
+    Image *small;   // 224x224 resize target
+    Image *rotated; // Same-size rotate target
+    Image *turned;  // Quarter-turn rotate target
+    img_tensor *planar_f32; // Same-size NCHW float32 RGB target
+    img_tensor *planar_u8;  // Same-size NCHW uint8 RGB source
+    img_tensor *aug_batch;  // AUG_BATCH x 224x224 NCHW float32 RGB augmentation target
+    img_cache *cache;       // Disk-only cache: every lookup maps the stored entry
+} fixture;
+
+typedef struct {
+    const char *name;
+    int (*run)(fixture *f);
+    int png_channels; // Load cases decode a PNG_PATH with 1, 3 or 4 channels; 0 otherwise
+    const char *file; // Load cases of uncompressed files read this one, written from the source first
+} bench_op;
+
+typedef struct {
+    char name[64];
+    int width, height;
+    int trials;
+    double p50, p99, min; // Seconds per call
+} bench_result;
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted samples
+static double percentile(const double *sorted, int n, double p)
+{
+    int rank = (int)(p / 100.0 * n + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > n) rank = n;
+    return sorted[rank - 1];
+}
+
+/* ------------------------------------------------------------------------- */
+/* Fixtures                                                                  */
+/* ------------------------------------------------------------------------- */
+
+// Smooth gradients plus mild noise, roughly the entropy of a photograph
+static void fill_image(Image *img)
+{
+    unsigned seed = 12345;
+    for (int y = 0; y < img->height; y++) {
+        pixel *row = img_row(img, y);
+        for (int x = 0; x < img->width; x++) {
+            seed = seed * 1103515245u + 12345u;
+            int noise = (int)((seed >> 16) & 7) - 4;
+            int r = (x * 255) / img->width + noise;
+            int g = (y * 255) / img->height + noise;
+            int b = ((x + y) * 255) / (img->width + img->height) - noise;
+            row[x].R = (unsigned char)(r < 0 ? 0 : r > 255 ? 255 : r);
+            row[x].G = (unsigned char)(g < 0 ? 0 : g > 255 ? 255 : g);
+            row[x].B = (unsigned char)(b < 0 ? 0 : b > 255 ? 255 : b);
+            row[x].A = 255;
+        }
+    }
+}
+
+static void fixture_free(fixture *f)
+{
+    img_free(f->src);
+    img_free(f->work);
+    img_free(f->half);
+    img_free(f->small);
+    img_free(f->rotated);
+    img_free(f->turned);
+    img_tensor_free(f->planar_f32);
+    img_tensor_free(f->planar_u8);
+    img_tensor_free(f->aug_batch);
+    if (f->cache) {
+        img_cache_clear(f->cache);
+        img_cache_free(f->cache);
+        rmdir(CACHE_DIR);
+    }
+}
+
+static int fixture_init(fixture *f, const bench_size *size)
+{
+    memset(f, 0, sizeof(*f));
+    f->src = img_new(size->width, size->height);
+    f->half = img_new(size->width / 2, size->height / 2);
+    f->small = img_new(224, 224);
+    f->rotated = img_new(size->width, size->height);
+    f->turned = img_new(size->height, size->width);
+    f->planar_f32 = img_tensor_new(1, size->height, size->width, 3, IMG_LAYOUT_NCHW, IMG_TENSOR_FLOAT32);
+    f->planar_u8 = img_tensor_new(1, size->height, size->width, 3, IMG_LAYOUT_NCHW, IMG_TENSOR_UINT8);
+    f->aug_batch = img_tensor_new(AUG_BATCH, 224, 224, 3, IMG_LAYOUT_NCHW, IMG_TENSOR_FLOAT32);
+    img_cache_options cache_opts = img_cache_defaults();
+    cache_opts.memory_bytes = 1; // Too small for any entry
+    cache_opts.disk_dir = CACHE_DIR;
+    f->cache = img_cache_new(&cache_opts);
+    if (!f->src || !f->half || !f->small || !f->rotated || !f->turned || !f->planar_f32 || !f->planar_u8 ||
+        !f->aug_batch || !f->cache) {
+        fixture_free(f);
+        return RET_FAIL;
+    }
+    fill_image(f->src);
+    f->work = img_copy(f->src);
+    if (!f->work || img_tensor_from_image(f->src, f->planar_u8, 0) != RET_SUCCESS) {
+        fixture_free(f);
+        return RET_FAIL;
+    }
+    return RET_SUCCESS;
+}
+
+// Encodes the source as gray, RGB or RGBA with libpng's default settings
+static int write_png_channels(const Image *img, int channels)
+{
+    png_image png;
+    memset(&png, 0, sizeof(png));
+    png.version = PNG_IMAGE_VERSION;
+    png.width = img->width;
+    png.height = img->height;
+    png.format = channels == 1 ? PNG_FORMAT_GRAY : channels == 3 ? PNG_FORMAT_RGB : PNG_FORMAT_RGBA;
+
+    unsigned char *buffer = (unsigned char *)malloc((size_t)img->width * img->height * channels);
+    if (!buffer) return RET_FAIL;
+
+    unsigned char *out = buffer;
+    for (int y = 0; y < img->height; y++) {
+        const pixel *row = img_row(img, y);
+        for (int x = 0; x < img->width; x++) {
+            const pixel *p = &row[x];
+            if (channels == 1) {
+                *out++ = (unsigned char)((p->R * 77 + p->G * 150 + p->B * 29) >> 8);
+            } else {
+                *out++ = p->R;
+                *out++ = p->G;
+                *out++ = p->B;
+                if (channels == 4) *out++ = p->A;
+            }
+        }
+    }
+
+    int ok = png_image_write_to_file(&png, PNG_PATH, 0, buffer, 0, NULL);
+    free(buffer);
+    return ok ? RET_SUCCESS : RET_FAIL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Operations                                                                */
+/* ------------------------------------------------------------------------- */
+
+static int op_resize_bilinear(fixture *f)
+{
+    return img_resize_into(f->src, f->half, IMG_FILTER_BILINEAR);
+}
+
+static int op_resize_area(fixture *f)
+{
+    return img_resize_into(f->src, f->small, IMG_FILTER_AREA);
+}
+
+// Crop to the centre half; a crop is a view, so this measures the handle swap
+static int op_crop(fixture *f)
+{
+    Image *img = img_view(f->src, 0, 0, f->src->width, f->src->height);
+    int ret = img_crop(&img, f->src->width / 4, f->src->height / 4, f->src->width / 2, f->src->height / 2);
+    img_free(img);
+    return ret;
+}
+
+// Crop to the centre half and materialize the pixels
+static int op_crop_copy(fixture *f)
+{
+    Image *view = img_view(f->src, f->src->width / 4, f->src->height / 4, f->src->width / 2, f->src->height / 2);
+    Image *copy = img_copy(view);
+    int ret = copy ? RET_SUCCESS : RET_FAIL;
+    img_free(view);
+    img_free(copy);
+    return ret;
+}
+
+static int op_flip(fixture *f)
+{
+    img_flip_horizontal(f->work);
+    return RET_SUCCESS;
+}
+
+static int op_rotate_bilinear(fixture *f)
+{
+    return img_rotate_into(f->src, f->rotated, 17.0f, IMG_FILTER_BILINEAR, IMG_BORDER_CONSTANT, (pixel){ 0, 0, 0, 0 });
+}
+
+static int op_rotate_90(fixture *f)
+{
+    return img_rotate_into(f->src, f->turned, 90.0f, IMG_FILTER_NEAREST, IMG_BORDER_CONSTANT, (pixel){ 0, 0, 0, 0 });
+}
+
+// Split RGBA8 into float32 RGB planes, the input layout of most float models
+static int op_to_planar_f32(fixture *f)
+{
+    return img_tensor_from_image(f->src, f->planar_f32, 0);
+}
+
+static int op_from_planar_u8(fixture *f)
+{
+    return img_tensor_to_image(f->planar_u8, 0, f->work);
+}
+
+// ImageNet-style per-channel standardization into float32 planes
+static int op_normalize_nchw_f32(fixture *f)
+{
+    img_norm_spec spec = img_norm_defaults();
+    spec.method = IMG_NORM_STANDARDIZE;
+    spec.layout = IMG_LAYOUT_NCHW;
+    const float mean[3] = { 123.675f, 116.28f, 103.53f }, std[3] = { 58.395f, 57.12f, 57.375f };
+    memcpy(spec.mean, mean, sizeof(mean));
+    memcpy(spec.std, std, sizeof(std));
+    return img_normalize(f->src, &spec, f->planar_f32->data);
+}
+
+static int op_channel_stats(fixture *f)
+{
+    img_channel_stats stats;
+    img_stats_init(&stats);
+    return img_stats_accumulate(&stats, f->src);
+}
+
+static int op_ycbcr_planes(fixture *f)
+{
+    uint8_t *planes[3];
+    for (int c = 0; c < 3; c++) planes[c] = (uint8_t *)img_tensor_plane(f->planar_u8, 0, c);
+    return img_rgb_to_color_planes(f->src, IMG_COLOR_YCBCR_709_LIMITED, planes, f->src->width);
+}
+
+static int op_ycbcr_planes_to_rgb(fixture *f)
+{
+    const uint8_t *planes[3];
+    for (int c = 0; c < 3; c++) planes[c] = (const uint8_t *)img_tensor_plane(f->planar_u8, 0, c);
+    return img_color_planes_to_rgb(planes, f->src->width, IMG_COLOR_YCBCR_709_LIMITED, f->rotated);
+}
+
+static int op_gray_plane(fixture *f)
+{
+    uint8_t *planes[3] = { (uint8_t *)img_tensor_plane(f->planar_u8, 0, 0), NULL, NULL };
+    return img_rgb_to_color_planes(f->src, IMG_COLOR_GRAY, planes, f->src->width);
+}
+
+static int op_rgb_to_hsv(fixture *f)
+{
+    return img_rgb_to_color(f->src, f->rotated, IMG_COLOR_HSV);
+}
+
+static int op_hsv_to_rgb(fixture *f)
+{
+    return img_color_to_rgb(f->src, f->rotated, IMG_COLOR_HSV);
+}
+
+// A typical augmentation chain: halve, crop the center quarter, rotate, mirror
+static int op_chain_staged(fixture *f)
+{
+    int w = f->src->width / 2, h = f->src->height / 2;
+    Image *img = img_new(w, h);
+    if (!img) return RET_FAIL;
+    int ret = img_resize_into(f->src, img, IMG_FILTER_BILINEAR);
+    if (ret == RET_SUCCESS) ret = img_crop(&img, w / 4, h / 4, w / 2, h / 2);
+    if (ret == RET_SUCCESS) ret = img_rotate(img, 10.0f);
+    if (ret == RET_SUCCESS) img_flip_horizontal(img);
+    img_free(img);
+    return ret;
+}
+
+// The same chain recorded on a transform and sampled once
+static int op_chain_fused(fixture *f)
+{
+    int w = f->src->width / 2, h = f->src->height / 2;
+    img_transform *t = img_transform_new(f->src->width, f->src->height);
+    Image *img = NULL;
+    if (t && img_transform_resize(t, w, h) == RET_SUCCESS &&
+        img_transform_crop(t, w / 4, h / 4, w / 2, h / 2) == RET_SUCCESS &&
+        img_transform_rotate(t, 10.0f) == RET_SUCCESS && img_transform_flip_horizontal(t) == RET_SUCCESS) {
+        img = img_transform_render(t, f->src, IMG_FILTER_BILINEAR);
+    }
+    img_transform_free(t);
+    int ret = img ? RET_SUCCESS : RET_FAIL;
+    img_free(img);
+    return ret;
+}
+
+// A training batch: random resized crop, flip, rotation, colour jitter, cutout and standardization per image
+static int op_augment_batch(fixture *f)
+{
+    const Image *srcs[AUG_BATCH];
+    for (int i = 0; i < AUG_BATCH; i++) srcs[i] = f->src;
+    aug_policy policy = aug_policy_defaults();
+    static const float mean[3] = { 123.675f, 116.28f, 103.53f }, std[3] = { 58.395f, 57.12f, 57.375f };
+    for (int ch = 0; ch < 3; ch++) {
+        policy.mean[ch] = mean[ch];
+        policy.std[ch] = std[ch];
+    }
+    return aug_batch(srcs, AUG_BATCH, &policy, 0, f->aug_batch, NULL);
+}
+
+static int op_png_load(fixture *f)
+{
+    Image *img = img_load(PNG_PATH);
+    int ok = img && img->width == f->src->width && img->height == f->src->height;
+    img_free(img);
+    return ok ? RET_SUCCESS : RET_FAIL;
+}
+
+// Warm cache lookup of the decoded PNG, reading every pixel as a consumer would
+static int op_cache_disk_hit(fixture *f)
+{
+    Image *img = img_cache_load(f->cache, PNG_PATH, NULL, IMG_FILTER_NEAREST);
+    int ok = img && img->width == f->work->width && img->height == f->work->height;
+    for (int y = 0; ok && y < img->height; y++) {
+        memcpy(img_row(f->work, y), img_row(img, y), sizeof(pixel) * img->width);
+    }
+    img_free(img);
+    return ok ? RET_SUCCESS : RET_FAIL;
+}
+
+// Maps an uncompressed file and reads every pixel, so the page faults are counted
+static int load_mapped(fixture *f, const char *path)
+{
+    Image *img = img_load(path);
+    int ok = img && img->width == f->work->width && img->height == f->work->height;
+    for (int y = 0; ok && y < img->height; y++) {
+        memcpy(img_row(f->work, y), img_row(img, y), sizeof(pixel) * img->width);
+    }
+    img_free(img);
+    return ok ? RET_SUCCESS : RET_FAIL;
+}
+
+static int op_pam_load(fixture *f)
+{
+    return load_mapped(f, PAM_PATH);
+}
+
+static int op_bmp_load(fixture *f)
+{
+    return load_mapped(f, BMP_PATH);
+}
+
+static int op_pam_write(fixture *f)
+{
+    return img_write_opts(PAM_PATH, f->src, NULL);
+}
+
+// The fastest useful encoder settings, so the 8K case stays within seconds
+static int op_png_write(fixture *f)
+{
+    img_write_options opts = img_write_defaults();
+    opts.level = 1;
+    opts.filter = IMG_PNG_FILTER_UP;
+    return img_write_opts(PNG_PATH, f->src, &opts);
+}
+
+static const bench_op ops[] = {
+    { "resize_bilinear_half", op_resize_bilinear, 0, NULL },
+    { "resize_area_224", op_resize_area, 0, NULL },
+    { "crop", op_crop, 0, NULL },
+    { "crop_copy", op_crop_copy, 0, NULL },
+    { "flip", op_flip, 0, NULL },
+    { "rotate_bilinear", op_rotate_bilinear, 0, NULL },
+    { "rotate_90", op_rotate_90, 0, NULL },
+    { "to_planar_f32", op_to_planar_f32, 0, NULL },
+    { "from_planar_u8", op_from_planar_u8, 0, NULL },
+    { "normalize_nchw_f32", op_normalize_nchw_f32, 0, NULL },
+    { "channel_stats", op_channel_stats, 0, NULL },
+    { "ycbcr_planes", op_ycbcr_planes, 0, NULL },
+    { "ycbcr_planes_to_rgb", op_ycbcr_planes_to_rgb, 0, NULL },
+    { "gray_plane", op_gray_plane, 0, NULL },
+    { "rgb_to_hsv", op_rgb_to_hsv, 0, NULL },
+    { "hsv_to_rgb", op_hsv_to_rgb, 0, NULL },
+    { "chain_staged", op_chain_staged, 0, NULL },
+    { "chain_fused", op_chain_fused, 0, NULL },
+    { "augment_batch", op_augment_batch, 0, NULL },
+    { "png_load_gray", op_png_load, 1, NULL },
+    { "png_load_rgb", op_png_load, 3, NULL },
+    { "png_load_rgba", op_png_load, 4, NULL },
+    { "cache_disk_hit", op_cache_disk_hit, 4, NULL },
+    { "png_write_fast", op_png_write, 0, NULL },
+    { "pam_load", op_pam_load, 0, PAM_PATH },
+    { "bmp_load", op_bmp_load, 0, BMP_PATH },
+    { "pam_write", op_pam_write, 0, NULL },
+};
+
+// Cases that split their work across threads: one image in bands, or a batch by image
+static const char *const scaling_ops[] = {
+    "resize_bilinear_half", "flip", "rotate_bilinear", "rotate_90", "chain_fused", "augment_batch",
+};
+
+static const int scaling_threads[] = { 1, 2, 4, 8, 16 };
+
+/* ------------------------------------------------------------------------- */
+/* Measurement                                                               */
+/* ------------------------------------------------------------------------- */
+
+// Times one sample of `reps` calls and returns seconds per call, or a negative value on failure
+static double time_sample(const bench_op *op, fixture *f, int reps)
+{
+    double start = now_seconds();
+    for (int i = 0; i < reps; i++) {
+        if (op->run(f) != RET_SUCCESS) return -1.0;
+    }
+    return (now_seconds() - start) / reps;
+}
+
+static int run_case(const bench_op *op, fixture *f, bench_result *result)
+{
+    // Warm up, doubling the calls per sample until one sample is long enough to time
+    int reps = 1;
+    double warm_start = now_seconds();
+    for (;;) {
+        double t = time_sample(op, f, reps);
+        if (t < 0) return RET_FAIL;
+        if (t * reps < MIN_SAMPLE_SECONDS && reps < (1 << 16)) {
+            reps *= 2;
+            continue;
+        }
+        if (now_seconds() - warm_start >= WARMUP_SECONDS) break;
+    }
+
+    static double samples[MAX_TRIALS];
+    int n = 0;
+    double start = now_seconds();
+    while (n < MAX_TRIALS) {
+        double t = time_sample(op, f, reps);
+        if (t < 0) return RET_FAIL;
+        samples[n++] = t;
+        double elapsed = now_seconds() - start;
+        if (n >= MIN_TRIALS && elapsed >= MIN_SECONDS) break;
+        if (n >= 3 && elapsed >= MAX_SECONDS) break;
+    }
+
+    qsort(samples, n, sizeof(double), compare_double);
+    result->trials = n;
+    result->min = samples[0];
+    result->p50 = percentile(samples, n, 50.0);
+    result->p99 = percentile(samples, n, 99.0);
+    return RET_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+/* JSON                                                                      */
+/* ------------------------------------------------------------------------- */
+
+static int write_json(const char *path, const bench_result *results, int count)
+{
+    FILE *fp = fopen(path, "w");
+    if (!fp) return RET_FAIL;
+
+    fprintf(fp, "{\n  \"cpu\": \"%s\",\n  \"cases\": [\n", img_cpu_kernels());
+    for (int i = 0; i < count; i++) {
+        const bench_result *r = &results[i];
+        double mpix = (double)r->width * r->height / 1e6;
+        fprintf(fp, "    {\"name\": \"%s\", \"width\": %d, \"height\": %d, \"trials\": %d, "
+                    "\"mpix_s\": %.3f, \"p50_ms\": %.6f, \"p99_ms\": %.6f, \"min_ms\": %.6f}%s\n",
+                r->name, r->width, r->height, r->trials, mpix / r->p50,
+                r->p50 * 1e3, r->p99 * 1e3, r->min * 1e3, i + 1 < count ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+    return fclose(fp) == 0 ? RET_SUCCESS : RET_FAIL;
+}
+
+// Reads a file written by write_json() into memory
+static char* read_file(const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char *text = size >= 0 ? (char *)malloc(size + 1) : NULL;
+    if (text && fread(text, 1, size, fp) != (size_t)size) {
+        free(text);
+        text = NULL;
+    }
+    if (text) text[size] = '\0';
+    fclose(fp);
+    return text;
+}
+
+// Finds the baseline p50 of a case in the JSON text; returns a negative value when it is absent
+static double baseline_p50(const char *json, const char *name)
+{
+    char key[96];
+    snprintf(key, sizeof(key), "\"name\": \"%s\"", name);
+    const char *at = strstr(json, key);
+    if (!at) return -1.0;
+
+    const char *end = strchr(at, '}');
+    const char *p50 = strstr(at, "\"p50_ms\":");
+    if (!p50 || (end && p50 > end)) return -1.0;
+    return strtod(p50 + strlen("\"p50_ms\":"), NULL) / 1e3;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Driver                                                                    */
+/* ------------------------------------------------------------------------- */
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [--json FILE] [--baseline FILE] [--threshold PCT] [--filter TEXT] [--scaling]\n",
+            prog);
+}
+
+// Times each scaling case at every thread count and prints its speedup over one thread
+static int run_scaling(const char *filter)
+{
+    const bench_size *size = &sizes[SCALING_SIZE];
+    fixture f;
+    if (fixture_init(&f, size) != RET_SUCCESS) {
+        fprintf(stderr, "Could not allocate %s benchmark images.\n", size->label);
+        return 1;
+    }
+
+    int threads_before = img_get_threads();
+    printf("ops scaling, %s kernels, %s (p50 ms and speedup over 1 thread)\n", img_cpu_kernels(), size->label);
+    int fails = 0;
+    for (size_t i = 0; i < sizeof(scaling_ops) / sizeof(scaling_ops[0]); i++) {
+        if (filter && !strstr(scaling_ops[i], filter)) continue;
+
+        const bench_op *op = NULL;
+        for (size_t o = 0; o < sizeof(ops) / sizeof(ops[0]); o++) {
+            if (strcmp(ops[o].name, scaling_ops[i]) == 0) op = &ops[o];
+        }
+        if (!op) continue;
+
+        printf("  %-24s", op->name);
+        double single = 0.0;
+        for (size_t t = 0; t < sizeof(scaling_threads) / sizeof(scaling_threads[0]); t++) {
+            bench_result r;
+            img_set_threads(scaling_threads[t]);
+            if (run_case(op, &f, &r) != RET_SUCCESS) {
+                printf("  %2dT FAILED", scaling_threads[t]);
+                fails++;
+                break;
+            }
+            if (t == 0) single = r.p50;
+            printf("  %2dT %8.3f ms %5.2fx", scaling_threads[t], r.p50 * 1e3, single / r.p50);
+            fflush(stdout);
+        }
+        printf("\n");
+    }
+    img_set_threads(threads_before);
+    fixture_free(&f);
+    return fails ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *json_path = NULL;
+    const char *baseline_path = NULL;
+    const char *filter = NULL;
+    double threshold = DEFAULT_THRESHOLD;
+    int scaling = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "--json") == 0) json_path = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--baseline") == 0) baseline_path = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--threshold") == 0) threshold = atof(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--filter") == 0) filter = argv[++i];
+        else if (strcmp(argv[i], "--scaling") == 0) scaling = 1;
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (scaling) return run_scaling(filter);
+
+    char *baseline = baseline_path ? read_file(baseline_path) : NULL;
+    if (baseline_path && !baseline) printf("ops: no baseline at %s, comparison skipped\n", baseline_path);
+
+    int capacity = (int)(sizeof(sizes) / sizeof(sizes[0]) * sizeof(ops) / sizeof(ops[0]));
+    bench_result *results = (bench_result *)calloc(capacity, sizeof(bench_result));
+    if (!results) return 1;
+
+    printf("ops, %s kernels (source Mpix/s at p50)\n", img_cpu_kernels());
+    int count = 0, fails = 0, regressions = 0;
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        fixture f;
+        int ready = 0;
+
+        for (size_t o = 0; o < sizeof(ops) / sizeof(ops[0]); o++) {
+            bench_result *r = &results[count];
+            snprintf(r->name, sizeof(r->name), "%s/%s", ops[o].name, sizes[s].label);
+            if (filter && !strstr(r->name, filter)) continue;
+
+            if (!ready) {
+                if (fixture_init(&f, &sizes[s]) != RET_SUCCESS) {
+                    fprintf(stderr, "Could not allocate %s benchmark images.\n", sizes[s].label);
+                    free(results);
+                    free(baseline);
+                    return 1;
+                }
+                ready = 1;
+            }
+
+            r->width = sizes[s].width;
+            r->height = sizes[s].height;
+            if ((ops[o].png_channels && write_png_channels(f.src, ops[o].png_channels) != RET_SUCCESS) ||
+                (ops[o].file && img_write_opts(ops[o].file, f.src, NULL) != RET_SUCCESS) ||
+                run_case(&ops[o], &f, r) != RET_SUCCESS) {
+                printf("  %-32s FAILED\n", r->name);
+                fails++;
+                continue;
+            }
+            count++;
+
+            char delta[48] = "";
+            double base = baseline ? baseline_p50(baseline, r->name) : -1.0;
+            if (base > 0) {
+                double change = (r->p50 / base - 1.0) * 100.0;
+                int regressed = change > threshold;
+                regressions += regressed;
+                snprintf(delta, sizeof(delta), "  %+6.1f%%%s", change, regressed ? "  REGRESSION" : "");
+            }
+            printf("  %-32s p50 %10.4f ms  p99 %10.4f ms  %10.1f Mpix/s%s\n", r->name, r->p50 * 1e3,
+                   r->p99 * 1e3, (double)r->width * r->height / 1e6 / r->p50, delta);
+        }
+        if (ready) fixture_free(&f);
+    }
+    remove(PNG_PATH);
+    remove(PAM_PATH);
+    remove(BMP_PATH);
+
+    if (json_path && write_json(json_path, results, count) != RET_SUCCESS) {
+        fprintf(stderr, "Could not write %s.\n", json_path);
+        fails++;
+    }
+    if (regressions) printf("ops: %d cases more than %.1f%% slower than the baseline\n", regressions, threshold);
+
+    free(results);
+    free(baseline);
+    return fails || regressions ? 1 : 0;
+}
@@ -0,0 +1,125 @@
+/**
+ * Resize throughput benchmark.
+ *
+ * Compares the separable resize engine against the original per-pixel
+ * nearest-neighbor loop and reports source Mpix/s for each scenario.
+ * Exits non-zero when the engine misses its throughput targets.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../include/img_utils.h"
+
+#define ITERATIONS 20
+
+// The area filter reads every source pixel; it must sustain this many source Mpix/s
+#define TARGET_AREA_MPIXS 400.0
+// The nearest filter must be at least this many times faster than the original loop
+#define TARGET_NEAREST_SPEEDUP 1.0
+
+typedef struct {
+    int src_width, src_height;
+    int dst_width, dst_height;
+} scenario;
+
+static const scenario scenarios[] = {
+    { 4032, 3024, 224, 224 }, // Camera frame to MobileNet input
+    { 1920, 1080, 960, 540 }, // Moderate 2x downscale where per-pixel cost dominates
+};
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// The nearest-neighbor loop img_resize used before the separable engine
+static void legacy_resize(const Image *src, Image *dst)
+{
+    int scaleX = (src->width << 10) / dst->width;
+    int scaleY = (src->height << 10) / dst->height;
+
+    int srcY = 0;
+    for (int y = 0; y < dst->height; y++, srcY += scaleY) {
+        int srcX = 0;
+        for (int x = 0; x < dst->width; x++, srcX += scaleX) {
+            dst->pixels[y * dst->width + x] = src->pixels[(srcY >> 10) * src->width + (srcX >> 10)];
+        }
+    }
+}
+
+static double run_legacy(const Image *src, Image *dst)
+{
+    double t0 = now_seconds();
+    for (int i = 0; i < ITERATIONS; i++) legacy_resize(src, dst);
+    return (now_seconds() - t0) / ITERATIONS;
+}
+
+static double run_engine(const Image *src, Image *dst, img_filter filter)
+{
+    img_resize_into(src, dst, filter); // Warm up and build the coefficient tables
+    double t0 = now_seconds();
+    for (int i = 0; i < ITERATIONS; i++) img_resize_into(src, dst, filter);
+    return (now_seconds() - t0) / ITERATIONS;
+}
+
+static void report(const char *name, double seconds, double mpix)
+{
+    printf("  %-10s %8.3f ms  %9.1f Mpix/s\n", name, seconds * 1e3, mpix / seconds);
+}
+
+static int run_scenario(const scenario *sc)
+{
+    Image *src = img_new(sc->src_width, sc->src_height);
+    Image *dst = img_new(sc->dst_width, sc->dst_height);
+    if (!src || !dst) {
+        fprintf(stderr, "Could not allocate benchmark images.\n");
+        img_free(src);
+        img_free(dst);
+        return 0;
+    }
+
+    srand(1);
+    for (int i = 0; i < sc->src_width * sc->src_height; i++) {
+        src->pixels[i].R = rand() & 0xff;
+        src->pixels[i].G = rand() & 0xff;
+        src->pixels[i].B = rand() & 0xff;
+        src->pixels[i].A = 0xff;
+    }
+
+    double mpix = (double)sc->src_width * sc->src_height / 1e6;
+    printf("resize %dx%d -> %dx%d (source Mpix/s)\n", sc->src_width, sc->src_height, sc->dst_width, sc->dst_height);
+    double legacy = run_legacy(src, dst);
+    double nearest = run_engine(src, dst, IMG_FILTER_NEAREST);
+    double bilinear = run_engine(src, dst, IMG_FILTER_BILINEAR);
+    double area = run_engine(src, dst, IMG_FILTER_AREA);
+    report("legacy", legacy, mpix);
+    report("nearest", nearest, mpix);
+    report("bilinear", bilinear, mpix);
+    report("area", area, mpix);
+
+    int ok = 1;
+    if (mpix / area < TARGET_AREA_MPIXS) {
+        printf("FAIL: area %.1f Mpix/s below target %.1f Mpix/s\n", mpix / area, TARGET_AREA_MPIXS);
+        ok = 0;
+    }
+    if (legacy / nearest < TARGET_NEAREST_SPEEDUP) {
+        printf("FAIL: nearest is %.2fx the original loop, target %.2fx\n", legacy / nearest, TARGET_NEAREST_SPEEDUP);
+        ok = 0;
+    }
+
+    img_free(src);
+    img_free(dst);
+    return ok;
+}
+
+int main(void)
+{
+    int ok = 1;
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        ok &= run_scenario(&scenarios[i]);
+    }
+    return ok ? 0 : 1;
+}
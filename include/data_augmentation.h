@@ -0,0 +1,145 @@
+/**
+ * @file data_augmentation.h
+ * Public API for randomized data augmentation.
+ *
+ * A policy describes the distributions of a random resized crop, a
+ * horizontal flip, a small rotation, brightness, contrast and saturation
+ * jitter and a cutout. The parameters of each image are drawn from a
+ * counter-based generator keyed by the policy seed and the image's sample
+ * number, so they do not depend on the order in which images are processed
+ * or on how many threads process them: the same seed and sample number
+ * always give the same output.
+ *
+ * The steps are fused. Each output row is sampled once from the source
+ * through a single affine map covering the crop, resize, rotation and flip,
+ * then jittered, cut out, normalized and stored into its tensor slot while
+ * it is still in cache. No intermediate image is produced.
+ */
+
+#ifndef DATA_AUGMENTATION_H
+#define DATA_AUGMENTATION_H
+
+#include <stdint.h>
+
+#include "img_utils.h"
+
+/**
+ * Distributions the per-image augmentation parameters are drawn from.
+ * Start from aug_policy_defaults() and adjust the fields.
+ */
+typedef struct {
+    uint64_t seed;          ///< Key of the random generator
+    float scale_min;        ///< Smallest crop area as a fraction of the source area, in (0, 1]
+    float scale_max;        ///< Largest crop area as a fraction of the source area, in [scale_min, 1]
+    float ratio_min;        ///< Smallest crop aspect ratio (width / height), > 0
+    float ratio_max;        ///< Largest crop aspect ratio; ratios are drawn log-uniformly
+    float flip_prob;        ///< Probability of mirroring the output horizontally
+    float max_angle;        ///< Rotations are drawn uniformly from [-max_angle, max_angle] degrees
+    float brightness;       ///< Brightness factor drawn from [1 - brightness, 1 + brightness]
+    float contrast;         ///< Contrast factor drawn from [1 - contrast, 1 + contrast]
+    float saturation;       ///< Saturation factor drawn from [1 - saturation, 1 + saturation]
+    float cutout_prob;      ///< Probability of erasing a rectangle of the output
+    float cutout_min;       ///< Smallest cutout side as a fraction of the output side, in [0, 1]
+    float cutout_max;       ///< Largest cutout side as a fraction of the output side, in [cutout_min, 1]
+    pixel cutout_fill;      ///< Value of erased pixels, before normalization
+    img_filter filter;      ///< IMG_FILTER_NEAREST samples nearest neighbors; any other filter is bilinear
+    img_border border;      ///< How rotated outputs sample positions outside the source
+    pixel fill;             ///< The color used by IMG_BORDER_CONSTANT
+    float mean[4];          ///< Float tensors: mean subtracted per channel, in 0-255 units
+    float std[4];           ///< Float tensors: divisor per channel, in 0-255 units
+} aug_policy;
+
+/**
+ * Augmentation parameters drawn for one image.
+ */
+typedef struct {
+    float crop_x;           ///< Left edge of the source area mapped onto the output
+    float crop_y;           ///< Top edge of the source area
+    float crop_width;       ///< Width of the source area
+    float crop_height;      ///< Height of the source area
+    int flip;               ///< Non-zero to mirror the output horizontally
+    float angle;            ///< Clockwise rotation of the output about its center, in degrees
+    float brightness;       ///< Brightness factor, 1 for none
+    float contrast;         ///< Contrast factor, 1 for none
+    float saturation;       ///< Saturation factor, 1 for none
+    int cutout_x;           ///< Left edge of the erased rectangle in output pixels
+    int cutout_y;           ///< Top edge of the erased rectangle
+    int cutout_width;       ///< Width of the erased rectangle; 0 for no cutout
+    int cutout_height;      ///< Height of the erased rectangle; 0 for no cutout
+} aug_params;
+
+/**
+ * Returns the default policy: seed 0, crops of 8% to 100% of the area with
+ * aspect ratios from 3/4 to 4/3, flips with probability 0.5, rotations up to
+ * 10 degrees, brightness, contrast and saturation jitter of 0.4, cutout with
+ * probability 0.5 and sides from 10% to 30%, erased to mid gray, bilinear
+ * sampling with reflected borders, mean 0 and std 1.
+ *
+ * @return The policy, which the caller may adjust before use.
+ */
+aug_policy aug_policy_defaults(void);
+
+/**
+ * Draws the parameters of one image.
+ *
+ * The result only depends on the policy, the sample number and the sizes.
+ * Use a different sample number for every image of every epoch, e.g.
+ * `epoch * dataset_size + index`, to get fresh parameters each time.
+ *
+ * @param policy The policy.
+ * @param sample The sample number.
+ * @param src_width The source image width.
+ * @param src_height The source image height.
+ * @param width The output width.
+ * @param height The output height.
+ * @param params Receives the parameters.
+ * @return RET_SUCCESS on success, or RET_FAIL if the policy or a size is invalid.
+ */
+int aug_sample(const aug_policy *policy, uint64_t sample, int src_width, int src_height, int width, int height,
+               aug_params *params);
+
+/**
+ * Produces one augmented image into a tensor slot.
+ *
+ * Contrast is blended toward the mean gray level of the source crop
+ * area, estimated from a sparse grid of samples, so that the output is made
+ * in a single pass. Brightness, contrast and saturation are applied in
+ * that order as one colour matrix, and the result is clamped to 0 to 255.
+ * Then cutout is applied. Uint8 tensors receive the rounded values; float
+ * tensors receive (v - mean) / std. A fourth channel receives the
+ * sampled alpha, without jitter. Downscaling crops are sampled bilinearly
+ * without prefiltering.
+ *
+ * @param src The source image. It is not modified.
+ * @param params The parameters, e.g. from aug_sample().
+ * @param policy The policy, for the filter, border, cutout fill and
+ *               normalization.
+ * @param dst The tensor, with 3 or 4 channels. Its height and width are the
+ *            output size.
+ * @param index The slot in the batch.
+ * @return RET_SUCCESS on success, or RET_FAIL if an argument is invalid or
+ *         allocation fails.
+ */
+int aug_apply(const Image *src, const aug_params *params, const aug_policy *policy, img_tensor *dst, int index);
+
+/**
+ * Augments a batch of images into a preallocated tensor.
+ *
+ * Image i gets the parameters aug_sample() draws for sample number
+ * `first_sample + i` and is written to slot i. The images may have
+ * different sizes. Images are distributed over the library's thread pool
+ * (see img_set_threads()). The output is the same for every thread count.
+ *
+ * @param srcs The source images.
+ * @param count The number of images, at most dst->batch.
+ * @param policy The policy.
+ * @param first_sample The sample number of the first image.
+ * @param dst The tensor, with 3 or 4 channels.
+ * @param params If not NULL, receives the parameters of each image; count entries.
+ * @return RET_SUCCESS on success, or RET_FAIL if an argument is invalid or
+ *         any image fails.
+ */
+int aug_batch(const Image *const *srcs, int count, const aug_policy *policy, uint64_t first_sample,
+              img_tensor *dst, aug_params *params);
+
+#endif // DATA_AUGMENTATION_H
@@ -11,6 +11,10 @@
 #ifndef IMG_UTILS_H
 #define IMG_UTILS_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
 /**
  * Structure representing a pixel with Red, Green, Blue, and Alpha channels.
  * Each channel is 8 bits, supporting values from 0 to 255.
@@ -22,16 +26,57 @@ typedef struct {
     unsigned char A; ///< Alpha channel (0-255) for transparency
 } pixel;
 
+/**
+ * Reference-counted pixel buffer shared by an image and its views. Opaque to
+ * library users.
+ */
+typedef struct img_storage img_storage;
+
 /**
  * Structure representing an image, consisting of its dimensions (width and height)
  * and an array of pixels storing the image data.
+ *
+ * Rows are `stride` pixels apart, so an Image can be a view into a larger
+ * buffer: row y starts at `pixels + y * stride`. Always address pixels through
+ * the stride (see img_row()); width == stride only holds for images created
+ * by img_new().
  */
 typedef struct {
-    int width;     ///< Width of the image in pixels
-    int height;    ///< Height of the image in pixels
-    pixel *pixels; ///< Pointer to the array of pixel data
+    int width;            ///< Width of the image in pixels
+    int height;           ///< Height of the image in pixels
+    int stride;           ///< Distance between the starts of consecutive rows, in pixels
+    pixel *pixels;        ///< Pointer to the first pixel of the first row
+    img_storage *storage; ///< Shared backing buffer, or NULL when the pixels are borrowed
 } Image;
 
+/**
+ * An 8-bit image in a file's native interleaved channel layout.
+ *
+ * Loading into this layout skips the expansion to RGBA, so callers that only
+ * need RGB (or gray) data never touch an alpha channel. Rows are `stride`
+ * bytes apart.
+ */
+typedef struct {
+    int width;            ///< Width of the image in pixels
+    int height;           ///< Height of the image in pixels
+    int channels;         ///< 1 gray, 2 gray + alpha, 3 RGB or 4 RGBA
+    size_t stride;        ///< Distance between the starts of consecutive rows, in bytes
+    unsigned char *data;  ///< Pointer to the first sample of the first row
+    img_storage *storage; ///< Shared backing buffer
+} img_packed;
+
+/**
+ * Returns a pointer to the first pixel of row y.
+ *
+ * @param img The image.
+ * @param y The row index.
+ * @return The address of pixel (0, y).
+ */
+static inline pixel* img_row(const Image *img, int y)
+{
+    return img->pixels + (size_t)y * img->stride;
+}
+
 
 /**
  * Enum to hold return values
@@ -45,9 +90,11 @@ typedef enum {
 /**
  * Creates a new image with specified dimensions.
  *
- * Allocates memory for a new Image structure and initializes its dimensions and
- * pixel data to default values. The caller is responsible for freeing the
- * allocated Image using img_free().
+ * Allocates memory for a new Image structure and its pixel data. The pixel
+ * contents are left uninitialized; the pixel buffer is 64-byte aligned. Both
+ * allocations are served by the image buffer pool when it is enabled (see
+ * img_pool_enable()). The caller is responsible for freeing the allocated
+ * Image using img_free().
  *
  * @param width The width of the new image.
  * @param height The height of the new image.
@@ -59,18 +106,194 @@ Image* img_new(int width, int height);
  * Frees the memory allocated for an Image structure.
  *
  * This function should be called to free the memory associated with an Image
- * when it is no longer needed.
+ * when it is no longer needed. The pixel buffer is released once the last
+ * image or view referencing it has been freed.
  *
  * @param img The Image to be freed.
  */
 void img_free(Image* img);
 
+/**
+ * Creates a view of a rectangular region of an image without copying.
+ *
+ * The view shares the parent's pixels and keeps them alive, so the parent may
+ * be freed first. Writes through the view are visible in the parent and in
+ * every other overlapping view.
+ *
+ * @param parent The image to view.
+ * @param x The X coordinate of the top-left corner of the region.
+ * @param y The Y coordinate of the top-left corner of the region.
+ * @param width The width of the region.
+ * @param height The height of the region.
+ * @return The new view, or NULL if the region is outside the parent or allocation fails.
+ */
+Image* img_view(const Image *parent, int x, int y, int width, int height);
+
+/**
+ * Wraps caller-owned pixels in an Image without copying.
+ *
+ * The caller keeps ownership of the pixels and must keep them alive until the
+ * returned Image, and every view created from it, has been freed.
+ *
+ * @param pixels The first pixel of the first row.
+ * @param width The width in pixels.
+ * @param height The height in pixels.
+ * @param stride The distance between rows in pixels (at least width).
+ * @return The new Image, or NULL on invalid arguments or allocation failure.
+ */
+Image* img_wrap(pixel *pixels, int width, int height, int stride);
+
+/**
+ * Copies an image or view into a new, contiguous image.
+ *
+ * @param src The image to copy.
+ * @return The copy, or NULL if allocation fails.
+ */
+Image* img_copy(const Image *src);
+
+/**
+ * Counters describing the image buffer pool.
+ */
+typedef struct {
+    unsigned long long hits;           ///< Allocations served from a cached block
+    unsigned long long misses;         ///< Allocations that went to the heap while the pool was enabled
+    unsigned long long releases;       ///< Blocks returned to the pool for reuse
+    unsigned long long evictions;      ///< Blocks returned to the heap because the pool was full
+    unsigned long long bytes_retained; ///< Bytes currently cached by the pool across all threads
+} img_pool_stats;
+
+/**
+ * Enables the image buffer pool.
+ *
+ * Once enabled, img_free() keeps image structs and pixel buffers in
+ * size-class buckets instead of returning them to the heap, and img_new()
+ * reuses them. A pipeline that processes images of recurring sizes then runs
+ * without heap allocations once it has warmed up. Each thread keeps a small
+ * cache of its own before blocks spill into the shared store.
+ *
+ * @param max_retained_bytes Upper bound on the bytes the pool may cache, or 0
+ *                           for the default of 256 MiB.
+ */
+void img_pool_enable(size_t max_retained_bytes);
+
+/**
+ * Disables the image buffer pool and releases every cached block held in the
+ * shared store and in the calling thread's cache.
+ *
+ * Images allocated while the pool was enabled remain valid and can still be
+ * freed with img_free().
+ */
+void img_pool_disable(void);
+
+/**
+ * Returns the cached blocks held in the shared store and in the calling
+ * thread's cache to the heap, leaving the pool enabled.
+ */
+void img_pool_trim(void);
+
+/**
+ * Reads the pool counters.
+ *
+ * @param stats Receives a snapshot of the counters.
+ */
+void img_pool_get_stats(img_pool_stats *stats);
+
+/**
+ * Returns the instruction set the pixel kernels are dispatched to.
+ *
+ * The best level the CPU supports is detected once at startup. Setting the
+ * environment variable NEURO_LENS_CPU to "scalar", "sse2", "ssse3", "avx2"
+ * or "avx512" caps it, e.g. to compare against the scalar reference kernels.
+ *
+ * @return The level name, e.g. "avx2".
+ */
+const char* img_cpu_kernels(void);
+
+/**
+ * Sets how many threads a single large image operation may use.
+ *
+ * Resizing, rotation, flips and transform chains split big images into row
+ * bands run on a shared pool that is started on first use; images under
+ * about 128K pixels always stay on the calling thread, as do operations
+ * called from inside a batch pipeline worker. The default is one thread per
+ * online CPU, or the value of the environment variable NEURO_LENS_THREADS.
+ * It may be called while other threads run image operations: those finish
+ * on the previous pool, which is stopped once the last of them returns.
+ *
+ * @param threads The thread count including the caller, 1 to stay
+ *                single-threaded, or 0 for one per online CPU.
+ * @return RET_SUCCESS on success, or RET_FAIL if threads is negative.
+ */
+int img_set_threads(int threads);
+
+/**
+ * Returns the thread count used by single image operations.
+ *
+ * @return The thread count, at least 1.
+ */
+int img_get_threads(void);
+
+/**
+ * Turns stage instrumentation on or off.
+ *
+ * While on, every public image and model call records a timed event in a
+ * per-thread buffer, together with the bytes read and written, the pixels
+ * produced and the image buffers allocated during the call. While off, each
+ * instrumented call pays one relaxed atomic load. Setting the environment
+ * variable NEURO_LENS_TRACE to a file path enables tracing from startup and
+ * writes the trace there, plus a summary to stderr, at exit.
+ *
+ * @param enabled Non-zero to record events.
+ */
+void img_trace_enable(int enabled);
+
+/**
+ * Returns whether instrumentation is on.
+ *
+ * @return Non-zero while events are recorded.
+ */
+int img_trace_enabled(void);
+
+/**
+ * Discards every recorded event and counter. Must not run concurrently with
+ * instrumented calls on other threads.
+ */
+void img_trace_reset(void);
+
+/**
+ * Writes the recorded events as a Chrome trace-event JSON file, which loads
+ * in Perfetto and chrome://tracing with one track per thread.
+ *
+ * @param filename The path of the JSON file.
+ * @return RET_SUCCESS on success, or RET_FAIL if the file cannot be written.
+ */
+int img_trace_write(const char *filename);
+
+/**
+ * Prints the calls, total, mean and maximum time and the counters of every
+ * instrumented stage, slowest first.
+ *
+ * @param out The stream receiving the table.
+ */
+void img_trace_print_summary(FILE *out);
+
+/**
+ * Resampling filters available to the resize engine.
+ */
+typedef enum {
+    IMG_FILTER_NEAREST  = 0, ///< Nearest neighbor, one tap per axis
+    IMG_FILTER_BILINEAR = 1, ///< Two-tap linear interpolation per axis
+    IMG_FILTER_AREA     = 2  ///< Box filter averaging the covered source area (bilinear when upscaling)
+} img_filter;
+
 /**
  * Resizes an image to new dimensions.
  *
  * Modifies the size of an image in place. The original image data is replaced
  * with a resized version. The resizing operation attempts to preserve the
- * aspect ratio and appearance of the original image as closely as possible.
+ * aspect ratio and appearance of the original image as closely as possible;
+ * it uses IMG_FILTER_AREA, which averages every covered source pixel when
+ * downscaling and interpolates bilinearly when upscaling.
  *
  * @param src A pointer to the pointer of the Image to be resized.
  * @param new_width The new width for the image.
@@ -79,11 +302,41 @@ void img_free(Image* img);
  */
 int img_resize(Image** src, int new_width, int new_height);
 
+/**
+ * Resizes an image to new dimensions with an explicit resampling filter.
+ *
+ * Same contract as img_resize(), but lets the caller pick the filter.
+ *
+ * @param src A pointer to the pointer of the Image to be resized.
+ * @param new_width The new width for the image.
+ * @param new_height The new height for the image.
+ * @param filter The resampling filter to use.
+ * @return RET_SUCCESS on success, or RET_FAIL if an error occurs.
+ */
+int img_resize_filter(Image** src, int new_width, int new_height, img_filter filter);
+
+/**
+ * Resizes an image into a caller-provided destination image.
+ *
+ * The destination dimensions define the output size. No image is allocated,
+ * so a pipeline can reuse the same destination for every frame. Coefficient
+ * tables are cached per thread for the most recent (source, destination)
+ * size pair.
+ *
+ * @param src The source image. It is not modified.
+ * @param dst The destination image; its width and height select the output size.
+ * @param filter The resampling filter to use.
+ * @return RET_SUCCESS on success, or RET_FAIL if an error occurs.
+ */
+int img_resize_into(const Image *src, Image *dst, img_filter filter);
+
 /**
  * Crops an image to a specified rectangular area.
  *
- * Modifies the image in place to retain only the specified rectangular area.
- * The original image outside the specified area is discarded.
+ * Replaces the image with a view of the specified rectangular area. No pixels
+ * are copied, so the cost does not depend on the image size; the pixels
+ * outside the area stay allocated until every image sharing the buffer has
+ * been freed. Use img_copy() to obtain a compact copy.
  *
  * @param src A pointer to the pointer of the Image to be cropped.
  * @param x The X coordinate of the top-left corner of the crop area.
@@ -94,12 +347,395 @@ int img_resize(Image** src, int new_width, int new_height);
  */
 int img_crop(Image **src, int x, int y, int width, int height);
 
+/**
+ * Element types for model input tensors.
+ */
+typedef enum {
+    IMG_TENSOR_UINT8   = 0, ///< Unsigned 8-bit, rounded and saturated
+    IMG_TENSOR_INT8    = 1, ///< Signed 8-bit, rounded and saturated
+    IMG_TENSOR_FLOAT32 = 2  ///< 32-bit float
+} img_tensor_type;
+
+/**
+ * Channel order of model input tensors.
+ */
+typedef enum {
+    IMG_ORDER_RGB = 0, ///< Red, green, blue
+    IMG_ORDER_BGR = 1  ///< Blue, green, red
+} img_channel_order;
+
+/**
+ * Describes the NHWC input tensor of a model and how to fill it.
+ *
+ * Each output element is computed from an 8-bit source channel value p as
+ * `p * scale + zero_point`, then rounded and saturated for the integer types.
+ * For the uint8 MobileNet model use scale 1 and zero_point 0; for float
+ * models expecting [-1, 1] use scale 1/127.5 and zero_point -1; for int8
+ * models shifted by 128 use scale 1 and zero_point -128.
+ */
+typedef struct {
+    int width;                 ///< Tensor width, e.g. 224
+    int height;                ///< Tensor height, e.g. 224
+    img_tensor_type type;      ///< Element type of the tensor
+    img_channel_order order;   ///< Channel order of the three output channels
+    float scale;               ///< Multiplier applied to each 8-bit channel value
+    float zero_point;          ///< Offset added after scaling
+    float crop_fraction;       ///< Fraction of the largest centered crop to keep, in (0, 1]
+    img_filter filter;         ///< Resampling filter for the resize step
+} img_tensor_spec;
+
+/**
+ * Returns the tensor spec for models/mobilenet_v1_1.0_224_quant.tflite.
+ *
+ * 224x224 RGB uint8 with identity scaling, the full centered crop and the
+ * area filter.
+ *
+ * @return The spec, which the caller may adjust before use.
+ */
+img_tensor_spec img_tensor_spec_mobilenet_v1_quant(void);
+
+/**
+ * Converts an image into a model input tensor in a single fused pass.
+ *
+ * Center-crops the image to the tensor's aspect ratio (scaled by
+ * crop_fraction), resizes it, drops the alpha channel, reorders the channels
+ * and applies the spec's scale and zero point, writing straight into the
+ * caller's height x width x 3 NHWC buffer. No intermediate images are
+ * allocated; coefficient tables and scratch rows are cached per thread.
+ *
+ * @param img The source image. It is not modified.
+ * @param spec The tensor description.
+ * @param out The destination buffer of spec->height * spec->width * 3 elements
+ *            of the spec's element type.
+ * @return RET_SUCCESS on success, or RET_FAIL if an error occurs.
+ */
+int img_to_tensor(const Image *img, const img_tensor_spec *spec, void *out);
+
+/**
+ * Loads an image file straight into a model input tensor.
+ *
+ * Same result as img_load() followed by img_to_tensor(), but the file is
+ * decoded row by row into the resizer, so only a few source rows are held in
+ * memory at a time regardless of the image size, and decoding stops after the
+ * last row the crop needs.
+ *
+ * @param filename The path to the image file to be loaded.
+ * @param spec The tensor description.
+ * @param out The destination buffer of spec->height * spec->width * 3 elements
+ *            of the spec's element type.
+ * @return RET_SUCCESS on success, or RET_FAIL if loading or conversion fails.
+ */
+int img_load_tensor(const char *filename, const img_tensor_spec *spec, void *out);
+
+/**
+ * Memory layouts of an img_tensor.
+ */
+typedef enum {
+    IMG_LAYOUT_NHWC = 0, ///< Interleaved: the channels of a pixel are adjacent
+    IMG_LAYOUT_NCHW = 1  ///< Planar: each channel of an image is one contiguous plane
+} img_layout;
+
+/**
+ * A batch of images in an interleaved or planar layout, with 8-bit or float
+ * samples.
+ *
+ * The data is dense: image n starts `n * height * width * channels` elements
+ * into the buffer, and in the NCHW layout each of its planes holds
+ * `height * width` elements. The buffer is 64-byte aligned. A one-image NHWC
+ * uint8 tensor with 4 channels has the Image layout, with 3 channels it is
+ * packed RGB8, and the NCHW layout gives planar uint8 or float32 images.
+ */
+typedef struct {
+    int batch;             ///< Number of images
+    int height;            ///< Height of each image in pixels
+    int width;             ///< Width of each image in pixels
+    int channels;          ///< Channels per pixel, 1 to 4
+    img_layout layout;     ///< NHWC or NCHW
+    img_tensor_type type;  ///< IMG_TENSOR_UINT8 or IMG_TENSOR_FLOAT32
+    void *data;            ///< First element of the first image
+    img_storage *storage;  ///< Backing buffer
+} img_tensor;
+
+/**
+ * Creates a tensor. The contents are left uninitialized. Free it with
+ * img_tensor_free().
+ *
+ * @param batch The number of images.
+ * @param height The height of each image.
+ * @param width The width of each image.
+ * @param channels The channels per pixel, 1 to 4.
+ * @param layout IMG_LAYOUT_NHWC or IMG_LAYOUT_NCHW.
+ * @param type IMG_TENSOR_UINT8 or IMG_TENSOR_FLOAT32.
+ * @return The tensor, or NULL if an argument is invalid or allocation fails.
+ */
+img_tensor* img_tensor_new(int batch, int height, int width, int channels, img_layout layout, img_tensor_type type);
+
+/**
+ * Frees a tensor and its buffer.
+ *
+ * @param t The tensor to free. NULL is ignored.
+ */
+void img_tensor_free(img_tensor *t);
+
+/**
+ * Returns the size of a tensor's data in bytes.
+ *
+ * @param t The tensor.
+ * @return batch * height * width * channels times the element size.
+ */
+size_t img_tensor_bytes(const img_tensor *t);
+
+/**
+ * Returns one channel plane of an NCHW tensor.
+ *
+ * @param t The tensor.
+ * @param index The image in the batch.
+ * @param channel The channel.
+ * @return The first element of the plane, or NULL for NHWC tensors and
+ *         indices out of range.
+ */
+void* img_tensor_plane(const img_tensor *t, int index, int channel);
+
+/**
+ * Copies an image into one slot of a tensor.
+ *
+ * The image must match the tensor's height and width. A 3-channel tensor
+ * receives R, G and B and drops alpha; a 4-channel one receives all four.
+ * Float tensors receive the 8-bit values unchanged (0 to 255). The
+ * deinterleaving is done by SIMD shuffle kernels.
+ *
+ * @param src The image. It is not modified.
+ * @param dst The tensor, with 3 or 4 channels.
+ * @param index The slot in the batch.
+ * @return RET_SUCCESS on success, or RET_FAIL if the sizes or channel counts
+ *         do not match.
+ */
+int img_tensor_from_image(const Image *src, img_tensor *dst, int index);
+
+/**
+ * Copies one slot of a tensor into an image.
+ *
+ * The image must match the tensor's height and width. 3-channel tensors get
+ * an opaque alpha. Float samples are rounded to the nearest integer and
+ * saturated to 0 to 255.
+ *
+ * @param src The tensor, with 3 or 4 channels.
+ * @param index The slot in the batch.
+ * @param dst The image.
+ * @return RET_SUCCESS on success, or RET_FAIL if the sizes or channel counts
+ *         do not match.
+ */
+int img_tensor_to_image(const img_tensor *src, int index, Image *dst);
+
+/**
+ * Converts a tensor into another layout and element type.
+ *
+ * Both tensors must have the same batch, height and width. The channel
+ * counts must match, except that 4 channels may be narrowed to 3 by
+ * dropping the last and 3 widened to 4 with an opaque last channel (255).
+ * Float to 8-bit conversion rounds and saturates as in img_tensor_to_image().
+ *
+ * @param src The source tensor. It is not modified and must not alias dst.
+ * @param dst The destination tensor.
+ * @return RET_SUCCESS on success, or RET_FAIL if the shapes do not match.
+ */
+int img_tensor_convert(const img_tensor *src, img_tensor *dst);
+
+/**
+ * Normalization methods. Each maps a source channel value p to a real value.
+ */
+typedef enum {
+    IMG_NORM_MINMAX      = 0, ///< [in_min, in_max] maps linearly onto [out_min, out_max]
+    IMG_NORM_STANDARDIZE = 1, ///< (p - mean) / std
+    IMG_NORM_REQUANTIZE  = 2  ///< (p - in_zero_point) * in_scale, the value p encodes
+} img_norm_method;
+
+/**
+ * Describes a per-channel normalization and the buffer it writes.
+ *
+ * Every method is an affine map per channel. Float outputs store the real
+ * value; integer outputs store `round(v / scale) + zero_point`, saturated to
+ * the type's range. Channel arrays are indexed R, G, B, A.
+ */
+typedef struct {
+    img_norm_method method; ///< How the real value is computed
+    int channels;           ///< Leading channels written per pixel: 1 (R), 3 (RGB) or 4 (RGBA); 2 is RG
+    img_layout layout;      ///< NHWC (interleaved) or NCHW (one plane per channel)
+    img_tensor_type type;   ///< Element type of the output
+    float in_min[4];        ///< IMG_NORM_MINMAX: source value mapped to out_min
+    float in_max[4];        ///< IMG_NORM_MINMAX: source value mapped to out_max
+    float out_min;          ///< IMG_NORM_MINMAX: lower end of the target range
+    float out_max;          ///< IMG_NORM_MINMAX: upper end of the target range
+    float mean[4];          ///< IMG_NORM_STANDARDIZE: mean in 0-255 units
+    float std[4];           ///< IMG_NORM_STANDARDIZE: standard deviation in 0-255 units
+    float in_scale;         ///< IMG_NORM_REQUANTIZE: scale of the source quantization
+    float in_zero_point;    ///< IMG_NORM_REQUANTIZE: zero point of the source quantization
+    float scale;            ///< Integer outputs: quantization step of the output
+    float zero_point;       ///< Integer outputs: quantized value of zero
+} img_norm_spec;
+
+/**
+ * Returns the default normalization: min-max from 0-255 to [0, 1], RGB,
+ * NHWC float32, mean 0 and std 1, and identity quantization.
+ *
+ * @return The spec, which the caller may adjust before use.
+ */
+img_norm_spec img_norm_defaults(void);
+
+/**
+ * Normalizes an image into a caller-supplied buffer.
+ *
+ * The per-channel maps are folded into 256-entry lookup tables; float32
+ * outputs use a vectorized multiply-add instead where the CPU supports FMA,
+ * with identical results. The NCHW layout splits the channels with the
+ * img_tensor shuffle kernels first, so each plane is converted in one
+ * contiguous run. `out` may be the data of an img_tensor slot of the same
+ * shape.
+ *
+ * @param src The image. It is not modified.
+ * @param spec The normalization and output description.
+ * @param out The destination buffer of src->height * src->width *
+ *            spec->channels elements of spec->type.
+ * @return RET_SUCCESS on success, or RET_FAIL if the spec is invalid (unknown
+ *         values, an empty min-max range, a zero std or a zero output scale).
+ */
+int img_normalize(const Image *src, const img_norm_spec *spec, void *out);
+
+/**
+ * Per-channel statistics of 8-bit samples, accumulated over any number of
+ * images. The sums are exact, so the result does not depend on the order in
+ * which images or partial results are combined.
+ */
+typedef struct {
+    uint64_t count;        ///< Pixels accumulated
+    uint64_t sum[4];       ///< Sum of the samples, per channel
+    uint64_t sum_sq[4];    ///< Sum of the squared samples, per channel
+    unsigned char min[4];  ///< Smallest sample, per channel
+    unsigned char max[4];  ///< Largest sample, per channel
+} img_channel_stats;
+
+/**
+ * Clears statistics before the first img_stats_accumulate().
+ *
+ * @param stats The statistics.
+ */
+void img_stats_init(img_channel_stats *stats);
+
+/**
+ * Adds every pixel of an image to the statistics in a single pass.
+ *
+ * @param stats The statistics.
+ * @param img The image.
+ * @return RET_SUCCESS on success, or RET_FAIL if an argument is invalid or
+ *         scratch memory cannot be allocated.
+ */
+int img_stats_accumulate(img_channel_stats *stats, const Image *img);
+
+/**
+ * Adds statistics gathered separately, e.g. by another thread.
+ *
+ * @param dst The statistics to add to.
+ * @param src The statistics to add.
+ */
+void img_stats_merge(img_channel_stats *dst, const img_channel_stats *src);
+
+/**
+ * Computes the per-channel mean and population variance.
+ *
+ * @param stats The statistics. With no pixels, the results are 0.
+ * @param mean Receives 4 means.
+ * @param variance Receives 4 variances.
+ */
+void img_stats_moments(const img_channel_stats *stats, double mean[4], double variance[4]);
+
+/**
+ * Fills the min-max range and the mean and std of a spec from statistics,
+ * for dataset-level normalization. Channels with zero variance get std 1
+ * and channels with a single value get the range [min, min + 1].
+ *
+ * @param spec The spec to update. Its method and output fields are kept.
+ * @param stats The statistics.
+ */
+void img_norm_set_stats(img_norm_spec *spec, const img_channel_stats *stats);
+
+/**
+ * Colour spaces of 8-bit samples. The channels of each space are listed in
+ * the order they are stored in R, G and B, or in the three planes.
+ */
+typedef enum {
+    IMG_COLOR_GRAY              = 0, ///< Y: BT.601 luma, 0-255; one plane, or Y in R, G and B
+    IMG_COLOR_YCBCR_601         = 1, ///< Y, Cb, Cr: BT.601, full range 0-255 (JPEG)
+    IMG_COLOR_YCBCR_601_LIMITED = 2, ///< Y, Cb, Cr: BT.601, Y 16-235 and Cb, Cr 16-240
+    IMG_COLOR_YCBCR_709         = 3, ///< Y, Cb, Cr: BT.709, full range 0-255
+    IMG_COLOR_YCBCR_709_LIMITED = 4, ///< Y, Cb, Cr: BT.709, Y 16-235 and Cb, Cr 16-240
+    IMG_COLOR_HSV               = 5  ///< H, S, V: hue scaled so a full turn is 256, S and V 0-255
+} img_color_space;
+
+/**
+ * Converts RGB pixels into a colour space, keeping alpha.
+ *
+ * The conversion runs in integer fixed point through SIMD kernels. The
+ * matrix conversions round to nearest; 8-bit HSV quantizes hue to 1.4
+ * degrees, so an HSV round trip may be off by a few units.
+ *
+ * @param src The RGB image.
+ * @param dst The destination, of the same size. May be src to convert in place.
+ * @param space The colour space.
+ * @return RET_SUCCESS on success, or RET_FAIL if the sizes differ or the
+ *         space is unknown.
+ */
+int img_rgb_to_color(const Image *src, Image *dst, img_color_space space);
+
+/**
+ * Converts pixels holding a colour space back to RGB, keeping alpha.
+ * IMG_COLOR_GRAY takes Y from R.
+ *
+ * @param src The image in the colour space.
+ * @param dst The RGB destination, of the same size. May be src to convert in place.
+ * @param space The colour space of src.
+ * @return RET_SUCCESS on success, or RET_FAIL if the sizes differ or the
+ *         space is unknown.
+ */
+int img_color_to_rgb(const Image *src, Image *dst, img_color_space space);
+
+/**
+ * Converts RGB pixels into planes of a colour space, e.g. the planes of a
+ * uint8 NCHW img_tensor (see img_tensor_plane()) or of a YUV 4:4:4 buffer.
+ *
+ * @param src The RGB image.
+ * @param space The colour space. IMG_COLOR_GRAY writes planes[0] only.
+ * @param planes The three destination planes. NULL entries are skipped, so
+ *               a luma-only consumer can ask for Y alone.
+ * @param stride The distance between rows of a plane in bytes, at least src->width.
+ * @return RET_SUCCESS on success, or RET_FAIL if an argument is invalid.
+ */
+int img_rgb_to_color_planes(const Image *src, img_color_space space, uint8_t *const planes[3], size_t stride);
+
+/**
+ * Converts planes of a colour space into opaque RGB pixels.
+ *
+ * @param planes The three source planes. IMG_COLOR_GRAY reads planes[0] only.
+ * @param stride The distance between rows of a plane in bytes, at least dst->width.
+ * @param space The colour space of the planes.
+ * @param dst The RGB destination.
+ * @return RET_SUCCESS on success, or RET_FAIL if an argument is invalid.
+ */
+int img_color_planes_to_rgb(const uint8_t *const planes[3], size_t stride, img_color_space space, Image *dst);
+
 /**
  * Loads an image from a file.
  *
- * This function determines the format of the image file and loads it into a
- * new Image structure. The supported formats depend on the internal capabilities
- * of the library.
+ * This function determines the format of the image file from its leading
+ * bytes and loads it into a new Image structure. Every PNG colour type and bit
+ * depth is accepted and expanded to 8-bit RGBA; use img_load_packed() to keep
+ * the native channel count.
+ *
+ * Binary PGM, PPM and PAM files and uncompressed 24 and 32-bit BMP files are
+ * mapped into memory instead of being read. When a file already holds
+ * top-down 8-bit RGBA rows, as the ones written by img_write() as .pam or
+ * .bmp do, the image points into a private copy-on-write mapping: loading
+ * costs no copy, and writing to the image does not change the file. The file
+ * must not be truncated while such an image is alive.
  *
  * @param filename The path to the image file to be loaded.
  * @return A pointer to the newly loaded Image, or NULL if loading fails.
@@ -107,49 +743,746 @@ int img_crop(Image **src, int x, int y, int width, int height);
 Image* img_load(const char *filename);
 
 /**
- * Writes an image to a file.
+ * Loads an image from a file held in memory, e.g. read by img_loader_next()
+ * or received over the network.
  *
- * Saves the image data to a file in a specified format. The format is determined
- * by the file extension or can be specified in another way by the library's
- * internal implementation.
+ * Accepts the same formats as img_load(), identified by their magic bytes.
+ * PNG streams are decoded straight from the buffer without stdio; the
+ * uncompressed formats are copied, since the caller keeps the buffer.
  *
- * @param filename The path to the file where the image will be saved.
- * @param img The Image to be saved.
+ * @param data The file contents.
+ * @param size The size of the contents in bytes.
+ * @return A pointer to the newly loaded Image, or NULL if the contents are
+ *         truncated or cannot be decoded.
  */
-void img_write(const char *filename, Image *img);
+Image* img_load_mem(const void *data, size_t size);
 
 /**
- * Flips an image horizontally in place.
+ * Loads an image file resized to the given dimensions.
  *
- * This function mirrors the image along its vertical axis, effectively reversing
- * the order of pixels in each row. The transformation is performed directly on the
- * input image data, modifying the original image.
+ * Same result as img_load() followed by img_resize_filter(), but the file is
+ * decoded row by row into the resizer, so the full-size image is never
+ * allocated. Peak memory is the destination image plus a few rows.
  *
- * @param img A pointer to an Image structure representing the image to be flipped.
- *            The Image structure must be valid and contain allocated pixel data.
- *            If the Image pointer is NULL or contains no pixel data, the function
- *            will exit without performing any operations.
+ * @param filename The path to the image file to be loaded.
+ * @param width The width of the returned image.
+ * @param height The height of the returned image.
+ * @param filter The resampling filter to use.
+ * @return A pointer to the newly loaded Image, or NULL if loading fails.
  */
-void img_flip_horizontal(Image* img);
+Image* img_load_resized(const char *filename, int width, int height, img_filter filter);
 
 /**
- * Rotates an image by a given angle around its center.
- *
- * This function rotates an image clockwise by the specified angle in degrees, with the rotation
- * centered around the geometric center of the image. The rotated image replaces the original
- * image data. For simplicity, this implementation does not perform interpolation, which means
- * the quality of the rotated image may decrease, especially for angles that are not multiples
- * of 90 degrees.
+ * Creates a new packed image with specified dimensions and channel count.
  *
- * @param img A pointer to an Image structure representing the image to be rotated. The image
- *           must be valid and contain allocated pixel data.
- * @param angle The angle in degrees by which to rotate the image clockwise. The function uses
- *             an approximation of sine and cosine functions (`sin_approx` and `cos_approx`)
- *             to calculate the rotation, which may affect precision for large angles or require
- *             adjustment for negative angles.
+ * The sample contents are left uninitialized. Free the image with
+ * img_packed_free().
+ *
+ * @param width The width of the image in pixels.
+ * @param height The height of the image in pixels.
+ * @param channels The number of interleaved channels, 1 to 4.
+ * @return A pointer to the newly created image, or NULL if an error occurs.
+ */
+img_packed* img_packed_new(int width, int height, int channels);
+
+/**
+ * Frees a packed image and its sample buffer.
+ *
+ * @param img The image to free. NULL is ignored.
+ */
+void img_packed_free(img_packed *img);
+
+/**
+ * Loads an image from a file, keeping its native channel count.
+ *
+ * Gray, gray + alpha, RGB and RGBA files keep their channels; palette files
+ * expand to RGB, or RGBA when they carry transparency, and a tRNS colour key
+ * adds an alpha channel. 16-bit samples are rounded to 8 bits and 1, 2 and
+ * 4-bit samples are unpacked to one byte each. Uncompressed 8-bit files in
+ * red-first order (PGM, PPM, PAM) are mapped without a copy, like in
+ * img_load(); BMP files are reordered to RGB.
+ *
+ * @param filename The path to the image file to be loaded.
+ * @return A pointer to the newly loaded image, or NULL if loading fails.
+ */
+img_packed* img_load_packed(const char *filename);
+
+/**
+ * Writes an image to a file.
+ *
+ * Saves the image data to a file in the format named by its extension: .pam
+ * writes PAM RGB_ALPHA, .ppm writes PPM without the alpha channel, .bmp writes
+ * a top-down 32-bit BMP and anything else PNG. The uncompressed formats cost
+ * no more than a copy of the pixels and load back without one (see
+ * img_load()), which suits intermediate files between processing stages.
+ *
+ * @param filename The path to the file where the image will be saved.
+ * @param img The Image to be saved.
+ */
+void img_write(const char *filename, Image *img);
+
+/**
+ * PNG row filters. ADAPTIVE picks, per row, the filter whose output has the
+ * smallest sum of absolute values, which usually compresses best.
+ */
+typedef enum {
+    IMG_PNG_FILTER_NONE     = 0,
+    IMG_PNG_FILTER_SUB      = 1,
+    IMG_PNG_FILTER_UP       = 2,
+    IMG_PNG_FILTER_AVERAGE  = 3,
+    IMG_PNG_FILTER_PAETH    = 4,
+    IMG_PNG_FILTER_ADAPTIVE = 5
+} img_png_filter;
+
+/**
+ * zlib compression strategies.
+ */
+typedef enum {
+    IMG_ZLIB_DEFAULT      = 0, ///< Full LZ77 + Huffman
+    IMG_ZLIB_FILTERED     = 1, ///< Favors Huffman coding over short matches; suits filtered rows
+    IMG_ZLIB_HUFFMAN_ONLY = 2, ///< No string matching; fastest real compression
+    IMG_ZLIB_RLE          = 3  ///< Matches limited to distance one; fast, good on flat areas
+} img_zlib_strategy;
+
+/**
+ * Options for img_write_opts().
+ */
+typedef struct {
+    int level;                  ///< zlib level, 1 (fastest) to 9 (smallest)
+    img_png_filter filter;      ///< Row filter
+    img_zlib_strategy strategy; ///< zlib strategy
+    int store_only;             ///< Non-zero to write uncompressed deflate blocks, ignoring level and strategy
+    int threads;                ///< Encoder threads: 1 encodes serially, 0 uses img_get_threads(), which also caps it
+} img_write_options;
+
+/**
+ * Returns the default write options, matching img_write(): level 6, adaptive
+ * filtering, the default strategy and a single thread.
+ *
+ * @return The options, which the caller may adjust before use.
+ */
+img_write_options img_write_defaults(void);
+
+/**
+ * Writes an image to a file with explicit PNG encoder options.
+ *
+ * The format is chosen as in img_write(); the options only apply to PNG.
+ *
+ * With more than one thread, a PNG is cut into horizontal strips that
+ * are filtered and deflated in parallel. Each strip is primed with the
+ * previous strip's last 32 KiB as a preset dictionary, so the compression
+ * ratio stays close to a serial encode. The strips are stitched into a single
+ * zlib stream whose checksum is combined from the per-strip checksums.
+ *
+ * @param filename The path to the file where the image will be saved.
+ * @param img The Image to be saved.
+ * @param opts The encoder options, or NULL for img_write_defaults().
+ * @return RET_SUCCESS on success, or RET_FAIL if the file cannot be written.
+ */
+int img_write_opts(const char *filename, const Image *img, const img_write_options *opts);
+
+/**
+ * Flips an image horizontally in place.
+ *
+ * This function mirrors the image along its vertical axis, effectively reversing
+ * the order of pixels in each row. The transformation is performed directly on the
+ * input image data, modifying the original image.
+ *
+ * @param img A pointer to an Image structure representing the image to be flipped.
+ *            The Image structure must be valid and contain allocated pixel data.
+ *            If the Image pointer is NULL or contains no pixel data, the function
+ *            will exit without performing any operations.
+ */
+void img_flip_horizontal(Image* img);
+
+/**
+ * How geometric transforms sample positions that fall outside the source image.
+ */
+typedef enum {
+    IMG_BORDER_CONSTANT  = 0, ///< Use a fill color
+    IMG_BORDER_REPLICATE = 1, ///< Repeat the nearest edge pixel
+    IMG_BORDER_REFLECT   = 2  ///< Mirror the image across its edges
+} img_border;
+
+/**
+ * Rotates an image by a given angle around its center.
+ *
+ * This function rotates an image clockwise by the specified angle in degrees, with the rotation
+ * centered around the geometric center of the image. The rotated image replaces the original
+ * image data and keeps its dimensions. Every output pixel is inverse-mapped into the source and
+ * sampled bilinearly, so the result has no holes; areas that map outside the source become
+ * transparent black. Exact multiples of 90 degrees are handled by lossless tiled kernels.
+ *
+ * @param img A pointer to an Image structure representing the image to be rotated. The image
+ *           must be valid and contain allocated pixel data.
+ * @param angle The angle in degrees by which to rotate the image clockwise. Negative angles
+ *             rotate counter-clockwise.
  *
  * @return RET_SUCCESS on success, or RET_FAIL if an error occurs.
  */
 int img_rotate(Image* img, float angle);
 
+/**
+ * Rotates an image around its center into a caller-provided destination.
+ *
+ * The destination keeps its own dimensions; the source center is mapped onto the
+ * destination center. The sine and cosine of the angle are computed once, and
+ * each output row is walked incrementally in 16.16 fixed point. Exact multiples
+ * of 90 degrees use cache-blocked transpose kernels whenever the mapping lands
+ * on whole pixels.
+ *
+ * @param src The source image. It is not modified and must not alias dst.
+ * @param dst The destination image.
+ * @param angle The clockwise rotation in degrees.
+ * @param filter IMG_FILTER_NEAREST or IMG_FILTER_BILINEAR (IMG_FILTER_AREA samples bilinearly).
+ * @param border How to sample positions outside the source.
+ * @param fill The color used by IMG_BORDER_CONSTANT.
+ * @return RET_SUCCESS on success, or RET_FAIL if an error occurs.
+ */
+int img_rotate_into(const Image *src, Image *dst, float angle, img_filter filter,
+                    img_border border, pixel fill);
+
+/**
+ * Rotates an image clockwise by a whole number of quarter turns.
+ *
+ * Unlike img_rotate(), the canvas follows the rotation: one or three quarter
+ * turns swap the width and height. The copy is lossless and runs through a
+ * cache-blocked tiled transpose.
+ *
+ * @param src A pointer to the pointer of the Image to be rotated.
+ * @param quarter_turns The number of clockwise quarter turns; negative values turn counter-clockwise.
+ * @return RET_SUCCESS on success, or RET_FAIL if an error occurs.
+ */
+int img_rotate90(Image **src, int quarter_turns);
+
+/**
+ * A deferred chain of geometric operations.
+ *
+ * Operations recorded on a transform only update a matrix mapping output
+ * pixels back to the source; nothing is sampled until img_transform_apply()
+ * or img_transform_render(), which produce the whole chain in one resampling
+ * pass into one buffer. Only the source pixels the output actually reaches are
+ * read. Axis-aligned chains (crops, resizes, flips and quarter turns of the
+ * canvas) use the separable resize filters, including IMG_FILTER_AREA; chains
+ * without any resampling are plain copies; rotated chains are sampled bilinearly
+ * or by nearest neighbor. A transform describes geometry only and can be
+ * applied to any number of images of the size it was created for.
+ */
+typedef struct img_transform img_transform;
+
+/**
+ * Creates an identity transform for images of the given size.
+ *
+ * @param width The source width.
+ * @param height The source height.
+ * @return The transform, or NULL on invalid sizes or allocation failure.
+ */
+img_transform* img_transform_new(int width, int height);
+
+/**
+ * Frees a transform.
+ *
+ * @param t The transform. NULL is ignored.
+ */
+void img_transform_free(img_transform *t);
+
+/**
+ * Returns the size of the transform's output.
+ *
+ * @param t The transform.
+ * @param width Receives the output width; may be NULL.
+ * @param height Receives the output height; may be NULL.
+ */
+void img_transform_size(const img_transform *t, int *width, int *height);
+
+/**
+ * Records a crop of the current output, as img_crop().
+ *
+ * @param t The transform.
+ * @param x The left edge of the crop in the current output.
+ * @param y The top edge of the crop in the current output.
+ * @param width The width of the crop.
+ * @param height The height of the crop.
+ * @return RET_SUCCESS on success, or RET_FAIL if the area is empty or not inside the current output.
+ */
+int img_transform_crop(img_transform *t, int x, int y, int width, int height);
+
+/**
+ * Records a resize of the current output, as img_resize().
+ *
+ * @param t The transform.
+ * @param width The new width.
+ * @param height The new height.
+ * @return RET_SUCCESS on success, or RET_FAIL on invalid sizes.
+ */
+int img_transform_resize(img_transform *t, int width, int height);
+
+/**
+ * Records a clockwise rotation about the center that keeps the canvas, as
+ * img_rotate().
+ *
+ * @param t The transform.
+ * @param angle The clockwise rotation in degrees.
+ * @return RET_SUCCESS on success, or RET_FAIL if t is NULL.
+ */
+int img_transform_rotate(img_transform *t, float angle);
+
+/**
+ * Records clockwise quarter turns whose canvas follows the rotation, as
+ * img_rotate90().
+ *
+ * @param t The transform.
+ * @param quarter_turns The number of clockwise quarter turns; negative values turn counter-clockwise.
+ * @return RET_SUCCESS on success, or RET_FAIL if t is NULL.
+ */
+int img_transform_rotate90(img_transform *t, int quarter_turns);
+
+/**
+ * Records a mirror of the current output along its vertical axis, as
+ * img_flip_horizontal().
+ *
+ * @param t The transform.
+ * @return RET_SUCCESS on success, or RET_FAIL if t is NULL.
+ */
+int img_transform_flip_horizontal(img_transform *t);
+
+/**
+ * Records a mirror of the current output along its horizontal axis.
+ *
+ * @param t The transform.
+ * @return RET_SUCCESS on success, or RET_FAIL if t is NULL.
+ */
+int img_transform_flip_vertical(img_transform *t);
+
+/**
+ * Runs a transform into a caller-provided destination.
+ *
+ * @param t The transform.
+ * @param src The source image, of the size the transform was created for. It
+ *            is not modified and must not alias dst.
+ * @param dst The destination, of the size img_transform_size() reports.
+ * @param filter The resampling filter. Rotated chains sample IMG_FILTER_AREA bilinearly.
+ * @param border How to sample positions outside the source; only rotations reach them.
+ * @param fill The color used by IMG_BORDER_CONSTANT.
+ * @return RET_SUCCESS on success, or RET_FAIL if the sizes do not match or
+ *         allocation fails.
+ */
+int img_transform_apply(const img_transform *t, const Image *src, Image *dst, img_filter filter,
+                        img_border border, pixel fill);
+
+/**
+ * Runs a transform into a new image. Areas outside the source become
+ * transparent black, as with img_rotate().
+ *
+ * @param t The transform.
+ * @param src The source image, of the size the transform was created for.
+ * @param filter The resampling filter.
+ * @return The new image, or NULL if the sizes do not match or allocation fails.
+ */
+Image* img_transform_render(const img_transform *t, const Image *src, img_filter filter);
+
+/**
+ * Returns a fingerprint of a transform and filter, for keying cached results
+ * of img_transform_apply(). Transforms recording the same geometry for the
+ * same source size have equal fingerprints.
+ *
+ * @param t The transform, or NULL for no geometric processing.
+ * @param filter The resampling filter the transform will run with.
+ * @return The 64-bit fingerprint.
+ */
+uint64_t img_transform_fingerprint(const img_transform *t, img_filter filter);
+
+/**
+ * A two-level cache of decoded and preprocessed images.
+ *
+ * Entries are keyed by the identity of the source file and a caller-supplied
+ * fingerprint of the processing applied to it. Level one is an in-memory LRU
+ * bounded by bytes; level two is an optional directory of raw pixel files
+ * that outlives the process and is memory-mapped on a hit, so warm runs skip
+ * decoding entirely. Images returned by the cache share their pixels with it
+ * and must be treated as read-only; use img_copy() to obtain a writable copy.
+ * A cache may be used from several threads at once.
+ */
+typedef struct img_cache img_cache;
+
+/**
+ * How the cache identifies a source file.
+ */
+typedef enum {
+    IMG_CACHE_KEY_STAT    = 0, ///< Path, device, inode, size and modification time; needs no reads
+    IMG_CACHE_KEY_CONTENT = 1  ///< Hash of the file bytes; survives copies and renames
+} img_cache_key;
+
+/**
+ * Cache settings.
+ */
+typedef struct {
+    size_t memory_bytes;  ///< Byte budget of the in-memory level, or 0 for the default of 256 MiB
+    const char *disk_dir; ///< Directory of the on-disk level, created if missing, or NULL for none
+    img_cache_key key;    ///< How source files are identified
+} img_cache_options;
+
+/**
+ * Cache counters.
+ */
+typedef struct {
+    unsigned long long memory_hits;  ///< Lookups served by the in-memory level
+    unsigned long long disk_hits;    ///< Lookups served by mapping a disk entry
+    unsigned long long misses;       ///< Lookups that had to decode and process the source
+    unsigned long long evictions;    ///< Entries dropped from the in-memory level to stay in budget
+    unsigned long long disk_writes;  ///< Entries written to the disk level
+    unsigned long long memory_bytes; ///< Pixel bytes currently held by the in-memory level
+    unsigned long long entries;      ///< Entries currently held by the in-memory level
+} img_cache_stats;
+
+/**
+ * Produces the image to cache for a source file on a miss.
+ *
+ * @param ctx The context given to img_cache_get().
+ * @param filename The source file.
+ * @return A new image the cache takes ownership of, or NULL on failure.
+ */
+typedef Image* (*img_cache_fill_fn)(void *ctx, const char *filename);
+
+/**
+ * Returns the default cache settings: 256 MiB in memory, no disk level,
+ * files identified by their metadata.
+ *
+ * @return The settings.
+ */
+img_cache_options img_cache_defaults(void);
+
+/**
+ * Creates a cache.
+ *
+ * @param opts The settings, or NULL for the defaults.
+ * @return The cache, or NULL if the disk directory cannot be created or allocation fails.
+ */
+img_cache* img_cache_new(const img_cache_options *opts);
+
+/**
+ * Frees a cache. Images it returned stay valid until they are freed.
+ *
+ * @param cache The cache. NULL is ignored.
+ */
+void img_cache_free(img_cache *cache);
+
+/**
+ * Looks up a processed image, producing and storing it on a miss.
+ *
+ * @param cache The cache.
+ * @param filename The source file.
+ * @param fingerprint Identifies the processing fill applies, e.g. from
+ *                    img_transform_fingerprint(); must differ whenever the
+ *                    output would.
+ * @param fill Produces the image on a miss.
+ * @param ctx Passed to fill.
+ * @return A read-only image to be freed with img_free(), or NULL if the file
+ *         cannot be identified or fill fails.
+ */
+Image* img_cache_get(img_cache *cache, const char *filename, uint64_t fingerprint,
+                     img_cache_fill_fn fill, void *ctx);
+
+/**
+ * Loads an image through the cache, optionally running a transform on it.
+ *
+ * @param cache The cache.
+ * @param filename The source file.
+ * @param t The transform to apply, created for the file's image size, or NULL to only decode.
+ * @param filter The resampling filter for the transform.
+ * @return A read-only image to be freed with img_free(), or NULL on failure
+ *         or if the image size does not match the transform.
+ */
+Image* img_cache_load(img_cache *cache, const char *filename, const img_transform *t, img_filter filter);
+
+/**
+ * Drops every in-memory entry and deletes every entry of the disk level.
+ *
+ * @param cache The cache.
+ * @return RET_SUCCESS on success, or RET_FAIL if the disk level cannot be listed.
+ */
+int img_cache_clear(img_cache *cache);
+
+/**
+ * Reads the cache counters.
+ *
+ * @param cache The cache.
+ * @param stats Receives a snapshot of the counters.
+ */
+void img_cache_get_stats(img_cache *cache, img_cache_stats *stats);
+
+/**
+ * How an image is stored in a pack.
+ */
+typedef enum {
+    IMG_PACK_RAW = 0, ///< Decoded RGBA8 rows, loaded in place without decoding
+    IMG_PACK_PNG = 1  ///< A PNG stream, decoded from memory on load
+} img_pack_format;
+
+/**
+ * Expected access pattern of a pack, passed to the kernel as a readahead hint.
+ */
+typedef enum {
+    IMG_PACK_ACCESS_NORMAL     = 0, ///< Default readahead
+    IMG_PACK_ACCESS_SEQUENTIAL = 1, ///< Entries are read in index order; read ahead aggressively
+    IMG_PACK_ACCESS_RANDOM     = 2  ///< Entries are read in shuffled order; do not read ahead
+} img_pack_access;
+
+/**
+ * Describes one entry of a pack.
+ */
+typedef struct {
+    int width;              ///< Image width in pixels
+    int height;             ///< Image height in pixels
+    img_pack_format format; ///< How the image is stored
+    size_t size;            ///< Stored size in bytes
+    int shard;              ///< Index of the shard holding the entry
+} img_pack_entry;
+
+/**
+ * Appends images to a pack: a few large shard files, each holding many images
+ * and an index of their offsets, sizes and dimensions.
+ */
+typedef struct img_pack_writer img_pack_writer;
+
+/**
+ * A pack opened for reading. Shards are memory-mapped, so any entry can be
+ * reached in constant time without opening a file.
+ */
+typedef struct img_pack img_pack;
+
+/**
+ * Starts writing a pack. Shards are named <prefix>-00000.nlp, -00001.nlp, and
+ * so on; existing shards with those names are replaced.
+ *
+ * @param prefix The path prefix of the shard files.
+ * @param shard_bytes The size after which a new shard is started, or 0 for 1 GiB.
+ * @return The writer, or NULL if allocation fails.
+ */
+img_pack_writer* img_pack_writer_new(const char *prefix, size_t shard_bytes);
+
+/**
+ * Appends an image.
+ *
+ * @param w The writer.
+ * @param img The image.
+ * @param format IMG_PACK_RAW to store the pixels, or IMG_PACK_PNG to encode them
+ *               with img_write_defaults().
+ * @return RET_SUCCESS on success, or RET_FAIL if the shard cannot be written.
+ */
+int img_pack_add_image(img_pack_writer *w, const Image *img, img_pack_format format);
+
+/**
+ * Appends an image file. PNG files are copied as they are, without decoding
+ * or re-encoding them; the other formats img_load() reads are decoded and
+ * stored as IMG_PACK_RAW.
+ *
+ * @param w The writer.
+ * @param filename The image file.
+ * @return RET_SUCCESS on success, or RET_FAIL if the file cannot be read or
+ *         decoded, or the shard cannot be written. Only the last failure
+ *         leaves the writer unusable.
+ */
+int img_pack_add_file(img_pack_writer *w, const char *filename);
+
+/**
+ * Appends a PNG stream held in memory as it is, e.g. a file returned by
+ * img_loader_next().
+ *
+ * @param w The writer.
+ * @param data The PNG stream.
+ * @param size The size of the stream in bytes.
+ * @return RET_SUCCESS on success, or RET_FAIL if the data is not a PNG or the
+ *         shard cannot be written.
+ */
+int img_pack_add_png(img_pack_writer *w, const void *data, size_t size);
+
+/**
+ * Returns the number of entries appended so far.
+ *
+ * @param w The writer.
+ * @return The number of entries.
+ */
+size_t img_pack_writer_count(const img_pack_writer *w);
+
+/**
+ * Writes the index of the last shard and frees the writer. A pack without
+ * entries still gets one empty shard, so it can be opened.
+ *
+ * @param w The writer. NULL is ignored.
+ * @return RET_SUCCESS if every shard was written, or RET_FAIL otherwise.
+ */
+int img_pack_writer_close(img_pack_writer *w);
+
+/**
+ * Opens a pack and maps its shards.
+ *
+ * @param path The prefix given to img_pack_writer_new(), or the path of a single shard.
+ * @return The pack, or NULL if no shard exists or a shard is invalid.
+ */
+img_pack* img_pack_open(const char *path);
+
+/**
+ * Closes a pack. Images loaded from it stay valid until they are freed.
+ *
+ * @param pack The pack. NULL is ignored.
+ */
+void img_pack_close(img_pack *pack);
+
+/**
+ * Returns the number of entries across all shards.
+ *
+ * @param pack The pack.
+ * @return The number of entries.
+ */
+size_t img_pack_count(const img_pack *pack);
+
+/**
+ * Describes an entry without loading it.
+ *
+ * @param pack The pack.
+ * @param index The entry index, in the order the entries were added.
+ * @param entry Receives the description.
+ * @return RET_SUCCESS on success, or RET_FAIL if the index is out of range.
+ */
+int img_pack_entry_info(const img_pack *pack, size_t index, img_pack_entry *entry);
+
+/**
+ * Loads an entry.
+ *
+ * Raw entries are returned in place: the image shares the shard mapping and
+ * must be treated as read-only; use img_copy() for a writable copy. PNG
+ * entries are decoded from the mapping into a new image.
+ *
+ * @param pack The pack.
+ * @param index The entry index.
+ * @return The image, to be freed with img_free(), or NULL if the index is out
+ *         of range or the entry cannot be decoded.
+ */
+Image* img_pack_load(const img_pack *pack, size_t index);
+
+/**
+ * Tells the kernel how the pack will be read, so it can tune readahead.
+ *
+ * @param pack The pack.
+ * @param access The expected access pattern.
+ */
+void img_pack_advise(const img_pack *pack, img_pack_access access);
+
+/**
+ * Asks the kernel to start reading an entry in the background, e.g. a few
+ * entries ahead of the one being loaded during a shuffled epoch.
+ *
+ * @param pack The pack.
+ * @param index The entry index. Out-of-range indices are ignored.
+ */
+void img_pack_prefetch(const img_pack *pack, size_t index);
+
+/**
+ * Fills a shuffled visiting order for one epoch.
+ *
+ * The permutation depends only on the seed, the epoch and the entry count,
+ * so every run, and every worker of a run, agrees on it.
+ *
+ * @param pack The pack.
+ * @param seed The shuffle seed.
+ * @param epoch The epoch number; each epoch gets a different permutation.
+ * @param order Receives img_pack_count() entry indices.
+ */
+void img_pack_epoch_order(const img_pack *pack, uint64_t seed, unsigned epoch, size_t *order);
+
+/**
+ * Reads files ahead of their consumer.
+ *
+ * Files are added in the order they will be consumed. The loader keeps up to
+ * `depth` of them in flight, reading each one whole into a buffer that is
+ * reused for later files, and hands them out in order. Decoding a file with
+ * img_load_mem() while the next ones are being read hides I/O latency, which
+ * dominates on network filesystems and cold page caches. A loader belongs to
+ * a single consumer thread.
+ */
+typedef struct img_loader img_loader;
+
+/**
+ * How a loader issues its reads.
+ */
+typedef enum {
+    IMG_LOADER_AUTO    = 0, ///< io_uring when the kernel allows it, reader threads otherwise
+    IMG_LOADER_URING   = 1, ///< Asynchronous openat, statx and read requests on an io_uring
+    IMG_LOADER_THREADS = 2  ///< Blocking reads on one reader thread per file in flight
+} img_loader_backend;
+
+/**
+ * Loader settings.
+ */
+typedef struct {
+    int depth;                  ///< Files read ahead of the one being consumed, or 0 for the default of 8
+    img_loader_backend backend; ///< How reads are issued
+} img_loader_options;
+
+/**
+ * A file handed out by img_loader_next().
+ */
+typedef struct {
+    size_t index;         ///< Position of the file in the order it was added
+    const char *filename; ///< The path as it was added
+    const void *data;     ///< The file contents, or NULL when it could not be read
+    size_t size;          ///< Size of the contents in bytes
+    int error;            ///< 0, or the errno of the failed open or read
+} img_loader_file;
+
+/**
+ * Returns the default loader settings: 8 files ahead, automatic backend.
+ *
+ * @return The settings.
+ */
+img_loader_options img_loader_defaults(void);
+
+/**
+ * Creates a loader.
+ *
+ * @param opts The settings, or NULL for img_loader_defaults().
+ * @return The loader, or NULL on allocation failure or when the io_uring
+ *         backend was requested but is unavailable.
+ */
+img_loader* img_loader_new(const img_loader_options *opts);
+
+/**
+ * Waits for the reads in flight and frees a loader and its buffers.
+ *
+ * @param loader The loader. NULL is ignored.
+ */
+void img_loader_free(img_loader *loader);
+
+/**
+ * Returns the backend a loader ended up with.
+ *
+ * @param loader The loader.
+ * @return IMG_LOADER_URING or IMG_LOADER_THREADS.
+ */
+img_loader_backend img_loader_get_backend(const img_loader *loader);
+
+/**
+ * Appends a file to the read order. Its read starts as soon as it is within
+ * `depth` files of the consumer.
+ *
+ * @param loader The loader.
+ * @param filename The path; it is copied.
+ * @return RET_SUCCESS on success, or RET_FAIL on allocation failure.
+ */
+int img_loader_add(img_loader *loader, const char *filename);
+
+/**
+ * Returns the next file in order, waiting for its read to finish.
+ *
+ * The previous file's buffer is recycled by this call, so its contents must
+ * no longer be used.
+ *
+ * @param loader The loader.
+ * @return The file, valid until the next call, or NULL once every added
+ *         file has been returned. Files that could not be read are returned
+ *         with their error set.
+ */
+const img_loader_file* img_loader_next(img_loader *loader);
+
 #endif // IMG_UTILS_H
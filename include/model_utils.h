@@ -0,0 +1,170 @@
+/**
+ * @file model_utils.h
+ * Public API for running image classification models.
+ *
+ * Loads uint8 asymmetric-quantized TFLite models, such as the bundled
+ * models/mobilenet_v1_1.0_224_quant.tflite, and runs them on the CPU without
+ * TensorFlow Lite. The supported operators are 2D convolution, depthwise 2D
+ * convolution, average pooling, reshape and softmax.
+ */
+
+#ifndef MODEL_UTILS_H
+#define MODEL_UTILS_H
+
+#include "img_utils.h"
+
+/**
+ * A loaded model together with its activation buffers. Opaque to library
+ * users. A model runs one inference at a time; threads classifying
+ * concurrently need a model each.
+ */
+typedef struct Model Model;
+
+/**
+ * One class of a classification result.
+ */
+typedef struct {
+    int index;   ///< Class index, i.e. the line of the label file counting from 0
+    float score; ///< Dequantized probability
+} model_prediction;
+
+/**
+ * Class names of a classification model, one per output class. Opaque to
+ * library users.
+ */
+typedef struct model_labels model_labels;
+
+/**
+ * Loads a TFLite model.
+ *
+ * The file is memory-mapped read-only and the weights are used in place,
+ * so loading costs only the parse of the graph, and processes using the
+ * same model share its pages. The file must not be modified while the
+ * model is loaded. The activation buffers are allocated up front.
+ *
+ * @param filename The path to the .tflite file.
+ * @return The model, or NULL if the file cannot be read, is malformed, or
+ *         uses operators or types that are not supported.
+ */
+Model* model_load(const char *filename);
+
+/**
+ * Frees a model.
+ *
+ * @param model The model. NULL is ignored.
+ */
+void model_free(Model *model);
+
+/**
+ * Returns the shape of the model's NHWC input tensor.
+ *
+ * @param model The model.
+ * @param height Receives the input height, e.g. 224. May be NULL.
+ * @param width Receives the input width. May be NULL.
+ * @param channels Receives the number of channels. May be NULL.
+ */
+void model_input_shape(const Model *model, int *height, int *width, int *channels);
+
+/**
+ * Returns the model's input tensor.
+ *
+ * The buffer holds height * width * channels uint8 values in NHWC order and
+ * can be filled in place, e.g. with img_load_tensor(), before model_invoke().
+ * Its contents are kept across inferences.
+ *
+ * @param model The model.
+ * @return The input buffer, owned by the model.
+ */
+unsigned char* model_input(Model *model);
+
+/**
+ * Runs the model on the contents of its input tensor.
+ *
+ * @param model The model.
+ * @return RET_SUCCESS on success, or RET_FAIL if an error occurs.
+ */
+int model_invoke(Model *model);
+
+/**
+ * Returns the model's quantized output tensor.
+ *
+ * @param model The model.
+ * @param count Receives the number of elements. May be NULL.
+ * @return The output buffer, owned by the model and valid until the next
+ *         model_invoke().
+ */
+const unsigned char* model_output(const Model *model, int *count);
+
+/**
+ * Returns the k highest scoring classes of the last inference.
+ *
+ * @param model The model.
+ * @param k The number of classes requested.
+ * @param out Receives up to k predictions, best first. Ties keep the lower
+ *            class index first.
+ * @return The number of predictions written, min(k, number of classes).
+ */
+int model_top_k(const Model *model, int k, model_prediction *out);
+
+/**
+ * Classifies an image.
+ *
+ * Converts the image into the input tensor with the MobileNet v1 spec (see
+ * img_tensor_spec_mobilenet_v1_quant()) sized to the model's input, runs the
+ * model and returns the top k classes.
+ *
+ * @param model The model.
+ * @param img The image. It is not modified.
+ * @param k The number of classes requested.
+ * @param out Receives up to k predictions, best first.
+ * @return The number of predictions written, or -1 if an error occurs.
+ */
+int model_classify(Model *model, const Image *img, int k, model_prediction *out);
+
+/**
+ * Loads a label file with one class name per line, such as
+ * models/labels_mobilenet_quant_v1_224.txt.
+ *
+ * All names are interned into a single string table: every distinct name is
+ * stored once and looked up by offset, so the table is one allocation no
+ * larger than the file.
+ *
+ * @param filename The path to the label file.
+ * @return The labels, or NULL if the file cannot be read or is empty.
+ */
+model_labels* model_labels_load(const char *filename);
+
+/**
+ * Frees a label table.
+ *
+ * @param labels The labels. NULL is ignored.
+ */
+void model_labels_free(model_labels *labels);
+
+/**
+ * Returns the number of labels.
+ *
+ * @param labels The labels.
+ * @return The number of lines of the label file.
+ */
+int model_labels_count(const model_labels *labels);
+
+/**
+ * Returns the name of a class.
+ *
+ * @param labels The labels.
+ * @param index The class index, e.g. model_prediction.index.
+ * @return The name, owned by the table, or NULL if the index is out of range.
+ */
+const char* model_labels_name(const model_labels *labels, int index);
+
+/**
+ * Looks up a class by name.
+ *
+ * @param labels The labels.
+ * @param name The class name.
+ * @return The lowest index with that name, or -1 if there is none.
+ */
+int model_labels_find(const model_labels *labels, const char *name);
+
+#endif // MODEL_UTILS_H
@@ -0,0 +1,79 @@
+/**
+ * @file batch.h
+ * Provides the batch preprocessing mode of the neuro-lens binary.
+ *
+ * A batch run loads every image of an input directory or file list, applies
+ * the requested transforms and writes the results to an output directory.
+ * A pack run stores the same kind of input list in a few large shard files.
+ * Decode, transform and encode run as pipeline stages on a work-stealing
+ * thread pool, so file I/O, inflate/deflate and pixel work overlap across
+ * cores.
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+
+#include "../../include/img_utils.h" // Include the public API for type definitions
+
+/**
+ * Options of a batch run.
+ */
+typedef struct {
+    const char *input;      ///< Directory of image files, a single image file, or a text file listing one path per line
+    const char *output_dir; ///< Directory receiving the results under their original file names, in the format their extension names; created if missing
+    int threads;            ///< Worker threads, or 0 for one per online CPU
+    int queue_capacity;     ///< Bound of each inter-stage queue, or 0 for twice the thread count
+    int width;              ///< Output width, or 0 to keep the size
+    int height;             ///< Output height, or 0 to keep the size
+    img_filter filter;      ///< Resampling filter when resizing
+    float rotate;           ///< Rotation in degrees, applied after resizing; 0 for none
+    int flip;               ///< Non-zero to flip each image horizontally
+    img_write_options write; ///< PNG encoder settings for the results written as PNG
+    const char *cache_dir;  ///< Directory of a persistent cache of decoded and transformed images, or NULL for none
+} img_batch_options;
+
+/**
+ * Returns the default batch options: no transforms, one thread per CPU.
+ *
+ * @return The options; input and output_dir still have to be set.
+ */
+img_batch_options img_batch_defaults(void);
+
+/**
+ * Runs a batch and prints per-stage throughput and queue occupancy.
+ *
+ * Nothing is processed if two inputs share a file name, since both would be
+ * written to the same output, or if an output would overwrite its input.
+ *
+ * @param opts The options.
+ * @param report Stream receiving the report, or NULL for none.
+ * @return RET_SUCCESS when every image was processed, or RET_FAIL if the
+ *         inputs cannot be listed, the outputs collide or any image failed.
+ */
+int img_batch_run(const img_batch_options *opts, FILE *report);
+
+/**
+ * Options of a pack run.
+ */
+typedef struct {
+    const char *input;  ///< Directory of image files, a single image file, or a text file listing one path per line
+    const char *output; ///< Path prefix of the shard files
+    size_t shard_bytes; ///< Size after which a new shard is started, or 0 for 1 GiB
+    int raw;            ///< Non-zero to store decoded pixels instead of copying the PNG files; other formats are always stored decoded
+} img_pack_options;
+
+/**
+ * Packs every input image into shard files readable with img_pack_open(), in
+ * input order, and prints the entry count, size and throughput. Inputs that
+ * cannot be read or decoded are skipped with a warning.
+ *
+ * @param opts The options.
+ * @param report Stream receiving the report, or NULL for none.
+ * @return RET_SUCCESS when every readable image was packed, or RET_FAIL if
+ *         the inputs cannot be listed or a shard cannot be written.
+ */
+int img_batch_pack(const img_pack_options *opts, FILE *report);
+
+#endif // BATCH_H
@@ -0,0 +1,50 @@
+/**
+ * @file internal_img_bmp.h
+ * Provides reading and writing of uncompressed BMP files.
+ *
+ * Only the uncompressed 24 and 32-bit variants are handled, which store
+ * each row as-is, bottom-up unless the height is negative. Little-endian
+ * fields are decoded byte by byte, so the code does not depend on the host
+ * byte order.
+ */
+
+#ifndef INTERNAL_IMG_BMP_H
+#define INTERNAL_IMG_BMP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../../include/img_utils.h" // Include the public API for type definitions
+#include "internal_img_raw.h" // For the img_raw_layout description
+
+/**
+ * Parses the headers of a BMP file.
+ *
+ * Accepts 24-bit BI_RGB files, 32-bit BI_RGB files, whose 4th byte is
+ * padding, and 32-bit BI_BITFIELDS files whose masks select whole bytes in
+ * RGBA or BGRA order.
+ *
+ * @param data The start of the file.
+ * @param size The file size in bytes.
+ * @param layout Receives the sample layout.
+ * @return RET_SUCCESS on success, or RET_FAIL if the headers are malformed,
+ *         describe an unsupported variant or the rows extend past the end of
+ *         the file.
+ */
+int img_bmp_parse(const uint8_t *data, size_t size, img_raw_layout *layout);
+
+/**
+ * Writes an Image as a top-down 32-bit BMP file with RGBA bit masks.
+ *
+ * The pixels start 128 bytes into the file in the Image's own byte order,
+ * so loading the file back maps them without a copy.
+ *
+ * @param fp The file to write to, opened in binary write mode. The caller closes it.
+ * @param img The image to write.
+ * @return RET_SUCCESS on success, or RET_FAIL if the image is too large for
+ *         the format or writing fails.
+ */
+int img_bmp_write(FILE *fp, const Image *img);
+
+#endif // INTERNAL_IMG_BMP_H
@@ -0,0 +1,54 @@
+/**
+ * @file internal_img_cache.h
+ * Provides the hashing and on-disk entry format behind the image cache.
+ *
+ * Every cache entry is identified by two 64-bit values: the identity of the
+ * source file and a fingerprint of the processing applied to it. The disk
+ * store keeps one file per entry, named after both values, holding a short
+ * header followed by the raw RGBA8 rows. Entries are written to a temporary
+ * name and renamed into place, so readers never see a partial file and
+ * several processes can share a store.
+ */
+
+#ifndef INTERNAL_IMG_CACHE_H
+#define INTERNAL_IMG_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../include/img_utils.h" // Include the public API for type definitions
+
+/**
+ * Magic bytes opening every disk entry; the digit is the format version.
+ */
+#define IMG_CACHE_MAGIC "NLCACHE1"
+
+/**
+ * File name suffix of disk entries.
+ */
+#define IMG_CACHE_SUFFIX ".nlc"
+
+/**
+ * Header of a disk entry. The pixels follow at offset sizeof(img_cache_header),
+ * which keeps them 64-byte aligned in a page-aligned mapping.
+ */
+typedef struct {
+    char magic[8];        ///< IMG_CACHE_MAGIC, without the terminator
+    uint32_t width;       ///< Image width in pixels
+    uint32_t height;      ///< Image height in pixels; rows are width pixels apart
+    uint64_t source;      ///< Source identity, repeated from the file name
+    uint64_t fingerprint; ///< Processing fingerprint, repeated from the file name
+    uint8_t reserved[32]; ///< Zero
+} img_cache_header;
+
+/**
+ * Hashes a byte range (XXH64).
+ *
+ * @param data The bytes.
+ * @param size The number of bytes.
+ * @param seed The seed, e.g. the hash of preceding data.
+ * @return The 64-bit hash.
+ */
+uint64_t img_hash_bytes(const void *data, size_t size, uint64_t seed);
+
+#endif // INTERNAL_IMG_CACHE_H
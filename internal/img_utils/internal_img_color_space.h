@@ -0,0 +1,92 @@
+/**
+ * @file internal_img_color_space.h
+ * Provides the row kernels behind the colour space conversions.
+ *
+ * A conversion is resolved once into a plan: YCbCr and gray conversions in
+ * either direction are a 3x3 matrix plus offset in 13-bit fixed point, HSV
+ * conversions use integer division tables. The row kernels then read pixels
+ * or planes and write pixels or planes, with an AVX2 variant picked at run
+ * time and a scalar fallback computing the same integers.
+ */
+
+#ifndef INTERNAL_IMG_COLOR_SPACE_H
+#define INTERNAL_IMG_COLOR_SPACE_H
+
+#include <stdint.h>
+
+#include "../../include/img_utils.h" // Include the public API for type definitions
+
+/**
+ * Fractional bits of the matrix weights.
+ */
+#define IMG_COLOR_SHIFT 13
+
+/**
+ * Value of the constant input paired with the third channel, through which
+ * the offset (including rounding) of each output is applied.
+ */
+#define IMG_COLOR_ONE 128
+
+/**
+ * How a plan computes its outputs.
+ */
+typedef enum {
+    IMG_COLOR_OP_MATRIX  = 0, ///< Fixed-point matrix plus offset
+    IMG_COLOR_OP_TO_HSV  = 1, ///< RGB to HSV
+    IMG_COLOR_OP_HSV_RGB = 2  ///< HSV to RGB
+} img_color_op;
+
+/**
+ * A resolved conversion. For matrices, output c is
+ *   (w01[c] . (in0, in1) + w2k[c] . (in2, IMG_COLOR_ONE)) >> IMG_COLOR_SHIFT
+ * saturated to 0 to 255, with each pair of int16 weights packed into one
+ * int32 (first weight in the low half) as pmaddwd consumes them.
+ */
+typedef struct {
+    img_color_op op;
+    int single;      ///< Non-zero when only the first input plane exists (gray to RGB)
+    int32_t w01[3];
+    int32_t w2k[3];
+} img_color_plan;
+
+/**
+ * Resolves a conversion.
+ *
+ * @param plan Receives the plan.
+ * @param space The colour space.
+ * @param to_rgb Zero for RGB to the space, non-zero for the space to RGB.
+ * @return RET_SUCCESS on success, or RET_FAIL for an unknown space.
+ */
+int img_color_plan_init(img_color_plan *plan, img_color_space space, int to_rgb);
+
+/**
+ * Converts a row of pixels in their interleaved layout, keeping alpha.
+ *
+ * @param plan The conversion.
+ * @param src n pixels.
+ * @param dst n pixels; may be src.
+ * @param n The number of pixels.
+ */
+void img_color_row(const img_color_plan *plan, const pixel *src, pixel *dst, int n);
+
+/**
+ * Converts a row of pixels into planes.
+ *
+ * @param plan The conversion.
+ * @param src n pixels.
+ * @param planes Three rows of n samples; NULL entries are not written.
+ * @param n The number of pixels.
+ */
+void img_color_row_to_planes(const img_color_plan *plan, const pixel *src, uint8_t *const planes[3], int n);
+
+/**
+ * Converts a row of planes into opaque pixels.
+ *
+ * @param plan The conversion.
+ * @param planes Three rows of n samples; only the first for single-plane plans.
+ * @param dst n pixels.
+ * @param n The number of pixels.
+ */
+void img_color_row_from_planes(const img_color_plan *plan, const uint8_t *const planes[3], pixel *dst, int n);
+
+#endif // INTERNAL_IMG_COLOR_SPACE_H
@@ -0,0 +1,78 @@
+/**
+ * @file internal_img_convert.h
+ * Provides the row kernels that expand decoded samples to the pixel layout.
+ *
+ * Decoders hand over rows in the file's native sample layout and these
+ * kernels turn them into RGBA8 pixels (or narrower 8-bit layouts). Each
+ * kernel has SSE2/SSSE3/AVX2 variants where they pay off, picked at run time,
+ * and a scalar fallback.
+ */
+
+#ifndef INTERNAL_IMG_CONVERT_H
+#define INTERNAL_IMG_CONVERT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../include/img_utils.h" // Include the public API for type definitions
+
+/**
+ * Broadcasts gray samples to opaque RGBA pixels.
+ *
+ * @param src n gray samples.
+ * @param dst n pixels.
+ * @param n The number of pixels.
+ */
+void img_cvt_gray_to_rgba(const uint8_t *src, pixel *dst, int n);
+
+/**
+ * Expands interleaved gray + alpha samples to RGBA pixels.
+ *
+ * @param src 2n samples.
+ * @param dst n pixels.
+ * @param n The number of pixels.
+ */
+void img_cvt_gray_alpha_to_rgba(const uint8_t *src, pixel *dst, int n);
+
+/**
+ * Inserts an opaque alpha channel after interleaved RGB samples.
+ *
+ * @param src 3n samples.
+ * @param dst n pixels.
+ * @param n The number of pixels.
+ */
+void img_cvt_rgb_to_rgba(const uint8_t *src, pixel *dst, int n);
+
+/**
+ * Maps palette indices to pixels through a 256-entry table.
+ *
+ * @param idx n palette indices.
+ * @param lut The palette; entries past the file's palette should be set to a
+ *            defined value since corrupt files may index them.
+ * @param dst n pixels.
+ * @param n The number of pixels.
+ */
+void img_cvt_palette_to_rgba(const uint8_t *idx, const pixel *lut, pixel *dst, int n);
+
+/**
+ * Narrows big-endian 16-bit samples to 8 bits with exact rounding (v / 257).
+ *
+ * @param src n big-endian 16-bit samples.
+ * @param dst n 8-bit samples. May alias src.
+ * @param n The number of samples.
+ */
+void img_cvt_narrow16(const uint8_t *src, uint8_t *dst, size_t n);
+
+/**
+ * Unpacks 1, 2 or 4-bit samples, most significant bits first, to one byte each.
+ *
+ * @param src The packed samples.
+ * @param dst n bytes.
+ * @param n The number of samples.
+ * @param depth The bits per sample: 1, 2 or 4.
+ * @param scale Multiplier applied to each sample: 1 keeps palette indices,
+ *              255 / (2^depth - 1) stretches gray levels to the 8-bit range.
+ */
+void img_cvt_unpack_bits(const uint8_t *src, uint8_t *dst, int n, int depth, int scale);
+
+#endif // INTERNAL_IMG_CONVERT_H
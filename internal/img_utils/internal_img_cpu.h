@@ -0,0 +1,51 @@
+/**
+ * @file internal_img_cpu.h
+ * Provides run-time CPU feature detection for kernel dispatch.
+ *
+ * The library is built for the baseline instruction set; SIMD kernels are
+ * compiled with per-function target attributes. At startup every module with
+ * such kernels binds its function pointers once, from the level reported
+ * here, so the hot loops never test CPU features.
+ *
+ * Setting the environment variable NEURO_LENS_CPU to one of "scalar",
+ * "sse2", "ssse3", "avx2" or "avx512" caps the level, e.g. to run the scalar
+ * reference kernels for debugging or differential testing. It is read once,
+ * before main().
+ */
+
+#ifndef INTERNAL_IMG_CPU_H
+#define INTERNAL_IMG_CPU_H
+
+/**
+ * Name of the environment variable capping the dispatch level.
+ */
+#define IMG_CPU_ENV "NEURO_LENS_CPU"
+
+/**
+ * Instruction set levels, each implying the ones below it.
+ */
+typedef enum {
+    IMG_CPU_SCALAR = 0, ///< Portable C only
+    IMG_CPU_SSE2   = 1,
+    IMG_CPU_SSSE3  = 2,
+    IMG_CPU_AVX2   = 3, ///< AVX2 and FMA
+    IMG_CPU_AVX512 = 4  ///< AVX-512 F, BW and VL
+} img_cpu_level;
+
+/**
+ * Returns the level kernels are dispatched to: the highest level the CPU and
+ * operating system support, capped by NEURO_LENS_CPU. Detected once.
+ *
+ * @return The level.
+ */
+img_cpu_level img_cpu_get_level(void);
+
+/**
+ * Returns the name of a level, as accepted by NEURO_LENS_CPU.
+ *
+ * @param level The level.
+ * @return The name, e.g. "avx2".
+ */
+const char* img_cpu_level_name(img_cpu_level level);
+
+#endif // INTERNAL_IMG_CPU_H
@@ -13,18 +13,55 @@
 
 #include "../../include/img_utils.h" // Include the public API for type definitions
 #include "internal_img_png.h" // For handling PNG-specific I/O operations
+#include "internal_img_raw.h" // For the uncompressed formats
+
+/**
+ * File formats known to the I/O hub.
+ */
+typedef enum {
+    IMG_FORMAT_PNG = 0, ///< PNG, and anything unrecognised, which the PNG decoder rejects
+    IMG_FORMAT_PPM = 1, ///< Binary PGM (P5) or PPM (P6)
+    IMG_FORMAT_PAM = 2, ///< PAM (P7)
+    IMG_FORMAT_BMP = 3  ///< Windows bitmap
+} img_format;
+
+/**
+ * Identifies the format of a file held in memory from its leading magic bytes.
+ *
+ * @param data The start of the file.
+ * @param size The number of bytes available.
+ * @return The format.
+ */
+img_format img_io_sniff_mem(const void *data, size_t size);
+
+/**
+ * Identifies the format of a file from its leading magic bytes.
+ *
+ * @param fp The file, positioned at its start. It is rewound before returning.
+ * @return The format.
+ */
+img_format img_io_sniff(FILE *fp);
+
+/**
+ * Picks the format to write from a file name extension: .pam, .ppm and .bmp
+ * select the uncompressed formats, anything else PNG.
+ *
+ * @param filename The path of the file to write.
+ * @return The format.
+ */
+img_format img_io_format_for_name(const char *filename);
 
 /**
  * Loads an image from a file.
  * 
- * This function determines the image format based on the file extension and 
- * delegates the loading process to the corresponding format-specific function. 
- * It supports various formats, including but not limited to PNG and JPEG. 
- * The function allocates memory for a new Image structure and populates it 
- * with the image data read from the file.
- *
- * @param filename The path to the image file to be loaded. The file extension 
- *                 is used to infer the image format.
+ * This function determines the image format from the file's magic bytes and
+ * delegates the loading process to the corresponding format-specific function:
+ * PNG is decoded, while PGM, PPM, PAM and BMP files are mapped into memory.
+ * The function allocates memory for a new Image structure and populates it
+ * with the image data read from the file, unless the file already holds
+ * RGBA8 pixels, which the image then uses in place.
+ *
+ * @param filename The path to the image file to be loaded.
  * 
  * @return A pointer to a newly allocated Image structure containing the loaded 
  *         image data. If the file cannot be opened, the format is not supported, 
@@ -32,13 +69,48 @@
  */
 Image* img_io_load(const char *filename);
 
+/**
+ * Loads an image from a file held in memory.
+ *
+ * The format is chosen from the magic bytes as in img_io_load(); the pixels
+ * are always decoded or copied into a new image.
+ *
+ * @param data The file contents.
+ * @param size The size of the contents in bytes.
+ * @return The new image, or NULL if the contents cannot be decoded.
+ */
+Image* img_io_load_mem(const void *data, size_t size);
+
+/**
+ * Loads an image from a file into a packed image in its native layout.
+ *
+ * @param filename The path to the image file to be loaded.
+ * @return The new image, or NULL if the file cannot be opened or decoded.
+ */
+img_packed* img_io_load_packed(const char *filename);
+
+/**
+ * Streams the rows of an image file into a consumer.
+ *
+ * Delegates to the format-specific row reader, so the decoded image is not
+ * held in memory as a whole.
+ *
+ * @param filename The path to the image file to be read.
+ * @param header Called with the image size before the first row.
+ * @param sink Receives each decoded row in order.
+ * @param ctx Opaque context passed to both callbacks.
+ * @return RET_SUCCESS on success, or RET_FAIL if the file cannot be opened
+ *         or decoded.
+ */
+int img_io_read_rows(const char *filename, img_header_fn header, img_row_sink sink, void *ctx);
+
 /**
  * Writes an image to a file.
  * 
  * This function determines the appropriate image format to use for saving based 
- * on the file extension specified in the filename. It delegates the writing 
- * process to the corresponding format-specific function. The function aims to 
- * preserve the original image quality and characteristics as much as possible.
+ * on the file extension specified in the filename (see img_io_format_for_name()).
+ * It delegates the writing process to the corresponding format-specific function.
+ * PPM files have no alpha channel; every other format is lossless.
  *
  * @param filename The path to the file where the image will be saved. The file 
  *                 extension is used to infer the desired image format for saving.
@@ -47,4 +119,15 @@ Image* img_io_load(const char *filename);
  */
 void img_io_write(const char *filename, Image *img);
 
+/**
+ * Writes an image to a file with explicit encoder options.
+ *
+ * @param filename The path to the file where the image will be saved.
+ * @param img The image to save.
+ * @param opts The PNG encoder options, or NULL for the defaults. Ignored by
+ *             the uncompressed formats.
+ * @return RET_SUCCESS on success, or RET_FAIL if the file cannot be written.
+ */
+int img_io_write_opts(const char *filename, const Image *img, const img_write_options *opts);
+
 #endif // INTERNAL_IMG_IO_H
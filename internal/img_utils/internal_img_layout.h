@@ -0,0 +1,94 @@
+/**
+ * @file internal_img_layout.h
+ * Provides the row kernels that move samples between interleaved and planar
+ * layouts and between 8-bit and float elements.
+ *
+ * They back the img_tensor conversions and are available to any module that
+ * wants to work on contiguous channel planes. Each kernel has SSE2/SSSE3/AVX2
+ * variants where they pay off, picked at run time, and a scalar fallback.
+ */
+
+#ifndef INTERNAL_IMG_LAYOUT_H
+#define INTERNAL_IMG_LAYOUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../include/img_utils.h" // Include the public API for type definitions
+
+/**
+ * Splits interleaved 4-channel samples into planes.
+ *
+ * @param src 4n samples.
+ * @param c0 n samples of the first channel.
+ * @param c1 n samples of the second channel.
+ * @param c2 n samples of the third channel.
+ * @param c3 n samples of the fourth channel, or NULL to drop it.
+ * @param n The number of pixels.
+ */
+void img_layout_deinterleave4_u8(const uint8_t *src, uint8_t *c0, uint8_t *c1, uint8_t *c2, uint8_t *c3, int n);
+
+/**
+ * Merges planes into interleaved 4-channel samples.
+ *
+ * @param c0 n samples of the first channel.
+ * @param c1 n samples of the second channel.
+ * @param c2 n samples of the third channel.
+ * @param c3 n samples of the fourth channel, or NULL for 255.
+ * @param dst 4n samples.
+ * @param n The number of pixels.
+ */
+void img_layout_interleave4_u8(const uint8_t *c0, const uint8_t *c1, const uint8_t *c2, const uint8_t *c3,
+                               uint8_t *dst, int n);
+
+/**
+ * Splits interleaved 3-channel samples into planes.
+ *
+ * @param src 3n samples.
+ * @param c0 n samples of the first channel.
+ * @param c1 n samples of the second channel.
+ * @param c2 n samples of the third channel.
+ * @param n The number of pixels.
+ */
+void img_layout_deinterleave3_u8(const uint8_t *src, uint8_t *c0, uint8_t *c1, uint8_t *c2, int n);
+
+/**
+ * Merges planes into interleaved 3-channel samples.
+ *
+ * @param c0 n samples of the first channel.
+ * @param c1 n samples of the second channel.
+ * @param c2 n samples of the third channel.
+ * @param dst 3n samples.
+ * @param n The number of pixels.
+ */
+void img_layout_interleave3_u8(const uint8_t *c0, const uint8_t *c1, const uint8_t *c2, uint8_t *dst, int n);
+
+/**
+ * Drops the fourth channel of interleaved 4-channel samples.
+ *
+ * @param src 4n samples.
+ * @param dst 3n samples.
+ * @param n The number of pixels.
+ */
+void img_layout_drop_alpha_u8(const uint8_t *src, uint8_t *dst, int n);
+
+/**
+ * Widens 8-bit samples to floats with the same value.
+ *
+ * @param src n samples.
+ * @param dst n floats.
+ * @param n The number of samples.
+ */
+void img_layout_u8_to_f32(const uint8_t *src, float *dst, size_t n);
+
+/**
+ * Narrows floats to 8-bit samples, rounding to nearest even and saturating
+ * to 0 to 255. NaN becomes 0.
+ *
+ * @param src n floats.
+ * @param dst n samples.
+ * @param n The number of samples.
+ */
+void img_layout_f32_to_u8(const float *src, uint8_t *dst, size_t n);
+
+#endif // INTERNAL_IMG_LAYOUT_H
@@ -1,9 +1,27 @@
+/**
+ * @file internal_img_normalization.h
+ * Provides in-place normalization of Image pixels.
+ *
+ * Normalization into model input buffers goes through img_normalize() in the
+ * public API; this is the 8-bit in-place variant built on the same tables.
+ */
+
 #ifndef INTERNAL_IMG_NORMALIZATION_H
 #define INTERNAL_IMG_NORMALIZATION_H
 
 #include "../../include/img_utils.h" // Include the public API for type definitions
 
+/**
+ * Stretches the R, G and B channels of an image in place so that each
+ * channel's smallest value becomes new_min and its largest new_max. Results
+ * are rounded and saturated to 0 to 255; alpha is left alone. Channels with
+ * a single value become new_min.
+ *
+ * @param img The image to modify.
+ * @param new_min The target of each channel's minimum.
+ * @param new_max The target of each channel's maximum.
+ */
 void img_normalize_pixel_values(Image *img, float new_min, float new_max);
 
 
-#endif // INTERNAL_IMG_NORMALIZATION_H
\ No newline at end of file
+#endif // INTERNAL_IMG_NORMALIZATION_H
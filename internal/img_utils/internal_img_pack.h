@@ -0,0 +1,58 @@
+/**
+ * @file internal_img_pack.h
+ * Describes the shard file format of image packs.
+ *
+ * A pack is a series of shard files named <prefix>-00000.nlp, -00001.nlp and
+ * so on. Each shard starts with a fixed header, followed by the entries, each
+ * starting on a 64-byte boundary, and ends with an index of one fixed-size
+ * record per entry. A reader maps the whole shard, reads the header and then
+ * reaches any entry through its record without further I/O. Shards are
+ * written under a temporary name and renamed once their index is complete.
+ */
+
+#ifndef INTERNAL_IMG_PACK_H
+#define INTERNAL_IMG_PACK_H
+
+#include <stdint.h>
+
+#include "../../include/img_utils.h" // Include the public API for type definitions
+
+/**
+ * Magic bytes opening every shard; the digits are the format version.
+ */
+#define IMG_PACK_MAGIC "NLPACK01"
+
+/**
+ * File name suffix of shards.
+ */
+#define IMG_PACK_SUFFIX ".nlp"
+
+/**
+ * Alignment of entries within a shard, so raw entries can be used in place.
+ */
+#define IMG_PACK_ALIGNMENT 64
+
+/**
+ * Shard header, at offset 0.
+ */
+typedef struct {
+    char magic[8];         ///< IMG_PACK_MAGIC, without the terminator
+    uint32_t count;        ///< Number of entries
+    uint32_t record_size;  ///< sizeof(img_pack_record), for forward compatibility
+    uint64_t index_offset; ///< Offset of the first index record
+    uint8_t reserved[40];  ///< Zero
+} img_pack_header;
+
+/**
+ * Index record of one entry.
+ */
+typedef struct {
+    uint64_t offset;  ///< Offset of the entry data, a multiple of IMG_PACK_ALIGNMENT
+    uint64_t size;    ///< Size of the entry data in bytes
+    uint32_t width;   ///< Image width in pixels
+    uint32_t height;  ///< Image height in pixels
+    uint32_t format;  ///< An img_pack_format
+    uint32_t reserved; ///< Zero
+} img_pack_record;
+
+#endif // INTERNAL_IMG_PACK_H
@@ -7,7 +7,23 @@
 #define INTERNAL_IMG_PNG_H
 
 #include <png.h>
+#include <stdio.h>
 #include "../../include/img_utils.h" // Include the public API for type definitions
+#include "internal_img_resize.h" // For the img_row_sink consumer type
+
+/**
+ * Called once the image header has been read, before any row is decoded.
+ *
+ * Lets a streaming consumer size itself (e.g. build a resize plan) from the
+ * source dimensions and tell the decoder how many rows it needs.
+ *
+ * @param ctx The opaque context passed to the reader.
+ * @param width The image width in pixels.
+ * @param height The image height in pixels.
+ * @return The number of leading rows to decode (clamped to the height), or a
+ *         negative value to abort.
+ */
+typedef int (*img_header_fn)(void *ctx, int width, int height);
 
 /**
  * Writes an Image to a PNG file.
@@ -23,6 +39,65 @@
  */
 void img_png_write(const char *filename, Image *img);
 
+/**
+ * Smallest number of rows per strip of the parallel encoder. Shorter images
+ * are always encoded serially.
+ */
+#define IMG_PNG_STRIP_MIN_ROWS 32
+
+/**
+ * Writes an Image to a PNG file with explicit encoder options.
+ *
+ * Encodes serially through libpng with one thread, and through
+ * img_png_write_strips() otherwise.
+ *
+ * @param filename The path to the file where the image should be saved.
+ * @param img The image to save.
+ * @param opts The encoder options, or NULL for the defaults.
+ * @return RET_SUCCESS on success, or RET_FAIL if the file cannot be written.
+ */
+int img_png_write_opts(const char *filename, const Image *img, const img_write_options *opts);
+
+/**
+ * Encodes an Image as a PNG stream at the current position of a file.
+ *
+ * Same encoder choice as img_png_write_opts(). Only writes sequentially, so
+ * the stream may be appended to a larger file.
+ *
+ * @param fp The file to write to, opened in binary write mode. The caller closes it.
+ * @param img The image to encode.
+ * @param opts The encoder options, or NULL for the defaults.
+ * @return RET_SUCCESS on success, or RET_FAIL on allocation or write failure.
+ */
+int img_png_write_fp(FILE *fp, const Image *img, const img_write_options *opts);
+
+/**
+ * Encodes an Image as a PNG stream, deflating horizontal strips in parallel.
+ *
+ * Every strip is filtered and deflated as a raw deflate stream primed with
+ * the previous strip's last 32 KiB of filtered data as a preset dictionary,
+ * and ends on a byte boundary with a sync flush (the last one with a final
+ * block). Concatenated behind a zlib header they form one valid stream; its
+ * Adler-32 trailer is combined from the per-strip checksums. The chunks
+ * and their CRCs are written directly, without libpng. The strips are
+ * encoded through img_parallel_for(), so they share the process-wide pool.
+ *
+ * @param fp The file to write to, opened in binary write mode.
+ * @param img The image to encode.
+ * @param opts The encoder options; level must be in [1, 9].
+ * @param threads The number of threads the strips are cut for, at least 1.
+ * @return RET_SUCCESS on success, or RET_FAIL on allocation or write failure.
+ */
+int img_png_write_strips(FILE *fp, const Image *img, const img_write_options *opts, int threads);
+
+/**
+ * Maps an img_zlib_strategy to the zlib constant.
+ *
+ * @param strategy The strategy.
+ * @return The zlib strategy.
+ */
+int img_png_zlib_strategy(img_zlib_strategy strategy);
+
 /**
  * Opens a PNG file and reads it into an Image structure.
  * 
@@ -44,4 +119,46 @@ void img_png_write(const char *filename, Image *img);
  */
 Image* img_png_open(FILE *fp);
 
+/**
+ * Decodes a PNG stream held in memory into an Image structure.
+ *
+ * Same decoding as img_png_open(), but libpng pulls the compressed data
+ * straight from the buffer through a read callback instead of stdio.
+ *
+ * @param data The PNG stream.
+ * @param size The size of the stream in bytes.
+ * @return The new image, or NULL if the stream is truncated or cannot be decoded.
+ */
+Image* img_png_open_mem(const void *data, size_t size);
+
+/**
+ * Opens a PNG file and reads it into a packed image in its native layout.
+ *
+ * Same decoding as img_png_open(), minus the expansion to RGBA: see
+ * img_load_packed() for the resulting channel layouts.
+ *
+ * @param fp The file pointer to an open PNG file. The caller closes it.
+ * @return The new image, or NULL on error.
+ */
+img_packed* img_png_open_packed(FILE *fp);
+
+/**
+ * Decodes a PNG file row by row into a consumer.
+ *
+ * Rows are decoded one at a time into a single reused row buffer and handed to
+ * the sink in order, so the full image is never materialized and memory use
+ * does not depend on the image height. Decoding stops after the number of
+ * rows requested by the header callback. Interlaced files cannot be streamed,
+ * since no row is final before the last Adam7 pass; they are decoded whole
+ * and then replayed through the sink.
+ *
+ * @param fp The file pointer to an open PNG file. The caller closes it.
+ * @param header Called with the image size before the first row.
+ * @param sink Receives each decoded row; the row is only valid during the call.
+ * @param ctx Opaque context passed to both callbacks.
+ * @return RET_SUCCESS on success, or RET_FAIL if the file cannot be decoded,
+ *         the header callback aborts or an allocation fails.
+ */
+int img_png_read_rows(FILE *fp, img_header_fn header, img_row_sink sink, void *ctx);
+
 #endif // INTERNAL_IMG_PNG_H
\ No newline at end of file
@@ -0,0 +1,53 @@
+/**
+ * @file internal_img_pnm.h
+ * Provides reading and writing of binary Netpbm files.
+ *
+ * PGM (P5), PPM (P6) and PAM (P7) files store their samples uncompressed,
+ * row after row, right behind a short text header. Samples up to 255 take
+ * one byte and larger ones two bytes, most significant first.
+ */
+
+#ifndef INTERNAL_IMG_PNM_H
+#define INTERNAL_IMG_PNM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../../include/img_utils.h" // Include the public API for type definitions
+#include "internal_img_raw.h" // For the img_raw_layout description
+
+/**
+ * Parses the header of a binary Netpbm file.
+ *
+ * @param data The start of the file.
+ * @param size The file size in bytes.
+ * @param layout Receives the sample layout.
+ * @return RET_SUCCESS on success, or RET_FAIL if the header is malformed,
+ *         describes an unsupported variant (e.g. plain-text or 1-bit
+ *         samples) or the samples extend past the end of the file.
+ */
+int img_pnm_parse(const uint8_t *data, size_t size, img_raw_layout *layout);
+
+/**
+ * Writes an Image as a PAM file with RGB_ALPHA tuples.
+ *
+ * The header is padded with a comment so the samples start 64 bytes into
+ * the file, and loading the file back maps the pixels without a copy.
+ *
+ * @param fp The file to write to, opened in binary write mode. The caller closes it.
+ * @param img The image to write.
+ * @return RET_SUCCESS on success, or RET_FAIL if writing fails.
+ */
+int img_pam_write(FILE *fp, const Image *img);
+
+/**
+ * Writes an Image as a PPM file, dropping the alpha channel.
+ *
+ * @param fp The file to write to, opened in binary write mode. The caller closes it.
+ * @param img The image to write.
+ * @return RET_SUCCESS on success, or RET_FAIL on allocation or write failure.
+ */
+int img_ppm_write(FILE *fp, const Image *img);
+
+#endif // INTERNAL_IMG_PNM_H
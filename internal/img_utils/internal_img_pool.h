@@ -0,0 +1,54 @@
+/**
+ * @file internal_img_pool.h
+ * Provides the internal image buffer allocator.
+ *
+ * Every image struct and pixel buffer is obtained through img_pool_alloc() and
+ * released through img_pool_free(). Blocks are 64-byte aligned so SIMD kernels
+ * can use aligned loads on row starts. When the pool is enabled, released
+ * blocks are kept in size-class buckets, first in a per-thread cache and then
+ * in a shared, mutex-protected store, and handed back out on the next request
+ * of the same class. When it is disabled, blocks go straight back to the heap.
+ */
+
+#ifndef INTERNAL_IMG_POOL_H
+#define INTERNAL_IMG_POOL_H
+
+#include <stddef.h>
+
+#include "../../include/img_utils.h" // Include the public API for type definitions
+
+/**
+ * Alignment of every block returned by img_pool_alloc().
+ */
+#define IMG_POOL_ALIGNMENT 64
+
+/**
+ * Allocates a 64-byte aligned block of at least `size` bytes.
+ *
+ * Served from the pool when it is enabled and a block of the same size class
+ * is cached; otherwise taken from the heap.
+ *
+ * @param size The number of bytes requested.
+ * @return The block, or NULL if the allocation fails.
+ */
+void* img_pool_alloc(size_t size);
+
+/**
+ * Releases a block obtained from img_pool_alloc().
+ *
+ * The block is cached for reuse while the pool is enabled and below its
+ * retention limit, and returned to the heap otherwise.
+ *
+ * @param ptr The block to release. NULL is ignored.
+ */
+void img_pool_free(void *ptr);
+
+/**
+ * Returns the usable size of a block obtained from img_pool_alloc().
+ *
+ * @param ptr The block.
+ * @return The number of usable bytes, which is at least the requested size.
+ */
+size_t img_pool_block_size(const void *ptr);
+
+#endif // INTERNAL_IMG_POOL_H
@@ -0,0 +1,100 @@
+/**
+ * @file internal_img_raw.h
+ * Provides loading of uncompressed image files through a memory mapping.
+ *
+ * The format parsers (see internal_img_pnm.h and internal_img_bmp.h) only
+ * read the header and describe where and how the samples are laid out in
+ * the file. The loaders here map the file and, when that layout already is
+ * the requested one, hand out images pointing straight into the mapping;
+ * otherwise each row is converted once into a new image.
+ */
+
+#ifndef INTERNAL_IMG_RAW_H
+#define INTERNAL_IMG_RAW_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "../../include/img_utils.h" // Include the public API for type definitions
+#include "internal_img_png.h" // For the img_header_fn callback type
+
+/**
+ * Channel order of colour samples in a file.
+ */
+typedef enum {
+    IMG_RAW_RGB = 0, ///< Red first
+    IMG_RAW_BGR = 1  ///< Blue first, as in BMP
+} img_raw_order;
+
+/**
+ * Sample layout of an uncompressed file, filled in by a format parser.
+ */
+typedef struct {
+    int width;           ///< Width in pixels
+    int height;          ///< Height in pixels
+    int channels;        ///< Samples per pixel: 1 gray, 2 gray + alpha, 3 colour, 4 colour + alpha
+    int sample_bytes;    ///< 1, or 2 for big-endian 16-bit samples
+    int maxval;          ///< Largest sample value, mapped to 255
+    img_raw_order order; ///< Order of the colour samples
+    int opaque;          ///< Non-zero when a 4th sample is padding rather than alpha
+    size_t offset;       ///< File offset of the first sample of the top row
+    ptrdiff_t pitch;     ///< Distance from one row to the row below in bytes; negative for bottom-up files
+} img_raw_layout;
+
+/**
+ * Checks that a layout describes rows lying within a file.
+ *
+ * @param layout The layout.
+ * @param size The file size in bytes.
+ * @return RET_SUCCESS if every row is inside the file, or RET_FAIL.
+ */
+int img_raw_check(const img_raw_layout *layout, size_t size);
+
+/**
+ * Maps an uncompressed file and loads it as RGBA.
+ *
+ * Files already stored as top-down 8-bit RGBA are not copied: the image
+ * points into a private copy-on-write mapping that it keeps alive.
+ *
+ * @param fp The file, opened in binary read mode. The caller closes it.
+ * @return The new image, or NULL if the file cannot be mapped or parsed.
+ */
+Image* img_raw_open(FILE *fp);
+
+/**
+ * Loads an uncompressed file held in memory as RGBA.
+ *
+ * The caller keeps ownership of the buffer, so the pixels are always copied.
+ *
+ * @param data The file contents.
+ * @param size The size of the contents in bytes.
+ * @return The new image, or NULL if the contents cannot be parsed.
+ */
+Image* img_raw_open_mem(const void *data, size_t size);
+
+/**
+ * Maps an uncompressed file and loads it in its native channel layout.
+ *
+ * Top-down 8-bit gray, gray + alpha, RGB and RGBA files are not copied.
+ * Blue-first files are reordered to RGB and padding samples are dropped.
+ *
+ * @param fp The file, opened in binary read mode. The caller closes it.
+ * @return The new image, or NULL if the file cannot be mapped or parsed.
+ */
+img_packed* img_raw_open_packed(FILE *fp);
+
+/**
+ * Maps an uncompressed file and streams its rows as RGBA into a consumer.
+ *
+ * Rows already stored as 8-bit RGBA are passed straight from the mapping.
+ *
+ * @param fp The file, opened in binary read mode. The caller closes it.
+ * @param header Called with the image size before the first row.
+ * @param sink Receives each row in order; the row is only valid during the call.
+ * @param ctx Opaque context passed to both callbacks.
+ * @return RET_SUCCESS on success, or RET_FAIL if the file cannot be mapped or
+ *         parsed, the header callback aborts or an allocation fails.
+ */
+int img_raw_read_rows(FILE *fp, img_header_fn header, img_row_sink sink, void *ctx);
+
+#endif // INTERNAL_IMG_RAW_H
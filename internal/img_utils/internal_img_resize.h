@@ -0,0 +1,203 @@
+/**
+ * @file internal_img_resize.h
+ * Provides the internal separable resize engine.
+ *
+ * Resizing is split into a horizontal and a vertical pass. Both passes are
+ * driven by coefficient tables that are computed once per (source, destination)
+ * size pair and stored in an img_resize_plan. The img_resizer consumes source
+ * rows one at a time, keeps only the horizontally resampled rows that the
+ * vertical filter still needs, and hands every finished destination row to a
+ * row sink. Whole-image resizing, streaming decoders and fused output kernels
+ * all sit on top of this row interface.
+ */
+
+#ifndef INTERNAL_IMG_RESIZE_H
+#define INTERNAL_IMG_RESIZE_H
+
+#include <stdint.h>
+
+#include "../../include/img_utils.h" // Include the public API for type definitions
+
+/**
+ * Fixed-point precision of the filter weights. Every weight set sums to
+ * exactly 1 << IMG_RESIZE_PRECISION.
+ */
+#define IMG_RESIZE_PRECISION 14
+
+/**
+ * Coefficient table for one axis.
+ *
+ * Every output sample reads exactly `taps` consecutive input samples starting
+ * at `start[i]`. Outputs near the border are shifted inwards and padded with
+ * zero weights, so the kernels never branch on the tap count.
+ */
+typedef struct {
+    int out_size;     ///< Number of output samples
+    int taps;         ///< Taps per output sample
+    int *start;       ///< First input sample per output, absolute source coordinate
+    int16_t *weights; ///< out_size * taps weights in IMG_RESIZE_PRECISION fixed point
+} img_resize_axis;
+
+/**
+ * Precomputed resize plan for a source region and a destination size.
+ */
+typedef struct {
+    int src_width;     ///< Width of the full source image
+    int src_height;    ///< Height of the full source image
+    int roi_x;         ///< Left edge of the resampled source region
+    int roi_y;         ///< Top edge of the resampled source region
+    int roi_width;     ///< Width of the resampled source region
+    int roi_height;    ///< Height of the resampled source region
+    int dst_width;     ///< Destination width
+    int dst_height;    ///< Destination height
+    img_filter filter; ///< Filter used to build the tables
+    img_resize_axis x; ///< Horizontal coefficients
+    img_resize_axis y; ///< Vertical coefficients
+} img_resize_plan;
+
+/**
+ * Receives one finished destination row.
+ *
+ * @param ctx The opaque context registered with the resizer.
+ * @param y The destination row index.
+ * @param row The dst_width resampled pixels. Only valid during the call.
+ * @param width The number of pixels in the row.
+ */
+typedef void (*img_row_sink)(void *ctx, int y, const pixel *row, int width);
+
+/**
+ * Streaming resizer state. Source rows are pushed in order; destination rows
+ * are emitted as soon as all the source rows they depend on have arrived.
+ */
+typedef struct {
+    const img_resize_plan *plan; ///< Plan driving the resize (not owned)
+    pixel *ring;                 ///< plan->y.taps horizontally resampled rows; heads the scratch block
+    pixel *out_row;              ///< Scratch row for the vertical pass
+    const pixel **taps;          ///< Scratch row pointers for the vertical pass
+    int next_src;                ///< Next source row expected by the resizer
+    int next_dst;                ///< Next destination row to emit
+    int end_dst;                 ///< One past the last destination row to emit
+    img_row_sink sink;           ///< Consumer of destination rows
+    void *sink_ctx;              ///< Context passed to the sink
+} img_resizer;
+
+/**
+ * Builds a resize plan for a source region.
+ *
+ * @param plan The plan to initialise.
+ * @param src_width Width of the full source image.
+ * @param src_height Height of the full source image.
+ * @param roi_x Left edge of the source region.
+ * @param roi_y Top edge of the source region.
+ * @param roi_width Width of the source region.
+ * @param roi_height Height of the source region.
+ * @param dst_width Destination width.
+ * @param dst_height Destination height.
+ * @param filter The resampling filter.
+ * @return RET_SUCCESS on success, or RET_FAIL on invalid sizes or allocation failure.
+ */
+int img_resize_plan_init(img_resize_plan *plan, int src_width, int src_height,
+                         int roi_x, int roi_y, int roi_width, int roi_height,
+                         int dst_width, int dst_height, img_filter filter);
+
+/**
+ * Builds a resize plan for a fractional source region.
+ *
+ * The region [x0, x1) x [y0, y1) is resampled onto the destination with the
+ * same filters as an integer region; the plan's ROI is the pixel-aligned box
+ * around it, and taps are clamped to that box. Used where crops and resizes
+ * are composed, so a crop of a resized image needs no intermediate image.
+ *
+ * @param plan The plan to fill in.
+ * @param src_width The width of the full source image.
+ * @param src_height The height of the full source image.
+ * @param x0 The left edge of the region, at least 0.
+ * @param y0 The top edge of the region, at least 0.
+ * @param x1 The right edge of the region, greater than x0 and at most src_width.
+ * @param y1 The bottom edge of the region, greater than y0 and at most src_height.
+ * @param dst_width The destination width.
+ * @param dst_height The destination height.
+ * @param filter The resampling filter.
+ * @return RET_SUCCESS on success, or RET_FAIL on invalid sizes or allocation failure.
+ */
+int img_resize_plan_init_region(img_resize_plan *plan, int src_width, int src_height,
+                                double x0, double y0, double x1, double y1,
+                                int dst_width, int dst_height, img_filter filter);
+
+/**
+ * Releases the coefficient tables owned by a plan.
+ *
+ * @param plan The plan to release. The struct itself is not freed.
+ */
+void img_resize_plan_release(img_resize_plan *plan);
+
+/**
+ * Returns a cached plan for the given geometry, building it if needed.
+ *
+ * The cache is per thread and holds the most recently used plan, which covers
+ * the common case of a pipeline resizing every frame with the same sizes.
+ *
+ * @return The cached plan, or NULL on failure. Valid until the next call on
+ *         the same thread.
+ */
+const img_resize_plan* img_resize_plan_cached(int src_width, int src_height,
+                                              int roi_x, int roi_y, int roi_width, int roi_height,
+                                              int dst_width, int dst_height, img_filter filter);
+
+/**
+ * Returns how many leading source rows a plan reads.
+ *
+ * Rows at or past this index never contribute to the output, so a streaming
+ * producer can stop there.
+ *
+ * @param plan The plan.
+ * @return One past the last source row read by the plan.
+ */
+int img_resize_plan_src_rows(const img_resize_plan *plan);
+
+/**
+ * Initialises a streaming resizer.
+ *
+ * @param rs The resizer to initialise.
+ * @param plan The plan to execute. Must outlive the resizer.
+ * @param sink The consumer of destination rows.
+ * @param sink_ctx Opaque context passed to the sink.
+ * @return RET_SUCCESS on success, or RET_FAIL on allocation failure.
+ */
+int img_resizer_init(img_resizer *rs, const img_resize_plan *plan, img_row_sink sink, void *sink_ctx);
+
+/**
+ * Pushes the next full-width source row into the resizer.
+ *
+ * Rows must be pushed in order starting at source row 0. Rows outside the
+ * plan's region, and rows no destination row depends on, are skipped cheaply.
+ *
+ * @param rs The resizer.
+ * @param row The src_width source pixels of row rs->next_src.
+ */
+void img_resizer_push_row(img_resizer *rs, const pixel *row);
+
+/**
+ * Releases the scratch memory owned by a resizer.
+ *
+ * @param rs The resizer to release. The struct itself is not freed.
+ */
+void img_resizer_release(img_resizer *rs);
+
+/**
+ * Runs a plan over an in-memory source image.
+ *
+ * Only the source rows the plan depends on are read. Large destinations are
+ * split into row bands run in parallel (see parallel.h), so the sink may be
+ * called concurrently and out of row order for distinct rows. Scratch rows
+ * come from a per-thread buffer, so steady-state runs do not allocate.
+ *
+ * @param plan The plan to execute.
+ * @param src The source image, matching the plan's source size.
+ * @param sink The consumer of destination rows.
+ * @param sink_ctx Opaque context passed to the sink.
+ * @return RET_SUCCESS on success, or RET_FAIL on allocation failure.
+ */
+int img_resize_run(const img_resize_plan *plan, const Image *src, img_row_sink sink, void *sink_ctx);
+
+#endif // INTERNAL_IMG_RESIZE_H
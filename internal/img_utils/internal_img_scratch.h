@@ -0,0 +1,36 @@
+/**
+ * @file internal_img_scratch.h
+ * Provides grow-only scratch blocks private to a thread.
+ *
+ * Row kernels that need a temporary buffer keep one img_scratch per thread in
+ * a _Thread_local variable and ask it for the size of the current job. The
+ * block only ever grows, so steady-state calls do not touch the heap, and
+ * every block a thread used is freed when that thread exits.
+ */
+
+#ifndef INTERNAL_IMG_SCRATCH_H
+#define INTERNAL_IMG_SCRATCH_H
+
+#include <stddef.h>
+
+/**
+ * A scratch block. Declare it _Thread_local and zero-initialized.
+ */
+typedef struct img_scratch {
+    void *data;                ///< The block, or NULL before first use
+    size_t size;               ///< Bytes available at data
+    struct img_scratch *next;  ///< Next block registered by the same thread
+    int registered;            ///< Non-zero once freed at thread exit
+} img_scratch;
+
+/**
+ * Returns the block grown to at least `size` bytes. Earlier contents are not
+ * preserved when it grows.
+ *
+ * @param s The calling thread's scratch block.
+ * @param size The bytes needed.
+ * @return The block, or NULL on allocation failure.
+ */
+void* img_scratch_reserve(img_scratch *s, size_t size);
+
+#endif // INTERNAL_IMG_SCRATCH_H
@@ -0,0 +1,101 @@
+/**
+ * @file internal_img_storage.h
+ * Provides reference-counted pixel storage shared by images and their views.
+ *
+ * An img_storage owns one pixel buffer. Every Image handle that points into
+ * the buffer (the image that allocated it and any views created from it)
+ * holds one reference; the buffer is released together with the last handle.
+ * Storage normally comes from the image buffer pool, but any buffer can be
+ * wrapped with a custom destructor, e.g. a memory-mapped file.
+ */
+
+#ifndef INTERNAL_IMG_STORAGE_H
+#define INTERNAL_IMG_STORAGE_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "../../include/img_utils.h" // Include the public API for type definitions
+
+/**
+ * Reference-counted backing buffer.
+ */
+struct img_storage {
+    atomic_int refs;                          ///< Number of Image handles using the buffer
+    void *data;                               ///< Start of the buffer
+    size_t size;                              ///< Size of the buffer in bytes
+    void (*destroy)(struct img_storage *s);   ///< Releases the buffer and the storage itself
+    void *ctx;                                ///< Opaque data for the destructor
+};
+
+/**
+ * Allocates pool-backed storage with one reference.
+ *
+ * The header and the buffer share a single pool block; the buffer is
+ * 64-byte aligned.
+ *
+ * @param size The number of bytes to allocate.
+ * @return The storage, or NULL if the allocation fails.
+ */
+img_storage* img_storage_new(size_t size);
+
+/**
+ * Wraps an existing buffer in storage with one reference.
+ *
+ * @param data The buffer.
+ * @param size The size of the buffer in bytes.
+ * @param destroy Called when the last reference is dropped. It must release
+ *                the buffer and free the storage with img_storage_free_header().
+ * @param ctx Opaque data made available to the destructor.
+ * @return The storage, or NULL if the allocation fails.
+ */
+img_storage* img_storage_wrap(void *data, size_t size, void (*destroy)(img_storage *s), void *ctx);
+
+/**
+ * Frees the header of storage created with img_storage_wrap(). Only to be
+ * called from a custom destructor.
+ *
+ * @param s The storage.
+ */
+void img_storage_free_header(img_storage *s);
+
+/**
+ * Maps a whole file into storage with one reference.
+ *
+ * The mapping is private and writable: pages are read from the file on first
+ * access and copied only when written, so images pointing into it may be
+ * modified in place without touching the file. The descriptor may be closed
+ * once the call returns.
+ *
+ * @param fd A descriptor of a regular file, open for reading.
+ * @return The storage, or NULL if the file is empty or cannot be mapped.
+ */
+img_storage* img_storage_map(int fd);
+
+/**
+ * Adds a reference to the storage.
+ *
+ * @param s The storage. NULL is ignored.
+ */
+void img_storage_retain(img_storage *s);
+
+/**
+ * Drops a reference and destroys the storage when it was the last one.
+ *
+ * @param s The storage. NULL is ignored.
+ */
+void img_storage_release(img_storage *s);
+
+/**
+ * Creates an Image handle for a region of storage, taking a new reference.
+ *
+ * @param storage The storage, or NULL for borrowed pixels.
+ * @param pixels The first pixel of the image.
+ * @param width The width in pixels.
+ * @param height The height in pixels.
+ * @param stride The row pitch in pixels.
+ * @return The handle, or NULL if the allocation fails.
+ */
+Image* img_handle_new(img_storage *storage, pixel *pixels, int width, int height, int stride);
+
+#endif // INTERNAL_IMG_STORAGE_H
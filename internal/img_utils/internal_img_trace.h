@@ -0,0 +1,106 @@
+/**
+ * @file internal_img_trace.h
+ * Provides the scoped timers and counters behind img_trace_enable().
+ *
+ * IMG_TRACE_SCOPE(name) times the rest of the enclosing block and records it
+ * as one event in the calling thread's buffer. IMG_TRACE_COUNT() adds to one
+ * of the calling thread's counters; every event carries the counter deltas
+ * accumulated while it was open, including those of nested scopes. While
+ * tracing is off both macros cost one relaxed atomic load and a branch.
+ */
+
+#ifndef INTERNAL_IMG_TRACE_H
+#define INTERNAL_IMG_TRACE_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "../../include/img_utils.h" // Include the public API for type definitions
+
+/**
+ * Environment variable that enables tracing from startup. Its value is the
+ * path the Chrome trace is written to at exit; the summary goes to stderr.
+ */
+#define IMG_TRACE_ENV "NEURO_LENS_TRACE"
+
+/**
+ * Per-thread counters.
+ */
+typedef enum {
+    IMG_TRACE_BYTES_READ = 0, ///< Encoded bytes consumed from files
+    IMG_TRACE_BYTES_WRITTEN,  ///< Encoded bytes written to files
+    IMG_TRACE_PIXELS,         ///< Output pixels produced by decoders and transforms
+    IMG_TRACE_ALLOCS,         ///< Blocks taken from the image buffer allocator, including libpng's
+    IMG_TRACE_COUNTERS
+} img_trace_counter;
+
+/**
+ * An open scope. `start` is zero when tracing was off at the start of the
+ * scope, in which case nothing is recorded at its end.
+ */
+typedef struct {
+    const char *name;
+    uint64_t start;
+    uint64_t counters[IMG_TRACE_COUNTERS];
+} img_trace_scope;
+
+/**
+ * Non-zero while tracing is enabled.
+ */
+extern atomic_int img_trace_active;
+
+/**
+ * Snapshots the clock and the calling thread's counters into a scope.
+ *
+ * @param scope The scope, with its name set.
+ */
+void img_trace_open(img_trace_scope *scope);
+
+/**
+ * Records a scope as an event in the calling thread's buffer.
+ *
+ * @param scope The scope filled in by img_trace_open().
+ */
+void img_trace_close(img_trace_scope *scope);
+
+/**
+ * Adds to one of the calling thread's counters.
+ *
+ * @param counter The counter.
+ * @param n The amount to add.
+ */
+void img_trace_add(img_trace_counter counter, uint64_t n);
+
+static inline int img_trace_on(void)
+{
+    return __builtin_expect(atomic_load_explicit(&img_trace_active, memory_order_relaxed), 0);
+}
+
+static inline img_trace_scope img_trace_begin(const char *name)
+{
+    img_trace_scope scope;
+    scope.name = name;
+    scope.start = 0;
+    if (img_trace_on()) img_trace_open(&scope);
+    return scope;
+}
+
+static inline void img_trace_end(img_trace_scope *scope)
+{
+    if (scope->start) img_trace_close(scope);
+}
+
+/**
+ * Times the rest of the enclosing block. `name` must be a string with static
+ * storage duration; at most one scope may be opened per block.
+ */
+#define IMG_TRACE_SCOPE(name) \
+    img_trace_scope img_trace_scope_ __attribute__((cleanup(img_trace_end))) = img_trace_begin(name)
+
+/**
+ * Adds `n` to a counter. `n` is only evaluated while tracing is on.
+ */
+#define IMG_TRACE_COUNT(counter, n) \
+    do { if (img_trace_on()) img_trace_add((counter), (uint64_t)(n)); } while (0)
+
+#endif // INTERNAL_IMG_TRACE_H
@@ -0,0 +1,68 @@
+/**
+ * @file internal_img_uring.h
+ * Provides a minimal io_uring submission and completion ring.
+ *
+ * The ring is driven through the raw system calls, so no liburing is needed
+ * at build or run time. Requests are prepared in place in the shared
+ * submission queue and handed to the kernel in batches; completions are
+ * popped one by one. A ring belongs to a single thread.
+ */
+
+#ifndef INTERNAL_IMG_URING_H
+#define INTERNAL_IMG_URING_H
+
+#include <linux/io_uring.h>
+#include <stdint.h>
+
+#include "../../include/img_utils.h" // Include the public API for the return codes
+
+/**
+ * Opaque ring.
+ */
+typedef struct img_uring img_uring;
+
+/**
+ * Sets up a ring.
+ *
+ * @param entries The number of requests that may be queued at once.
+ * @return The ring, or NULL if io_uring is unavailable (old kernel, blocked
+ *         by a seccomp filter) or does not support openat, statx and read.
+ */
+img_uring* img_uring_new(unsigned entries);
+
+/**
+ * Tears down a ring. Requests still in flight must have completed.
+ *
+ * @param ring The ring. NULL is ignored.
+ */
+void img_uring_free(img_uring *ring);
+
+/**
+ * Reserves the next submission queue entry.
+ *
+ * @param ring The ring.
+ * @return A zeroed entry to fill in, or NULL if the queue is full. It is
+ *         submitted by the next img_uring_submit().
+ */
+struct io_uring_sqe* img_uring_get_sqe(img_uring *ring);
+
+/**
+ * Submits the reserved entries and optionally waits for completions.
+ *
+ * @param ring The ring.
+ * @param wait The number of completions to wait for, or 0 to return at once.
+ * @return RET_SUCCESS on success, or RET_FAIL if the kernel rejects the call.
+ */
+int img_uring_submit(img_uring *ring, unsigned wait);
+
+/**
+ * Pops one completion, if any.
+ *
+ * @param ring The ring.
+ * @param user_data Receives the user_data of the completed request.
+ * @param res Receives its result: a byte count or descriptor, or -errno.
+ * @return 1 if a completion was popped, 0 if none is pending.
+ */
+int img_uring_peek(img_uring *ring, uint64_t *user_data, int32_t *res);
+
+#endif // INTERNAL_IMG_URING_H
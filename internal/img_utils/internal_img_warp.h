@@ -0,0 +1,63 @@
+/**
+ * @file internal_img_warp.h
+ * Provides the inverse-mapping affine sampler shared by img_rotate_into(), the
+ * transform graph and the augmentation engine.
+ *
+ * Every destination pixel center is mapped back into the source through a
+ * 2x3 matrix and sampled there, so the output has no holes and only source
+ * pixels that some destination pixel lands on are read.
+ */
+
+#ifndef INTERNAL_IMG_WARP_H
+#define INTERNAL_IMG_WARP_H
+
+#include "../../include/img_utils.h" // Include the public API for type definitions
+
+/**
+ * Map from continuous destination coordinates (X, Y) to source coordinates,
+ * relative to a destination pivot:
+ *   sx = a * (X - px) + b * (Y - py) + c
+ *   sy = d * (X - px) + e * (Y - py) + f
+ * Pixel (x, y) covers [x, x + 1) x [y, y + 1), so its center is (x + 0.5, y + 0.5).
+ */
+typedef struct {
+    double a, b, c;
+    double d, e, f;
+    double px, py;
+} img_affine;
+
+/**
+ * Fills a destination image by sampling the source through an affine map.
+ *
+ * Each row is walked in 16.16 fixed point; the span whose samples are all
+ * inside the source runs without border checks. Large destinations are
+ * filled in parallel row bands.
+ *
+ * @param src The source image. It must not alias dst.
+ * @param dst The destination image.
+ * @param m The destination to source map.
+ * @param bilinear Non-zero for bilinear sampling, zero for nearest neighbor.
+ * @param border How to sample positions outside the source.
+ * @param fill The color used by IMG_BORDER_CONSTANT.
+ */
+void img_warp_affine(const Image *src, Image *dst, const img_affine *m, int bilinear,
+                     img_border border, pixel fill);
+
+/**
+ * Samples one destination row through an affine map, as img_warp_affine()
+ * does for each of its rows. Lets callers post-process every row while it is
+ * still in cache instead of making a second pass over the image.
+ *
+ * @param src The source image.
+ * @param out The row to fill.
+ * @param width The number of pixels in the row.
+ * @param y The destination row index the map is evaluated at.
+ * @param m The destination to source map.
+ * @param bilinear Non-zero for bilinear sampling, zero for nearest neighbor.
+ * @param border How to sample positions outside the source.
+ * @param fill The color used by IMG_BORDER_CONSTANT.
+ */
+void img_warp_row(const Image *src, pixel *out, int width, int y, const img_affine *m, int bilinear,
+                  img_border border, pixel fill);
+
+#endif // INTERNAL_IMG_WARP_H
@@ -1,10 +1,24 @@
+/**
+ * @file math_utils.h
+ * Provides internal math helpers shared by the geometric transforms.
+ *
+ * Two trigonometry implementations are offered:
+ *  - sincos_approx() and the sin_approx()/cos_approx() wrappers take degrees and
+ *    combine a 256-entry quarter-wave lookup table with a short polynomial
+ *    correction. Maximum absolute error is below 2e-15 for every finite input,
+ *    and multiples of 90 degrees are exact.
+ *  - sincosf_batch(), sinf_batch() and cosf_batch() take radians in float
+ *    arrays and use branch-free minimax polynomials on [-PI/4, PI/4] after a
+ *    three-constant Cody-Waite reduction. Maximum absolute error is below
+ *    3e-7 for |x| <= 8192. The loops vectorize, so prefer them whenever many
+ *    angles are evaluated at once.
+ */
+
+#ifndef MATH_UTILS_H
+#define MATH_UTILS_H
 
 /**
  * Converts an angle from degrees to radians.
- * 
- * Since trigonometric functions in the Taylor series expansion are calculated in radians,
- * this function provides a utility for converting angles from degrees (a common input format) 
- * to radians (required for mathematical computations).
  *
  * @param degrees The angle in degrees to be converted.
  * @return The angle in radians.
@@ -12,31 +26,70 @@
 double to_radians(double degrees);
 
 /**
- * Approximates the sine of an angle, given in radians, using the Taylor series expansion.
- * 
- * This function provides a simplified approximation of the sine function for small angles or
- * applications where high precision is not critical. It uses the first four terms of the 
- * Taylor series expansion for sine.
- * 
- * @param x The radians for which to approximate the sine. For improved accuracy, 
- *          the angle should be normalized to the range [-PI, PI].
- * @return An approximation of the sine of the input angle.
- * 
- * Note: The accuracy of this approximation decreases as the angle moves away from 0.
+ * Computes the sine and cosine of an angle given in degrees.
+ *
+ * The angle is reduced exactly with fmod, split into a table index (steps of
+ * 360/256 degrees) and a remainder |r| <= PI/256 radians, and the table values
+ * are rotated by the remainder using truncated series whose omitted terms are
+ * below 1e-17. Maximum absolute error is below 2e-15.
+ *
+ * @param degrees The angle in degrees. Any finite value is accepted.
+ * @param s Receives the sine.
+ * @param c Receives the cosine.
+ */
+void sincos_approx(double degrees, double *s, double *c);
+
+/**
+ * Approximates the sine of an angle given in degrees.
+ *
+ * Wrapper around sincos_approx(); prefer that function when both values are
+ * needed.
+ *
+ * @param x The angle in degrees.
+ * @return The sine of the angle, with absolute error below 2e-15.
  */
 double sin_approx(double x);
 
 /**
- * Approximates the cosine of an angle, given in radians, using the Taylor series expansion.
- * 
- * Similar to sin_approx, this function provides an approximation of the cosine function using 
- * the first four terms of the Taylor series expansion for cosine. It is suitable for small angles
- * or when precise accuracy is not essential.
+ * Approximates the cosine of an angle given in degrees.
+ *
+ * Wrapper around sincos_approx(); prefer that function when both values are
+ * needed.
  *
- * @param x The angle in radians for which to approximate the cosine. For improved accuracy, 
- *          the angle should be normalized to the range [-PI, PI].
- * @return An approximation of the cosine of the input angle.
- * 
- * Note: As with sin_approx, the precision of this approximation diminishes for angles far from 0.
+ * @param x The angle in degrees.
+ * @return The cosine of the angle, with absolute error below 2e-15.
  */
 double cos_approx(double x);
+
+/**
+ * Computes the sine and cosine of n angles given in radians.
+ *
+ * Absolute error is below 3e-7 for |x| <= 8192; accuracy degrades gradually
+ * beyond that as the range reduction loses bits.
+ *
+ * @param x The input angles in radians.
+ * @param s Receives the n sines. Must not overlap x or c.
+ * @param c Receives the n cosines. Must not overlap x or s.
+ * @param n The number of angles.
+ */
+void sincosf_batch(const float *restrict x, float *restrict s, float *restrict c, int n);
+
+/**
+ * Computes the sine of n angles given in radians. Same accuracy as sincosf_batch().
+ *
+ * @param x The input angles in radians.
+ * @param out Receives the n sines. Must not overlap x.
+ * @param n The number of angles.
+ */
+void sinf_batch(const float *restrict x, float *restrict out, int n);
+
+/**
+ * Computes the cosine of n angles given in radians. Same accuracy as sincosf_batch().
+ *
+ * @param x The input angles in radians.
+ * @param out Receives the n cosines. Must not overlap x.
+ * @param n The number of angles.
+ */
+void cosf_batch(const float *restrict x, float *restrict out, int n);
+
+#endif // MATH_UTILS_H
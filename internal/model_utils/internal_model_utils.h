@@ -0,0 +1,180 @@
+/**
+ * @file internal_model_utils.h
+ * Provides the internal model representation and the quantized kernels.
+ *
+ * A loaded model is a flat list of tensors and operators resolved from the
+ * TFLite flatbuffer. The file is memory-mapped read-only and constant
+ * tensors point straight into the mapping, so processes loading the same
+ * model share its pages through the page cache. Activations live in one
+ * arena whose layout is planned at load time from the tensors' lifetimes,
+ * so an inference performs no allocation.
+ */
+
+#ifndef INTERNAL_MODEL_UTILS_H
+#define INTERNAL_MODEL_UTILS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../include/model_utils.h" // Include the public API for type definitions
+
+/**
+ * TFLite tensor element types.
+ */
+enum {
+    MODEL_TYPE_FLOAT32 = 0,
+    MODEL_TYPE_INT32   = 2,
+    MODEL_TYPE_UINT8   = 3,
+    MODEL_TYPE_INT64   = 4
+};
+
+/**
+ * TFLite builtin codes of the supported operators.
+ */
+enum {
+    MODEL_OP_AVERAGE_POOL_2D   = 1,
+    MODEL_OP_CONV_2D           = 3,
+    MODEL_OP_DEPTHWISE_CONV_2D = 4,
+    MODEL_OP_RESHAPE           = 22,
+    MODEL_OP_SOFTMAX           = 25
+};
+
+/**
+ * TFLite fused activation functions.
+ */
+enum {
+    MODEL_ACT_NONE  = 0,
+    MODEL_ACT_RELU  = 1,
+    MODEL_ACT_RELU1 = 2,
+    MODEL_ACT_RELU6 = 3
+};
+
+#define MODEL_MAX_DIMS 4
+#define MODEL_MAX_INPUTS 3
+
+/**
+ * Alignment of the activation arena and of every activation in it.
+ */
+#define MODEL_ARENA_ALIGNMENT 64
+
+/**
+ * The GEMM kernels consume the reduction dimension in steps of this many
+ * elements; shorter rows are zero padded.
+ */
+#define MODEL_GEMM_K_STEP 16
+
+/**
+ * A tensor of the graph.
+ */
+typedef struct {
+    int type;                   ///< Element type, one of MODEL_TYPE_*
+    int dims;                   ///< Number of dimensions
+    int shape[MODEL_MAX_DIMS];  ///< Extent of each dimension, outermost first
+    size_t bytes;               ///< Size of the data in bytes
+    float scale;                ///< Quantization scale
+    int32_t zero_point;         ///< Quantization zero point
+    const uint8_t *data;        ///< Constant data in the model file, or NULL for activations
+    size_t offset;              ///< Arena offset of an activation
+    int first_op;               ///< Operator producing the tensor, -1 for the graph input
+    int last_op;                ///< Last operator reading the tensor
+} model_tensor;
+
+/**
+ * An operator with its options and the parameters derived at load time.
+ */
+typedef struct {
+    int code;                      ///< Builtin operator code, one of MODEL_OP_*
+    int inputs[MODEL_MAX_INPUTS];  ///< Input tensor indices, -1 when absent
+    int input_count;
+    int output;                    ///< Output tensor index
+    int padding_same;              ///< 1 for SAME padding, 0 for VALID
+    int stride_w, stride_h;
+    int dilation_w, dilation_h;
+    int filter_w, filter_h;        ///< Kernel or pooling window size
+    int depth_multiplier;
+    int activation;                ///< Fused activation, one of MODEL_ACT_*
+    float beta;                    ///< Softmax beta
+    int pad_top, pad_left;         ///< Resolved padding
+    int32_t act_min, act_max;      ///< Output clamp range in the quantized domain
+    int32_t multiplier;            ///< Q31 requantization multiplier
+    int shift;                     ///< Requantization exponent
+    const int32_t *bias;           ///< Bias, one entry per output channel
+    int32_t *bias_copy;            ///< Owned aligned copy of the bias when the mapped one is misaligned
+    int k;                         ///< Reduction length of a convolution (kh * kw * in_channels)
+    int k_padded;                  ///< k rounded up to MODEL_GEMM_K_STEP
+    int block;                     ///< Output pixels per GEMM block, a multiple of 4
+    const uint8_t *weights;        ///< Convolution weights as out_channels rows of k_padded bytes
+    uint8_t *packed;               ///< Owned zero-padded weights when k != k_padded
+} model_op;
+
+/**
+ * Loaded model.
+ */
+struct Model {
+    const uint8_t *file;       ///< The flatbuffer, mapped read-only
+    size_t file_size;
+    model_tensor *tensors;
+    int tensor_count;
+    model_op *ops;
+    int op_count;
+    int input;                 ///< Graph input tensor
+    int output;                ///< Graph output tensor
+    uint8_t *arena;            ///< Activations
+    size_t arena_size;
+    int16_t *gemm_a;           ///< Zero-point corrected input rows of one GEMM block
+    int32_t *gemm_sums;        ///< Sum of each gemm_a row
+    int32_t *gemm_acc;         ///< Accumulators of one GEMM block
+};
+
+/**
+ * Resolves the flatbuffer in model->file into tensors and operators.
+ *
+ * Every offset is bounds-checked against the file, so a truncated or
+ * corrupted model is rejected instead of read out of bounds.
+ *
+ * @param model The model, with file and file_size set and everything else zeroed.
+ * @return RET_SUCCESS on success, or RET_FAIL if the file is malformed or
+ *         uses unsupported operators, types or quantization.
+ */
+int model_parse(Model *model);
+
+/**
+ * Derives the per-operator parameters (padding, requantization, weight
+ * layout) and allocates the activation arena and the GEMM scratch.
+ *
+ * @param model A parsed model.
+ * @return RET_SUCCESS on success, or RET_FAIL on inconsistent shapes or
+ *         allocation failure.
+ */
+int model_prepare(Model *model);
+
+/**
+ * Converts a real multiplier to a Q31 fixed-point multiplier and a power of
+ * two exponent, as TFLite's QuantizeMultiplier() does.
+ *
+ * @param real The multiplier, non-negative.
+ * @param multiplier Receives the Q31 mantissa.
+ * @param shift Receives the exponent; negative values shift right.
+ */
+void model_quantize_multiplier(double real, int32_t *multiplier, int *shift);
+
+/**
+ * Scales an accumulator by a quantized multiplier, rounding exactly like
+ * TFLite's MultiplyByQuantizedMultiplier().
+ *
+ * @param x The accumulator.
+ * @param multiplier The Q31 multiplier.
+ * @param shift The exponent.
+ * @return x * multiplier * 2^(shift - 31), rounded.
+ */
+int32_t model_requantize(int32_t x, int32_t multiplier, int shift);
+
+/**
+ * Runs one operator on the model's arena.
+ *
+ * @param model The model.
+ * @param op The operator.
+ */
+void model_run_op(Model *model, const model_op *op);
+
+#endif // INTERNAL_MODEL_UTILS_H
@@ -0,0 +1,63 @@
+/**
+ * @file parallel.h
+ * Provides data parallelism inside a single image operation.
+ *
+ * Kernels describe their work as a number of independent rows (or tile rows)
+ * and a callback that processes a range of them. img_parallel_for() cuts the
+ * range into bands and runs them on a process-wide thread pool that is
+ * started on first use, with the calling thread taking bands as well. Work
+ * too small to amortize the hand-off, and calls made from inside any pool
+ * worker (e.g. a batch pipeline stage, which is already parallel across
+ * images), run serially on the calling thread.
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "../../include/img_utils.h" // Include the public API for type definitions
+
+/**
+ * Environment variable setting the default thread count, read once on first
+ * use. img_set_threads() overrides it.
+ */
+#define IMG_THREADS_ENV "NEURO_LENS_THREADS"
+
+/**
+ * Pixels below which a band is not worth handing to another thread. Images
+ * smaller than two such bands always run single-threaded.
+ */
+#define IMG_PARALLEL_MIN_PIXELS (1 << 16)
+
+/**
+ * Processes rows [begin, end).
+ *
+ * @param ctx The context given to img_parallel_for().
+ * @param begin The first row.
+ * @param end One past the last row.
+ */
+typedef void (*img_range_fn)(void *ctx, int begin, int end);
+
+/**
+ * Runs fn over [0, count) in bands of at least `grain` rows and returns once
+ * every band has finished. Bands may run concurrently and in any order.
+ *
+ * @param count The number of rows.
+ * @param grain The smallest band worth running on another thread, at least 1.
+ * @param fn The band callback.
+ * @param ctx The context passed to fn.
+ */
+void img_parallel_for(int count, int grain, img_range_fn fn, void *ctx);
+
+/**
+ * Returns the band size for rows of the given width, so that each band
+ * covers at least IMG_PARALLEL_MIN_PIXELS pixels.
+ *
+ * @param width The pixels per row.
+ * @return The grain for img_parallel_for(), at least 1.
+ */
+static inline int img_parallel_grain(int width)
+{
+    return width >= IMG_PARALLEL_MIN_PIXELS ? 1 : IMG_PARALLEL_MIN_PIXELS / (width > 0 ? width : 1);
+}
+
+#endif // PARALLEL_H
@@ -0,0 +1,71 @@
+/**
+ * @file pipeline.h
+ * Provides a staged pipeline scheduler on top of the thread pool.
+ *
+ * Items flow through a fixed sequence of stages. Every stage invocation is a
+ * pool task, so different items can be in different stages at the same time
+ * and I/O-bound and compute-bound stages overlap across cores. The queue in
+ * front of each stage after the first is bounded: a stage only starts an item
+ * when the queue it feeds has a free slot, counting the items it is already
+ * working on. Downstream stages are served first, so finished work drains
+ * before new work is admitted and the number of items in flight stays bounded
+ * without ever blocking a worker.
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "../../include/img_utils.h" // Include the public API for the return codes
+#include "thread_pool.h"
+
+/**
+ * Stage entry point.
+ *
+ * @param ctx The context passed to img_pipeline_run().
+ * @param item The item to process. Stages pass state on through the item.
+ * @return RET_SUCCESS to pass the item on, or RET_FAIL to drop it. A stage
+ *         dropping an item releases whatever the item holds.
+ */
+typedef int (*img_stage_fn)(void *ctx, void *item);
+
+/**
+ * A pipeline stage.
+ */
+typedef struct {
+    const char *name;  ///< Name used in reports and trace events; must outlive any trace export
+    img_stage_fn fn;   ///< Entry point
+} img_stage;
+
+/**
+ * Counters collected for one stage during a run.
+ */
+typedef struct {
+    unsigned long long done;   ///< Items the stage passed on
+    unsigned long long failed; ///< Items the stage dropped
+    double busy_seconds;       ///< Time spent inside the stage, summed over threads
+    double queue_mean;         ///< Time-averaged number of items waiting for the stage
+    int queue_max;             ///< Largest number of items waiting for the stage
+    int queue_capacity;        ///< Bound of the stage's queue; 0 for the input of the first stage
+} img_stage_stats;
+
+/**
+ * Runs every item through the stages and waits for the run to finish.
+ *
+ * @param pool The pool executing the stages.
+ * @param stages The stages, in order.
+ * @param stage_count The number of stages.
+ * @param items The items, fed to the first stage in order.
+ * @param item_count The number of items.
+ * @param queue_capacity The bound of each inter-stage queue, at least 1.
+ * @param ctx Opaque context passed to every stage.
+ * @param stats Receives stage_count entries of counters. May be NULL.
+ * @param wall_seconds Receives the duration of the run. May be NULL.
+ * @return RET_SUCCESS when the run completed (individual items may still
+ *         have been dropped), or RET_FAIL on invalid arguments or allocation
+ *         failure.
+ */
+int img_pipeline_run(img_thread_pool *pool, const img_stage *stages, int stage_count,
+                     void **items, int item_count, int queue_capacity, void *ctx,
+                     img_stage_stats *stats, double *wall_seconds);
+
+#endif // PIPELINE_H
@@ -0,0 +1,78 @@
+/**
+ * @file thread_pool.h
+ * Provides a work-stealing thread pool.
+ *
+ * Every worker owns a deque of tasks. A task submitted from a worker goes to
+ * the back of that worker's deque and is picked up last-in first-out, which
+ * keeps follow-up work on the core that produced its input. Tasks submitted
+ * from other threads go to a shared injection queue. Idle workers first drain
+ * the injection queue and then steal from the front of the other workers'
+ * deques before going to sleep.
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include "../../include/img_utils.h" // Include the public API for the return codes
+
+/**
+ * Opaque thread pool.
+ */
+typedef struct img_thread_pool img_thread_pool;
+
+/**
+ * Task entry point.
+ *
+ * @param arg The argument given at submission.
+ */
+typedef void (*img_task_fn)(void *arg);
+
+/**
+ * Starts a thread pool.
+ *
+ * @param threads The number of worker threads, or 0 for one per online CPU.
+ * @return The pool, or NULL if the threads cannot be started.
+ */
+img_thread_pool* img_thread_pool_new(int threads);
+
+/**
+ * Returns the number of worker threads of a pool.
+ *
+ * @param pool The pool.
+ * @return The number of workers.
+ */
+int img_thread_pool_size(const img_thread_pool *pool);
+
+/**
+ * Queues a task. Safe to call from any thread, including from inside tasks.
+ *
+ * @param pool The pool.
+ * @param fn The task entry point.
+ * @param arg The argument passed to fn.
+ * @return RET_SUCCESS on success, or RET_FAIL on allocation failure.
+ */
+int img_thread_pool_submit(img_thread_pool *pool, img_task_fn fn, void *arg);
+
+/**
+ * Blocks until every submitted task, including tasks submitted by tasks,
+ * has finished. Must not be called from a worker.
+ *
+ * @param pool The pool.
+ */
+void img_thread_pool_wait(img_thread_pool *pool);
+
+/**
+ * Tells whether the calling thread is a worker of any pool.
+ *
+ * @return Non-zero inside a pool task, zero otherwise.
+ */
+int img_thread_pool_in_worker(void);
+
+/**
+ * Waits for the queued tasks, stops the workers and frees the pool.
+ *
+ * @param pool The pool. NULL is ignored.
+ */
+void img_thread_pool_free(img_thread_pool *pool);
+
+#endif // THREAD_POOL_H
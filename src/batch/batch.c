@@ -0,0 +1,506 @@
+/**
+ * Batch preprocessing.
+ *
+ * Each input file becomes a job that travels through three stages:
+ * decode, transform and encode. When a resize is requested it is fused into
+ * decode through the streaming loader, so full-size images never sit in the
+ * pipeline queues. With a cache, decode looks the processed image up first
+ * and fills misses with the whole decode and transform chain, so warm runs
+ * only map and encode.
+ */
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "../../include/img_utils.h"
+#include "../../internal/batch/batch.h"
+#include "../../internal/img_utils/internal_img_cache.h"
+#include "../../internal/thread/pipeline.h"
+#include "../../internal/thread/thread_pool.h"
+
+
+typedef struct {
+    char *src;
+    char *dst;
+    Image *img;
+    int processed; // The image came from the cache with the transforms applied
+} batch_job;
+
+// State shared by the stages of one run
+typedef struct {
+    const img_batch_options *opts;
+    img_cache *cache;     // NULL without a cache
+    uint64_t fingerprint; // Identifies the decode and transform settings in the cache
+} batch_ctx;
+
+typedef struct {
+    char **paths;
+    int count;
+    int capacity;
+} path_list;
+
+img_batch_options img_batch_defaults(void)
+{
+    img_batch_options opts = {
+        .input = NULL,
+        .output_dir = NULL,
+        .threads = 0,
+        .queue_capacity = 0,
+        .width = 0,
+        .height = 0,
+        .filter = IMG_FILTER_AREA,
+        .rotate = 0.0f,
+        .flip = 0,
+        .write = img_write_defaults(),
+        .cache_dir = NULL,
+    };
+    return opts;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Stages                                                                    */
+/* ------------------------------------------------------------------------- */
+
+static Image* decode_image(const img_batch_options *opts, const char *src)
+{
+    if (opts->width > 0 && opts->height > 0) return img_load_resized(src, opts->width, opts->height, opts->filter);
+    return img_load(src);
+}
+
+// Applies the flip and rotation; replaces *img, or frees it and stores NULL on failure
+static int transform_image(const img_batch_options *opts, Image **img)
+{
+    if (opts->rotate == 0.0f) {
+        if (opts->flip) img_flip_horizontal(*img);
+        return RET_SUCCESS;
+    }
+
+    // Flip and rotation are composed and sampled in a single pass
+    img_transform *t = img_transform_new((*img)->width, (*img)->height);
+    Image *out = NULL;
+    if (t && (!opts->flip || img_transform_flip_horizontal(t) == RET_SUCCESS) &&
+        img_transform_rotate(t, opts->rotate) == RET_SUCCESS) {
+        out = img_transform_render(t, *img, IMG_FILTER_BILINEAR);
+    }
+    img_transform_free(t);
+    img_free(*img);
+    *img = out;
+    return out ? RET_SUCCESS : RET_FAIL;
+}
+
+// Cache fill: the complete decode and transform chain
+static Image* cache_fill(void *ctx, const char *src)
+{
+    const img_batch_options *opts = (const img_batch_options *)ctx;
+
+    Image *img = decode_image(opts, src);
+    if (img && transform_image(opts, &img) != RET_SUCCESS) return NULL;
+    return img;
+}
+
+// Hash of every option that changes the decoded and transformed pixels
+static uint64_t settings_fingerprint(const img_batch_options *opts)
+{
+    struct {
+        int32_t width, height, filter, flip;
+        float rotate;
+    } settings;
+    memset(&settings, 0, sizeof(settings));
+    settings.width = opts->width > 0 && opts->height > 0 ? opts->width : 0;
+    settings.height = opts->width > 0 && opts->height > 0 ? opts->height : 0;
+    settings.filter = settings.width ? (int32_t)opts->filter : 0;
+    settings.flip = opts->flip != 0;
+    settings.rotate = opts->rotate;
+    return img_hash_bytes(&settings, sizeof(settings), 0);
+}
+
+static int stage_decode(void *ctx, void *item)
+{
+    const batch_ctx *run = (const batch_ctx *)ctx;
+    batch_job *job = (batch_job *)item;
+
+    if (run->cache) {
+        job->img = img_cache_get(run->cache, job->src, run->fingerprint, cache_fill, (void *)run->opts);
+        job->processed = 1;
+    } else {
+        job->img = decode_image(run->opts, job->src);
+    }
+    if (!job->img) {
+        fprintf(stderr, "Could not load %s.\n", job->src);
+        return RET_FAIL;
+    }
+    return RET_SUCCESS;
+}
+
+static int stage_transform(void *ctx, void *item)
+{
+    const batch_ctx *run = (const batch_ctx *)ctx;
+    batch_job *job = (batch_job *)item;
+
+    if (job->processed) return RET_SUCCESS;
+    if (transform_image(run->opts, &job->img) != RET_SUCCESS) {
+        fprintf(stderr, "Could not rotate %s.\n", job->src);
+        return RET_FAIL;
+    }
+    return RET_SUCCESS;
+}
+
+static int stage_encode(void *ctx, void *item)
+{
+    const batch_ctx *run = (const batch_ctx *)ctx;
+    batch_job *job = (batch_job *)item;
+
+    int ret = img_write_opts(job->dst, job->img, &run->opts->write);
+    img_free(job->img);
+    job->img = NULL;
+    return ret;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Inputs                                                                    */
+/* ------------------------------------------------------------------------- */
+
+static int list_add(path_list *list, const char *path)
+{
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 256;
+        char **paths = (char **)realloc(list->paths, sizeof(char *) * capacity);
+        if (!paths) return RET_FAIL;
+        list->paths = paths;
+        list->capacity = capacity;
+    }
+    char *copy = strdup(path);
+    if (!copy) return RET_FAIL;
+    list->paths[list->count++] = copy;
+    return RET_SUCCESS;
+}
+
+static void list_free(path_list *list)
+{
+    for (int i = 0; i < list->count; i++) {
+        free(list->paths[i]);
+    }
+    free(list->paths);
+}
+
+static int has_extension(const char *path, const char *ext)
+{
+    size_t len = strlen(path), ext_len = strlen(ext);
+    return len > ext_len && strcasecmp(path + len - ext_len, ext) == 0;
+}
+
+// The formats img_write_opts() can write back under the same name
+static int has_image_extension(const char *path)
+{
+    static const char *const exts[] = { ".png", ".ppm", ".pam", ".bmp" };
+    for (size_t i = 0; i < sizeof(exts) / sizeof(exts[0]); i++) {
+        if (has_extension(path, exts[i])) return 1;
+    }
+    return 0;
+}
+
+static int compare_paths(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Every image file of a directory, sorted so runs are reproducible
+static int list_directory(path_list *list, const char *dir)
+{
+    DIR *d = opendir(dir);
+    if (!d) return RET_FAIL;
+
+    int ret = RET_SUCCESS;
+    struct dirent *entry;
+    while (ret == RET_SUCCESS && (entry = readdir(d)) != NULL) {
+        if (!has_image_extension(entry->d_name)) continue;
+
+        size_t len = strlen(dir) + strlen(entry->d_name) + 2;
+        char *path = (char *)malloc(len);
+        if (!path) {
+            ret = RET_FAIL;
+            break;
+        }
+        snprintf(path, len, "%s/%s", dir, entry->d_name);
+        ret = list_add(list, path);
+        free(path);
+    }
+    closedir(d);
+
+    if (ret == RET_SUCCESS) qsort(list->paths, list->count, sizeof(char *), compare_paths);
+    return ret;
+}
+
+// One path per line; blank lines and lines starting with '#' are skipped
+static int list_file(path_list *list, const char *filename)
+{
+    FILE *fp = fopen(filename, "r");
+    if (!fp) return RET_FAIL;
+
+    int ret = RET_SUCCESS;
+    char line[4096];
+    while (ret == RET_SUCCESS && fgets(line, sizeof(line), fp)) {
+        char *start = line;
+        while (isspace((unsigned char)*start)) start++;
+        char *end = start + strlen(start);
+        while (end > start && isspace((unsigned char)end[-1])) *--end = '\0';
+        if (*start == '\0' || *start == '#') continue;
+        ret = list_add(list, start);
+    }
+    fclose(fp);
+    return ret;
+}
+
+static int list_inputs(path_list *list, const char *input)
+{
+    struct stat st;
+    if (stat(input, &st) != 0) return RET_FAIL;
+
+    if (S_ISDIR(st.st_mode)) return list_directory(list, input);
+    if (has_image_extension(input)) return list_add(list, input);
+    return list_file(list, input);
+}
+
+static char* output_path(const char *dir, const char *src)
+{
+    const char *name = strrchr(src, '/');
+    name = name ? name + 1 : src;
+
+    size_t len = strlen(dir) + strlen(name) + 2;
+    char *path = (char *)malloc(len);
+    if (path) snprintf(path, len, "%s/%s", dir, name);
+    return path;
+}
+
+static int compare_outputs(const void *a, const void *b)
+{
+    return strcmp((*(batch_job *const *)a)->dst, (*(batch_job *const *)b)->dst);
+}
+
+// Fails before anything is written if two inputs share an output name, or if
+// an output is the input file itself, which encode would overwrite mid-run
+static int check_outputs(batch_job *jobs, int count)
+{
+    batch_job **sorted = (batch_job **)malloc(sizeof(batch_job *) * (count > 0 ? (size_t)count : 1));
+    if (!sorted) return RET_FAIL;
+    for (int i = 0; i < count; i++) {
+        sorted[i] = &jobs[i];
+    }
+    qsort(sorted, count, sizeof(batch_job *), compare_outputs);
+
+    int ret = RET_SUCCESS;
+    for (int i = 1; i < count; i++) {
+        if (strcmp(sorted[i - 1]->dst, sorted[i]->dst) == 0) {
+            fprintf(stderr, "Inputs %s and %s would both be written to %s.\n",
+                    sorted[i - 1]->src, sorted[i]->src, sorted[i]->dst);
+            ret = RET_FAIL;
+            break;
+        }
+    }
+    free(sorted);
+
+    // Comparing inodes also catches symlinks, hard links and relative spellings
+    for (int i = 0; ret == RET_SUCCESS && i < count; i++) {
+        struct stat src_st, dst_st;
+        if (stat(jobs[i].dst, &dst_st) != 0 || stat(jobs[i].src, &src_st) != 0) continue;
+        if (src_st.st_dev == dst_st.st_dev && src_st.st_ino == dst_st.st_ino) {
+            fprintf(stderr, "Output %s is the input file itself.\n", jobs[i].dst);
+            ret = RET_FAIL;
+        }
+    }
+    return ret;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Run                                                                       */
+/* ------------------------------------------------------------------------- */
+
+static void print_report(FILE *out, const img_stage *stages, const img_stage_stats *stats, int stage_count,
+                         int images, int threads, double wall)
+{
+    fprintf(out, "%d images in %.3f s on %d threads: %.1f images/s\n",
+            images, wall, threads, wall > 0 ? images / wall : 0.0);
+    fprintf(out, "%-10s %8s %7s %9s %10s %12s %21s\n",
+            "stage", "done", "failed", "busy s", "images/s", "per thread/s", "queue mean/max/cap");
+    for (int k = 0; k < stage_count; k++) {
+        const img_stage_stats *s = &stats[k];
+        fprintf(out, "%-10s %8llu %7llu %9.3f %10.1f %12.1f ",
+                stages[k].name, s->done, s->failed, s->busy_seconds,
+                wall > 0 ? s->done / wall : 0.0,
+                s->busy_seconds > 0 ? s->done / s->busy_seconds : 0.0);
+        if (s->queue_capacity > 0) {
+            fprintf(out, "%11.2f/%4d/%4d\n", s->queue_mean, s->queue_max, s->queue_capacity);
+        } else {
+            fprintf(out, "%21s\n", "input");
+        }
+    }
+}
+
+static void print_cache_report(FILE *out, img_cache *cache)
+{
+    img_cache_stats s;
+    img_cache_get_stats(cache, &s);
+    fprintf(out, "cache: %llu memory hits, %llu disk hits, %llu misses, %llu evictions, %llu disk writes\n",
+            s.memory_hits, s.disk_hits, s.misses, s.evictions, s.disk_writes);
+}
+
+int img_batch_run(const img_batch_options *opts, FILE *report)
+{
+    if (!opts || !opts->input || !opts->output_dir) return RET_FAIL;
+
+    if (mkdir(opts->output_dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Could not create output directory %s.\n", opts->output_dir);
+        return RET_FAIL;
+    }
+
+    path_list list = { NULL, 0, 0 };
+    if (list_inputs(&list, opts->input) != RET_SUCCESS) {
+        fprintf(stderr, "Could not list inputs from %s.\n", opts->input);
+        list_free(&list);
+        return RET_FAIL;
+    }
+
+    batch_job *jobs = (batch_job *)calloc(list.count ? list.count : 1, sizeof(batch_job));
+    void **items = (void **)malloc(sizeof(void *) * (list.count ? list.count : 1));
+    img_thread_pool *pool = img_thread_pool_new(opts->threads);
+    int ret = jobs && items && pool ? RET_SUCCESS : RET_FAIL;
+
+    batch_ctx run = { opts, NULL, settings_fingerprint(opts) };
+    if (ret == RET_SUCCESS && opts->cache_dir) {
+        img_cache_options cache_opts = img_cache_defaults();
+        cache_opts.disk_dir = opts->cache_dir;
+        run.cache = img_cache_new(&cache_opts);
+        if (!run.cache) {
+            fprintf(stderr, "Could not open cache directory %s.\n", opts->cache_dir);
+            ret = RET_FAIL;
+        }
+    }
+
+    for (int i = 0; ret == RET_SUCCESS && i < list.count; i++) {
+        jobs[i].src = list.paths[i];
+        jobs[i].dst = output_path(opts->output_dir, list.paths[i]);
+        if (!jobs[i].dst) ret = RET_FAIL;
+        items[i] = &jobs[i];
+    }
+    if (ret == RET_SUCCESS) ret = check_outputs(jobs, list.count);
+
+    if (ret == RET_SUCCESS) {
+        const img_stage stages[] = {
+            { "decode", stage_decode },
+            { "transform", stage_transform },
+            { "encode", stage_encode },
+        };
+        const int stage_count = (int)(sizeof(stages) / sizeof(stages[0]));
+        img_stage_stats stats[sizeof(stages) / sizeof(stages[0])];
+        int threads = img_thread_pool_size(pool);
+        int capacity = opts->queue_capacity > 0 ? opts->queue_capacity : 2 * threads;
+        double wall = 0.0;
+
+        ret = img_pipeline_run(pool, stages, stage_count, items, list.count, capacity,
+                               &run, stats, &wall);
+        if (ret == RET_SUCCESS) {
+            if (report) print_report(report, stages, stats, stage_count, list.count, threads, wall);
+            if (report && run.cache) print_cache_report(report, run.cache);
+            for (int k = 0; k < stage_count; k++) {
+                if (stats[k].failed) ret = RET_FAIL;
+            }
+        }
+    }
+
+    img_thread_pool_free(pool);
+    img_cache_free(run.cache);
+    if (jobs) {
+        for (int i = 0; i < list.count; i++) {
+            free(jobs[i].dst);
+        }
+    }
+    free(items);
+    free(jobs);
+    list_free(&list);
+    return ret;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Pack                                                                      */
+/* ------------------------------------------------------------------------- */
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Appends one file. PNG files are copied as they are unless raw pixels are
+// requested; anything else is decoded. Inputs that cannot be read or decoded
+// are skipped with a warning, so only shard failures stop the run.
+static int pack_file(img_pack_writer *w, const img_loader_file *file, int raw, size_t *skipped)
+{
+    if (!file->error && !raw && img_pack_add_png(w, file->data, file->size) == RET_SUCCESS) return RET_SUCCESS;
+
+    // A failed shard fails every later add and the close, so skipping here never hides it
+    Image *img = file->error ? NULL : img_load_mem(file->data, file->size);
+    if (!img) {
+        fprintf(stderr, "Skipping %s: not a readable image.\n", file->filename);
+        (*skipped)++;
+        return RET_SUCCESS;
+    }
+    int ret = img_pack_add_image(w, img, IMG_PACK_RAW);
+    img_free(img);
+    return ret;
+}
+
+int img_batch_pack(const img_pack_options *opts, FILE *report)
+{
+    if (!opts || !opts->input || !opts->output) return RET_FAIL;
+
+    path_list list = { NULL, 0, 0 };
+    if (list_inputs(&list, opts->input) != RET_SUCCESS) {
+        fprintf(stderr, "Could not list inputs from %s.\n", opts->input);
+        list_free(&list);
+        return RET_FAIL;
+    }
+
+    img_pack_writer *w = img_pack_writer_new(opts->output, opts->shard_bytes);
+    if (!w) {
+        list_free(&list);
+        return RET_FAIL;
+    }
+
+    // Inputs are read ahead while the current one is decoded and written
+    img_loader *loader = img_loader_new(NULL);
+    int ret = loader ? RET_SUCCESS : RET_FAIL;
+    for (int i = 0; ret == RET_SUCCESS && i < list.count; i++) {
+        ret = img_loader_add(loader, list.paths[i]);
+    }
+
+    double start = now_seconds();
+    size_t bytes = 0;
+    const img_loader_file *file;
+    size_t skipped = 0;
+    while (ret == RET_SUCCESS && (file = img_loader_next(loader)) != NULL) {
+        bytes += file->size;
+        ret = pack_file(w, file, opts->raw, &skipped);
+        if (ret != RET_SUCCESS) fprintf(stderr, "Could not pack %s.\n", file->filename);
+    }
+    img_loader_free(loader);
+    size_t packed = img_pack_writer_count(w);
+    if (img_pack_writer_close(w) != RET_SUCCESS) {
+        fprintf(stderr, "Could not write shards %s.\n", opts->output);
+        ret = RET_FAIL;
+    }
+
+    double wall = now_seconds() - start;
+    if (report) {
+        fprintf(report, "%zu images (%.1f MiB of input) packed in %.3f s: %.1f images/s\n",
+                packed, bytes / (1024.0 * 1024.0), wall, wall > 0 ? packed / wall : 0.0);
+        if (skipped) fprintf(report, "%zu unreadable inputs skipped\n", skipped);
+    }
+    list_free(&list);
+    return ret;
+}
@@ -0,0 +1,555 @@
+/**
+ * Randomized data augmentation.
+ *
+ * Parameters are drawn from a counter-based generator: every random value is
+ * a hash of a key (derived from the policy seed and the sample number) and a
+ * fixed slot number per parameter, so there is no generator state to share
+ * between threads or to advance in order, and changing one distribution does
+ * not shift the values drawn for the others.
+ *
+ * The crop, resize, rotation and flip fold into one affine map from output
+ * to source pixels. Brightness, contrast and saturation fold into one
+ * colour matrix of the form gain * p + gray_gain * gray(p) + bias, and the
+ * normalization into a per-channel multiply-add. Each output row is sampled
+ * by the shared warp sampler, passed through an FMA kernel doing the colour
+ * matrix, the clamp and the normalization, cut out and stored into the
+ * tensor, so every output pixel is produced in one pass. Scalar and SIMD
+ * kernels compute the same fused products, so all CPU levels give identical
+ * results.
+ */
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define AUG_X86 1
+#endif
+
+#include "../../include/data_augmentation.h"
+#include "../../include/img_utils.h"
+#include "../../internal/img_utils/internal_img_cpu.h"
+#include "../../internal/img_utils/internal_img_layout.h"
+#include "../../internal/img_utils/internal_img_pool.h"
+#include "../../internal/img_utils/internal_img_trace.h"
+#include "../../internal/img_utils/internal_img_warp.h"
+#include "../../internal/math/math_utils.h"
+#include "../../internal/thread/parallel.h"
+
+
+// Weyl increment of SplitMix64
+#define GOLDEN 0x9E3779B97F4A7C15ull
+
+// Random resized crop attempts before falling back to a center crop, as in torchvision
+#define CROP_ATTEMPTS 10
+
+// Grid of source samples estimating the mean gray level of a crop
+#define MEAN_GRID 16
+
+// BT.601 luma weights, as used for grayscale by torchvision
+#define GRAY_R 0.299f
+#define GRAY_G 0.587f
+#define GRAY_B 0.114f
+
+// Generator slots of the parameters; each crop attempt takes four from DRAW_CROP on
+enum {
+    DRAW_FLIP = 0,
+    DRAW_ANGLE,
+    DRAW_BRIGHTNESS,
+    DRAW_CONTRAST,
+    DRAW_SATURATION,
+    DRAW_CUTOUT,
+    DRAW_CUTOUT_WIDTH,
+    DRAW_CUTOUT_HEIGHT,
+    DRAW_CUTOUT_X,
+    DRAW_CUTOUT_Y,
+    DRAW_CROP
+};
+
+// Colour matrix, clamp and normalization of one image:
+// v = clamp(gain * p + gray_gain * gray(p) + bias, 0, 255), out = v * scale + offset
+typedef struct {
+    float gain;
+    float gray_gain;
+    float bias;
+    float scale[4];
+    float offset[4];
+    float cutout[4];   // Normalized value of erased samples
+} color_plan;
+
+// Per-band buffers for one output row
+typedef struct {
+    pixel *row;
+    float *planes[4];
+    uint8_t *bytes[4];
+} row_scratch;
+
+/* ------------------------------------------------------------------------- */
+/* Counter-based generator                                                   */
+/* ------------------------------------------------------------------------- */
+
+// SplitMix64 finalizer
+static inline uint64_t mix64(uint64_t z)
+{
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static uint64_t sample_key(uint64_t seed, uint64_t sample)
+{
+    return mix64(seed ^ mix64(sample * GOLDEN + GOLDEN));
+}
+
+// Uniform in [0, 1) with 24 random bits
+static inline float draw(uint64_t key, unsigned slot)
+{
+    return (float)(mix64(key + (slot + 1) * GOLDEN) >> 40) * 0x1p-24f;
+}
+
+static inline float draw_range(uint64_t key, unsigned slot, float lo, float hi)
+{
+    return lo + (hi - lo) * draw(key, slot);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Kernels                                                                   */
+/* ------------------------------------------------------------------------- */
+
+static void color_row_scalar(const pixel *in, int n, const color_plan *p, float *const out[4])
+{
+    for (int i = 0; i < n; i++) {
+        float r = in[i].R, g = in[i].G, b = in[i].B;
+        float t = fmaf(p->gray_gain, fmaf(GRAY_B, b, fmaf(GRAY_G, g, GRAY_R * r)), p->bias);
+        float c[3] = { r, g, b };
+        for (int ch = 0; ch < 3; ch++) {
+            float v = fminf(fmaxf(fmaf(p->gain, c[ch], t), 0.0f), 255.0f);
+            out[ch][i] = fmaf(v, p->scale[ch], p->offset[ch]);
+        }
+        if (out[3]) out[3][i] = fmaf((float)in[i].A, p->scale[3], p->offset[3]);
+    }
+}
+
+// SIMD kernel bound at startup; returns the pixels it handled, the scalar code does the rest
+static int (*color_kernel)(const pixel *in, int n, const color_plan *p, float *const out[4]);
+
+#ifdef AUG_X86
+__attribute__((target("avx2,fma")))
+static int color_row_avx2(const pixel *in, int n, const color_plan *p, float *const out[4])
+{
+    const __m256i mask = _mm256_set1_epi32(0xFF);
+    const __m256 wr = _mm256_set1_ps(GRAY_R), wg = _mm256_set1_ps(GRAY_G), wb = _mm256_set1_ps(GRAY_B);
+    const __m256 gain = _mm256_set1_ps(p->gain), gray_gain = _mm256_set1_ps(p->gray_gain);
+    const __m256 bias = _mm256_set1_ps(p->bias);
+    const __m256 lo = _mm256_setzero_ps(), hi = _mm256_set1_ps(255.0f);
+    __m256 scale[4], offset[4];
+    for (int ch = 0; ch < 4; ch++) {
+        scale[ch] = _mm256_set1_ps(p->scale[ch]);
+        offset[ch] = _mm256_set1_ps(p->offset[ch]);
+    }
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i px = _mm256_loadu_si256((const __m256i *)(in + i));
+        __m256 r = _mm256_cvtepi32_ps(_mm256_and_si256(px, mask));
+        __m256 g = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(px, 8), mask));
+        __m256 b = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(px, 16), mask));
+        __m256 gray = _mm256_fmadd_ps(wb, b, _mm256_fmadd_ps(wg, g, _mm256_mul_ps(wr, r)));
+        __m256 t = _mm256_fmadd_ps(gray_gain, gray, bias);
+
+        __m256 c[3] = { r, g, b };
+        for (int ch = 0; ch < 3; ch++) {
+            __m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_fmadd_ps(gain, c[ch], t), lo), hi);
+            _mm256_storeu_ps(out[ch] + i, _mm256_fmadd_ps(v, scale[ch], offset[ch]));
+        }
+        if (out[3]) {
+            __m256 a = _mm256_cvtepi32_ps(_mm256_srli_epi32(px, 24));
+            _mm256_storeu_ps(out[3] + i, _mm256_fmadd_ps(a, scale[3], offset[3]));
+        }
+    }
+    return i;
+}
+#endif
+
+__attribute__((constructor))
+static void bind_kernels(void)
+{
+#ifdef AUG_X86
+    if (img_cpu_get_level() >= IMG_CPU_AVX2) color_kernel = color_row_avx2;
+#endif
+}
+
+static void color_row(const pixel *in, int n, const color_plan *p, float *const out[4])
+{
+    int done = color_kernel ? color_kernel(in, n, p, out) : 0;
+    if (done < n) {
+        float *rest[4] = { out[0] + done, out[1] + done, out[2] + done, out[3] ? out[3] + done : NULL };
+        color_row_scalar(in + done, n - done, p, rest);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* Helpers                                                                   */
+/* ------------------------------------------------------------------------- */
+
+static int policy_valid(const aug_policy *p)
+{
+    if (!p) return 0;
+    if (!(p->scale_min > 0.0f && p->scale_min <= p->scale_max && p->scale_max <= 1.0f)) return 0;
+    if (!(p->ratio_min > 0.0f && p->ratio_min <= p->ratio_max)) return 0;
+    if (!(p->flip_prob >= 0.0f && p->flip_prob <= 1.0f)) return 0;
+    if (!(p->cutout_prob >= 0.0f && p->cutout_prob <= 1.0f)) return 0;
+    if (!(p->cutout_min >= 0.0f && p->cutout_min <= p->cutout_max && p->cutout_max <= 1.0f)) return 0;
+    if (!(p->max_angle >= 0.0f && p->max_angle <= 180.0f)) return 0;
+    if (!(p->brightness >= 0.0f && p->brightness <= 1.0f)) return 0;
+    if (!(p->contrast >= 0.0f && p->contrast <= 1.0f)) return 0;
+    if (!(p->saturation >= 0.0f && p->saturation <= 1.0f)) return 0;
+    for (int ch = 0; ch < 4; ch++) {
+        if (!(p->std[ch] != 0.0f) || !isfinite(p->std[ch]) || !isfinite(p->mean[ch])) return 0;
+    }
+    return 1;
+}
+
+static int tensor_valid(const img_tensor *t)
+{
+    if (!t || !t->data || t->height <= 0 || t->width <= 0) return 0;
+    if (t->channels != 3 && t->channels != 4) return 0;
+    return t->type == IMG_TENSOR_UINT8 || t->type == IMG_TENSOR_FLOAT32;
+}
+
+// Mean gray level of the crop area over a sparse grid of nearest samples
+static float crop_mean_gray(const Image *src, const aug_params *params)
+{
+    double sum = 0.0;
+    for (int j = 0; j < MEAN_GRID; j++) {
+        int y = (int)(params->crop_y + (j + 0.5f) * params->crop_height / MEAN_GRID);
+        y = y < 0 ? 0 : y >= src->height ? src->height - 1 : y;
+        const pixel *row = img_row(src, y);
+        for (int i = 0; i < MEAN_GRID; i++) {
+            int x = (int)(params->crop_x + (i + 0.5f) * params->crop_width / MEAN_GRID);
+            x = x < 0 ? 0 : x >= src->width ? src->width - 1 : x;
+            sum += GRAY_R * row[x].R + GRAY_G * row[x].G + GRAY_B * row[x].B;
+        }
+    }
+    return (float)(sum / (MEAN_GRID * MEAN_GRID));
+}
+
+/*
+ * Brightness b, then contrast c toward the mean gray m, then saturation s
+ * toward each pixel's gray. Gray is linear with weights summing to 1, so
+ *   x1 = b * p
+ *   x2 = c * x1 + (1 - c) * b * m
+ *   x3 = s * x2 + (1 - s) * gray(x2)
+ *      = s * c * b * p + (1 - s) * c * b * gray(p) + (1 - c) * b * m
+ */
+static void plan_color(const Image *src, const aug_params *params, const aug_policy *policy, int float_out,
+                       color_plan *plan)
+{
+    float b = params->brightness, c = params->contrast, s = params->saturation;
+    float mean = c != 1.0f ? crop_mean_gray(src, params) : 0.0f;
+    plan->gain = s * c * b;
+    plan->gray_gain = (1.0f - s) * c * b;
+    plan->bias = (1.0f - c) * b * mean;
+
+    const unsigned char *fill = &policy->cutout_fill.R;
+    for (int ch = 0; ch < 4; ch++) {
+        plan->scale[ch] = float_out ? 1.0f / policy->std[ch] : 1.0f;
+        plan->offset[ch] = float_out ? -policy->mean[ch] / policy->std[ch] : 0.0f;
+        plan->cutout[ch] = fmaf((float)fill[ch], plan->scale[ch], plan->offset[ch]);
+    }
+}
+
+// Output to source map: unflip, unrotate about the output center, then scale into the crop
+static void plan_affine(const aug_params *params, int width, int height, img_affine *m)
+{
+    double sn, cs;
+    sincos_approx(params->angle, &sn, &cs);
+    double sx = params->crop_width / width, sy = params->crop_height / height;
+    double flip = params->flip ? -1.0 : 1.0;
+
+    m->a = sx * cs * flip;
+    m->b = sx * sn;
+    m->c = params->crop_x + params->crop_width / 2.0;
+    m->d = -sy * sn * flip;
+    m->e = sy * cs;
+    m->f = params->crop_y + params->crop_height / 2.0;
+    m->px = width / 2.0;
+    m->py = height / 2.0;
+}
+
+static size_t round_up64(size_t n)
+{
+    return (n + 63) & ~(size_t)63;
+}
+
+// One block holding a pixel row, four float rows and four byte rows
+static void* scratch_alloc(int width, row_scratch *s)
+{
+    size_t row = round_up64(sizeof(pixel) * width), plane = round_up64(sizeof(float) * width);
+    size_t bytes = round_up64(width);
+    uint8_t *block = (uint8_t *)img_pool_alloc(row + 4 * plane + 4 * bytes);
+    if (!block) return NULL;
+
+    s->row = (pixel *)block;
+    for (int ch = 0; ch < 4; ch++) {
+        s->planes[ch] = (float *)(block + row + ch * plane);
+        s->bytes[ch] = block + row + 4 * plane + ch * bytes;
+    }
+    return block;
+}
+
+typedef struct {
+    const Image *src;
+    const aug_policy *policy;
+    img_tensor *dst;
+    int index;
+    img_affine m;
+    color_plan color;
+    int cut_x0, cut_x1, cut_y0, cut_y1;
+} image_job;
+
+static void job_init(image_job *job, const Image *src, const aug_params *params, const aug_policy *policy,
+                     img_tensor *dst, int index)
+{
+    job->src = src;
+    job->policy = policy;
+    job->dst = dst;
+    job->index = index;
+    plan_affine(params, dst->width, dst->height, &job->m);
+    plan_color(src, params, policy, dst->type == IMG_TENSOR_FLOAT32, &job->color);
+
+    // Clip the cutout to the output; an empty one covers no row
+    job->cut_x0 = params->cutout_x < 0 ? 0 : params->cutout_x;
+    job->cut_y0 = params->cutout_y < 0 ? 0 : params->cutout_y;
+    job->cut_x1 = params->cutout_x + params->cutout_width;
+    job->cut_y1 = params->cutout_y + params->cutout_height;
+    if (job->cut_x1 > dst->width) job->cut_x1 = dst->width;
+    if (job->cut_y1 > dst->height) job->cut_y1 = dst->height;
+    if (params->cutout_width <= 0 || params->cutout_height <= 0 || job->cut_x1 <= job->cut_x0) {
+        job->cut_y0 = job->cut_y1 = 0;
+    }
+}
+
+// Produces output rows [begin, end) of one image
+static void job_rows(const image_job *job, int begin, int end, const row_scratch *s)
+{
+    const img_tensor *t = job->dst;
+    const int width = t->width, channels = t->channels;
+    const int bilinear = job->policy->filter != IMG_FILTER_NEAREST;
+    const int planar_float = t->layout == IMG_LAYOUT_NCHW && t->type == IMG_TENSOR_FLOAT32;
+    const size_t image_elems = (size_t)t->height * width * channels;
+
+    for (int y = begin; y < end; y++) {
+        img_warp_row(job->src, s->row, width, y, &job->m, bilinear, job->policy->border, job->policy->fill);
+
+        // Float planes are written in place; everything else goes through the scratch rows
+        float *rows[4] = { NULL, NULL, NULL, NULL };
+        for (int ch = 0; ch < channels; ch++) {
+            rows[ch] = planar_float ? (float *)img_tensor_plane(t, job->index, ch) + (size_t)y * width
+                                    : s->planes[ch];
+        }
+        color_row(s->row, width, &job->color, rows);
+
+        if (y >= job->cut_y0 && y < job->cut_y1) {
+            for (int ch = 0; ch < channels; ch++) {
+                for (int x = job->cut_x0; x < job->cut_x1; x++) rows[ch][x] = job->color.cutout[ch];
+            }
+        }
+
+        if (planar_float) continue;
+        if (t->layout == IMG_LAYOUT_NCHW) {
+            for (int ch = 0; ch < channels; ch++) {
+                img_layout_f32_to_u8(rows[ch], (uint8_t *)img_tensor_plane(t, job->index, ch) + (size_t)y * width,
+                                     width);
+            }
+        } else if (t->type == IMG_TENSOR_UINT8) {
+            uint8_t *out = (uint8_t *)t->data + job->index * image_elems + (size_t)y * width * channels;
+            for (int ch = 0; ch < channels; ch++) img_layout_f32_to_u8(rows[ch], s->bytes[ch], width);
+            if (channels == 4) {
+                img_layout_interleave4_u8(s->bytes[0], s->bytes[1], s->bytes[2], s->bytes[3], out, width);
+            } else {
+                img_layout_interleave3_u8(s->bytes[0], s->bytes[1], s->bytes[2], out, width);
+            }
+        } else {
+            float *out = (float *)t->data + job->index * image_elems + (size_t)y * width * channels;
+            for (int x = 0; x < width; x++) {
+                for (int ch = 0; ch < channels; ch++) out[x * channels + ch] = rows[ch][x];
+            }
+        }
+    }
+}
+
+typedef struct {
+    const image_job *job;
+    int failed;
+} rows_ctx;
+
+static void apply_rows(void *opaque, int begin, int end)
+{
+    rows_ctx *ctx = (rows_ctx *)opaque;
+    row_scratch s;
+    void *block = scratch_alloc(ctx->job->dst->width, &s);
+    if (!block) {
+        __atomic_store_n(&ctx->failed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    job_rows(ctx->job, begin, end, &s);
+    img_pool_free(block);
+}
+
+typedef struct {
+    const Image *const *srcs;
+    const aug_policy *policy;
+    uint64_t first_sample;
+    img_tensor *dst;
+    aug_params *params;
+    int failed;
+} batch_ctx;
+
+// Augments images [begin, end) of a batch, each on a single thread
+static void batch_images(void *opaque, int begin, int end)
+{
+    batch_ctx *ctx = (batch_ctx *)opaque;
+    img_tensor *dst = ctx->dst;
+    row_scratch s;
+    void *block = scratch_alloc(dst->width, &s);
+    if (!block) {
+        __atomic_store_n(&ctx->failed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    for (int i = begin; i < end; i++) {
+        const Image *src = ctx->srcs[i];
+        aug_params params;
+        if (!src || !src->pixels ||
+            aug_sample(ctx->policy, ctx->first_sample + (uint64_t)i, src->width, src->height, dst->width,
+                       dst->height, &params) != RET_SUCCESS) {
+            __atomic_store_n(&ctx->failed, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        if (ctx->params) ctx->params[i] = params;
+
+        image_job job;
+        job_init(&job, src, &params, ctx->policy, dst, i);
+        job_rows(&job, 0, dst->height, &s);
+    }
+    img_pool_free(block);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+aug_policy aug_policy_defaults(void)
+{
+    aug_policy p;
+    memset(&p, 0, sizeof(p));
+    p.scale_min = 0.08f;
+    p.scale_max = 1.0f;
+    p.ratio_min = 3.0f / 4.0f;
+    p.ratio_max = 4.0f / 3.0f;
+    p.flip_prob = 0.5f;
+    p.max_angle = 10.0f;
+    p.brightness = 0.4f;
+    p.contrast = 0.4f;
+    p.saturation = 0.4f;
+    p.cutout_prob = 0.5f;
+    p.cutout_min = 0.1f;
+    p.cutout_max = 0.3f;
+    p.cutout_fill = (pixel){ 128, 128, 128, 255 };
+    p.filter = IMG_FILTER_BILINEAR;
+    p.border = IMG_BORDER_REFLECT;
+    p.fill = (pixel){ 0, 0, 0, 255 };
+    for (int ch = 0; ch < 4; ch++) {
+        p.mean[ch] = 0.0f;
+        p.std[ch] = 1.0f;
+    }
+    return p;
+}
+
+int aug_sample(const aug_policy *policy, uint64_t sample, int src_width, int src_height, int width, int height,
+               aug_params *params)
+{
+    if (!policy_valid(policy) || !params) return RET_FAIL;
+    if (src_width <= 0 || src_height <= 0 || width <= 0 || height <= 0) return RET_FAIL;
+
+    const uint64_t key = sample_key(policy->seed, sample);
+
+    // Random resized crop: area fraction uniform, aspect ratio log-uniform
+    const float area = (float)src_width * src_height;
+    const float log_lo = logf(policy->ratio_min), log_hi = logf(policy->ratio_max);
+    int found = 0;
+    for (unsigned k = 0; k < CROP_ATTEMPTS && !found; k++) {
+        unsigned slot = DRAW_CROP + 4 * k;
+        float target = area * draw_range(key, slot, policy->scale_min, policy->scale_max);
+        float ratio = expf(draw_range(key, slot + 1, log_lo, log_hi));
+        float w = sqrtf(target * ratio), h = sqrtf(target / ratio);
+        if (w <= src_width && h <= src_height) {
+            params->crop_width = w;
+            params->crop_height = h;
+            params->crop_x = draw(key, slot + 2) * (src_width - w);
+            params->crop_y = draw(key, slot + 3) * (src_height - h);
+            found = 1;
+        }
+    }
+    if (!found) {
+        // Center crop with the aspect ratio clamped into range
+        float w = (float)src_width, h = (float)src_height, ratio = w / h;
+        if (ratio < policy->ratio_min) {
+            h = w / policy->ratio_min;
+        } else if (ratio > policy->ratio_max) {
+            w = h * policy->ratio_max;
+        }
+        params->crop_width = w;
+        params->crop_height = h;
+        params->crop_x = (src_width - w) / 2.0f;
+        params->crop_y = (src_height - h) / 2.0f;
+    }
+
+    params->flip = draw(key, DRAW_FLIP) < policy->flip_prob;
+    params->angle = draw_range(key, DRAW_ANGLE, -policy->max_angle, policy->max_angle);
+    params->brightness = draw_range(key, DRAW_BRIGHTNESS, 1.0f - policy->brightness, 1.0f + policy->brightness);
+    params->contrast = draw_range(key, DRAW_CONTRAST, 1.0f - policy->contrast, 1.0f + policy->contrast);
+    params->saturation = draw_range(key, DRAW_SATURATION, 1.0f - policy->saturation, 1.0f + policy->saturation);
+
+    params->cutout_x = params->cutout_y = params->cutout_width = params->cutout_height = 0;
+    if (draw(key, DRAW_CUTOUT) < policy->cutout_prob) {
+        int w = (int)lrintf(draw_range(key, DRAW_CUTOUT_WIDTH, policy->cutout_min, policy->cutout_max) * width);
+        int h = (int)lrintf(draw_range(key, DRAW_CUTOUT_HEIGHT, policy->cutout_min, policy->cutout_max) * height);
+        if (w > 0 && h > 0) {
+            params->cutout_width = w;
+            params->cutout_height = h;
+            params->cutout_x = (int)(draw(key, DRAW_CUTOUT_X) * (width - w + 1));
+            params->cutout_y = (int)(draw(key, DRAW_CUTOUT_Y) * (height - h + 1));
+        }
+    }
+    return RET_SUCCESS;
+}
+
+int aug_apply(const Image *src, const aug_params *params, const aug_policy *policy, img_tensor *dst, int index)
+{
+    if (!src || !src->pixels || !params || !policy_valid(policy) || !tensor_valid(dst)) return RET_FAIL;
+    if (index < 0 || index >= dst->batch) return RET_FAIL;
+    if (!(params->crop_width > 0.0f && params->crop_height > 0.0f)) return RET_FAIL;
+    IMG_TRACE_SCOPE("aug_apply");
+    IMG_TRACE_COUNT(IMG_TRACE_PIXELS, (size_t)dst->width * dst->height);
+
+    image_job job;
+    job_init(&job, src, params, policy, dst, index);
+    rows_ctx ctx = { &job, 0 };
+    img_parallel_for(dst->height, img_parallel_grain(dst->width), apply_rows, &ctx);
+    return ctx.failed ? RET_FAIL : RET_SUCCESS;
+}
+
+int aug_batch(const Image *const *srcs, int count, const aug_policy *policy, uint64_t first_sample,
+              img_tensor *dst, aug_params *params)
+{
+    if (!srcs || count < 0 || !policy_valid(policy) || !tensor_valid(dst) || count > dst->batch) return RET_FAIL;
+    IMG_TRACE_SCOPE("aug_batch");
+    IMG_TRACE_COUNT(IMG_TRACE_PIXELS, (size_t)count * dst->width * dst->height);
+
+    // Whole images per band: each is independent, so bands need no coordination
+    batch_ctx ctx = { srcs, policy, first_sample, dst, params, 0 };
+    img_parallel_for(count, 1, batch_images, &ctx);
+    return ctx.failed ? RET_FAIL : RET_SUCCESS;
+}
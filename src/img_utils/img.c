@@ -6,22 +6,30 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define IMG_X86 1
+#endif
+
 #include "../../include/img_utils.h"
 #include "../../internal/math/math_utils.h"
+#include "../../internal/img_utils/internal_img_cpu.h"
 #include "../../internal/img_utils/internal_img_io.h"
+#include "../../internal/img_utils/internal_img_pool.h"
+#include "../../internal/img_utils/internal_img_storage.h"
+#include "../../internal/img_utils/internal_img_trace.h"
+#include "../../internal/thread/parallel.h"
 
 
 Image* img_new(int width, int height)
 {
-	Image *image = (Image *)malloc(sizeof(Image));
-	if (!image) return NULL; // Error during malloc
-
-	image->width = width;
-    image->height = height;
+	if (width <= 0 || height <= 0) return NULL;
 
-    image->pixels = (pixel *)malloc(sizeof(pixel) * image->width * image->height);
+	img_storage *storage = img_storage_new(sizeof(pixel) * (size_t)width * height);
+	if (!storage) return NULL; // Error during allocation
 
-    if (!image->pixels) return NULL; // Error during malloc
+	Image *image = img_handle_new(storage, (pixel *)storage->data, width, height, width);
+	img_storage_release(storage); // The handle holds the only reference now
 
     return image;
 }
@@ -29,123 +37,189 @@ Image* img_new(int width, int height)
 void img_free(Image* img)
 {
 	if (img != NULL) {
-        free(img->pixels); // Free the pixels array
-        free(img);         // Then free the image struct itself
+        img_storage_release(img->storage); // Drop this handle's reference to the pixels
+        img_pool_free(img);                // Then free the image struct itself
     }
 }
 
-// Nearest-neighbor image resize function, on succes return 0, else 1
-int img_resize(Image** src, int new_width, int new_height) {
-    if (!src || !*src) return 1; // Check for valid source image
+img_packed* img_packed_new(int width, int height, int channels)
+{
+    if (width <= 0 || height <= 0 || channels < 1 || channels > 4) return NULL;
 
-    Image* resized = img_new(new_width, new_height); // Create new resized image
-    if (!resized) return 1; // Check for successful allocation
+    size_t stride = (size_t)width * channels;
+    img_storage *storage = img_storage_new(stride * height);
+    if (!storage) return NULL;
 
-    // Using fixed-point arithmetic with a scale factor of 1024 for precision
-    int scaleX = ((*src)->width << 10) / new_width;
-    int scaleY = ((*src)->height << 10) / new_height;
+    img_packed *image = (img_packed *)img_pool_alloc(sizeof(img_packed));
+    if (!image) {
+        img_storage_release(storage);
+        return NULL;
+    }
 
-    int srcY = 0;
-    for (int y = 0; y < new_height; y++, srcY += scaleY) {
-        int srcX = 0;
-        for (int x = 0; x < new_width; x++, srcX += scaleX) {
-            // Accessing source pixel based on scaled indices
-            pixel* srcPixel = &(*src)->pixels[(srcY >> 10) * (*src)->width + (srcX >> 10)];
-            pixel* dstPixel = &resized->pixels[y * new_width + x];
-            *dstPixel = *srcPixel;
-        }
+    image->width = width;
+    image->height = height;
+    image->channels = channels;
+    image->stride = stride;
+    image->data = (unsigned char *)storage->data;
+    image->storage = storage; // Takes over the initial reference
+    return image;
+}
+
+void img_packed_free(img_packed *img)
+{
+    if (img != NULL) {
+        img_storage_release(img->storage);
+        img_pool_free(img);
     }
+}
+
+Image* img_view(const Image *parent, int x, int y, int width, int height)
+{
+    if (!parent || !parent->pixels) return NULL;
+    if (x < 0 || y < 0 || width <= 0 || height <= 0) return NULL;
+    if (x + width > parent->width || y + height > parent->height) return NULL;
 
-    img_free(*src); // Free the original image
-    *src = resized; // Update the source image pointer to point to the resized image
-    return RET_SUCCESS;
+    return img_handle_new(parent->storage, img_row(parent, y) + x, width, height, parent->stride);
 }
 
-// Crop image function
-int img_crop(Image **src, int x, int y, int width, int height) {
-    if (!src || !*src) return RET_FAIL;
+Image* img_wrap(pixel *pixels, int width, int height, int stride)
+{
+    if (!pixels || width <= 0 || height <= 0 || stride < width) return NULL;
+    return img_handle_new(NULL, pixels, width, height, stride);
+}
 
-    Image* cropped = img_new(width, height);
-    if (!cropped) return RET_FAIL; // Allocation failure
+Image* img_copy(const Image *src)
+{
+    if (!src || !src->pixels) return NULL;
+    IMG_TRACE_SCOPE("img_copy");
 
+    Image *copy = img_new(src->width, src->height);
+    if (!copy) return NULL;
 
-    for (int newY = 0; newY < height; newY++) {
-        for (int newX = 0; newX < width; newX++) {
-            //  Accessing source pixel based on scaled indices
-            pixel *srcPixel = &(*src)->pixels[((y + newY) * (*src)->width + x + newX)];
-            pixel *dstPixel = &cropped->pixels[newY * width + newX];
-            *dstPixel = *srcPixel;
-        }
+    for (int y = 0; y < src->height; y++) {
+        memcpy(img_row(copy, y), img_row(src, y), sizeof(pixel) * src->width);
     }
+    IMG_TRACE_COUNT(IMG_TRACE_PIXELS, (size_t)src->width * src->height);
+    return copy;
+}
 
-    // Free the original image and update the pointer to point to the cropped image
+// Crop image function: the result is a view, so no pixels are copied
+int img_crop(Image **src, int x, int y, int width, int height) {
+    if (!src || !*src) return RET_FAIL;
+    IMG_TRACE_SCOPE("img_crop");
+
+    Image* cropped = img_view(*src, x, y, width, height);
+    if (!cropped) return RET_FAIL; // Out of bounds or allocation failure
+
+    // Free the original handle; the view keeps the shared pixels alive
     img_free(*src);
     *src = cropped;
 
     return RET_SUCCESS; // Success
 }
 
-// Function to flip an image horizontally
-void img_flip_horizontal(Image* img)
-{
-    if (!img || !img->pixels) return; // Check for valid image
+/* ------------------------------------------------------------------------- */
+/* Horizontal flip                                                           */
+/* ------------------------------------------------------------------------- */
 
-    int width = img->width;
-    int height = img->height;
+// Row kernels swap mirrored blocks from both ends and return how many pixels
+// from each end they handled; the scalar loop finishes the middle
+typedef int (*flip_row_fn)(pixel *row, int width);
 
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width / 2; x++) {
-            int oppositeX = width - 1 - x; // Find the opposite pixel in the same row
+static int flip_row_scalar(pixel *row, int width)
+{
+    (void)row;
+    (void)width;
+    return 0;
+}
 
-            // Calculate the indexes for the current pixel and its horizontal opposite
-            int currentIndex = (y * width + x);
-            int oppositeIndex = (y * width + oppositeX);
+#ifdef IMG_X86
+__attribute__((target("sse2")))
+static int flip_row_sse2(pixel *row, int width)
+{
+    int x = 0;
+    for (; 2 * (x + 4) <= width; x += 4) {
+        __m128i *l = (__m128i *)(row + x), *r = (__m128i *)(row + width - x - 4);
+        __m128i a = _mm_loadu_si128(l), b = _mm_loadu_si128(r);
+        _mm_storeu_si128(l, _mm_shuffle_epi32(b, 0x1B));
+        _mm_storeu_si128(r, _mm_shuffle_epi32(a, 0x1B));
+    }
+    return x;
+}
 
-            // Swap the current pixel with its horizontal opposite
-            pixel temp = img->pixels[currentIndex];
-            img->pixels[currentIndex] = img->pixels[oppositeIndex];
-            img->pixels[oppositeIndex] = temp;
-        }
+__attribute__((target("avx2")))
+static int flip_row_avx2(pixel *row, int width)
+{
+    const __m256i reverse = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    int x = 0;
+    for (; 2 * (x + 8) <= width; x += 8) {
+        __m256i *l = (__m256i *)(row + x), *r = (__m256i *)(row + width - x - 8);
+        __m256i a = _mm256_loadu_si256(l), b = _mm256_loadu_si256(r);
+        _mm256_storeu_si256(l, _mm256_permutevar8x32_epi32(b, reverse));
+        _mm256_storeu_si256(r, _mm256_permutevar8x32_epi32(a, reverse));
     }
+    return x + flip_row_sse2(row + x, width - 2 * x);
 }
 
-int img_rotate(Image* img, float angle) {
+__attribute__((target("avx512f")))
+static int flip_row_avx512(pixel *row, int width)
+{
+    const __m512i reverse = _mm512_setr_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    int x = 0;
+    for (; 2 * (x + 16) <= width; x += 16) {
+        pixel *l = row + x, *r = row + width - x - 16;
+        __m512i a = _mm512_loadu_si512(l), b = _mm512_loadu_si512(r);
+        _mm512_storeu_si512(l, _mm512_permutexvar_epi32(reverse, b));
+        _mm512_storeu_si512(r, _mm512_permutexvar_epi32(reverse, a));
+    }
+    return x + flip_row_avx2(row + x, width - 2 * x);
+}
+#endif
 
-    // Calculate the center of the image
-    float centerX = img->width / 2.0;
-    float centerY = img->height / 2.0;
+static flip_row_fn flip_row;
 
-    // Create a new image to store the rotated pixels
-    Image* rotatedImg = img_new(img->width, img->height);
+__attribute__((constructor))
+static void bind_kernels(void)
+{
+    img_cpu_level cpu = img_cpu_get_level();
+    flip_row = flip_row_scalar;
+#ifdef IMG_X86
+    if (cpu >= IMG_CPU_SSE2) flip_row = flip_row_sse2;
+    if (cpu >= IMG_CPU_AVX2) flip_row = flip_row_avx2;
+    if (cpu >= IMG_CPU_AVX512) flip_row = flip_row_avx512;
+#endif
+    (void)cpu;
+}
 
-    if (rotatedImg == NULL)
-    {
-        return RET_FAIL;
-    }
+// Mirrors rows [begin, end) in place
+static void flip_rows(void *ctx, int begin, int end)
+{
+    Image *img = (Image *)ctx;
+    int width = img->width;
+
+    for (int y = begin; y < end; y++) {
+        pixel *row = img_row(img, y);
+        for (int x = flip_row(row, width); x < width / 2; x++) {
+            int oppositeX = width - 1 - x; // Find the opposite pixel in the same row
 
-    // Initialize the rotated image pixels to a default value (e.g., transparent or black)
-    memset(rotatedImg->pixels, 0, img->width * img->height * sizeof(pixel));
-
-    for (int y = 0; y < img->height; y++) {
-        for (int x = 0; x < img->width; x++) {
-            // Calculate the new position for each pixel
-            float newX = cos_approx(angle) * (x - centerX) - sin_approx(angle) * (y - centerY) + centerX;
-            float newY = sin_approx(angle) * (x - centerX) + cos_approx(angle) * (y - centerY) + centerY;
-
-            // Check if the new position is within the bounds of the original image
-            if (newX >= 0 && newX < img->width && newY >= 0 && newY < img->height) {
-                // For simplicity, this does not include interpolation.
-                // Directly assign the pixel value to the closest integer position.
-                rotatedImg->pixels[(int)newY * img->width + (int)newX] = img->pixels[y * img->width + x];
-            }
+            // Swap the current pixel with its horizontal opposite
+            pixel temp = row[x];
+            row[x] = row[oppositeX];
+            row[oppositeX] = temp;
         }
     }
+}
+
+void img_flip_horizontal(Image* img)
+{
+    if (!img || !img->pixels) return; // Check for valid image
+    IMG_TRACE_SCOPE("img_flip_horizontal");
 
-    // Replace the original image pixels with the rotated pixels
-    memcpy(img->pixels, rotatedImg->pixels, img->width * img->height * sizeof(pixel));
-    img_free(rotatedImg);
+    int width = img->width;
+    int height = img->height;
 
-    return RET_SUCCESS;
+    img_parallel_for(height, img_parallel_grain(width), flip_rows, img);
+    IMG_TRACE_COUNT(IMG_TRACE_PIXELS, (size_t)width * height);
 }
 
 Image* img_load(const char *filename)
@@ -153,7 +227,34 @@ Image* img_load(const char *filename)
     return img_io_load(filename);
 }
 
+Image* img_load_mem(const void *data, size_t size)
+{
+    return img_io_load_mem(data, size);
+}
+
+img_packed* img_load_packed(const char *filename)
+{
+    return img_io_load_packed(filename);
+}
+
 void img_write(const char *filename, Image *img)
 {
     img_io_write(filename, img);
+}
+
+img_write_options img_write_defaults(void)
+{
+    img_write_options opts = {
+        .level = 6,
+        .filter = IMG_PNG_FILTER_ADAPTIVE,
+        .strategy = IMG_ZLIB_DEFAULT,
+        .store_only = 0,
+        .threads = 1,
+    };
+    return opts;
+}
+
+int img_write_opts(const char *filename, const Image *img, const img_write_options *opts)
+{
+    return img_io_write_opts(filename, img, opts);
 }
\ No newline at end of file
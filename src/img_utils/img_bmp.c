@@ -0,0 +1,148 @@
+/**
+ * Uncompressed BMP header parsing and writer.
+ */
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../../internal/img_utils/internal_img_bmp.h"
+#include "../../internal/img_utils/internal_img_trace.h"
+
+
+#define BMP_FILE_HEADER 14
+#define BMP_V4_HEADER 108
+#define BMP_DATA_OFFSET 128 // Pixels written by img_bmp_write() start here, past a little padding
+
+// Compression methods
+#define BI_RGB 0
+#define BI_BITFIELDS 3
+#define BI_ALPHABITFIELDS 6
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+// Maps 32-bit colour masks to a channel order; only whole-byte RGB or BGR masks qualify
+static int masks_order(uint32_t r, uint32_t g, uint32_t b, img_raw_order *order)
+{
+    if (g != 0x0000ff00u) return RET_FAIL;
+    if (r == 0x000000ffu && b == 0x00ff0000u) *order = IMG_RAW_RGB;
+    else if (r == 0x00ff0000u && b == 0x000000ffu) *order = IMG_RAW_BGR;
+    else return RET_FAIL;
+    return RET_SUCCESS;
+}
+
+int img_bmp_parse(const uint8_t *data, size_t size, img_raw_layout *layout)
+{
+    if (size < BMP_FILE_HEADER + 40 || data[0] != 'B' || data[1] != 'M') return RET_FAIL;
+
+    const uint8_t *info = data + BMP_FILE_HEADER;
+    uint32_t info_size = get_u32(info);
+    int32_t width = (int32_t)get_u32(info + 4);
+    int32_t height = (int32_t)get_u32(info + 8);
+    uint16_t bpp = get_u16(info + 14);
+    uint32_t compression = get_u32(info + 16);
+    if (info_size < 40 || info_size > size - BMP_FILE_HEADER || get_u16(info + 12) != 1) return RET_FAIL;
+    if (width <= 0 || height == 0 || height == INT32_MIN) return RET_FAIL;
+
+    memset(layout, 0, sizeof(*layout));
+    layout->width = width;
+    layout->height = height < 0 ? -height : height;
+    layout->sample_bytes = 1;
+    layout->maxval = 255;
+    layout->order = IMG_RAW_BGR;
+    if (bpp == 24 && compression == BI_RGB) {
+        layout->channels = 3;
+    } else if (bpp == 32 && compression == BI_RGB) {
+        layout->channels = 4;
+        layout->opaque = 1;
+    } else if (bpp == 32 && (compression == BI_BITFIELDS || compression == BI_ALPHABITFIELDS)) {
+        // Masks follow a 40-byte header and are part of the larger ones
+        int alpha = compression == BI_ALPHABITFIELDS || info_size >= 56;
+        size_t masks_end = BMP_FILE_HEADER + 40 + (alpha ? 16 : 12);
+        if (size < masks_end) return RET_FAIL;
+        const uint8_t *masks = info + 40;
+        if (masks_order(get_u32(masks), get_u32(masks + 4), get_u32(masks + 8), &layout->order) != RET_SUCCESS) {
+            return RET_FAIL;
+        }
+        uint32_t alpha_mask = alpha ? get_u32(masks + 12) : 0;
+        if (alpha_mask != 0 && alpha_mask != 0xff000000u) return RET_FAIL;
+        layout->channels = 4;
+        layout->opaque = alpha_mask == 0;
+    } else {
+        return RET_FAIL; // Palette, 16-bit and compressed variants
+    }
+
+    // Rows are padded to 4 bytes; bottom-up files store the top row last
+    size_t row_bytes = ((size_t)width * layout->channels + 3) & ~(size_t)3;
+    size_t data_offset = get_u32(data + 10);
+    if (data_offset > size || (size - data_offset) / row_bytes < (size_t)layout->height) return RET_FAIL;
+    if (height < 0) {
+        layout->offset = data_offset;
+        layout->pitch = (ptrdiff_t)row_bytes;
+    } else {
+        layout->offset = data_offset + row_bytes * (layout->height - 1);
+        layout->pitch = -(ptrdiff_t)row_bytes;
+    }
+    return img_raw_check(layout, size);
+}
+
+int img_bmp_write(FILE *fp, const Image *img)
+{
+    IMG_TRACE_SCOPE("img_bmp_write");
+    size_t row_bytes = sizeof(pixel) * (size_t)img->width;
+    if ((UINT32_MAX - BMP_DATA_OFFSET) / row_bytes < (size_t)img->height) return RET_FAIL;
+    uint32_t image_size = (uint32_t)(row_bytes * img->height);
+
+    uint8_t header[BMP_DATA_OFFSET] = { 'B', 'M' };
+    put_u32(header + 2, BMP_DATA_OFFSET + image_size);
+    put_u32(header + 10, BMP_DATA_OFFSET);
+
+    // BITMAPV4HEADER: top-down (negative height), 32 bits, masks matching the pixel byte order
+    uint8_t *info = header + BMP_FILE_HEADER;
+    put_u32(info, BMP_V4_HEADER);
+    put_u32(info + 4, (uint32_t)img->width);
+    put_u32(info + 8, (uint32_t)-img->height);
+    put_u16(info + 12, 1);
+    put_u16(info + 14, 32);
+    put_u32(info + 16, BI_BITFIELDS);
+    put_u32(info + 20, image_size);
+    put_u32(info + 24, 2835); // 72 dpi
+    put_u32(info + 28, 2835);
+    put_u32(info + 40, 0x000000ffu);
+    put_u32(info + 44, 0x0000ff00u);
+    put_u32(info + 48, 0x00ff0000u);
+    put_u32(info + 52, 0xff000000u);
+    put_u32(info + 56, 0x73524742u); // 'sRGB' colour space
+
+    int ok = fwrite(header, 1, sizeof(header), fp) == sizeof(header);
+    if (img->stride == img->width) {
+        ok = ok && fwrite(img->pixels, row_bytes, img->height, fp) == (size_t)img->height;
+    } else {
+        for (int y = 0; ok && y < img->height; y++) {
+            ok = fwrite(img_row(img, y), 1, row_bytes, fp) == row_bytes;
+        }
+    }
+    IMG_TRACE_COUNT(IMG_TRACE_BYTES_WRITTEN, sizeof(header) + (size_t)image_size);
+    return ok ? RET_SUCCESS : RET_FAIL;
+}
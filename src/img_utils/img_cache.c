@@ -0,0 +1,552 @@
+/**
+ * Two-level image cache.
+ *
+ * The memory level is a chained hash table threaded onto an LRU list, holding
+ * one Image handle per entry; lookups hand out new handles to the same
+ * storage, so a hit costs one small allocation. The disk level stores one
+ * raw file per entry (see internal_img_cache.h) and maps it read-only on a
+ * hit; the mapping then joins the memory level like a decoded image. Only the
+ * table itself is guarded by the lock: identifying files, filling misses and
+ * disk I/O run unlocked, so concurrent misses for the same key may both fill,
+ * and the first one stored wins.
+ */
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../../include/img_utils.h"
+#include "../../internal/img_utils/internal_img_cache.h"
+#include "../../internal/img_utils/internal_img_pool.h"
+#include "../../internal/img_utils/internal_img_storage.h"
+#include "../../internal/img_utils/internal_img_trace.h"
+
+
+#define CACHE_DEFAULT_BYTES ((size_t)256 << 20)
+#define CACHE_MIN_BUCKETS 64
+
+#define PRIME64_1 0x9E3779B185EBCA87ull
+#define PRIME64_2 0xC2B2AE3D27D4EB4Full
+#define PRIME64_3 0x165667B19E3779F9ull
+#define PRIME64_4 0x85EBCA77C2B2AE63ull
+#define PRIME64_5 0x27D4EB2F165667C5ull
+
+typedef struct cache_entry {
+    uint64_t source;
+    uint64_t fingerprint;
+    Image *img;                 // Handle owned by the entry
+    size_t bytes;               // Storage bytes charged to the budget
+    struct cache_entry *chain;  // Next entry in the same bucket
+    struct cache_entry *prev;   // LRU neighbours; the head is the most recently used
+    struct cache_entry *next;
+} cache_entry;
+
+struct img_cache {
+    pthread_mutex_t lock;
+    cache_entry **buckets;      // Power-of-two table, guarded by lock
+    size_t bucket_count;
+    size_t entries;
+    size_t used;                // Bytes held, guarded by lock
+    size_t budget;
+    cache_entry *head;
+    cache_entry *tail;
+    char *disk_dir;             // NULL without a disk level
+    img_cache_key key;
+    atomic_uint temp_seq;       // Makes temporary file names unique within the process
+    atomic_ullong memory_hits, disk_hits, misses, evictions, disk_writes;
+};
+
+/* ------------------------------------------------------------------------- */
+/* Hashing                                                                   */
+/* ------------------------------------------------------------------------- */
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const unsigned char *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t read32(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t xxh_round(uint64_t acc, uint64_t input)
+{
+    acc += input * PRIME64_2;
+    return rotl64(acc, 31) * PRIME64_1;
+}
+
+static inline uint64_t xxh_merge(uint64_t acc, uint64_t val)
+{
+    acc ^= xxh_round(0, val);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+uint64_t img_hash_bytes(const void *data, size_t size, uint64_t seed)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    const unsigned char *end = p + size;
+    uint64_t h;
+
+    if (size >= 32) {
+        // Four independent lanes over 32-byte stripes
+        uint64_t v1 = seed + PRIME64_1 + PRIME64_2, v2 = seed + PRIME64_2, v3 = seed, v4 = seed - PRIME64_1;
+        const unsigned char *limit = end - 32;
+        do {
+            v1 = xxh_round(v1, read64(p));
+            v2 = xxh_round(v2, read64(p + 8));
+            v3 = xxh_round(v3, read64(p + 16));
+            v4 = xxh_round(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = xxh_merge(h, v1);
+        h = xxh_merge(h, v2);
+        h = xxh_merge(h, v3);
+        h = xxh_merge(h, v4);
+    } else {
+        h = seed + PRIME64_5;
+    }
+    h += (uint64_t)size;
+
+    for (; p + 8 <= end; p += 8) h = rotl64(h ^ xxh_round(0, read64(p)), 27) * PRIME64_1 + PRIME64_4;
+    if (p + 4 <= end) {
+        h = rotl64(h ^ (read32(p) * PRIME64_1), 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    for (; p < end; p++) h = rotl64(h ^ (*p * PRIME64_5), 11) * PRIME64_1;
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+// Identifies a source file by its metadata or its bytes
+static int source_id(const img_cache *cache, const char *filename, uint64_t *id)
+{
+    int fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return RET_FAIL;
+
+    struct stat st;
+    int ret = fstat(fd, &st) == 0 && S_ISREG(st.st_mode) ? RET_SUCCESS : RET_FAIL;
+    if (ret == RET_SUCCESS && cache->key == IMG_CACHE_KEY_CONTENT) {
+        void *data = NULL;
+        if (st.st_size > 0) {
+            data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) ret = RET_FAIL;
+            else madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+        }
+        if (ret == RET_SUCCESS) {
+            *id = img_hash_bytes(data, (size_t)st.st_size, 0);
+            if (data) munmap(data, (size_t)st.st_size);
+        }
+    } else if (ret == RET_SUCCESS) {
+        uint64_t fields[6] = {
+            (uint64_t)st.st_dev, (uint64_t)st.st_ino, (uint64_t)st.st_size,
+            (uint64_t)st.st_mtim.tv_sec, (uint64_t)st.st_mtim.tv_nsec, (uint64_t)st.st_ctim.tv_sec,
+        };
+        *id = img_hash_bytes(fields, sizeof(fields), img_hash_bytes(filename, strlen(filename), 0));
+    }
+    close(fd);
+    return ret;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Memory level                                                              */
+/* ------------------------------------------------------------------------- */
+
+static inline size_t bucket_of(const img_cache *cache, uint64_t source, uint64_t fingerprint)
+{
+    return (size_t)((source ^ rotl64(fingerprint, 32)) * PRIME64_1 >> 32) & (cache->bucket_count - 1);
+}
+
+// New handle sharing the entry's pixels
+static Image* share(const Image *img)
+{
+    return img_handle_new(img->storage, img->pixels, img->width, img->height, img->stride);
+}
+
+static cache_entry* find(const img_cache *cache, uint64_t source, uint64_t fingerprint)
+{
+    cache_entry *e = cache->buckets[bucket_of(cache, source, fingerprint)];
+    while (e && (e->source != source || e->fingerprint != fingerprint)) e = e->chain;
+    return e;
+}
+
+static void lru_unlink(img_cache *cache, cache_entry *e)
+{
+    if (e->prev) e->prev->next = e->next;
+    else cache->head = e->next;
+    if (e->next) e->next->prev = e->prev;
+    else cache->tail = e->prev;
+}
+
+static void lru_push_front(img_cache *cache, cache_entry *e)
+{
+    e->prev = NULL;
+    e->next = cache->head;
+    if (cache->head) cache->head->prev = e;
+    else cache->tail = e;
+    cache->head = e;
+}
+
+static void remove_entry(img_cache *cache, cache_entry *e)
+{
+    cache_entry **link = &cache->buckets[bucket_of(cache, e->source, e->fingerprint)];
+    while (*link != e) link = &(*link)->chain;
+    *link = e->chain;
+    lru_unlink(cache, e);
+
+    cache->entries--;
+    cache->used -= e->bytes;
+    img_free(e->img); // Outstanding handles keep the pixels alive
+    img_pool_free(e);
+}
+
+// Doubles the table once it averages more than one entry per bucket
+static void maybe_grow(img_cache *cache)
+{
+    if (cache->entries < cache->bucket_count) return;
+
+    size_t count = cache->bucket_count * 2;
+    cache_entry **buckets = (cache_entry **)calloc(count, sizeof(cache_entry *));
+    if (!buckets) return; // Longer chains, still correct
+
+    cache_entry **old = cache->buckets;
+    size_t old_count = cache->bucket_count;
+    cache->buckets = buckets;
+    cache->bucket_count = count;
+    for (size_t i = 0; i < old_count; i++) {
+        for (cache_entry *e = old[i], *chain; e; e = chain) {
+            chain = e->chain;
+            size_t b = bucket_of(cache, e->source, e->fingerprint);
+            e->chain = buckets[b];
+            buckets[b] = e;
+        }
+    }
+    free(old);
+}
+
+// Stores an image and returns the handle for the caller; takes ownership of img
+static Image* insert(img_cache *cache, uint64_t source, uint64_t fingerprint, Image *img)
+{
+    size_t bytes = img->storage->size;
+    if (bytes > cache->budget) return img;
+
+    cache_entry *e = (cache_entry *)img_pool_alloc(sizeof(cache_entry));
+    if (!e) return img;
+
+    pthread_mutex_lock(&cache->lock);
+    cache_entry *existing = find(cache, source, fingerprint);
+    if (existing) {
+        // Another thread filled the same key first
+        Image *out = share(existing->img);
+        pthread_mutex_unlock(&cache->lock);
+        img_pool_free(e);
+        img_free(img);
+        return out;
+    }
+
+    while (cache->tail && cache->used + bytes > cache->budget) {
+        remove_entry(cache, cache->tail);
+        atomic_fetch_add_explicit(&cache->evictions, 1, memory_order_relaxed);
+    }
+
+    e->source = source;
+    e->fingerprint = fingerprint;
+    e->img = img;
+    e->bytes = bytes;
+    size_t b = bucket_of(cache, source, fingerprint);
+    e->chain = cache->buckets[b];
+    cache->buckets[b] = e;
+    lru_push_front(cache, e);
+    cache->entries++;
+    cache->used += bytes;
+    maybe_grow(cache);
+
+    Image *out = share(img);
+    pthread_mutex_unlock(&cache->lock);
+    return out;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Disk level                                                                */
+/* ------------------------------------------------------------------------- */
+
+static char* entry_path(const img_cache *cache, uint64_t source, uint64_t fingerprint)
+{
+    size_t len = strlen(cache->disk_dir) + 1 + 32 + sizeof(IMG_CACHE_SUFFIX);
+    char *path = (char *)malloc(len);
+    if (path) {
+        snprintf(path, len, "%s/%016llx%016llx%s", cache->disk_dir, (unsigned long long)source,
+                 (unsigned long long)fingerprint, IMG_CACHE_SUFFIX);
+    }
+    return path;
+}
+
+static void destroy_mapped(img_storage *s)
+{
+    munmap(s->data, s->size);
+    img_storage_free_header(s);
+}
+
+// Maps a disk entry; NULL when it is absent or does not match the key
+static Image* disk_read(const img_cache *cache, uint64_t source, uint64_t fingerprint)
+{
+    char *path = entry_path(cache, source, fingerprint);
+    if (!path) return NULL;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    free(path);
+    if (fd < 0) return NULL;
+
+    void *data = MAP_FAILED;
+    size_t size = 0;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && (size_t)st.st_size > sizeof(img_cache_header)) {
+        size = (size_t)st.st_size;
+        data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+
+    // The pixel count is compared by division so that forged dimensions cannot wrap it
+    const img_cache_header *h = (const img_cache_header *)data;
+    size_t count = (size - sizeof(img_cache_header)) / sizeof(pixel);
+    if (memcmp(h->magic, IMG_CACHE_MAGIC, sizeof(h->magic)) != 0 || h->source != source ||
+        h->fingerprint != fingerprint || h->width == 0 || h->height == 0 || h->width > INT32_MAX ||
+        h->height > INT32_MAX || (size - sizeof(img_cache_header)) % sizeof(pixel) != 0 ||
+        count % h->width != 0 || count / h->width != h->height) {
+        munmap(data, size);
+        return NULL;
+    }
+    madvise(data, size, MADV_WILLNEED);
+
+    img_storage *storage = img_storage_wrap(data, size, destroy_mapped, NULL);
+    if (!storage) {
+        munmap(data, size);
+        return NULL;
+    }
+    pixel *pixels = (pixel *)((unsigned char *)data + sizeof(img_cache_header));
+    Image *img = img_handle_new(storage, pixels, (int)h->width, (int)h->height, (int)h->width);
+    img_storage_release(storage); // The handle holds the only reference now
+    return img;
+}
+
+// Writes a disk entry under a temporary name and renames it into place
+static void disk_write(img_cache *cache, uint64_t source, uint64_t fingerprint, const Image *img)
+{
+    char *path = entry_path(cache, source, fingerprint);
+    if (!path) return;
+
+    size_t len = strlen(path) + 32;
+    char *temp = (char *)malloc(len);
+    if (!temp) {
+        free(path);
+        return;
+    }
+    snprintf(temp, len, "%s.tmp.%ld.%u", path, (long)getpid(),
+             atomic_fetch_add_explicit(&cache->temp_seq, 1, memory_order_relaxed));
+
+    img_cache_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, IMG_CACHE_MAGIC, sizeof(h.magic));
+    h.width = (uint32_t)img->width;
+    h.height = (uint32_t)img->height;
+    h.source = source;
+    h.fingerprint = fingerprint;
+
+    FILE *fp = fopen(temp, "wb");
+    int ok = fp && fwrite(&h, sizeof(h), 1, fp) == 1;
+    for (int y = 0; ok && y < img->height; y++) {
+        ok = fwrite(img_row(img, y), sizeof(pixel), (size_t)img->width, fp) == (size_t)img->width;
+    }
+    if (fp && fclose(fp) != 0) ok = 0;
+
+    if (ok && rename(temp, path) == 0) {
+        atomic_fetch_add_explicit(&cache->disk_writes, 1, memory_order_relaxed);
+    } else if (fp) {
+        unlink(temp);
+    }
+    free(temp);
+    free(path);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+img_cache_options img_cache_defaults(void)
+{
+    img_cache_options opts = {
+        .memory_bytes = 0,
+        .disk_dir = NULL,
+        .key = IMG_CACHE_KEY_STAT,
+    };
+    return opts;
+}
+
+img_cache* img_cache_new(const img_cache_options *opts)
+{
+    img_cache_options defaults = img_cache_defaults();
+    if (!opts) opts = &defaults;
+
+    if (opts->disk_dir && mkdir(opts->disk_dir, 0755) != 0 && errno != EEXIST) return NULL;
+
+    img_cache *cache = (img_cache *)img_pool_alloc(sizeof(img_cache));
+    if (!cache) return NULL;
+    memset(cache, 0, sizeof(*cache));
+
+    cache->budget = opts->memory_bytes ? opts->memory_bytes : CACHE_DEFAULT_BYTES;
+    cache->key = opts->key;
+    cache->bucket_count = CACHE_MIN_BUCKETS;
+    cache->buckets = (cache_entry **)calloc(cache->bucket_count, sizeof(cache_entry *));
+    cache->disk_dir = opts->disk_dir ? strdup(opts->disk_dir) : NULL;
+    if (!cache->buckets || (opts->disk_dir && !cache->disk_dir)) {
+        free(cache->buckets);
+        free(cache->disk_dir);
+        img_pool_free(cache);
+        return NULL;
+    }
+    pthread_mutex_init(&cache->lock, NULL);
+    atomic_init(&cache->temp_seq, 0);
+    atomic_init(&cache->memory_hits, 0);
+    atomic_init(&cache->disk_hits, 0);
+    atomic_init(&cache->misses, 0);
+    atomic_init(&cache->evictions, 0);
+    atomic_init(&cache->disk_writes, 0);
+    return cache;
+}
+
+void img_cache_free(img_cache *cache)
+{
+    if (!cache) return;
+
+    while (cache->tail) remove_entry(cache, cache->tail);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->buckets);
+    free(cache->disk_dir);
+    img_pool_free(cache);
+}
+
+Image* img_cache_get(img_cache *cache, const char *filename, uint64_t fingerprint,
+                     img_cache_fill_fn fill, void *ctx)
+{
+    if (!cache || !filename || !fill) return NULL;
+    IMG_TRACE_SCOPE("img_cache_get");
+
+    uint64_t source;
+    if (source_id(cache, filename, &source) != RET_SUCCESS) return NULL;
+
+    pthread_mutex_lock(&cache->lock);
+    cache_entry *e = find(cache, source, fingerprint);
+    if (e) {
+        lru_unlink(cache, e);
+        lru_push_front(cache, e);
+        Image *out = share(e->img);
+        pthread_mutex_unlock(&cache->lock);
+        atomic_fetch_add_explicit(&cache->memory_hits, 1, memory_order_relaxed);
+        return out;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    Image *img = cache->disk_dir ? disk_read(cache, source, fingerprint) : NULL;
+    if (img) {
+        atomic_fetch_add_explicit(&cache->disk_hits, 1, memory_order_relaxed);
+    } else {
+        atomic_fetch_add_explicit(&cache->misses, 1, memory_order_relaxed);
+        img = fill(ctx, filename);
+        if (!img) return NULL;
+        if (!img->storage) {
+            // Borrowed pixels cannot be shared beyond the caller's lifetime
+            Image *copy = img_copy(img);
+            img_free(img);
+            if (!(img = copy)) return NULL;
+        }
+        if (cache->disk_dir) disk_write(cache, source, fingerprint, img);
+    }
+    IMG_TRACE_COUNT(IMG_TRACE_PIXELS, (size_t)img->width * img->height);
+    return insert(cache, source, fingerprint, img);
+}
+
+typedef struct {
+    const img_transform *t;
+    img_filter filter;
+} load_ctx;
+
+static Image* load_fill(void *opaque, const char *filename)
+{
+    const load_ctx *ctx = (const load_ctx *)opaque;
+
+    Image *img = img_load(filename);
+    if (!img || !ctx->t) return img;
+
+    Image *out = img_transform_render(ctx->t, img, ctx->filter);
+    img_free(img);
+    return out;
+}
+
+Image* img_cache_load(img_cache *cache, const char *filename, const img_transform *t, img_filter filter)
+{
+    load_ctx ctx = { t, filter };
+    return img_cache_get(cache, filename, img_transform_fingerprint(t, filter), load_fill, &ctx);
+}
+
+int img_cache_clear(img_cache *cache)
+{
+    if (!cache) return RET_FAIL;
+
+    pthread_mutex_lock(&cache->lock);
+    while (cache->tail) remove_entry(cache, cache->tail);
+    pthread_mutex_unlock(&cache->lock);
+    if (!cache->disk_dir) return RET_SUCCESS;
+
+    DIR *d = opendir(cache->disk_dir);
+    if (!d) return RET_FAIL;
+
+    // Entries and leftover temporary files both carry the suffix
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        if (!strstr(entry->d_name, IMG_CACHE_SUFFIX)) continue;
+        size_t len = strlen(cache->disk_dir) + strlen(entry->d_name) + 2;
+        char *path = (char *)malloc(len);
+        if (!path) continue;
+        snprintf(path, len, "%s/%s", cache->disk_dir, entry->d_name);
+        unlink(path);
+        free(path);
+    }
+    closedir(d);
+    return RET_SUCCESS;
+}
+
+void img_cache_get_stats(img_cache *cache, img_cache_stats *stats)
+{
+    stats->memory_hits = atomic_load_explicit(&cache->memory_hits, memory_order_relaxed);
+    stats->disk_hits = atomic_load_explicit(&cache->disk_hits, memory_order_relaxed);
+    stats->misses = atomic_load_explicit(&cache->misses, memory_order_relaxed);
+    stats->evictions = atomic_load_explicit(&cache->evictions, memory_order_relaxed);
+    stats->disk_writes = atomic_load_explicit(&cache->disk_writes, memory_order_relaxed);
+
+    pthread_mutex_lock(&cache->lock);
+    stats->memory_bytes = cache->used;
+    stats->entries = cache->entries;
+    pthread_mutex_unlock(&cache->lock);
+}
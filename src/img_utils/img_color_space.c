@@ -0,0 +1,510 @@
+/**
+ * Colour space conversions.
+ *
+ * YCbCr and gray conversions are affine maps of the three channels. Each is
+ * resolved once into 13-bit fixed-point weights and evaluated with pmaddwd
+ * on channel pairs: (in0, in1) and (in2, a constant) whose weight carries
+ * the offset and the rounding. The weights of the forward luma rows are
+ * adjusted to sum exactly to the range's scale, and those of the chroma rows
+ * to zero, so black and white map exactly and grays carry no chroma. HSV
+ * follows the usual 8-bit integer formulation with division tables,
+ * gathered by the AVX2 kernel. All kernels compute the same integers, so
+ * every CPU level gives identical results.
+ */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define IMG_COLOR_X86 1
+#endif
+
+#include "../../include/img_utils.h"
+#include "../../internal/img_utils/internal_img_color_space.h"
+#include "../../internal/img_utils/internal_img_cpu.h"
+#include "../../internal/img_utils/internal_img_trace.h"
+#include "../../internal/thread/parallel.h"
+
+
+#define COLOR_UNIT (1 << IMG_COLOR_SHIFT)
+
+// Fractional bits of the HSV division tables
+#define HSV_SHIFT 12
+
+// (255 << HSV_SHIFT) / v and (256 << HSV_SHIFT) / (6 * diff), rounded; 0 at 0
+static int32_t hsv_sdiv[256];
+static int32_t hsv_hdiv[256];
+
+// Luma coefficients of red and blue; green is 1 - kr - kb
+typedef struct {
+    double kr, kb;
+    int limited;
+} ycbcr_def;
+
+static const ycbcr_def ycbcr_defs[] = {
+    [IMG_COLOR_GRAY] = { 0.299, 0.114, 0 },
+    [IMG_COLOR_YCBCR_601] = { 0.299, 0.114, 0 },
+    [IMG_COLOR_YCBCR_601_LIMITED] = { 0.299, 0.114, 1 },
+    [IMG_COLOR_YCBCR_709] = { 0.2126, 0.0722, 0 },
+    [IMG_COLOR_YCBCR_709_LIMITED] = { 0.2126, 0.0722, 1 },
+};
+
+// SIMD kernel bound at startup; returns the pixels it handled, the scalar code does the rest
+static int (*color_kernel)(const img_color_plan *p, const pixel *src, const uint8_t *const in[3], pixel *dst,
+                           uint8_t *const out[3], int n);
+
+/* ------------------------------------------------------------------------- */
+/* Plans                                                                     */
+/* ------------------------------------------------------------------------- */
+
+static int32_t pack_weights(int w0, int w1)
+{
+    return (int32_t)((uint32_t)(uint16_t)w0 | (uint32_t)(uint16_t)w1 << 16);
+}
+
+/*
+ * Sets output c to sum_j w[j] * (in_j - zero[j]) + offset. Weights are
+ * rounded, then the largest is adjusted so they sum to `sum` (in fixed
+ * point) unless sum is NAN. Zero points of 128 are folded exactly through
+ * the IMG_COLOR_ONE lane; the others are rounded together with the offset.
+ */
+static void set_row(img_color_plan *plan, int c, const double w[3], const int zero[3], double offset, double sum)
+{
+    int q[3], largest = 0;
+    for (int j = 0; j < 3; j++) {
+        q[j] = (int)lrint(w[j] * COLOR_UNIT);
+        if (fabs(w[j]) > fabs(w[largest])) largest = j;
+    }
+    if (!isnan(sum)) q[largest] += (int)lrint(sum * COLOR_UNIT) - (q[0] + q[1] + q[2]);
+
+    double rest = offset * COLOR_UNIT + COLOR_UNIT / 2;
+    int bias = 0;
+    for (int j = 0; j < 3; j++) {
+        if (zero[j] == IMG_COLOR_ONE) {
+            bias -= q[j];
+        } else {
+            rest -= (double)q[j] * zero[j];
+        }
+    }
+    bias += (int)lrint(rest / IMG_COLOR_ONE);
+
+    plan->w01[c] = pack_weights(q[0], q[1]);
+    plan->w2k[c] = pack_weights(q[2], bias);
+}
+
+static void plan_ycbcr(img_color_plan *plan, const ycbcr_def *def, int to_rgb)
+{
+    const double kr = def->kr, kb = def->kb, kg = 1.0 - kr - kb;
+    const double sy = def->limited ? 219.0 / 255.0 : 1.0, sc = def->limited ? 224.0 / 255.0 : 1.0;
+    const int y0 = def->limited ? 16 : 0;
+    const double cb_scale = 2.0 * (1.0 - kb), cr_scale = 2.0 * (1.0 - kr);
+
+    if (!to_rgb) {
+        static const int none[3] = { 0, 0, 0 };
+        const double y[3] = { kr * sy, kg * sy, kb * sy };
+        const double cb[3] = { -kr / cb_scale * sc, -kg / cb_scale * sc, (1.0 - kb) / cb_scale * sc };
+        const double cr[3] = { (1.0 - kr) / cr_scale * sc, -kg / cr_scale * sc, -kb / cr_scale * sc };
+        set_row(plan, 0, y, none, y0, sy);
+        set_row(plan, 1, cb, none, 128.0, 0.0);
+        set_row(plan, 2, cr, none, 128.0, 0.0);
+    } else {
+        const int zero[3] = { y0, IMG_COLOR_ONE, IMG_COLOR_ONE };
+        const double r[3] = { 1.0 / sy, 0.0, cr_scale / sc };
+        const double g[3] = { 1.0 / sy, -kb * cb_scale / kg / sc, -kr * cr_scale / kg / sc };
+        const double b[3] = { 1.0 / sy, cb_scale / sc, 0.0 };
+        set_row(plan, 0, r, zero, 0.0, NAN);
+        set_row(plan, 1, g, zero, 0.0, NAN);
+        set_row(plan, 2, b, zero, 0.0, NAN);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* Scalar kernels                                                            */
+/* ------------------------------------------------------------------------- */
+
+static inline uint8_t clamp_u8(int32_t v)
+{
+    return (uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v);
+}
+
+static inline uint8_t matrix_out(const img_color_plan *p, int c, int in0, int in1, int in2)
+{
+    int32_t w = p->w01[c], k = p->w2k[c];
+    int32_t v = (int16_t)w * in0 + (int16_t)(w >> 16) * in1 + (int16_t)k * in2 + (int16_t)(k >> 16) * IMG_COLOR_ONE;
+    return clamp_u8(v >> IMG_COLOR_SHIFT);
+}
+
+static inline void to_hsv(int r, int g, int b, uint8_t out[3])
+{
+    int v = r > g ? r : g, mn = r < g ? r : g;
+    v = b > v ? b : v;
+    mn = b < mn ? b : mn;
+    int diff = v - mn;
+
+    int h = v == r ? g - b : v == g ? b - r + 2 * diff : r - g + 4 * diff;
+    h = (h * hsv_hdiv[diff] + (1 << (HSV_SHIFT - 1))) >> HSV_SHIFT;
+    out[0] = (uint8_t)(h & 255); // A full turn wraps to 0
+    out[1] = (uint8_t)((diff * hsv_sdiv[v] + (1 << (HSV_SHIFT - 1))) >> HSV_SHIFT);
+    out[2] = (uint8_t)v;
+}
+
+// Rounded x / 255 for x up to 255 * 255
+static inline int div255(int x)
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+static inline void hsv_to_rgb(int h, int s, int v, uint8_t out[3])
+{
+    int hh = h * 6, sector = hh >> 8, f = hh & 255;
+    int p = div255(v * (255 - s));
+    int q = div255(v * (255 - ((s * f + 128) >> 8)));
+    int t = div255(v * (255 - ((s * (256 - f) + 128) >> 8)));
+
+    static const int8_t pick[6][3] = { { 0, 3, 1 }, { 2, 0, 1 }, { 1, 0, 3 }, { 1, 2, 0 }, { 3, 1, 0 }, { 0, 1, 2 } };
+    const int values[4] = { v, p, q, t };
+    for (int c = 0; c < 3; c++) out[c] = (uint8_t)values[pick[sector][c]];
+}
+
+static void color_row_scalar(const img_color_plan *p, const pixel *src, const uint8_t *const in[3], pixel *dst,
+                             uint8_t *const out[3], int n)
+{
+    for (int i = 0; i < n; i++) {
+        int c0, c1, c2;
+        unsigned char alpha = 255;
+        if (src) {
+            c0 = src[i].R, c1 = src[i].G, c2 = src[i].B;
+            alpha = src[i].A;
+        } else {
+            c0 = in[0][i];
+            c1 = p->single ? c0 : in[1][i];
+            c2 = p->single ? c0 : in[2][i];
+        }
+
+        uint8_t o[3];
+        switch (p->op) {
+        case IMG_COLOR_OP_MATRIX:
+            for (int c = 0; c < 3; c++) o[c] = matrix_out(p, c, c0, c1, c2);
+            break;
+        case IMG_COLOR_OP_TO_HSV:
+            to_hsv(c0, c1, c2, o);
+            break;
+        default:
+            hsv_to_rgb(c0, c1, c2, o);
+            break;
+        }
+
+        if (dst) {
+            dst[i] = (pixel){ o[0], o[1], o[2], alpha };
+        } else {
+            for (int c = 0; c < 3; c++) {
+                if (out[c]) out[c][i] = o[c];
+            }
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* AVX2 kernels                                                              */
+/* ------------------------------------------------------------------------- */
+
+#ifdef IMG_COLOR_X86
+__attribute__((target("avx2")))
+static inline __m256i clamp_u8_avx2(__m256i v)
+{
+    return _mm256_min_epi32(_mm256_max_epi32(v, _mm256_setzero_si256()), _mm256_set1_epi32(255));
+}
+
+__attribute__((target("avx2")))
+static inline void matrix_avx2(const img_color_plan *p, __m256i c0, __m256i c1, __m256i c2, __m256i o[3])
+{
+    __m256i in01 = _mm256_or_si256(c0, _mm256_slli_epi32(c1, 16));
+    __m256i in2k = _mm256_or_si256(c2, _mm256_set1_epi32(IMG_COLOR_ONE << 16));
+    for (int c = 0; c < 3; c++) {
+        __m256i v = _mm256_add_epi32(_mm256_madd_epi16(in01, _mm256_set1_epi32(p->w01[c])),
+                                     _mm256_madd_epi16(in2k, _mm256_set1_epi32(p->w2k[c])));
+        o[c] = clamp_u8_avx2(_mm256_srai_epi32(v, IMG_COLOR_SHIFT));
+    }
+}
+
+__attribute__((target("avx2")))
+static inline void to_hsv_avx2(__m256i r, __m256i g, __m256i b, __m256i o[3])
+{
+    const __m256i round = _mm256_set1_epi32(1 << (HSV_SHIFT - 1));
+    __m256i v = _mm256_max_epi32(_mm256_max_epi32(r, g), b);
+    __m256i diff = _mm256_sub_epi32(v, _mm256_min_epi32(_mm256_min_epi32(r, g), b));
+    __m256i is_r = _mm256_cmpeq_epi32(v, r), is_g = _mm256_cmpeq_epi32(v, g);
+
+    // Red wins ties over green, green over blue
+    __m256i h_r = _mm256_sub_epi32(g, b);
+    __m256i h_g = _mm256_add_epi32(_mm256_sub_epi32(b, r), _mm256_slli_epi32(diff, 1));
+    __m256i h_b = _mm256_add_epi32(_mm256_sub_epi32(r, g), _mm256_slli_epi32(diff, 2));
+    __m256i h = _mm256_blendv_epi8(_mm256_blendv_epi8(h_b, h_g, is_g), h_r, is_r);
+    h = _mm256_mullo_epi32(h, _mm256_i32gather_epi32(hsv_hdiv, diff, 4));
+    o[0] = _mm256_and_si256(_mm256_srai_epi32(_mm256_add_epi32(h, round), HSV_SHIFT), _mm256_set1_epi32(255));
+    __m256i s = _mm256_mullo_epi32(diff, _mm256_i32gather_epi32(hsv_sdiv, v, 4));
+    o[1] = _mm256_srai_epi32(_mm256_add_epi32(s, round), HSV_SHIFT);
+    o[2] = v;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i div255_avx2(__m256i x)
+{
+    x = _mm256_add_epi32(x, _mm256_set1_epi32(128));
+    return _mm256_srli_epi32(_mm256_add_epi32(x, _mm256_srli_epi32(x, 8)), 8);
+}
+
+__attribute__((target("avx2")))
+static inline void hsv_to_rgb_avx2(__m256i h, __m256i s, __m256i v, __m256i o[3])
+{
+    const __m256i c128 = _mm256_set1_epi32(128), c255 = _mm256_set1_epi32(255), c256 = _mm256_set1_epi32(256);
+    __m256i hh = _mm256_mullo_epi32(h, _mm256_set1_epi32(6));
+    __m256i sector = _mm256_srli_epi32(hh, 8), f = _mm256_and_si256(hh, c255);
+
+    __m256i sf = _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(s, f), c128), 8);
+    __m256i sf1 = _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(s, _mm256_sub_epi32(c256, f)), c128), 8);
+    __m256i p = div255_avx2(_mm256_mullo_epi32(v, _mm256_sub_epi32(c255, s)));
+    __m256i q = div255_avx2(_mm256_mullo_epi32(v, _mm256_sub_epi32(c255, sf)));
+    __m256i t = div255_avx2(_mm256_mullo_epi32(v, _mm256_sub_epi32(c255, sf1)));
+
+    __m256i m[6];
+    for (int k = 0; k < 6; k++) m[k] = _mm256_cmpeq_epi32(sector, _mm256_set1_epi32(k));
+    // Same table as hsv_to_rgb(): each channel is v, p, q or t depending on the sector
+    __m256i r = _mm256_blendv_epi8(p, v, _mm256_or_si256(m[0], m[5]));
+    r = _mm256_blendv_epi8(r, q, m[1]);
+    o[0] = _mm256_blendv_epi8(r, t, m[4]);
+    __m256i g = _mm256_blendv_epi8(p, v, _mm256_or_si256(m[1], m[2]));
+    g = _mm256_blendv_epi8(g, t, m[0]);
+    o[1] = _mm256_blendv_epi8(g, q, m[3]);
+    __m256i b = _mm256_blendv_epi8(p, v, _mm256_or_si256(m[3], m[4]));
+    b = _mm256_blendv_epi8(b, t, m[2]);
+    o[2] = _mm256_blendv_epi8(b, q, m[5]);
+}
+
+// Narrows eight 0-255 lanes to bytes and stores them
+__attribute__((target("avx2")))
+static inline void store_plane_avx2(uint8_t *dst, __m256i v)
+{
+    v = _mm256_packus_epi32(v, v);
+    v = _mm256_packus_epi16(v, v);
+    v = _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0));
+    _mm_storel_epi64((__m128i *)dst, _mm256_castsi256_si128(v));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i load_plane_avx2(const uint8_t *src)
+{
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)src));
+}
+
+__attribute__((target("avx2")))
+static int color_row_avx2(const img_color_plan *p, const pixel *src, const uint8_t *const in[3], pixel *dst,
+                          uint8_t *const out[3], int n)
+{
+    const __m256i low = _mm256_set1_epi32(0xFF), alpha_mask = _mm256_set1_epi32((int)0xFF000000u);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i c0, c1, c2, alpha = alpha_mask;
+        if (src) {
+            __m256i px = _mm256_loadu_si256((const __m256i *)(src + i));
+            c0 = _mm256_and_si256(px, low);
+            c1 = _mm256_and_si256(_mm256_srli_epi32(px, 8), low);
+            c2 = _mm256_and_si256(_mm256_srli_epi32(px, 16), low);
+            alpha = _mm256_and_si256(px, alpha_mask);
+        } else {
+            c0 = load_plane_avx2(in[0] + i);
+            c1 = p->single ? c0 : load_plane_avx2(in[1] + i);
+            c2 = p->single ? c0 : load_plane_avx2(in[2] + i);
+        }
+
+        __m256i o[3];
+        switch (p->op) {
+        case IMG_COLOR_OP_MATRIX:
+            matrix_avx2(p, c0, c1, c2, o);
+            break;
+        case IMG_COLOR_OP_TO_HSV:
+            to_hsv_avx2(c0, c1, c2, o);
+            break;
+        default:
+            hsv_to_rgb_avx2(c0, c1, c2, o);
+            break;
+        }
+
+        if (dst) {
+            __m256i px = _mm256_or_si256(_mm256_or_si256(o[0], _mm256_slli_epi32(o[1], 8)),
+                                         _mm256_or_si256(_mm256_slli_epi32(o[2], 16), alpha));
+            _mm256_storeu_si256((__m256i *)(dst + i), px);
+        } else {
+            for (int c = 0; c < 3; c++) {
+                if (out[c]) store_plane_avx2(out[c] + i, o[c]);
+            }
+        }
+    }
+    return i;
+}
+#endif
+
+__attribute__((constructor))
+static void bind_kernels(void)
+{
+    for (int i = 1; i < 256; i++) {
+        hsv_sdiv[i] = (int32_t)lrint((double)(255 << HSV_SHIFT) / i);
+        hsv_hdiv[i] = (int32_t)lrint((double)(256 << HSV_SHIFT) / (6.0 * i));
+    }
+#ifdef IMG_COLOR_X86
+    if (img_cpu_get_level() >= IMG_CPU_AVX2) color_kernel = color_row_avx2;
+#endif
+}
+
+static void color_row_any(const img_color_plan *p, const pixel *src, const uint8_t *const in[3], pixel *dst,
+                          uint8_t *const out[3], int n)
+{
+    int done = color_kernel ? color_kernel(p, src, in, dst, out, n) : 0;
+    if (done == n) return;
+
+    const uint8_t *in_rest[3] = { NULL, NULL, NULL };
+    uint8_t *out_rest[3] = { NULL, NULL, NULL };
+    for (int c = 0; c < 3; c++) {
+        if (in && in[c]) in_rest[c] = in[c] + done;
+        if (out && out[c]) out_rest[c] = out[c] + done;
+    }
+    color_row_scalar(p, src ? src + done : NULL, in_rest, dst ? dst + done : NULL, out_rest, n - done);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Row kernels                                                               */
+/* ------------------------------------------------------------------------- */
+
+int img_color_plan_init(img_color_plan *plan, img_color_space space, int to_rgb)
+{
+    memset(plan, 0, sizeof(*plan));
+    switch (space) {
+    case IMG_COLOR_GRAY:
+        if (to_rgb) {
+            // Y is read from the first input into all three outputs
+            static const double first[3] = { 1.0, 0.0, 0.0 };
+            static const int none[3] = { 0, 0, 0 };
+            for (int c = 0; c < 3; c++) set_row(plan, c, first, none, 0.0, 1.0);
+            plan->single = 1;
+        } else {
+            plan_ycbcr(plan, &ycbcr_defs[space], 0);
+            plan->w01[1] = plan->w01[2] = plan->w01[0];
+            plan->w2k[1] = plan->w2k[2] = plan->w2k[0];
+        }
+        break;
+    case IMG_COLOR_YCBCR_601:
+    case IMG_COLOR_YCBCR_601_LIMITED:
+    case IMG_COLOR_YCBCR_709:
+    case IMG_COLOR_YCBCR_709_LIMITED:
+        plan_ycbcr(plan, &ycbcr_defs[space], to_rgb);
+        break;
+    case IMG_COLOR_HSV:
+        plan->op = to_rgb ? IMG_COLOR_OP_HSV_RGB : IMG_COLOR_OP_TO_HSV;
+        break;
+    default:
+        return RET_FAIL;
+    }
+    return RET_SUCCESS;
+}
+
+void img_color_row(const img_color_plan *plan, const pixel *src, pixel *dst, int n)
+{
+    color_row_any(plan, src, NULL, dst, NULL, n);
+}
+
+void img_color_row_to_planes(const img_color_plan *plan, const pixel *src, uint8_t *const planes[3], int n)
+{
+    color_row_any(plan, src, NULL, NULL, planes, n);
+}
+
+void img_color_row_from_planes(const img_color_plan *plan, const uint8_t *const planes[3], pixel *dst, int n)
+{
+    color_row_any(plan, NULL, planes, dst, NULL, n);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+typedef struct {
+    img_color_plan plan;
+    const Image *src;
+    Image *dst;
+    const uint8_t *const *in;
+    uint8_t *const *out;
+    size_t stride;
+    int width;
+} convert_ctx;
+
+// Converts rows [begin, end) between whichever of pixels and planes the context holds
+static void convert_rows(void *opaque, int begin, int end)
+{
+    const convert_ctx *ctx = (const convert_ctx *)opaque;
+    for (int y = begin; y < end; y++) {
+        const uint8_t *in[3] = { NULL, NULL, NULL };
+        uint8_t *out[3] = { NULL, NULL, NULL };
+        for (int c = 0; c < 3; c++) {
+            if (ctx->in && ctx->in[c]) in[c] = ctx->in[c] + (size_t)y * ctx->stride;
+            if (ctx->out && ctx->out[c]) out[c] = ctx->out[c] + (size_t)y * ctx->stride;
+        }
+        color_row_any(&ctx->plan, ctx->src ? img_row(ctx->src, y) : NULL, in, ctx->dst ? img_row(ctx->dst, y) : NULL,
+                      out, ctx->width);
+    }
+}
+
+static int convert_pixels(const Image *src, Image *dst, img_color_space space, int to_rgb)
+{
+    if (!src || !src->pixels || !dst || !dst->pixels) return RET_FAIL;
+    if (src->width != dst->width || src->height != dst->height) return RET_FAIL;
+
+    convert_ctx ctx = { .src = src, .dst = dst, .width = src->width };
+    if (img_color_plan_init(&ctx.plan, space, to_rgb) != RET_SUCCESS) return RET_FAIL;
+    img_parallel_for(src->height, img_parallel_grain(src->width), convert_rows, &ctx);
+    return RET_SUCCESS;
+}
+
+int img_rgb_to_color(const Image *src, Image *dst, img_color_space space)
+{
+    IMG_TRACE_SCOPE("img_rgb_to_color");
+    if (src) IMG_TRACE_COUNT(IMG_TRACE_PIXELS, (size_t)src->width * src->height);
+    return convert_pixels(src, dst, space, 0);
+}
+
+int img_color_to_rgb(const Image *src, Image *dst, img_color_space space)
+{
+    IMG_TRACE_SCOPE("img_color_to_rgb");
+    if (src) IMG_TRACE_COUNT(IMG_TRACE_PIXELS, (size_t)src->width * src->height);
+    return convert_pixels(src, dst, space, 1);
+}
+
+int img_rgb_to_color_planes(const Image *src, img_color_space space, uint8_t *const planes[3], size_t stride)
+{
+    if (!src || !src->pixels || !planes || stride < (size_t)src->width) return RET_FAIL;
+    IMG_TRACE_SCOPE("img_rgb_to_color_planes");
+    IMG_TRACE_COUNT(IMG_TRACE_PIXELS, (size_t)src->width * src->height);
+
+    // Gray has one plane
+    uint8_t *out[3] = { planes[0], space == IMG_COLOR_GRAY ? NULL : planes[1],
+                        space == IMG_COLOR_GRAY ? NULL : planes[2] };
+    convert_ctx ctx = { .src = src, .out = out, .stride = stride, .width = src->width };
+    if (img_color_plan_init(&ctx.plan, space, 0) != RET_SUCCESS) return RET_FAIL;
+    img_parallel_for(src->height, img_parallel_grain(src->width), convert_rows, &ctx);
+    return RET_SUCCESS;
+}
+
+int img_color_planes_to_rgb(const uint8_t *const planes[3], size_t stride, img_color_space space, Image *dst)
+{
+    if (!planes || !planes[0] || !dst || !dst->pixels || stride < (size_t)dst->width) return RET_FAIL;
+    if (space != IMG_COLOR_GRAY && (!planes[1] || !planes[2])) return RET_FAIL;
+    IMG_TRACE_SCOPE("img_color_planes_to_rgb");
+    IMG_TRACE_COUNT(IMG_TRACE_PIXELS, (size_t)dst->width * dst->height);
+
+    const uint8_t *in[3] = { planes[0], space == IMG_COLOR_GRAY ? NULL : planes[1],
+                             space == IMG_COLOR_GRAY ? NULL : planes[2] };
+    convert_ctx ctx = { .dst = dst, .in = in, .stride = stride, .width = dst->width };
+    if (img_color_plan_init(&ctx.plan, space, 1) != RET_SUCCESS) return RET_FAIL;
+    img_parallel_for(dst->height, img_parallel_grain(dst->width), convert_rows, &ctx);
+    return RET_SUCCESS;
+}
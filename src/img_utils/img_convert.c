@@ -0,0 +1,218 @@
+/**
+ * Sample layout conversion kernels.
+ *
+ * All kernels work on one row at a time. The SIMD variants, bound once at
+ * startup, handle the bulk of the row and leave the last few pixels to the
+ * scalar loop.
+ */
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define IMG_CONVERT_X86 1
+#endif
+
+#include "../../include/img_utils.h"
+#include "../../internal/img_utils/internal_img_convert.h"
+#include "../../internal/img_utils/internal_img_cpu.h"
+
+
+// SIMD kernels bound at startup; NULL leaves the whole row to the scalar loop
+static int (*gray_kernel)(const uint8_t *src, pixel *dst, int n);
+static int (*gray_alpha_kernel)(const uint8_t *src, pixel *dst, int n);
+static int (*rgb_kernel)(const uint8_t *src, pixel *dst, int n);
+static int (*palette_kernel)(const uint8_t *idx, const pixel *lut, pixel *dst, int n);
+static size_t (*narrow16_kernel)(const uint8_t *src, uint8_t *dst, size_t n);
+
+/* ------------------------------------------------------------------------- */
+/* Gray                                                                      */
+/* ------------------------------------------------------------------------- */
+
+#ifdef IMG_CONVERT_X86
+__attribute__((target("sse2")))
+static int gray_sse2(const uint8_t *src, pixel *dst, int n)
+{
+    const __m128i opaque = _mm_set1_epi32((int)0xFF000000u);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i g = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i lo = _mm_unpacklo_epi8(g, g);
+        __m128i hi = _mm_unpackhi_epi8(g, g);
+        __m128i *out = (__m128i *)(dst + i);
+        _mm_storeu_si128(out + 0, _mm_or_si128(_mm_unpacklo_epi16(lo, lo), opaque));
+        _mm_storeu_si128(out + 1, _mm_or_si128(_mm_unpackhi_epi16(lo, lo), opaque));
+        _mm_storeu_si128(out + 2, _mm_or_si128(_mm_unpacklo_epi16(hi, hi), opaque));
+        _mm_storeu_si128(out + 3, _mm_or_si128(_mm_unpackhi_epi16(hi, hi), opaque));
+    }
+    return i;
+}
+
+__attribute__((target("ssse3")))
+static int gray_alpha_ssse3(const uint8_t *src, pixel *dst, int n)
+{
+    const __m128i lo_mask = _mm_setr_epi8(0, 0, 0, 1, 2, 2, 2, 3, 4, 4, 4, 5, 6, 6, 6, 7);
+    const __m128i hi_mask = _mm_setr_epi8(8, 8, 8, 9, 10, 10, 10, 11, 12, 12, 12, 13, 14, 14, 14, 15);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+        __m128i *out = (__m128i *)(dst + i);
+        _mm_storeu_si128(out + 0, _mm_shuffle_epi8(v, lo_mask));
+        _mm_storeu_si128(out + 1, _mm_shuffle_epi8(v, hi_mask));
+    }
+    return i;
+}
+
+__attribute__((target("ssse3")))
+static int rgb_ssse3(const uint8_t *src, pixel *dst, int n)
+{
+    const __m128i mask = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i opaque = _mm_set1_epi32((int)0xFF000000u);
+    int i = 0;
+    // Each load covers 4 pixels plus 4 bytes past them, so stop while a full load still fits
+    for (; i + 18 <= n; i += 16) {
+        const uint8_t *s = src + 3 * i;
+        __m128i *out = (__m128i *)(dst + i);
+        for (int k = 0; k < 4; k++) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(s + 12 * k));
+            _mm_storeu_si128(out + k, _mm_or_si128(_mm_shuffle_epi8(v, mask), opaque));
+        }
+    }
+    return i;
+}
+#endif
+
+void img_cvt_gray_to_rgba(const uint8_t *src, pixel *dst, int n)
+{
+    int i = 0;
+    if (gray_kernel) i = gray_kernel(src, dst, n);
+    for (; i < n; i++) {
+        dst[i].R = dst[i].G = dst[i].B = src[i];
+        dst[i].A = 255;
+    }
+}
+
+void img_cvt_gray_alpha_to_rgba(const uint8_t *src, pixel *dst, int n)
+{
+    int i = 0;
+    if (gray_alpha_kernel) i = gray_alpha_kernel(src, dst, n);
+    for (; i < n; i++) {
+        dst[i].R = dst[i].G = dst[i].B = src[2 * i];
+        dst[i].A = src[2 * i + 1];
+    }
+}
+
+void img_cvt_rgb_to_rgba(const uint8_t *src, pixel *dst, int n)
+{
+    int i = 0;
+    if (rgb_kernel) i = rgb_kernel(src, dst, n);
+    for (; i < n; i++) {
+        dst[i].R = src[3 * i];
+        dst[i].G = src[3 * i + 1];
+        dst[i].B = src[3 * i + 2];
+        dst[i].A = 255;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* Palette                                                                   */
+/* ------------------------------------------------------------------------- */
+
+#ifdef IMG_CONVERT_X86
+__attribute__((target("avx2")))
+static int palette_avx2(const uint8_t *idx, const pixel *lut, pixel *dst, int n)
+{
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i k = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(idx + i)));
+        __m256i v = _mm256_i32gather_epi32((const int *)lut, k, 4);
+        _mm256_storeu_si256((__m256i *)(dst + i), v);
+    }
+    return i;
+}
+#endif
+
+void img_cvt_palette_to_rgba(const uint8_t *idx, const pixel *lut, pixel *dst, int n)
+{
+    int i = 0;
+    if (palette_kernel) i = palette_kernel(idx, lut, dst, n);
+    for (; i < n; i++) {
+        dst[i] = lut[idx[i]];
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* Bit depth                                                                 */
+/* ------------------------------------------------------------------------- */
+
+// round(v / 257) for v = hi * 256 + lo is hi, nudged by one when lo - hi passes +-128
+static inline uint8_t narrow16(uint8_t hi, uint8_t lo)
+{
+    int d = lo - hi;
+    return (uint8_t)(hi + (d > 128) - (d < -128));
+}
+
+#ifdef IMG_CONVERT_X86
+__attribute__((target("sse2")))
+static size_t narrow16_sse2(const uint8_t *src, uint8_t *dst, size_t n)
+{
+    const __m128i low = _mm_set1_epi16(0xFF);
+    const __m128i pos = _mm_set1_epi16(128);
+    const __m128i neg = _mm_set1_epi16(-128);
+    size_t i = 0;
+    // Writes trail the reads, so dst may alias src
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + 2 * i + 16));
+        __m128i r[2];
+        for (int k = 0; k < 2; k++) {
+            __m128i v = k ? b : a;
+            __m128i hi = _mm_and_si128(v, low); // Big-endian: the high byte comes first
+            __m128i lo = _mm_srli_epi16(v, 8);
+            __m128i d = _mm_sub_epi16(lo, hi);
+            r[k] = _mm_add_epi16(_mm_sub_epi16(hi, _mm_cmpgt_epi16(d, pos)), _mm_cmplt_epi16(d, neg));
+        }
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(r[0], r[1]));
+    }
+    return i;
+}
+#endif
+
+void img_cvt_narrow16(const uint8_t *src, uint8_t *dst, size_t n)
+{
+    size_t i = 0;
+    if (narrow16_kernel) i = narrow16_kernel(src, dst, n);
+    for (; i < n; i++) {
+        dst[i] = narrow16(src[2 * i], src[2 * i + 1]);
+    }
+}
+
+__attribute__((constructor))
+static void bind_kernels(void)
+{
+#ifdef IMG_CONVERT_X86
+    img_cpu_level cpu = img_cpu_get_level();
+    if (cpu >= IMG_CPU_SSE2) {
+        gray_kernel = gray_sse2;
+        narrow16_kernel = narrow16_sse2;
+    }
+    if (cpu >= IMG_CPU_SSSE3) {
+        gray_alpha_kernel = gray_alpha_ssse3;
+        rgb_kernel = rgb_ssse3;
+    }
+    if (cpu >= IMG_CPU_AVX2) palette_kernel = palette_avx2;
+#endif
+}
+
+void img_cvt_unpack_bits(const uint8_t *src, uint8_t *dst, int n, int depth, int scale)
+{
+    const int per_byte = 8 / depth;
+    const int mask = (1 << depth) - 1;
+
+    for (int i = 0; i < n; i += per_byte) {
+        int byte = src[i / per_byte];
+        int count = n - i < per_byte ? n - i : per_byte;
+        for (int k = 0; k < count; k++) {
+            dst[i + k] = (uint8_t)(((byte >> (8 - depth * (k + 1))) & mask) * scale);
+        }
+    }
+}
@@ -0,0 +1,96 @@
+/**
+ * CPU feature detection.
+ *
+ * Features are read with cpuid. The AVX levels also need the operating system
+ * to save the wider registers on context switches, which xgetbv reports.
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define IMG_CPU_X86 1
+#endif
+
+#include "../../include/img_utils.h"
+#include "../../internal/img_utils/internal_img_cpu.h"
+
+
+static const char *level_names[] = { "scalar", "sse2", "ssse3", "avx2", "avx512" };
+
+static img_cpu_level cpu_level;
+static pthread_once_t cpu_once = PTHREAD_ONCE_INIT;
+
+#ifdef IMG_CPU_X86
+// XCR0, the register state the operating system saves
+static unsigned long long read_xcr0(void)
+{
+    unsigned int lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((unsigned long long)hi << 32) | lo;
+}
+
+static img_cpu_level detect(void)
+{
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return IMG_CPU_SCALAR;
+
+    img_cpu_level level = IMG_CPU_SCALAR;
+    if (!(edx & bit_SSE2)) return level;
+    level = IMG_CPU_SSE2;
+    if (!(ecx & bit_SSSE3)) return level;
+    level = IMG_CPU_SSSE3;
+
+    // AVX registers need OSXSAVE and the XMM and YMM state enabled; the AVX2
+    // kernels also use FMA, which every AVX2 CPU has in practice
+    if (!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX) || !(ecx & bit_FMA)) return level;
+    unsigned long long xcr0 = read_xcr0();
+    if ((xcr0 & 0x6) != 0x6) return level;
+
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) || !(ebx & bit_AVX2)) return level;
+    level = IMG_CPU_AVX2;
+
+    // AVX-512 additionally needs the opmask and both halves of the ZMM state
+    const unsigned int avx512 = bit_AVX512F | bit_AVX512BW | bit_AVX512VL;
+    if ((ebx & avx512) == avx512 && (xcr0 & 0xE0) == 0xE0) level = IMG_CPU_AVX512;
+    return level;
+}
+#else
+static img_cpu_level detect(void)
+{
+    return IMG_CPU_SCALAR;
+}
+#endif
+
+static void init_level(void)
+{
+    cpu_level = detect();
+
+    const char *cap = getenv(IMG_CPU_ENV);
+    if (!cap || !*cap) return;
+    for (int i = 0; i <= IMG_CPU_AVX512; i++) {
+        if (strcmp(cap, level_names[i]) == 0) {
+            if ((img_cpu_level)i < cpu_level) cpu_level = (img_cpu_level)i;
+            return;
+        }
+    }
+    fprintf(stderr, "Ignoring unknown %s value: %s\n", IMG_CPU_ENV, cap);
+}
+
+img_cpu_level img_cpu_get_level(void)
+{
+    pthread_once(&cpu_once, init_level);
+    return cpu_level;
+}
+
+const char* img_cpu_level_name(img_cpu_level level)
+{
+    return level >= IMG_CPU_SCALAR && level <= IMG_CPU_AVX512 ? level_names[level] : "unknown";
+}
+
+const char* img_cpu_kernels(void)
+{
+    return img_cpu_level_name(img_cpu_get_level());
+}
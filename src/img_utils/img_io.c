@@ -1,24 +1,136 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <strings.h>
 
+#include "../../internal/img_utils/internal_img_bmp.h"
 #include "../../internal/img_utils/internal_img_io.h"
+#include "../../internal/img_utils/internal_img_pnm.h"
+#include "../../internal/img_utils/internal_img_trace.h"
 
 
-// Function to load a PNG image
+img_format img_io_sniff_mem(const void *data, size_t size)
+{
+    const unsigned char *magic = (const unsigned char *)data;
+    if (size < 2) return IMG_FORMAT_PNG;
+    if (magic[0] == 'P' && (magic[1] == '5' || magic[1] == '6')) return IMG_FORMAT_PPM;
+    if (magic[0] == 'P' && magic[1] == '7') return IMG_FORMAT_PAM;
+    if (magic[0] == 'B' && magic[1] == 'M') return IMG_FORMAT_BMP;
+    return IMG_FORMAT_PNG;
+}
+
+img_format img_io_sniff(FILE *fp)
+{
+    unsigned char magic[2];
+    size_t n = fread(magic, 1, sizeof(magic), fp);
+    rewind(fp);
+    return img_io_sniff_mem(magic, n);
+}
+
+img_format img_io_format_for_name(const char *filename)
+{
+    const char *dot = strrchr(filename, '.');
+    if (!dot || strchr(dot, '/')) return IMG_FORMAT_PNG;
+    if (strcasecmp(dot, ".ppm") == 0) return IMG_FORMAT_PPM;
+    if (strcasecmp(dot, ".pam") == 0) return IMG_FORMAT_PAM;
+    if (strcasecmp(dot, ".bmp") == 0) return IMG_FORMAT_BMP;
+    return IMG_FORMAT_PNG;
+}
+
+// Function to load an image, choosing the decoder from the magic bytes
 Image* img_io_load(const char *filename)
 {
-    
+    IMG_TRACE_SCOPE("img_io_load");
     FILE *fp = fopen(filename, "rb");
     if (!fp) return NULL; // File could not be opened
 
-    Image *image = img_png_open(fp);
+    Image *image;
+    if (img_io_sniff(fp) != IMG_FORMAT_PNG) {
+        image = img_raw_open(fp);
+    } else {
+        image = img_png_open(fp);
+        IMG_TRACE_COUNT(IMG_TRACE_BYTES_READ, ftell(fp));
+    }
 
     fclose(fp);
 
     return image;
 }
 
+Image* img_io_load_mem(const void *data, size_t size)
+{
+    IMG_TRACE_SCOPE("img_io_load_mem");
+    if (!data) return NULL;
+
+    Image *image = img_io_sniff_mem(data, size) != IMG_FORMAT_PNG ? img_raw_open_mem(data, size)
+                                                                  : img_png_open_mem(data, size);
+    if (image) IMG_TRACE_COUNT(IMG_TRACE_BYTES_READ, size);
+    return image;
+}
+
+img_packed* img_io_load_packed(const char *filename)
+{
+    IMG_TRACE_SCOPE("img_io_load_packed");
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) return NULL; // File could not be opened
+
+    img_packed *image;
+    if (img_io_sniff(fp) != IMG_FORMAT_PNG) {
+        image = img_raw_open_packed(fp);
+    } else {
+        image = img_png_open_packed(fp);
+        IMG_TRACE_COUNT(IMG_TRACE_BYTES_READ, ftell(fp));
+    }
+
+    fclose(fp);
+
+    return image;
+}
+
+int img_io_read_rows(const char *filename, img_header_fn header, img_row_sink sink, void *ctx)
+{
+    IMG_TRACE_SCOPE("img_io_read_rows");
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) return RET_FAIL; // File could not be opened
+
+    int ret;
+    if (img_io_sniff(fp) != IMG_FORMAT_PNG) {
+        ret = img_raw_read_rows(fp, header, sink, ctx);
+    } else {
+        ret = img_png_read_rows(fp, header, sink, ctx);
+        IMG_TRACE_COUNT(IMG_TRACE_BYTES_READ, ftell(fp));
+    }
+
+    fclose(fp);
+
+    return ret;
+}
+
 void img_io_write(const char *filename, Image *img)
 {
-    img_png_write(filename, img);
+    img_io_write_opts(filename, img, NULL);
+}
+
+int img_io_write_opts(const char *filename, const Image *img, const img_write_options *opts)
+{
+    if (!filename || !img || !img->pixels) return RET_FAIL;
+
+    img_format format = img_io_format_for_name(filename);
+    if (format == IMG_FORMAT_PNG) return img_png_write_opts(filename, img, opts);
+
+    FILE *fp = fopen(filename, "wb");
+    if (!fp) {
+        fprintf(stderr, "Could not open file %s for writing.\n", filename);
+        return RET_FAIL;
+    }
+
+    int ret;
+    switch (format) {
+    case IMG_FORMAT_PPM: ret = img_ppm_write(fp, img); break;
+    case IMG_FORMAT_BMP: ret = img_bmp_write(fp, img); break;
+    default: ret = img_pam_write(fp, img); break;
+    }
+
+    if (fclose(fp) != 0) ret = RET_FAIL;
+    return ret;
 }
@@ -0,0 +1,368 @@
+/**
+ * Interleaved/planar layout and element type kernels.
+ *
+ * Like the decode conversions, every kernel works on one row at a time; the
+ * SIMD variants, bound once at startup, handle the bulk and return how many
+ * pixels (or samples) they covered, and a scalar loop finishes the rest.
+ * The 4-channel splits group each pixel's channels with a byte shuffle and
+ * finish with a 4x4 transpose of 32-bit lanes; the 3-channel ones combine
+ * three byte shuffles per output register.
+ */
+#include <math.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define IMG_LAYOUT_X86 1
+#endif
+
+#include "../../include/img_utils.h"
+#include "../../internal/img_utils/internal_img_cpu.h"
+#include "../../internal/img_utils/internal_img_layout.h"
+
+
+// SIMD kernels bound at startup; NULL leaves the whole row to the scalar loop
+static int (*deinterleave4_kernel)(const uint8_t *src, uint8_t *c0, uint8_t *c1, uint8_t *c2, uint8_t *c3, int n);
+static int (*interleave4_kernel)(const uint8_t *c0, const uint8_t *c1, const uint8_t *c2, const uint8_t *c3,
+                                 uint8_t *dst, int n);
+static int (*deinterleave3_kernel)(const uint8_t *src, uint8_t *c0, uint8_t *c1, uint8_t *c2, int n);
+static int (*interleave3_kernel)(const uint8_t *c0, const uint8_t *c1, const uint8_t *c2, uint8_t *dst, int n);
+static int (*drop_alpha_kernel)(const uint8_t *src, uint8_t *dst, int n);
+static size_t (*u8_to_f32_kernel)(const uint8_t *src, float *dst, size_t n);
+static size_t (*f32_to_u8_kernel)(const float *src, uint8_t *dst, size_t n);
+
+/* ------------------------------------------------------------------------- */
+/* Four channels                                                             */
+/* ------------------------------------------------------------------------- */
+
+#ifdef IMG_LAYOUT_X86
+__attribute__((target("ssse3")))
+static int deinterleave4_ssse3(const uint8_t *src, uint8_t *c0, uint8_t *c1, uint8_t *c2, uint8_t *c3, int n)
+{
+    // Four pixels per register become one 32-bit lane per channel
+    const __m128i group = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m128i *in = (const __m128i *)(src + 4 * i);
+        __m128i a = _mm_shuffle_epi8(_mm_loadu_si128(in + 0), group);
+        __m128i b = _mm_shuffle_epi8(_mm_loadu_si128(in + 1), group);
+        __m128i c = _mm_shuffle_epi8(_mm_loadu_si128(in + 2), group);
+        __m128i d = _mm_shuffle_epi8(_mm_loadu_si128(in + 3), group);
+        __m128i ab_lo = _mm_unpacklo_epi32(a, b), ab_hi = _mm_unpackhi_epi32(a, b);
+        __m128i cd_lo = _mm_unpacklo_epi32(c, d), cd_hi = _mm_unpackhi_epi32(c, d);
+        _mm_storeu_si128((__m128i *)(c0 + i), _mm_unpacklo_epi64(ab_lo, cd_lo));
+        _mm_storeu_si128((__m128i *)(c1 + i), _mm_unpackhi_epi64(ab_lo, cd_lo));
+        _mm_storeu_si128((__m128i *)(c2 + i), _mm_unpacklo_epi64(ab_hi, cd_hi));
+        if (c3) _mm_storeu_si128((__m128i *)(c3 + i), _mm_unpackhi_epi64(ab_hi, cd_hi));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static int deinterleave4_avx2(const uint8_t *src, uint8_t *c0, uint8_t *c1, uint8_t *c2, uint8_t *c3, int n)
+{
+    const __m256i group = _mm256_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15,
+                                           0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+    // The in-lane transpose leaves the 4-pixel groups in the order 0, 2, 4, 6, 1, 3, 5, 7
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        const __m256i *in = (const __m256i *)(src + 4 * i);
+        __m256i a = _mm256_shuffle_epi8(_mm256_loadu_si256(in + 0), group);
+        __m256i b = _mm256_shuffle_epi8(_mm256_loadu_si256(in + 1), group);
+        __m256i c = _mm256_shuffle_epi8(_mm256_loadu_si256(in + 2), group);
+        __m256i d = _mm256_shuffle_epi8(_mm256_loadu_si256(in + 3), group);
+        __m256i ab_lo = _mm256_unpacklo_epi32(a, b), ab_hi = _mm256_unpackhi_epi32(a, b);
+        __m256i cd_lo = _mm256_unpacklo_epi32(c, d), cd_hi = _mm256_unpackhi_epi32(c, d);
+        __m256i p0 = _mm256_permutevar8x32_epi32(_mm256_unpacklo_epi64(ab_lo, cd_lo), order);
+        __m256i p1 = _mm256_permutevar8x32_epi32(_mm256_unpackhi_epi64(ab_lo, cd_lo), order);
+        __m256i p2 = _mm256_permutevar8x32_epi32(_mm256_unpacklo_epi64(ab_hi, cd_hi), order);
+        _mm256_storeu_si256((__m256i *)(c0 + i), p0);
+        _mm256_storeu_si256((__m256i *)(c1 + i), p1);
+        _mm256_storeu_si256((__m256i *)(c2 + i), p2);
+        if (c3) {
+            __m256i p3 = _mm256_permutevar8x32_epi32(_mm256_unpackhi_epi64(ab_hi, cd_hi), order);
+            _mm256_storeu_si256((__m256i *)(c3 + i), p3);
+        }
+    }
+    return i + deinterleave4_ssse3(src + 4 * i, c0 + i, c1 + i, c2 + i, c3 ? c3 + i : NULL, n - i);
+}
+
+__attribute__((target("sse2")))
+static int interleave4_sse2(const uint8_t *c0, const uint8_t *c1, const uint8_t *c2, const uint8_t *c3,
+                            uint8_t *dst, int n)
+{
+    const __m128i opaque = _mm_set1_epi8((char)0xFF);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i r = _mm_loadu_si128((const __m128i *)(c0 + i));
+        __m128i g = _mm_loadu_si128((const __m128i *)(c1 + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(c2 + i));
+        __m128i a = c3 ? _mm_loadu_si128((const __m128i *)(c3 + i)) : opaque;
+        __m128i rg_lo = _mm_unpacklo_epi8(r, g), rg_hi = _mm_unpackhi_epi8(r, g);
+        __m128i ba_lo = _mm_unpacklo_epi8(b, a), ba_hi = _mm_unpackhi_epi8(b, a);
+        __m128i *out = (__m128i *)(dst + 4 * i);
+        _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(rg_lo, ba_lo));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(rg_lo, ba_lo));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(rg_hi, ba_hi));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(rg_hi, ba_hi));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static int interleave4_avx2(const uint8_t *c0, const uint8_t *c1, const uint8_t *c2, const uint8_t *c3,
+                            uint8_t *dst, int n)
+{
+    const __m256i opaque = _mm256_set1_epi8((char)0xFF);
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i r = _mm256_loadu_si256((const __m256i *)(c0 + i));
+        __m256i g = _mm256_loadu_si256((const __m256i *)(c1 + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(c2 + i));
+        __m256i a = c3 ? _mm256_loadu_si256((const __m256i *)(c3 + i)) : opaque;
+        __m256i rg_lo = _mm256_unpacklo_epi8(r, g), rg_hi = _mm256_unpackhi_epi8(r, g);
+        __m256i ba_lo = _mm256_unpacklo_epi8(b, a), ba_hi = _mm256_unpackhi_epi8(b, a);
+        // Each lane holds pixels 0-15 (low) or 16-31 (high); the 128-bit permutes put them in order
+        __m256i q0 = _mm256_unpacklo_epi16(rg_lo, ba_lo), q1 = _mm256_unpackhi_epi16(rg_lo, ba_lo);
+        __m256i q2 = _mm256_unpacklo_epi16(rg_hi, ba_hi), q3 = _mm256_unpackhi_epi16(rg_hi, ba_hi);
+        __m256i *out = (__m256i *)(dst + 4 * i);
+        _mm256_storeu_si256(out + 0, _mm256_permute2x128_si256(q0, q1, 0x20));
+        _mm256_storeu_si256(out + 1, _mm256_permute2x128_si256(q2, q3, 0x20));
+        _mm256_storeu_si256(out + 2, _mm256_permute2x128_si256(q0, q1, 0x31));
+        _mm256_storeu_si256(out + 3, _mm256_permute2x128_si256(q2, q3, 0x31));
+    }
+    return i + interleave4_sse2(c0 + i, c1 + i, c2 + i, c3 ? c3 + i : NULL, dst + 4 * i, n - i);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Three channels                                                            */
+/* ------------------------------------------------------------------------- */
+
+// Shuffle masks for 16 pixels spread over three registers, filled at startup.
+// split_masks[c][r] gathers the bytes of channel c found in input register r;
+// merge_masks[r][c] places channel c's bytes into output register r.
+static uint8_t split_masks[3][3][16] __attribute__((aligned(16)));
+static uint8_t merge_masks[3][3][16] __attribute__((aligned(16)));
+
+static void build_masks(void)
+{
+    for (int c = 0; c < 3; c++) {
+        for (int r = 0; r < 3; r++) {
+            for (int j = 0; j < 16; j++) {
+                int s = 3 * j + c; // Byte of pixel j, channel c
+                split_masks[c][r][j] = s / 16 == r ? (uint8_t)(s % 16) : 0x80;
+                int o = 16 * r + j; // Output byte
+                merge_masks[r][c][j] = o % 3 == c ? (uint8_t)(o / 3) : 0x80;
+            }
+        }
+    }
+}
+
+__attribute__((target("ssse3")))
+static int deinterleave3_ssse3(const uint8_t *src, uint8_t *c0, uint8_t *c1, uint8_t *c2, int n)
+{
+    uint8_t *planes[3] = { c0, c1, c2 };
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m128i *in = (const __m128i *)(src + 3 * i);
+        __m128i v0 = _mm_loadu_si128(in + 0);
+        __m128i v1 = _mm_loadu_si128(in + 1);
+        __m128i v2 = _mm_loadu_si128(in + 2);
+        for (int c = 0; c < 3; c++) {
+            __m128i p = _mm_shuffle_epi8(v0, _mm_load_si128((const __m128i *)split_masks[c][0]));
+            p = _mm_or_si128(p, _mm_shuffle_epi8(v1, _mm_load_si128((const __m128i *)split_masks[c][1])));
+            p = _mm_or_si128(p, _mm_shuffle_epi8(v2, _mm_load_si128((const __m128i *)split_masks[c][2])));
+            _mm_storeu_si128((__m128i *)(planes[c] + i), p);
+        }
+    }
+    return i;
+}
+
+__attribute__((target("ssse3")))
+static int interleave3_ssse3(const uint8_t *c0, const uint8_t *c1, const uint8_t *c2, uint8_t *dst, int n)
+{
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i p[3] = {
+            _mm_loadu_si128((const __m128i *)(c0 + i)),
+            _mm_loadu_si128((const __m128i *)(c1 + i)),
+            _mm_loadu_si128((const __m128i *)(c2 + i)),
+        };
+        __m128i *out = (__m128i *)(dst + 3 * i);
+        for (int r = 0; r < 3; r++) {
+            __m128i v = _mm_shuffle_epi8(p[0], _mm_load_si128((const __m128i *)merge_masks[r][0]));
+            v = _mm_or_si128(v, _mm_shuffle_epi8(p[1], _mm_load_si128((const __m128i *)merge_masks[r][1])));
+            v = _mm_or_si128(v, _mm_shuffle_epi8(p[2], _mm_load_si128((const __m128i *)merge_masks[r][2])));
+            _mm_storeu_si128(out + r, v);
+        }
+    }
+    return i;
+}
+
+__attribute__((target("ssse3")))
+static int drop_alpha_ssse3(const uint8_t *src, uint8_t *dst, int n)
+{
+    // Twelve color bytes per register, then four registers are spliced into three
+    const __m128i drop = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m128i *in = (const __m128i *)(src + 4 * i);
+        __m128i s0 = _mm_shuffle_epi8(_mm_loadu_si128(in + 0), drop);
+        __m128i s1 = _mm_shuffle_epi8(_mm_loadu_si128(in + 1), drop);
+        __m128i s2 = _mm_shuffle_epi8(_mm_loadu_si128(in + 2), drop);
+        __m128i s3 = _mm_shuffle_epi8(_mm_loadu_si128(in + 3), drop);
+        __m128i *out = (__m128i *)(dst + 3 * i);
+        _mm_storeu_si128(out + 0, _mm_or_si128(s0, _mm_slli_si128(s1, 12)));
+        _mm_storeu_si128(out + 1, _mm_or_si128(_mm_srli_si128(s1, 4), _mm_slli_si128(s2, 8)));
+        _mm_storeu_si128(out + 2, _mm_or_si128(_mm_srli_si128(s2, 8), _mm_slli_si128(s3, 4)));
+    }
+    return i;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Element types                                                             */
+/* ------------------------------------------------------------------------- */
+
+__attribute__((target("sse2")))
+static size_t u8_to_f32_sse2(const uint8_t *src, float *dst, size_t n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i lo = _mm_unpacklo_epi8(v, zero), hi = _mm_unpackhi_epi8(v, zero);
+        _mm_storeu_ps(dst + i + 0, _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)));
+        _mm_storeu_ps(dst + i + 4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)));
+        _mm_storeu_ps(dst + i + 8, _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)));
+        _mm_storeu_ps(dst + i + 12, _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t u8_to_f32_avx2(const uint8_t *src, float *dst, size_t n)
+{
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m128i lo = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i hi = _mm_loadu_si128((const __m128i *)(src + i + 16));
+        _mm256_storeu_ps(dst + i + 0, _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(lo)));
+        _mm256_storeu_ps(dst + i + 8, _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(lo, 8))));
+        _mm256_storeu_ps(dst + i + 16, _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(hi)));
+        _mm256_storeu_ps(dst + i + 24, _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(hi, 8))));
+    }
+    return i + u8_to_f32_sse2(src + i, dst + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static size_t f32_to_u8_sse2(const float *src, uint8_t *dst, size_t n)
+{
+    // max(v, 0) returns 0 for NaN, matching the scalar fmaxf
+    const __m128 zero = _mm_setzero_ps(), top = _mm_set1_ps(255.0f);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + 0), zero), top));
+        __m128i b = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + 4), zero), top));
+        __m128i c = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + 8), zero), top));
+        __m128i d = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + 12), zero), top));
+        __m128i v = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+        _mm_storeu_si128((__m128i *)(dst + i), v);
+    }
+    return i;
+}
+#endif
+
+__attribute__((constructor))
+static void bind_kernels(void)
+{
+    build_masks();
+#ifdef IMG_LAYOUT_X86
+    img_cpu_level cpu = img_cpu_get_level();
+    if (cpu >= IMG_CPU_SSE2) {
+        interleave4_kernel = interleave4_sse2;
+        u8_to_f32_kernel = u8_to_f32_sse2;
+        f32_to_u8_kernel = f32_to_u8_sse2;
+    }
+    if (cpu >= IMG_CPU_SSSE3) {
+        deinterleave4_kernel = deinterleave4_ssse3;
+        deinterleave3_kernel = deinterleave3_ssse3;
+        interleave3_kernel = interleave3_ssse3;
+        drop_alpha_kernel = drop_alpha_ssse3;
+    }
+    if (cpu >= IMG_CPU_AVX2) {
+        deinterleave4_kernel = deinterleave4_avx2;
+        interleave4_kernel = interleave4_avx2;
+        u8_to_f32_kernel = u8_to_f32_avx2;
+    }
+#endif
+}
+
+/* ------------------------------------------------------------------------- */
+/* Entry points                                                              */
+/* ------------------------------------------------------------------------- */
+
+void img_layout_deinterleave4_u8(const uint8_t *src, uint8_t *c0, uint8_t *c1, uint8_t *c2, uint8_t *c3, int n)
+{
+    int i = deinterleave4_kernel ? deinterleave4_kernel(src, c0, c1, c2, c3, n) : 0;
+    for (; i < n; i++) {
+        c0[i] = src[4 * i + 0];
+        c1[i] = src[4 * i + 1];
+        c2[i] = src[4 * i + 2];
+        if (c3) c3[i] = src[4 * i + 3];
+    }
+}
+
+void img_layout_interleave4_u8(const uint8_t *c0, const uint8_t *c1, const uint8_t *c2, const uint8_t *c3,
+                               uint8_t *dst, int n)
+{
+    int i = interleave4_kernel ? interleave4_kernel(c0, c1, c2, c3, dst, n) : 0;
+    for (; i < n; i++) {
+        dst[4 * i + 0] = c0[i];
+        dst[4 * i + 1] = c1[i];
+        dst[4 * i + 2] = c2[i];
+        dst[4 * i + 3] = c3 ? c3[i] : 0xFF;
+    }
+}
+
+void img_layout_deinterleave3_u8(const uint8_t *src, uint8_t *c0, uint8_t *c1, uint8_t *c2, int n)
+{
+    int i = deinterleave3_kernel ? deinterleave3_kernel(src, c0, c1, c2, n) : 0;
+    for (; i < n; i++) {
+        c0[i] = src[3 * i + 0];
+        c1[i] = src[3 * i + 1];
+        c2[i] = src[3 * i + 2];
+    }
+}
+
+void img_layout_interleave3_u8(const uint8_t *c0, const uint8_t *c1, const uint8_t *c2, uint8_t *dst, int n)
+{
+    int i = interleave3_kernel ? interleave3_kernel(c0, c1, c2, dst, n) : 0;
+    for (; i < n; i++) {
+        dst[3 * i + 0] = c0[i];
+        dst[3 * i + 1] = c1[i];
+        dst[3 * i + 2] = c2[i];
+    }
+}
+
+void img_layout_drop_alpha_u8(const uint8_t *src, uint8_t *dst, int n)
+{
+    int i = drop_alpha_kernel ? drop_alpha_kernel(src, dst, n) : 0;
+    for (; i < n; i++) {
+        dst[3 * i + 0] = src[4 * i + 0];
+        dst[3 * i + 1] = src[4 * i + 1];
+        dst[3 * i + 2] = src[4 * i + 2];
+    }
+}
+
+void img_layout_u8_to_f32(const uint8_t *src, float *dst, size_t n)
+{
+    size_t i = u8_to_f32_kernel ? u8_to_f32_kernel(src, dst, n) : 0;
+    for (; i < n; i++) dst[i] = (float)src[i];
+}
+
+void img_layout_f32_to_u8(const float *src, uint8_t *dst, size_t n)
+{
+    size_t i = f32_to_u8_kernel ? f32_to_u8_kernel(src, dst, n) : 0;
+    for (; i < n; i++) dst[i] = (uint8_t)lrintf(fminf(fmaxf(src[i], 0.0f), 255.0f));
+}
@@ -0,0 +1,437 @@
+/**
+ * Read-ahead file loader.
+ *
+ * A loader owns depth + 1 slots, each with a buffer that grows to the largest
+ * file it has held: one slot holds the file last handed to the consumer and
+ * the others hold reads in flight. File i always uses slot i % (depth + 1),
+ * so files complete into slots in order and the consumer only ever waits on
+ * the oldest one.
+ *
+ * With io_uring, every file is opened and sized by an openat and a statx
+ * request issued together, then read by read requests; the consumer drives
+ * the ring while it waits. Otherwise reader threads perform blocking
+ * open/fstat/read calls on queued slots.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/stat.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../../include/img_utils.h"
+#include "../../internal/img_utils/internal_img_trace.h"
+#include "../../internal/img_utils/internal_img_uring.h"
+
+
+#define DEFAULT_DEPTH 8
+#define MAX_READ (1u << 30) // Largest single read request; bigger files take several
+
+// Requests of the io_uring backend, tagged into the low bits of user_data
+#define OP_OPEN 0
+#define OP_STAT 1
+#define OP_READ 2
+#define OP_BITS 2
+
+typedef enum {
+    SLOT_FREE,    // Available for the next file
+    SLOT_QUEUED,  // Waiting for a reader thread
+    SLOT_OPENING, // openat and statx in flight
+    SLOT_READING, // Read in flight
+    SLOT_DONE,    // Contents or error ready
+    SLOT_HELD     // Handed to the consumer
+} slot_state;
+
+typedef struct {
+    slot_state state;
+    size_t index;           // The file held by the slot
+    unsigned char *buffer;  // Reused across files
+    size_t capacity;
+    size_t size;            // Bytes of the file
+    size_t done;            // Bytes read so far
+    int error;              // errno of the first failure
+    int fd;                 // Open descriptor, or -1
+    int pending;            // io_uring requests in flight
+    struct statx stx;       // statx result
+} loader_slot;
+
+struct img_loader {
+    img_loader_backend backend;
+    int depth;
+    int slot_count;
+    loader_slot *slots;
+    char **paths;
+    size_t count, capacity;
+    size_t next_start;      // Next file to start reading
+    size_t next_return;     // Next file to hand out
+    img_loader_file current;
+    img_uring *ring;
+    pthread_t *readers;
+    int reader_count;
+    pthread_mutex_t lock;
+    pthread_cond_t work;    // Signalled when a slot is queued or on shutdown
+    pthread_cond_t done;    // Signalled when a slot finishes
+    int stop;
+};
+
+// Makes room for a file, keeping the buffer when it is large enough
+static int slot_reserve(loader_slot *slot, size_t size)
+{
+    if (size <= slot->capacity) return RET_SUCCESS;
+
+    unsigned char *buffer = (unsigned char *)realloc(slot->buffer, size);
+    if (!buffer) return RET_FAIL;
+    slot->buffer = buffer;
+    slot->capacity = size;
+    return RET_SUCCESS;
+}
+
+// Records the outcome of a file and closes it; the caller marks the slot done
+static void slot_finish(loader_slot *slot, int error)
+{
+    if (error && !slot->error) slot->error = error;
+    if (slot->fd >= 0) close(slot->fd);
+    slot->fd = -1;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Reader threads                                                            */
+/* ------------------------------------------------------------------------- */
+
+// Reads a whole file with blocking calls; runs without the lock
+static void read_blocking(loader_slot *slot, const char *path)
+{
+    slot->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (slot->fd < 0) {
+        slot_finish(slot, errno);
+        return;
+    }
+
+    struct stat st;
+    if (fstat(slot->fd, &st) != 0) {
+        slot_finish(slot, errno);
+        return;
+    }
+    if (slot_reserve(slot, (size_t)st.st_size) != RET_SUCCESS) {
+        slot_finish(slot, ENOMEM);
+        return;
+    }
+
+    slot->size = (size_t)st.st_size;
+    while (slot->done < slot->size) {
+        size_t want = slot->size - slot->done;
+        ssize_t n = pread(slot->fd, slot->buffer + slot->done, want < MAX_READ ? want : MAX_READ, (off_t)slot->done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            slot_finish(slot, errno);
+            return;
+        }
+        if (n == 0) slot->size = slot->done; // The file shrank since fstat()
+        slot->done += (size_t)n;
+    }
+    slot_finish(slot, 0);
+}
+
+static void* reader_main(void *arg)
+{
+    img_loader *l = (img_loader *)arg;
+    pthread_mutex_lock(&l->lock);
+    while (!l->stop) {
+        // Serve the oldest queued file first, since the consumer waits on it
+        loader_slot *slot = NULL;
+        for (int i = 0; i < l->slot_count; i++) {
+            loader_slot *s = &l->slots[i];
+            if (s->state == SLOT_QUEUED && (!slot || s->index < slot->index)) slot = s;
+        }
+        if (!slot) {
+            pthread_cond_wait(&l->work, &l->lock);
+            continue;
+        }
+
+        slot->state = SLOT_READING;
+        const char *path = l->paths[slot->index];
+        pthread_mutex_unlock(&l->lock);
+        read_blocking(slot, path);
+        pthread_mutex_lock(&l->lock);
+        slot->state = SLOT_DONE;
+        pthread_cond_broadcast(&l->done);
+    }
+    pthread_mutex_unlock(&l->lock);
+    return NULL;
+}
+
+static int start_readers(img_loader *l)
+{
+    l->readers = (pthread_t *)calloc(l->depth, sizeof(pthread_t));
+    if (!l->readers) return RET_FAIL;
+
+    for (int i = 0; i < l->depth; i++) {
+        if (pthread_create(&l->readers[i], NULL, reader_main, l) != 0) break;
+        l->reader_count++;
+    }
+    return l->reader_count > 0 ? RET_SUCCESS : RET_FAIL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* io_uring                                                                  */
+/* ------------------------------------------------------------------------- */
+
+static uint64_t op_tag(const img_loader *l, const loader_slot *slot, int op)
+{
+    return (uint64_t)(slot - l->slots) << OP_BITS | (uint64_t)op;
+}
+
+// Queues the read of the next chunk of a sized, open file
+static void ring_queue_read(img_loader *l, loader_slot *slot)
+{
+    struct io_uring_sqe *sqe = img_uring_get_sqe(l->ring);
+    size_t want = slot->size - slot->done;
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = slot->fd;
+    sqe->addr = (uint64_t)(uintptr_t)(slot->buffer + slot->done);
+    sqe->len = (unsigned)(want < MAX_READ ? want : MAX_READ);
+    sqe->off = slot->done;
+    sqe->user_data = op_tag(l, slot, OP_READ);
+    slot->pending++;
+    slot->state = SLOT_READING;
+}
+
+// Opening and sizing go out together; the ring holds two entries per slot
+static void ring_queue_open(img_loader *l, loader_slot *slot)
+{
+    const char *path = l->paths[slot->index];
+
+    struct io_uring_sqe *sqe = img_uring_get_sqe(l->ring);
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (uint64_t)(uintptr_t)path;
+    sqe->open_flags = O_RDONLY | O_CLOEXEC;
+    sqe->user_data = op_tag(l, slot, OP_OPEN);
+
+    sqe = img_uring_get_sqe(l->ring);
+    sqe->opcode = IORING_OP_STATX;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (uint64_t)(uintptr_t)path;
+    sqe->len = STATX_SIZE;
+    sqe->off = (uint64_t)(uintptr_t)&slot->stx;
+    sqe->user_data = op_tag(l, slot, OP_STAT);
+
+    slot->pending = 2;
+    slot->state = SLOT_OPENING;
+}
+
+static void ring_complete(img_loader *l, uint64_t tag, int32_t res)
+{
+    loader_slot *slot = &l->slots[tag >> OP_BITS];
+    int op = (int)(tag & ((1u << OP_BITS) - 1));
+    slot->pending--;
+
+    if (op == OP_OPEN && res >= 0) slot->fd = res;
+    else if (res < 0 && res != -EINTR && res != -EAGAIN && !slot->error) slot->error = -res;
+    if (op == OP_READ && res > 0) slot->done += (size_t)res;
+    if (op == OP_READ && res == 0) slot->size = slot->done; // The file shrank since statx
+    if (slot->pending > 0) return;
+
+    if (!slot->error && op != OP_READ) {
+        slot->size = (size_t)slot->stx.stx_size;
+        if (slot_reserve(slot, slot->size) != RET_SUCCESS) slot->error = ENOMEM;
+    }
+    if (!slot->error && slot->done < slot->size) {
+        ring_queue_read(l, slot);
+        return;
+    }
+    slot_finish(slot, 0);
+    slot->state = SLOT_DONE;
+}
+
+// Submits queued requests, waits for at least one completion and processes them all
+static int ring_pump(img_loader *l)
+{
+    if (img_uring_submit(l->ring, 1) != RET_SUCCESS) return RET_FAIL;
+
+    uint64_t tag;
+    int32_t res;
+    while (img_uring_peek(l->ring, &tag, &res)) {
+        ring_complete(l, tag, res);
+    }
+    return RET_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Loader                                                                    */
+/* ------------------------------------------------------------------------- */
+
+// Starts the files within depth of the consumer
+static void start_reads(img_loader *l)
+{
+    int queued = 0;
+    while (l->next_start < l->count && l->next_start < l->next_return + l->depth) {
+        loader_slot *slot = &l->slots[l->next_start % l->slot_count];
+        slot->index = l->next_start++;
+        slot->size = slot->done = 0;
+        slot->error = 0;
+        if (l->ring) ring_queue_open(l, slot);
+        else slot->state = SLOT_QUEUED;
+        queued = 1;
+    }
+    if (queued && l->ring) img_uring_submit(l->ring, 0);
+    if (queued && !l->ring) pthread_cond_broadcast(&l->work);
+}
+
+img_loader_options img_loader_defaults(void)
+{
+    img_loader_options opts = { DEFAULT_DEPTH, IMG_LOADER_AUTO };
+    return opts;
+}
+
+img_loader* img_loader_new(const img_loader_options *opts)
+{
+    img_loader_options o = opts ? *opts : img_loader_defaults();
+    if (o.depth <= 0) o.depth = DEFAULT_DEPTH;
+
+    img_loader *l = (img_loader *)calloc(1, sizeof(img_loader));
+    if (!l) return NULL;
+    l->depth = o.depth;
+    l->slot_count = o.depth + 1;
+    l->slots = (loader_slot *)calloc(l->slot_count, sizeof(loader_slot));
+    pthread_mutex_init(&l->lock, NULL);
+    pthread_cond_init(&l->work, NULL);
+    pthread_cond_init(&l->done, NULL);
+    if (!l->slots) {
+        img_loader_free(l);
+        return NULL;
+    }
+    for (int i = 0; i < l->slot_count; i++) {
+        l->slots[i].fd = -1;
+    }
+
+    if (o.backend != IMG_LOADER_THREADS) l->ring = img_uring_new(2 * (unsigned)l->slot_count);
+    if (l->ring) {
+        l->backend = IMG_LOADER_URING;
+    } else if (o.backend == IMG_LOADER_URING || start_readers(l) != RET_SUCCESS) {
+        img_loader_free(l);
+        return NULL;
+    } else {
+        l->backend = IMG_LOADER_THREADS;
+    }
+    return l;
+}
+
+void img_loader_free(img_loader *l)
+{
+    if (!l) return;
+
+    // The kernel may still write into the buffers of requests in flight
+    int in_flight = 1;
+    while (l->ring && in_flight) {
+        in_flight = 0;
+        for (int i = 0; i < l->slot_count; i++) {
+            in_flight |= l->slots[i].pending > 0;
+        }
+        if (in_flight && ring_pump(l) != RET_SUCCESS) break;
+    }
+    img_uring_free(l->ring);
+
+    pthread_mutex_lock(&l->lock);
+    l->stop = 1;
+    pthread_cond_broadcast(&l->work);
+    pthread_mutex_unlock(&l->lock);
+    for (int i = 0; i < l->reader_count; i++) {
+        pthread_join(l->readers[i], NULL);
+    }
+    free(l->readers);
+
+    for (int i = 0; l->slots && i < l->slot_count; i++) {
+        if (l->slots[i].fd >= 0) close(l->slots[i].fd);
+        free(l->slots[i].buffer);
+    }
+    free(l->slots);
+    for (size_t i = 0; i < l->count; i++) {
+        free(l->paths[i]);
+    }
+    free(l->paths);
+    pthread_mutex_destroy(&l->lock);
+    pthread_cond_destroy(&l->work);
+    pthread_cond_destroy(&l->done);
+    free(l);
+}
+
+img_loader_backend img_loader_get_backend(const img_loader *l)
+{
+    return l->backend;
+}
+
+int img_loader_add(img_loader *l, const char *filename)
+{
+    if (!l || !filename) return RET_FAIL;
+
+    char *path = strdup(filename);
+    if (!path) return RET_FAIL;
+
+    pthread_mutex_lock(&l->lock);
+    int ret = RET_SUCCESS;
+    if (l->count == l->capacity) {
+        size_t capacity = l->capacity ? 2 * l->capacity : 64;
+        char **paths = (char **)realloc(l->paths, capacity * sizeof(char *));
+        if (paths) {
+            l->paths = paths;
+            l->capacity = capacity;
+        } else {
+            ret = RET_FAIL;
+        }
+    }
+    if (ret == RET_SUCCESS) {
+        l->paths[l->count++] = path;
+        start_reads(l);
+    } else {
+        free(path);
+    }
+    pthread_mutex_unlock(&l->lock);
+    return ret;
+}
+
+const img_loader_file* img_loader_next(img_loader *l)
+{
+    if (!l) return NULL;
+    IMG_TRACE_SCOPE("img_loader_next");
+
+    pthread_mutex_lock(&l->lock);
+    // Recycle the previous file's slot, which the next read may now use
+    if (l->next_return > 0) l->slots[(l->next_return - 1) % l->slot_count].state = SLOT_FREE;
+    if (l->next_return >= l->count) {
+        pthread_mutex_unlock(&l->lock);
+        return NULL;
+    }
+    start_reads(l);
+
+    loader_slot *slot = &l->slots[l->next_return % l->slot_count];
+    while (slot->state != SLOT_DONE) {
+        if (!l->ring) {
+            pthread_cond_wait(&l->done, &l->lock);
+        } else if (ring_pump(l) != RET_SUCCESS) {
+            // Requests already queued still complete, but nothing new can be waited on
+            for (int i = 0; i < l->slot_count; i++) {
+                if (l->slots[i].state == SLOT_OPENING || l->slots[i].state == SLOT_READING) {
+                    l->slots[i].pending = 0;
+                    slot_finish(&l->slots[i], EIO);
+                    l->slots[i].state = SLOT_DONE;
+                }
+            }
+        }
+    }
+    slot->state = SLOT_HELD;
+
+    l->current.index = slot->index;
+    l->current.filename = l->paths[slot->index];
+    l->current.data = slot->error ? NULL : slot->buffer;
+    l->current.size = slot->error ? 0 : slot->size;
+    l->current.error = slot->error;
+    l->next_return++;
+    start_reads(l);
+    pthread_mutex_unlock(&l->lock);
+
+    IMG_TRACE_COUNT(IMG_TRACE_BYTES_READ, l->current.size);
+    return &l->current;
+}
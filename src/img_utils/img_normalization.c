@@ -0,0 +1,451 @@
+/**
+ * Per-channel normalization and statistics.
+ *
+ * Every normalization is an affine map per channel, p * mul + add, with the
+ * output quantization folded into mul and add. It is applied through
+ * 256-entry tables built with fmaf(), or for float outputs by an FMA kernel
+ * computing the same fused product, so all CPU levels give identical
+ * results. The statistics are exact integer sums; the SIMD kernels work on
+ * channel planes split off each row by the layout kernels.
+ */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define IMG_NORM_X86 1
+#endif
+
+#include "../../include/img_utils.h"
+#include "../../internal/img_utils/internal_img_cpu.h"
+#include "../../internal/img_utils/internal_img_layout.h"
+#include "../../internal/img_utils/internal_img_normalization.h"
+#include "../../internal/img_utils/internal_img_scratch.h"
+#include "../../internal/img_utils/internal_img_trace.h"
+
+
+// Samples per step of the multiply-add kernels: the channel pattern of 1 to 4
+// interleaved channels repeats every 24 samples
+#define PATTERN 24
+
+typedef struct {
+    float mul[4];
+    float add[4];
+    union {
+        uint8_t u8[4][256];
+        int8_t s8[4][256];
+        float f32[4][256];
+    } lut;
+} norm_plan;
+
+// SIMD kernels bound at startup; NULL leaves the whole run to the scalar code
+static size_t (*affine_kernel)(const uint8_t *src, float *dst, size_t n, const float *mul, const float *add);
+static int (*plane_stats_kernel)(const uint8_t *src, int n, uint64_t *sum, uint64_t *sum_sq,
+                                 uint8_t *min, uint8_t *max);
+
+/* ------------------------------------------------------------------------- */
+/* Kernels                                                                   */
+/* ------------------------------------------------------------------------- */
+
+#ifdef IMG_NORM_X86
+__attribute__((target("avx2,fma")))
+static size_t affine_avx2(const uint8_t *src, float *dst, size_t n, const float *mul, const float *add)
+{
+    const __m256 m0 = _mm256_loadu_ps(mul), m1 = _mm256_loadu_ps(mul + 8), m2 = _mm256_loadu_ps(mul + 16);
+    const __m256 a0 = _mm256_loadu_ps(add), a1 = _mm256_loadu_ps(add + 8), a2 = _mm256_loadu_ps(add + 16);
+    size_t i = 0;
+    for (; i + PATTERN <= n; i += PATTERN) {
+        __m256 v0 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + i))));
+        __m256 v1 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + i + 8))));
+        __m256 v2 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + i + 16))));
+        _mm256_storeu_ps(dst + i, _mm256_fmadd_ps(v0, m0, a0));
+        _mm256_storeu_ps(dst + i + 8, _mm256_fmadd_ps(v1, m1, a1));
+        _mm256_storeu_ps(dst + i + 16, _mm256_fmadd_ps(v2, m2, a2));
+    }
+    return i;
+}
+
+// The 32-bit square sums grow by at most 4 * 255^2 per lane and step, so
+// they are widened every STATS_FLUSH steps, well before they could wrap
+#define STATS_FLUSH 4096
+
+__attribute__((target("sse2")))
+static int plane_stats_sse2(const uint8_t *src, int n, uint64_t *sum, uint64_t *sum_sq, uint8_t *min, uint8_t *max)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i vmin = _mm_set1_epi8((char)0xFF), vmax = zero, vsum = zero, vsq64 = zero;
+    int i = 0;
+    while (i + 16 <= n) {
+        __m128i vsq = zero;
+        for (int k = 0; k < STATS_FLUSH && i + 16 <= n; k++, i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+            vmin = _mm_min_epu8(vmin, v);
+            vmax = _mm_max_epu8(vmax, v);
+            vsum = _mm_add_epi64(vsum, _mm_sad_epu8(v, zero));
+            __m128i lo = _mm_unpacklo_epi8(v, zero), hi = _mm_unpackhi_epi8(v, zero);
+            vsq = _mm_add_epi32(vsq, _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi)));
+        }
+        vsq64 = _mm_add_epi64(vsq64, _mm_add_epi64(_mm_unpacklo_epi32(vsq, zero), _mm_unpackhi_epi32(vsq, zero)));
+    }
+    if (i == 0) return 0;
+
+    uint64_t s[2], q[2];
+    uint8_t lo[16], hi[16];
+    _mm_storeu_si128((__m128i *)s, vsum);
+    _mm_storeu_si128((__m128i *)q, vsq64);
+    _mm_storeu_si128((__m128i *)lo, vmin);
+    _mm_storeu_si128((__m128i *)hi, vmax);
+    *sum += s[0] + s[1];
+    *sum_sq += q[0] + q[1];
+    for (int k = 0; k < 16; k++) {
+        if (lo[k] < *min) *min = lo[k];
+        if (hi[k] > *max) *max = hi[k];
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static int plane_stats_avx2(const uint8_t *src, int n, uint64_t *sum, uint64_t *sum_sq, uint8_t *min, uint8_t *max)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i vmin = _mm256_set1_epi8((char)0xFF), vmax = zero, vsum = zero, vsq64 = zero;
+    int i = 0;
+    while (i + 32 <= n) {
+        __m256i vsq = zero;
+        for (int k = 0; k < STATS_FLUSH && i + 32 <= n; k++, i += 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+            vmin = _mm256_min_epu8(vmin, v);
+            vmax = _mm256_max_epu8(vmax, v);
+            vsum = _mm256_add_epi64(vsum, _mm256_sad_epu8(v, zero));
+            __m256i lo = _mm256_unpacklo_epi8(v, zero), hi = _mm256_unpackhi_epi8(v, zero);
+            vsq = _mm256_add_epi32(vsq, _mm256_add_epi32(_mm256_madd_epi16(lo, lo), _mm256_madd_epi16(hi, hi)));
+        }
+        vsq64 = _mm256_add_epi64(vsq64, _mm256_add_epi64(_mm256_unpacklo_epi32(vsq, zero),
+                                                         _mm256_unpackhi_epi32(vsq, zero)));
+    }
+
+    if (i > 0) {
+        uint64_t s[4], q[4];
+        uint8_t lo[32], hi[32];
+        _mm256_storeu_si256((__m256i *)s, vsum);
+        _mm256_storeu_si256((__m256i *)q, vsq64);
+        _mm256_storeu_si256((__m256i *)lo, vmin);
+        _mm256_storeu_si256((__m256i *)hi, vmax);
+        *sum += s[0] + s[1] + s[2] + s[3];
+        *sum_sq += q[0] + q[1] + q[2] + q[3];
+        for (int k = 0; k < 32; k++) {
+            if (lo[k] < *min) *min = lo[k];
+            if (hi[k] > *max) *max = hi[k];
+        }
+    }
+    return i + plane_stats_sse2(src + i, n - i, sum, sum_sq, min, max);
+}
+#endif
+
+__attribute__((constructor))
+static void bind_kernels(void)
+{
+#ifdef IMG_NORM_X86
+    img_cpu_level cpu = img_cpu_get_level();
+    if (cpu >= IMG_CPU_SSE2) plane_stats_kernel = plane_stats_sse2;
+    if (cpu >= IMG_CPU_AVX2) {
+        affine_kernel = affine_avx2;
+        plane_stats_kernel = plane_stats_avx2;
+    }
+#endif
+}
+
+/* ------------------------------------------------------------------------- */
+/* Helpers                                                                   */
+/* ------------------------------------------------------------------------- */
+
+// Row of channel planes reused on each thread
+static _Thread_local img_scratch norm_scratch;
+
+static uint8_t* scratch_planes(int width)
+{
+    return (uint8_t *)img_scratch_reserve(&norm_scratch, (size_t)width * 4);
+}
+
+static size_t element_size(img_tensor_type type)
+{
+    return type == IMG_TENSOR_FLOAT32 ? sizeof(float) : 1;
+}
+
+// Folds the spec into per-channel mul/add and fills the tables of the written channels
+static int build_plan(const img_norm_spec *spec, norm_plan *plan)
+{
+    if (spec->channels < 1 || spec->channels > 4) return RET_FAIL;
+    if (spec->layout != IMG_LAYOUT_NHWC && spec->layout != IMG_LAYOUT_NCHW) return RET_FAIL;
+    if (spec->type != IMG_TENSOR_UINT8 && spec->type != IMG_TENSOR_INT8 && spec->type != IMG_TENSOR_FLOAT32) {
+        return RET_FAIL;
+    }
+    if (spec->type != IMG_TENSOR_FLOAT32 && spec->scale == 0.0f) return RET_FAIL;
+
+    for (int c = 0; c < spec->channels; c++) {
+        double mul, add;
+        switch (spec->method) {
+        case IMG_NORM_MINMAX:
+            if (spec->in_max[c] == spec->in_min[c]) return RET_FAIL;
+            mul = ((double)spec->out_max - spec->out_min) / ((double)spec->in_max[c] - spec->in_min[c]);
+            add = spec->out_min - spec->in_min[c] * mul;
+            break;
+        case IMG_NORM_STANDARDIZE:
+            if (spec->std[c] == 0.0f) return RET_FAIL;
+            mul = 1.0 / spec->std[c];
+            add = -(double)spec->mean[c] / spec->std[c];
+            break;
+        case IMG_NORM_REQUANTIZE:
+            mul = spec->in_scale;
+            add = -(double)spec->in_zero_point * spec->in_scale;
+            break;
+        default:
+            return RET_FAIL;
+        }
+        if (spec->type != IMG_TENSOR_FLOAT32) {
+            mul /= spec->scale;
+            add = add / spec->scale + spec->zero_point;
+        }
+        plan->mul[c] = (float)mul;
+        plan->add[c] = (float)add;
+
+        for (int p = 0; p < 256; p++) {
+            float v = fmaf((float)p, plan->mul[c], plan->add[c]);
+            switch (spec->type) {
+            case IMG_TENSOR_UINT8:
+                plan->lut.u8[c][p] = (uint8_t)lrintf(fminf(fmaxf(v, 0.0f), 255.0f));
+                break;
+            case IMG_TENSOR_INT8:
+                plan->lut.s8[c][p] = (int8_t)lrintf(fminf(fmaxf(v, -128.0f), 127.0f));
+                break;
+            case IMG_TENSOR_FLOAT32:
+                plan->lut.f32[c][p] = v;
+                break;
+            }
+        }
+    }
+    return RET_SUCCESS;
+}
+
+// Float output of n samples holding `channels` interleaved channels, the first being `first`
+static void affine_run(const norm_plan *plan, const uint8_t *src, float *dst, size_t n, int channels, int first)
+{
+    float mul[PATTERN], add[PATTERN];
+    for (int j = 0; j < PATTERN; j++) {
+        mul[j] = plan->mul[first + j % channels];
+        add[j] = plan->add[first + j % channels];
+    }
+    size_t i = affine_kernel(src, dst, n, mul, add);
+    for (; i < n; i++) dst[i] = plan->lut.f32[first + i % channels][src[i]];
+}
+
+// Table lookup from a row of interleaved RGBA into `channels` interleaved outputs
+static void lut_interleaved(const norm_plan *plan, img_tensor_type type, const uint8_t *src, void *dst,
+                            int width, int channels)
+{
+    size_t n = (size_t)width * channels;
+    for (size_t i = 0, x = 0; i < n; x++) {
+        for (int c = 0; c < channels; c++, i++) {
+            uint8_t p = src[4 * x + c];
+            switch (type) {
+            case IMG_TENSOR_UINT8: ((uint8_t *)dst)[i] = plan->lut.u8[c][p]; break;
+            case IMG_TENSOR_INT8: ((int8_t *)dst)[i] = plan->lut.s8[c][p]; break;
+            case IMG_TENSOR_FLOAT32: ((float *)dst)[i] = plan->lut.f32[c][p]; break;
+            }
+        }
+    }
+}
+
+// Table lookup of one channel plane
+static void lut_plane(const norm_plan *plan, img_tensor_type type, int c, const uint8_t *src, void *dst, int n)
+{
+    switch (type) {
+    case IMG_TENSOR_UINT8:
+        for (int i = 0; i < n; i++) ((uint8_t *)dst)[i] = plan->lut.u8[c][src[i]];
+        break;
+    case IMG_TENSOR_INT8:
+        for (int i = 0; i < n; i++) ((int8_t *)dst)[i] = plan->lut.s8[c][src[i]];
+        break;
+    case IMG_TENSOR_FLOAT32:
+        for (int i = 0; i < n; i++) ((float *)dst)[i] = plan->lut.f32[c][src[i]];
+        break;
+    }
+}
+
+static void plane_stats(img_channel_stats *stats, int c, const uint8_t *src, int n)
+{
+    int i = plane_stats_kernel
+        ? plane_stats_kernel(src, n, &stats->sum[c], &stats->sum_sq[c], &stats->min[c], &stats->max[c])
+        : 0;
+    for (; i < n; i++) {
+        uint8_t p = src[i];
+        stats->sum[c] += p;
+        stats->sum_sq[c] += (uint64_t)p * p;
+        if (p < stats->min[c]) stats->min[c] = p;
+        if (p > stats->max[c]) stats->max[c] = p;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+img_norm_spec img_norm_defaults(void)
+{
+    img_norm_spec spec = {
+        .method = IMG_NORM_MINMAX,
+        .channels = 3,
+        .layout = IMG_LAYOUT_NHWC,
+        .type = IMG_TENSOR_FLOAT32,
+        .in_min = { 0.0f, 0.0f, 0.0f, 0.0f },
+        .in_max = { 255.0f, 255.0f, 255.0f, 255.0f },
+        .out_min = 0.0f,
+        .out_max = 1.0f,
+        .mean = { 0.0f, 0.0f, 0.0f, 0.0f },
+        .std = { 1.0f, 1.0f, 1.0f, 1.0f },
+        .in_scale = 1.0f,
+        .in_zero_point = 0.0f,
+        .scale = 1.0f,
+        .zero_point = 0.0f,
+    };
+    return spec;
+}
+
+int img_normalize(const Image *src, const img_norm_spec *spec, void *out)
+{
+    if (!src || !src->pixels || !spec || !out) return RET_FAIL;
+
+    norm_plan plan;
+    if (build_plan(spec, &plan) != RET_SUCCESS) return RET_FAIL;
+
+    int width = src->width, channels = spec->channels;
+    int fused = spec->type == IMG_TENSOR_FLOAT32 && affine_kernel;
+    uint8_t *planes = scratch_planes(width);
+    if (!planes) return RET_FAIL;
+    IMG_TRACE_SCOPE("img_normalize");
+
+    size_t es = element_size(spec->type);
+    size_t plane = (size_t)width * src->height;
+    for (int y = 0; y < src->height; y++) {
+        const uint8_t *row = (const uint8_t *)img_row(src, y);
+        if (spec->layout == IMG_LAYOUT_NHWC) {
+            unsigned char *dst = (unsigned char *)out + (size_t)y * width * channels * es;
+            if (fused && channels == 4) {
+                affine_run(&plan, row, (float *)dst, (size_t)width * 4, 4, 0);
+            } else if (fused && channels == 3) {
+                img_layout_drop_alpha_u8(row, planes, width);
+                affine_run(&plan, planes, (float *)dst, (size_t)width * 3, 3, 0);
+            } else {
+                lut_interleaved(&plan, spec->type, row, dst, width, channels);
+            }
+        } else {
+            uint8_t *p[4] = { planes, planes + width, planes + 2 * (size_t)width, planes + 3 * (size_t)width };
+            img_layout_deinterleave4_u8(row, p[0], p[1], p[2], channels == 4 ? p[3] : NULL, width);
+            for (int c = 0; c < channels; c++) {
+                unsigned char *dst = (unsigned char *)out + ((size_t)c * plane + (size_t)y * width) * es;
+                if (fused) affine_run(&plan, p[c], (float *)dst, width, 1, c);
+                else lut_plane(&plan, spec->type, c, p[c], dst, width);
+            }
+        }
+    }
+    IMG_TRACE_COUNT(IMG_TRACE_PIXELS, plane);
+    return RET_SUCCESS;
+}
+
+void img_stats_init(img_channel_stats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    memset(stats->min, 0xFF, sizeof(stats->min));
+}
+
+int img_stats_accumulate(img_channel_stats *stats, const Image *img)
+{
+    if (!stats || !img || !img->pixels) return RET_FAIL;
+
+    int width = img->width;
+    uint8_t *planes = scratch_planes(width);
+    if (!planes) return RET_FAIL;
+    IMG_TRACE_SCOPE("img_stats_accumulate");
+
+    uint8_t *p[4] = { planes, planes + width, planes + 2 * (size_t)width, planes + 3 * (size_t)width };
+    for (int y = 0; y < img->height; y++) {
+        img_layout_deinterleave4_u8((const uint8_t *)img_row(img, y), p[0], p[1], p[2], p[3], width);
+        for (int c = 0; c < 4; c++) plane_stats(stats, c, p[c], width);
+    }
+    stats->count += (uint64_t)width * img->height;
+    IMG_TRACE_COUNT(IMG_TRACE_PIXELS, (size_t)width * img->height);
+    return RET_SUCCESS;
+}
+
+void img_stats_merge(img_channel_stats *dst, const img_channel_stats *src)
+{
+    dst->count += src->count;
+    for (int c = 0; c < 4; c++) {
+        dst->sum[c] += src->sum[c];
+        dst->sum_sq[c] += src->sum_sq[c];
+        if (src->min[c] < dst->min[c]) dst->min[c] = src->min[c];
+        if (src->max[c] > dst->max[c]) dst->max[c] = src->max[c];
+    }
+}
+
+void img_stats_moments(const img_channel_stats *stats, double mean[4], double variance[4])
+{
+    for (int c = 0; c < 4; c++) {
+        if (stats->count == 0) {
+            mean[c] = variance[c] = 0.0;
+            continue;
+        }
+        // n * sum_sq - sum^2 is exact in integers up to about 2^32 pixels; fall back to doubles beyond
+        double n = (double)stats->count;
+        mean[c] = stats->sum[c] / n;
+        if (stats->count < (1ull << 32)) {
+            unsigned __int128 spread = (unsigned __int128)stats->count * stats->sum_sq[c] -
+                                       (unsigned __int128)stats->sum[c] * stats->sum[c];
+            variance[c] = (double)spread / (n * n);
+        } else {
+            variance[c] = fmax(stats->sum_sq[c] / n - mean[c] * mean[c], 0.0);
+        }
+    }
+}
+
+void img_norm_set_stats(img_norm_spec *spec, const img_channel_stats *stats)
+{
+    if (stats->count == 0) return;
+
+    double mean[4], variance[4];
+    img_stats_moments(stats, mean, variance);
+    for (int c = 0; c < 4; c++) {
+        spec->in_min[c] = stats->min[c];
+        spec->in_max[c] = stats->max[c] > stats->min[c] ? stats->max[c] : stats->min[c] + 1.0f;
+        spec->mean[c] = (float)mean[c];
+        spec->std[c] = variance[c] > 0.0 ? (float)sqrt(variance[c]) : 1.0f;
+    }
+}
+
+void img_normalize_pixel_values(Image *img, float new_min, float new_max)
+{
+    if (!img || !img->pixels) return;
+
+    img_channel_stats stats;
+    img_stats_init(&stats);
+    if (img_stats_accumulate(&stats, img) != RET_SUCCESS) return;
+
+    img_norm_spec spec = img_norm_defaults();
+    spec.type = IMG_TENSOR_UINT8;
+    spec.out_min = new_min;
+    spec.out_max = new_max;
+    img_norm_set_stats(&spec, &stats);
+
+    norm_plan plan;
+    if (build_plan(&spec, &plan) != RET_SUCCESS) return;
+    IMG_TRACE_SCOPE("img_normalize_pixel_values");
+
+    for (int y = 0; y < img->height; y++) {
+        uint8_t *row = (uint8_t *)img_row(img, y);
+        for (int x = 0; x < img->width; x++) {
+            for (int c = 0; c < 3; c++) row[4 * x + c] = plan.lut.u8[c][row[4 * x + c]];
+        }
+    }
+    IMG_TRACE_COUNT(IMG_TRACE_PIXELS, (size_t)img->width * img->height);
+}
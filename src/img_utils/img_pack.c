@@ -0,0 +1,546 @@
+/**
+ * Packed image datasets.
+ *
+ * The writer streams entries into the current shard and keeps their index
+ * records in memory until the shard is finished. The reader maps every shard
+ * read-only into one reference-counted storage each, so raw entries become
+ * Image handles into the mapping and outlive img_pack_close() if needed; a
+ * flat table maps global entry indices to their shard and record.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../../include/img_utils.h"
+#include "../../internal/img_utils/internal_img_io.h"
+#include "../../internal/img_utils/internal_img_pack.h"
+#include "../../internal/img_utils/internal_img_png.h"
+#include "../../internal/img_utils/internal_img_pool.h"
+#include "../../internal/img_utils/internal_img_storage.h"
+#include "../../internal/img_utils/internal_img_trace.h"
+
+
+#define PACK_DEFAULT_SHARD_BYTES ((size_t)1 << 30)
+#define PNG_SIGNATURE_SIZE 8
+#define PNG_IHDR_END 24 // Signature, IHDR length and type, width and height
+
+struct img_pack_writer {
+    char *prefix;
+    size_t shard_bytes;
+    int shard;                 // Index of the open shard
+    FILE *fp;                  // Open shard, or NULL between shards
+    uint64_t offset;           // Write position in the open shard
+    img_pack_record *records;  // Index of the open shard
+    size_t count;              // Records in the open shard
+    size_t capacity;
+    size_t total;              // Entries across all shards
+    int failed;
+};
+
+typedef struct {
+    img_storage *storage;      // The mapping; one reference held by the pack
+    const unsigned char *data;
+    size_t size;
+    const img_pack_record *records;
+    uint32_t count;
+} pack_shard;
+
+typedef struct {
+    uint32_t shard;
+    uint32_t record;
+} pack_slot;
+
+struct img_pack {
+    pack_shard *shards;
+    int shard_count;
+    pack_slot *slots;          // Global index to shard and record
+    size_t count;
+};
+
+static char* shard_path(const char *prefix, int shard, const char *suffix)
+{
+    size_t len = strlen(prefix) + 16 + strlen(IMG_PACK_SUFFIX) + strlen(suffix);
+    char *path = (char *)malloc(len);
+    if (path) snprintf(path, len, "%s-%05d%s%s", prefix, shard, IMG_PACK_SUFFIX, suffix);
+    return path;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Writer                                                                    */
+/* ------------------------------------------------------------------------- */
+
+static int write_zeros(FILE *fp, size_t n)
+{
+    static const unsigned char zeros[IMG_PACK_ALIGNMENT];
+    while (n > 0) {
+        size_t chunk = n < sizeof(zeros) ? n : sizeof(zeros);
+        if (fwrite(zeros, 1, chunk, fp) != chunk) return RET_FAIL;
+        n -= chunk;
+    }
+    return RET_SUCCESS;
+}
+
+static int shard_begin(img_pack_writer *w)
+{
+    char *temp = shard_path(w->prefix, w->shard, ".tmp");
+    if (!temp) return RET_FAIL;
+    w->fp = fopen(temp, "wb");
+    free(temp);
+    if (!w->fp) return RET_FAIL;
+
+    // The header is rewritten once the index is known
+    w->offset = sizeof(img_pack_header);
+    w->count = 0;
+    return write_zeros(w->fp, sizeof(img_pack_header));
+}
+
+// Writes the index and header, then renames the shard into place
+static int shard_finish(img_pack_writer *w)
+{
+    uint64_t index_offset = (w->offset + IMG_PACK_ALIGNMENT - 1) & ~(uint64_t)(IMG_PACK_ALIGNMENT - 1);
+    int ret = write_zeros(w->fp, index_offset - w->offset);
+    if (ret == RET_SUCCESS && w->count > 0 &&
+        fwrite(w->records, sizeof(img_pack_record), w->count, w->fp) != w->count) {
+        ret = RET_FAIL;
+    }
+
+    img_pack_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, IMG_PACK_MAGIC, sizeof(h.magic));
+    h.count = (uint32_t)w->count;
+    h.record_size = sizeof(img_pack_record);
+    h.index_offset = index_offset;
+    if (ret == RET_SUCCESS && (fseek(w->fp, 0, SEEK_SET) != 0 || fwrite(&h, sizeof(h), 1, w->fp) != 1)) {
+        ret = RET_FAIL;
+    }
+    if (fclose(w->fp) != 0) ret = RET_FAIL;
+    w->fp = NULL;
+
+    char *temp = shard_path(w->prefix, w->shard, ".tmp");
+    char *path = shard_path(w->prefix, w->shard, "");
+    if (!temp || !path) ret = RET_FAIL;
+    if (ret == RET_SUCCESS && rename(temp, path) != 0) ret = RET_FAIL;
+    if (ret != RET_SUCCESS && temp) unlink(temp);
+    free(temp);
+    free(path);
+
+    w->shard++;
+    return ret;
+}
+
+// Opens a shard if needed and pads to the next entry boundary
+static int entry_begin(img_pack_writer *w)
+{
+    if (w->failed) return RET_FAIL;
+    if (!w->fp && shard_begin(w) != RET_SUCCESS) return RET_FAIL;
+
+    if (w->count == w->capacity) {
+        size_t capacity = w->capacity ? w->capacity * 2 : 1024;
+        img_pack_record *records = (img_pack_record *)realloc(w->records, sizeof(img_pack_record) * capacity);
+        if (!records) return RET_FAIL;
+        w->records = records;
+        w->capacity = capacity;
+    }
+
+    uint64_t aligned = (w->offset + IMG_PACK_ALIGNMENT - 1) & ~(uint64_t)(IMG_PACK_ALIGNMENT - 1);
+    if (write_zeros(w->fp, aligned - w->offset) != RET_SUCCESS) return RET_FAIL;
+    w->offset = aligned;
+    return RET_SUCCESS;
+}
+
+// Records an entry that ends at the current file position and rolls the shard over when full
+static int entry_end(img_pack_writer *w, int width, int height, img_pack_format format)
+{
+    long end = ftell(w->fp);
+    if (end < 0) return RET_FAIL;
+
+    img_pack_record *r = &w->records[w->count];
+    memset(r, 0, sizeof(*r));
+    r->offset = w->offset;
+    r->size = (uint64_t)end - w->offset;
+    r->width = (uint32_t)width;
+    r->height = (uint32_t)height;
+    r->format = (uint32_t)format;
+    w->offset = (uint64_t)end;
+    w->count++;
+    w->total++;
+
+    if (w->offset >= w->shard_bytes || w->count == UINT32_MAX) return shard_finish(w);
+    return RET_SUCCESS;
+}
+
+// A failed entry leaves the shard unusable, so every later call fails too
+static int writer_result(img_pack_writer *w, int ret)
+{
+    if (ret != RET_SUCCESS) w->failed = 1;
+    return ret;
+}
+
+img_pack_writer* img_pack_writer_new(const char *prefix, size_t shard_bytes)
+{
+    if (!prefix) return NULL;
+
+    img_pack_writer *w = (img_pack_writer *)img_pool_alloc(sizeof(img_pack_writer));
+    if (!w) return NULL;
+    memset(w, 0, sizeof(*w));
+
+    w->prefix = strdup(prefix);
+    if (!w->prefix) {
+        img_pool_free(w);
+        return NULL;
+    }
+    w->shard_bytes = shard_bytes ? shard_bytes : PACK_DEFAULT_SHARD_BYTES;
+    return w;
+}
+
+int img_pack_add_image(img_pack_writer *w, const Image *img, img_pack_format format)
+{
+    if (!w || !img || !img->pixels) return RET_FAIL;
+    if (format != IMG_PACK_RAW && format != IMG_PACK_PNG) return RET_FAIL;
+    IMG_TRACE_SCOPE("img_pack_add_image");
+
+    if (entry_begin(w) != RET_SUCCESS) return writer_result(w, RET_FAIL);
+
+    int ret = RET_SUCCESS;
+    if (format == IMG_PACK_PNG) {
+        ret = img_png_write_fp(w->fp, img, NULL);
+    } else {
+        for (int y = 0; ret == RET_SUCCESS && y < img->height; y++) {
+            if (fwrite(img_row(img, y), sizeof(pixel), (size_t)img->width, w->fp) != (size_t)img->width) {
+                ret = RET_FAIL;
+            }
+        }
+    }
+    if (ret == RET_SUCCESS) ret = entry_end(w, img->width, img->height, format);
+    IMG_TRACE_COUNT(IMG_TRACE_PIXELS, (size_t)img->width * img->height);
+    return writer_result(w, ret);
+}
+
+static uint32_t read_be32(const unsigned char *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// Only the PNG signature and IHDR are parsed; the stream is copied verbatim
+static int png_dimensions(const unsigned char head[PNG_IHDR_END], int *width, int *height)
+{
+    static const unsigned char signature[PNG_SIGNATURE_SIZE] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    if (memcmp(head, signature, sizeof(signature)) != 0 || memcmp(head + 12, "IHDR", 4) != 0) return RET_FAIL;
+
+    uint32_t w = read_be32(head + 16), h = read_be32(head + 20);
+    if (w == 0 || h == 0 || w > INT32_MAX || h > INT32_MAX) return RET_FAIL;
+    *width = (int)w;
+    *height = (int)h;
+    return RET_SUCCESS;
+}
+
+int img_pack_add_file(img_pack_writer *w, const char *filename)
+{
+    if (!w || !filename) return RET_FAIL;
+    IMG_TRACE_SCOPE("img_pack_add_file");
+
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) return RET_FAIL;
+
+    unsigned char head[PNG_IHDR_END];
+    int width, height;
+    if (fread(head, 1, sizeof(head), fp) != sizeof(head) || png_dimensions(head, &width, &height) != RET_SUCCESS) {
+        // Other formats are decoded and stored as pixels
+        fclose(fp);
+        Image *img = img_io_load(filename);
+        if (!img) return RET_FAIL;
+        int ret = img_pack_add_image(w, img, IMG_PACK_RAW);
+        img_free(img);
+        return ret;
+    }
+
+    if (entry_begin(w) != RET_SUCCESS) {
+        fclose(fp);
+        return writer_result(w, RET_FAIL);
+    }
+
+    int ret = fwrite(head, 1, sizeof(head), w->fp) == sizeof(head) ? RET_SUCCESS : RET_FAIL;
+    unsigned char buffer[1 << 16];
+    size_t n;
+    while (ret == RET_SUCCESS && (n = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+        if (fwrite(buffer, 1, n, w->fp) != n) ret = RET_FAIL;
+    }
+    if (ferror(fp)) ret = RET_FAIL;
+    fclose(fp);
+
+    if (ret == RET_SUCCESS) ret = entry_end(w, width, height, IMG_PACK_PNG);
+    return writer_result(w, ret);
+}
+
+int img_pack_add_png(img_pack_writer *w, const void *data, size_t size)
+{
+    if (!w || !data) return RET_FAIL;
+    IMG_TRACE_SCOPE("img_pack_add_png");
+
+    int width, height;
+    if (size < PNG_IHDR_END || png_dimensions((const unsigned char *)data, &width, &height) != RET_SUCCESS) {
+        return RET_FAIL;
+    }
+
+    if (entry_begin(w) != RET_SUCCESS) return writer_result(w, RET_FAIL);
+    int ret = fwrite(data, 1, size, w->fp) == size ? RET_SUCCESS : RET_FAIL;
+    if (ret == RET_SUCCESS) ret = entry_end(w, width, height, IMG_PACK_PNG);
+    return writer_result(w, ret);
+}
+
+size_t img_pack_writer_count(const img_pack_writer *w)
+{
+    return w ? w->total : 0;
+}
+
+int img_pack_writer_close(img_pack_writer *w)
+{
+    if (!w) return RET_SUCCESS;
+
+    int ret = w->failed ? RET_FAIL : RET_SUCCESS;
+    if (!w->fp && w->shard == 0 && !w->failed && shard_begin(w) != RET_SUCCESS) ret = RET_FAIL;
+    if (w->fp && shard_finish(w) != RET_SUCCESS) ret = RET_FAIL;
+
+    free(w->records);
+    free(w->prefix);
+    img_pool_free(w);
+    return ret;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Reader                                                                    */
+/* ------------------------------------------------------------------------- */
+
+static void destroy_mapped(img_storage *s)
+{
+    munmap(s->data, s->size);
+    img_storage_free_header(s);
+}
+
+// Maps a shard and checks its header and every record
+static int shard_map(pack_shard *shard, const char *path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return RET_FAIL;
+
+    void *data = MAP_FAILED;
+    size_t size = 0;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && (size_t)st.st_size >= sizeof(img_pack_header)) {
+        size = (size_t)st.st_size;
+        data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) return RET_FAIL;
+
+    const img_pack_header *h = (const img_pack_header *)data;
+    int ok = memcmp(h->magic, IMG_PACK_MAGIC, sizeof(h->magic)) == 0 && h->record_size == sizeof(img_pack_record) &&
+             h->index_offset >= sizeof(img_pack_header) && h->index_offset % IMG_PACK_ALIGNMENT == 0 &&
+             h->index_offset <= size && (size - h->index_offset) / sizeof(img_pack_record) >= h->count;
+
+    const img_pack_record *records = ok ? (const img_pack_record *)((const unsigned char *)data + h->index_offset)
+                                        : NULL;
+    for (uint32_t i = 0; ok && i < h->count; i++) {
+        const img_pack_record *r = &records[i];
+        ok = r->offset >= sizeof(img_pack_header) && r->offset % IMG_PACK_ALIGNMENT == 0 &&
+             r->offset <= h->index_offset && r->size <= h->index_offset - r->offset &&
+             r->width > 0 && r->height > 0 && r->width <= INT32_MAX && r->height <= INT32_MAX;
+        if (ok && r->format == IMG_PACK_RAW) {
+            // Compared by division, since width * height * 4 can wrap for forged dimensions
+            uint64_t pixels = r->size / sizeof(pixel);
+            ok = r->size % sizeof(pixel) == 0 && pixels % r->width == 0 && pixels / r->width == r->height;
+        } else if (ok) {
+            ok = r->format == IMG_PACK_PNG;
+        }
+    }
+
+    shard->storage = ok ? img_storage_wrap(data, size, destroy_mapped, NULL) : NULL;
+    if (!shard->storage) {
+        munmap(data, size);
+        return RET_FAIL;
+    }
+    shard->data = (const unsigned char *)data;
+    shard->size = size;
+    shard->records = records;
+    shard->count = h->count;
+    return RET_SUCCESS;
+}
+
+static int has_suffix(const char *s, const char *suffix)
+{
+    size_t len = strlen(s), n = strlen(suffix);
+    return len >= n && strcmp(s + len - n, suffix) == 0;
+}
+
+static int add_shard(img_pack *pack, const char *path)
+{
+    pack_shard *shards = (pack_shard *)realloc(pack->shards, sizeof(pack_shard) * (pack->shard_count + 1));
+    if (!shards) return RET_FAIL;
+    pack->shards = shards;
+    if (shard_map(&pack->shards[pack->shard_count], path) != RET_SUCCESS) return RET_FAIL;
+    pack->count += pack->shards[pack->shard_count].count;
+    pack->shard_count++;
+    return RET_SUCCESS;
+}
+
+img_pack* img_pack_open(const char *path)
+{
+    if (!path) return NULL;
+    IMG_TRACE_SCOPE("img_pack_open");
+
+    img_pack *pack = (img_pack *)img_pool_alloc(sizeof(img_pack));
+    if (!pack) return NULL;
+    memset(pack, 0, sizeof(*pack));
+
+    int ret = RET_SUCCESS;
+    if (has_suffix(path, IMG_PACK_SUFFIX)) {
+        ret = add_shard(pack, path);
+    } else {
+        // Shards are numbered without gaps; the first missing one ends the pack
+        for (int i = 0; ret == RET_SUCCESS; i++) {
+            char *shard = shard_path(path, i, "");
+            if (!shard) {
+                ret = RET_FAIL;
+                break;
+            }
+            if (access(shard, F_OK) != 0) {
+                free(shard);
+                break;
+            }
+            ret = add_shard(pack, shard);
+            free(shard);
+        }
+        if (pack->shard_count == 0) ret = RET_FAIL;
+    }
+
+    if (ret == RET_SUCCESS) {
+        pack->slots = (pack_slot *)malloc(sizeof(pack_slot) * (pack->count ? pack->count : 1));
+        if (!pack->slots) ret = RET_FAIL;
+    }
+    if (ret != RET_SUCCESS) {
+        img_pack_close(pack);
+        return NULL;
+    }
+
+    size_t k = 0;
+    for (int s = 0; s < pack->shard_count; s++) {
+        for (uint32_t i = 0; i < pack->shards[s].count; i++, k++) {
+            pack->slots[k].shard = (uint32_t)s;
+            pack->slots[k].record = i;
+        }
+    }
+    return pack;
+}
+
+void img_pack_close(img_pack *pack)
+{
+    if (!pack) return;
+
+    for (int s = 0; s < pack->shard_count; s++) {
+        img_storage_release(pack->shards[s].storage);
+    }
+    free(pack->shards);
+    free(pack->slots);
+    img_pool_free(pack);
+}
+
+size_t img_pack_count(const img_pack *pack)
+{
+    return pack ? pack->count : 0;
+}
+
+static const img_pack_record* record_of(const img_pack *pack, size_t index, const pack_shard **shard)
+{
+    if (!pack || index >= pack->count) return NULL;
+    const pack_slot *slot = &pack->slots[index];
+    *shard = &pack->shards[slot->shard];
+    return &(*shard)->records[slot->record];
+}
+
+int img_pack_entry_info(const img_pack *pack, size_t index, img_pack_entry *entry)
+{
+    const pack_shard *shard;
+    const img_pack_record *r = record_of(pack, index, &shard);
+    if (!r || !entry) return RET_FAIL;
+
+    entry->width = (int)r->width;
+    entry->height = (int)r->height;
+    entry->format = (img_pack_format)r->format;
+    entry->size = (size_t)r->size;
+    entry->shard = (int)pack->slots[index].shard;
+    return RET_SUCCESS;
+}
+
+Image* img_pack_load(const img_pack *pack, size_t index)
+{
+    const pack_shard *shard;
+    const img_pack_record *r = record_of(pack, index, &shard);
+    if (!r) return NULL;
+    IMG_TRACE_SCOPE("img_pack_load");
+
+    void *data = (void *)(shard->data + r->offset);
+    if (r->format == IMG_PACK_RAW) {
+        IMG_TRACE_COUNT(IMG_TRACE_BYTES_READ, r->size);
+        return img_handle_new(shard->storage, (pixel *)data, (int)r->width, (int)r->height, (int)r->width);
+    }
+
+    Image *img = img_png_open_mem(data, (size_t)r->size);
+    IMG_TRACE_COUNT(IMG_TRACE_BYTES_READ, r->size);
+    return img;
+}
+
+void img_pack_advise(const img_pack *pack, img_pack_access access)
+{
+    if (!pack) return;
+
+    int advice = access == IMG_PACK_ACCESS_SEQUENTIAL ? MADV_SEQUENTIAL
+               : access == IMG_PACK_ACCESS_RANDOM ? MADV_RANDOM : MADV_NORMAL;
+    for (int s = 0; s < pack->shard_count; s++) {
+        madvise((void *)pack->shards[s].data, pack->shards[s].size, advice);
+    }
+}
+
+void img_pack_prefetch(const img_pack *pack, size_t index)
+{
+    const pack_shard *shard;
+    const img_pack_record *r = record_of(pack, index, &shard);
+    if (!r) return;
+
+    // madvise() wants a page-aligned start
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)(shard->data + r->offset) & ~(page - 1);
+    uintptr_t end = (uintptr_t)(shard->data + r->offset + r->size);
+    madvise((void *)start, end - start, MADV_WILLNEED);
+}
+
+// splitmix64 step
+static uint64_t next_random(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+void img_pack_epoch_order(const img_pack *pack, uint64_t seed, unsigned epoch, size_t *order)
+{
+    if (!pack || !order) return;
+
+    size_t n = pack->count;
+    for (size_t i = 0; i < n; i++) order[i] = i;
+
+    // Fisher-Yates with a stream derived from the seed and the epoch
+    uint64_t state = seed ^ ((uint64_t)epoch * 0xD1B54A32D192ED03ull);
+    next_random(&state);
+    for (size_t i = n; i > 1; i--) {
+        size_t j = (size_t)(((unsigned __int128)next_random(&state) * i) >> 64);
+        size_t tmp = order[i - 1];
+        order[i - 1] = order[j];
+        order[j] = tmp;
+    }
+}
@@ -1,78 +1,481 @@
 #include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
 
+#include "../../internal/img_utils/internal_img_convert.h"
 #include "../../internal/img_utils/internal_img_png.h"
+#include "../../internal/img_utils/internal_img_pool.h"
+#include "../../internal/img_utils/internal_img_trace.h"
 
 
-Image* img_png_open(FILE *fp)
+// libpng and its zlib streams allocate through the image pool, so decoding
+// and encoding stop hitting the heap once the pool is warm
+static png_voidp png_pool_malloc(png_structp png, png_alloc_size_t size)
 {
+    (void)png;
+    return img_pool_alloc(size);
+}
 
-	// Initialize read structure
-	png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-    if (!png) return NULL; // Read structure not created
+static void png_pool_free(png_structp png, png_voidp ptr)
+{
+    (void)png;
+    img_pool_free(ptr);
+}
 
-    // Initialize info structure
-    png_infop info = png_create_info_struct(png);
-    if (!info) return NULL; // Info structure not created
+typedef struct {
+    png_structp png;
+    png_infop info;
+    int width;
+    int height;
+    int passes;             // 1, or 7 for Adam7 interlaced files
+    int color_type;
+    int bit_depth;
+    int channels;           // Samples per pixel in the file; 1 for palette images
+    size_t row_bytes;       // Bytes per decoded file row
+    int has_key;            // Gray or RGB image with a tRNS colour key
+    png_color_16 key;       // The colour key, at the file's bit depth
+    int palette_alpha;      // Palette image with a tRNS alpha table
+    pixel palette[256];     // Palette with tRNS alpha; unused entries are opaque black
+    unsigned char *scratch; // Pool block holding the row buffers below
+    png_bytep raw;          // One decoded file row
+    pixel *row;             // One converted RGBA row
+    unsigned char *samples; // Unpacked samples of a 1, 2 or 4-bit row
+    unsigned char *alpha;   // Colour key mask of the current row
+    png_bytep full;         // Whole decoded file image, for interlaced files only
+} png_reader;
 
-    // Read file
-    if (setjmp(png_jmpbuf(png))) return NULL; // Error during init_io
+static int reader_create(png_reader *r)
+{
+    memset(r, 0, sizeof(*r));
+    r->png = png_create_read_struct_2(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL,
+                                      NULL, png_pool_malloc, png_pool_free);
+    if (!r->png) return RET_FAIL; // Read structure not created
 
-    png_init_io(png, fp);
-    png_read_info(png, info);
+    r->info = png_create_info_struct(r->png);
+    if (!r->info) {
+        png_destroy_read_struct(&r->png, NULL, NULL);
+        return RET_FAIL; // Info structure not created
+    }
+    return RET_SUCCESS;
+}
+
+static void reader_destroy(png_reader *r)
+{
+    img_pool_free(r->full);
+    img_pool_free(r->scratch);
+    png_destroy_read_struct(&r->png, &r->info, NULL);
+}
+
+static void reader_load_palette(png_reader *r)
+{
+    png_colorp plte = NULL;
+    int count = 0;
+    if (!png_get_PLTE(r->png, r->info, &plte, &count)) png_error(r->png, "missing palette");
+
+    for (int i = 0; i < 256; i++) {
+        pixel p = { 0, 0, 0, 255 };
+        if (i < count) {
+            p.R = plte[i].red;
+            p.G = plte[i].green;
+            p.B = plte[i].blue;
+        }
+        r->palette[i] = p;
+    }
+
+    png_bytep trans = NULL;
+    int num_trans = 0;
+    if (png_get_tRNS(r->png, r->info, &trans, &num_trans, NULL) && trans) {
+        for (int i = 0; i < num_trans && i < 256; i++) {
+            r->palette[i].A = trans[i];
+        }
+        r->palette_alpha = 1;
+    }
+}
+
+// Where the compressed stream comes from: a file, or a buffer when fp is NULL
+typedef struct {
+    FILE *fp;
+    const uint8_t *data;
+    size_t size;
+    size_t pos;
+} png_source;
+
+static void read_mem(png_structp png, png_bytep out, png_size_t n)
+{
+    png_source *src = (png_source *)png_get_io_ptr(png);
+    if (n > src->size - src->pos) png_error(png, "unexpected end of data");
+    memcpy(out, src->data + src->pos, n);
+    src->pos += n;
+}
+
+// Reads the header and sets up the row buffers; must run under the caller's setjmp.
+// libpng only inflates and unfilters: sample conversion is left to our own kernels.
+static void reader_start(png_reader *r, png_source *src)
+{
+    if (src->fp) png_init_io(r->png, src->fp);
+    else png_set_read_fn(r->png, src, read_mem);
+    png_read_info(r->png, r->info);
+
+    r->width = (int)png_get_image_width(r->png, r->info);
+    r->height = (int)png_get_image_height(r->png, r->info);
+    r->color_type = png_get_color_type(r->png, r->info);
+    r->bit_depth = png_get_bit_depth(r->png, r->info);
+    r->channels = png_get_channels(r->png, r->info);
+
+    if (r->color_type == PNG_COLOR_TYPE_PALETTE) {
+        reader_load_palette(r);
+    } else if (png_get_valid(r->png, r->info, PNG_INFO_tRNS)) {
+        png_color_16p key = NULL;
+        png_get_tRNS(r->png, r->info, NULL, NULL, &key);
+        if (key) {
+            r->key = *key;
+            r->has_key = 1;
+        }
+    }
+
+    r->passes = png_set_interlace_handling(r->png);
+    png_read_update_info(r->png, r->info);
+    r->row_bytes = png_get_rowbytes(r->png, r->info);
+
+    size_t width = (size_t)r->width;
+    r->scratch = (unsigned char *)img_pool_alloc(r->row_bytes + width * (sizeof(pixel) + 2));
+    if (!r->scratch) png_error(r->png, "out of memory");
+    r->row = (pixel *)r->scratch; // Pool blocks are aligned, so the RGBA row goes first
+    r->raw = r->scratch + width * sizeof(pixel);
+    r->samples = r->raw + r->row_bytes;
+    r->alpha = r->samples + width;
+}
+
+// Channels of the native 8-bit layout: colour keys and palette alpha add an alpha channel
+static int reader_packed_channels(const png_reader *r)
+{
+    if (r->color_type == PNG_COLOR_TYPE_PALETTE) return r->palette_alpha ? 4 : 3;
+    return r->channels + r->has_key;
+}
+
+// True when decoded rows already are RGBA8 pixels
+static int reader_direct_rgba(const png_reader *r)
+{
+    return r->color_type == PNG_COLOR_TYPE_RGBA && r->bit_depth == 8;
+}
+
+// True when decoded rows already are in the native 8-bit layout
+static int reader_direct_packed(const png_reader *r)
+{
+    return r->color_type != PNG_COLOR_TYPE_PALETTE && r->bit_depth == 8 && !r->has_key;
+}
+
+static inline unsigned sample_at(png_const_bytep raw, int i, int depth)
+{
+    if (depth == 16) return (unsigned)raw[2 * i] << 8 | raw[2 * i + 1];
+    if (depth == 8) return raw[i];
+    int bit = i * depth;
+    return (raw[bit >> 3] >> (8 - depth - (bit & 7))) & ((1u << depth) - 1);
+}
+
+// Marks the pixels matching the tRNS colour key, compared at the file's bit depth
+static void reader_key_mask(png_reader *r, png_const_bytep raw)
+{
+    const int depth = r->bit_depth;
+    for (int x = 0; x < r->width; x++) {
+        int match;
+        if (r->channels == 1) {
+            match = sample_at(raw, x, depth) == r->key.gray;
+        } else {
+            match = sample_at(raw, 3 * x, depth) == r->key.red &&
+                    sample_at(raw, 3 * x + 1, depth) == r->key.green &&
+                    sample_at(raw, 3 * x + 2, depth) == r->key.blue;
+        }
+        r->alpha[x] = match ? 0 : 255;
+    }
+}
+
+// Brings a decoded row to one byte per sample; 16-bit rows are narrowed in place
+static const uint8_t* reader_samples(png_reader *r, png_bytep raw)
+{
+    const int n = r->width * r->channels;
 
-    png_byte color_type = png_get_color_type(png, info);
+    if (r->has_key) reader_key_mask(r, raw);
+
+    if (r->bit_depth == 16) {
+        img_cvt_narrow16(raw, raw, (size_t)n);
+        return raw;
+    }
+    if (r->bit_depth < 8) {
+        int scale = r->color_type == PNG_COLOR_TYPE_PALETTE ? 1 : 255 / ((1 << r->bit_depth) - 1);
+        img_cvt_unpack_bits(raw, r->samples, n, r->bit_depth, scale);
+        return r->samples;
+    }
+    return raw;
+}
+
+static void reader_row_rgba(png_reader *r, png_bytep raw, pixel *dst)
+{
+    const uint8_t *s = reader_samples(r, raw);
+
+    switch (r->color_type) {
+    case PNG_COLOR_TYPE_PALETTE:
+        img_cvt_palette_to_rgba(s, r->palette, dst, r->width);
+        break;
+    case PNG_COLOR_TYPE_GRAY:
+        img_cvt_gray_to_rgba(s, dst, r->width);
+        break;
+    case PNG_COLOR_TYPE_GRAY_ALPHA:
+        img_cvt_gray_alpha_to_rgba(s, dst, r->width);
+        break;
+    case PNG_COLOR_TYPE_RGB:
+        img_cvt_rgb_to_rgba(s, dst, r->width);
+        break;
+    default:
+        if ((const void *)s != (const void *)dst) memcpy(dst, s, sizeof(pixel) * (size_t)r->width);
+        break;
+    }
+
+    if (r->has_key) {
+        for (int x = 0; x < r->width; x++) {
+            dst[x].A = r->alpha[x];
+        }
+    }
+}
+
+static void reader_row_packed(png_reader *r, png_bytep raw, uint8_t *dst)
+{
+    const uint8_t *s = reader_samples(r, raw);
+    const int c = r->channels;
+
+    if (r->color_type == PNG_COLOR_TYPE_PALETTE) {
+        if (r->palette_alpha) {
+            img_cvt_palette_to_rgba(s, r->palette, (pixel *)dst, r->width);
+        } else {
+            for (int x = 0; x < r->width; x++, dst += 3) {
+                const pixel *p = &r->palette[s[x]];
+                dst[0] = p->R;
+                dst[1] = p->G;
+                dst[2] = p->B;
+            }
+        }
+    } else if (r->has_key) {
+        for (int x = 0; x < r->width; x++) {
+            for (int k = 0; k < c; k++) {
+                *dst++ = s[x * c + k];
+            }
+            *dst++ = r->alpha[x];
+        }
+    } else if (s != dst) {
+        memcpy(dst, s, (size_t)r->width * c);
+    }
+}
+
+// Decodes every pass straight into destination rows; only for rows needing no conversion
+static void reader_read_direct(png_reader *r, unsigned char *dst, size_t stride)
+{
+    for (int pass = 0; pass < r->passes; pass++) {
+        for (int y = 0; y < r->height; y++) {
+            png_read_row(r->png, dst + (size_t)y * stride, NULL);
+        }
+    }
+}
+
+typedef void (*raw_row_fn)(png_reader *r, int y, png_bytep raw, void *ctx);
+
+// Decodes rows [0, rows) and hands each finished file row to `emit`
+static void reader_read_rows(png_reader *r, int rows, raw_row_fn emit, void *ctx)
+{
+    if (r->passes == 1) {
+        for (int y = 0; y < rows; y++) {
+            png_read_row(r->png, r->raw, NULL);
+            emit(r, y, r->raw, ctx);
+        }
+        return;
+    }
+
+    // Adam7 rows are only complete after the last pass, so interlaced
+    // files are decoded whole and then replayed row by row
+    r->full = (png_bytep)img_pool_alloc(r->row_bytes * (size_t)r->height);
+    if (!r->full) png_error(r->png, "out of memory");
+    for (int pass = 0; pass < r->passes; pass++) {
+        for (int y = 0; y < r->height; y++) {
+            png_read_row(r->png, r->full + (size_t)y * r->row_bytes, NULL);
+        }
+    }
+    for (int y = 0; y < rows; y++) {
+        emit(r, y, r->full + (size_t)y * r->row_bytes, ctx);
+    }
+}
 
-    if (color_type != PNG_COLOR_TYPE_RGBA)
-    {
-        printf("color type not supported\n");
+static void emit_image_row(png_reader *r, int y, png_bytep raw, void *ctx)
+{
+    reader_row_rgba(r, raw, img_row((Image *)ctx, y));
+}
+
+static void emit_packed_row(png_reader *r, int y, png_bytep raw, void *ctx)
+{
+    img_packed *img = (img_packed *)ctx;
+    reader_row_packed(r, raw, img->data + (size_t)y * img->stride);
+}
+
+static Image* decode_image(png_source *src)
+{
+    png_reader r;
+    if (reader_create(&r) != RET_SUCCESS) return NULL;
+
+    Image *volatile image = NULL;
+    if (setjmp(png_jmpbuf(r.png))) {
+        // Error during decoding
+        img_free(image);
+        reader_destroy(&r);
         return NULL;
     }
 
-    Image *image = img_new(png_get_image_width(png, info), png_get_image_height(png, info));
+    reader_start(&r, src);
 
-    if (!image) return NULL; // Not enough img space
+    image = img_new(r.width, r.height);
+    if (!image) {
+        reader_destroy(&r);
+        return NULL; // Not enough img space
+    }
 
-    // Set up row pointers directly in the allocated pixels array
-    png_bytep row_pointers[image->height];
-    for (int y = 0; y < image->height; y++) {
-        row_pointers[y] = (png_bytep)(image->pixels + y * image->width);
+    if (reader_direct_rgba(&r)) {
+        reader_read_direct(&r, (unsigned char *)image->pixels, sizeof(pixel) * (size_t)image->stride);
+    } else {
+        reader_read_rows(&r, r.height, emit_image_row, image);
     }
+    png_read_end(r.png, NULL);
+    reader_destroy(&r);
+    IMG_TRACE_COUNT(IMG_TRACE_PIXELS, (size_t)image->width * image->height);
+
+    return image;
+}
+
+Image* img_png_open(FILE *fp)
+{
+    IMG_TRACE_SCOPE("img_png_open");
+    png_source src = { fp, NULL, 0, 0 };
+    return decode_image(&src);
+}
 
-    png_read_image(png, row_pointers);
-    png_destroy_read_struct(&png, &info, NULL);
+Image* img_png_open_mem(const void *data, size_t size)
+{
+    IMG_TRACE_SCOPE("img_png_open_mem");
+    png_source src = { NULL, (const uint8_t *)data, size, 0 };
+    return decode_image(&src);
+}
+
+img_packed* img_png_open_packed(FILE *fp)
+{
+    IMG_TRACE_SCOPE("img_png_open_packed");
+    png_reader r;
+    if (reader_create(&r) != RET_SUCCESS) return NULL;
+
+    img_packed *volatile image = NULL;
+    if (setjmp(png_jmpbuf(r.png))) {
+        img_packed_free(image);
+        reader_destroy(&r);
+        return NULL;
+    }
+
+    png_source src = { fp, NULL, 0, 0 };
+    reader_start(&r, &src);
+
+    image = img_packed_new(r.width, r.height, reader_packed_channels(&r));
+    if (!image) {
+        reader_destroy(&r);
+        return NULL;
+    }
+
+    if (reader_direct_packed(&r)) {
+        reader_read_direct(&r, image->data, image->stride);
+    } else {
+        reader_read_rows(&r, r.height, emit_packed_row, image);
+    }
+    png_read_end(r.png, NULL);
+    reader_destroy(&r);
+    IMG_TRACE_COUNT(IMG_TRACE_PIXELS, (size_t)image->width * image->height);
 
     return image;
 }
 
+typedef struct {
+    img_row_sink sink;
+    void *ctx;
+} stream_ctx;
 
-void img_png_write(const char *filename, Image *img)
+static void emit_stream_row(png_reader *r, int y, png_bytep raw, void *opaque)
 {
-    FILE *fp = fopen(filename, "wb");
-    if (!fp) {
-        fprintf(stderr, "Could not open file %s for writing.\n", filename);
-        return;
+    stream_ctx *s = (stream_ctx *)opaque;
+    if (reader_direct_rgba(r)) {
+        s->sink(s->ctx, y, (const pixel *)raw, r->width);
+    } else {
+        reader_row_rgba(r, raw, r->row);
+        s->sink(s->ctx, y, r->row, r->width);
+    }
+}
+
+int img_png_read_rows(FILE *fp, img_header_fn header, img_row_sink sink, void *ctx)
+{
+    IMG_TRACE_SCOPE("img_png_read_rows");
+    png_reader r;
+    if (reader_create(&r) != RET_SUCCESS) return RET_FAIL;
+
+    if (setjmp(png_jmpbuf(r.png))) {
+        reader_destroy(&r);
+        return RET_FAIL;
     }
 
-    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    png_source src = { fp, NULL, 0, 0 };
+    reader_start(&r, &src);
+
+    int rows = header(ctx, r.width, r.height);
+    if (rows < 0) {
+        reader_destroy(&r);
+        return RET_FAIL;
+    }
+    if (rows > r.height) rows = r.height;
+
+    stream_ctx s = { sink, ctx };
+    reader_read_rows(&r, rows, emit_stream_row, &s);
+    IMG_TRACE_COUNT(IMG_TRACE_PIXELS, (size_t)r.width * rows);
+
+    // Rows past the consumer's last needed row are never inflated
+    if (rows == r.height) png_read_end(r.png, NULL);
+    reader_destroy(&r);
+    return RET_SUCCESS;
+}
+
+
+static int png_filter_flags(img_png_filter filter)
+{
+    switch (filter) {
+    case IMG_PNG_FILTER_NONE:    return PNG_FILTER_NONE;
+    case IMG_PNG_FILTER_SUB:     return PNG_FILTER_SUB;
+    case IMG_PNG_FILTER_UP:      return PNG_FILTER_UP;
+    case IMG_PNG_FILTER_AVERAGE: return PNG_FILTER_AVG;
+    case IMG_PNG_FILTER_PAETH:   return PNG_FILTER_PAETH;
+    default:                     return PNG_ALL_FILTERS;
+    }
+}
+
+// Serial encode through libpng
+static int write_serial(FILE *fp, const Image *img, const img_write_options *opts)
+{
+    png_structp png = png_create_write_struct_2(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL,
+                                                  NULL, png_pool_malloc, png_pool_free);
     if (!png) {
-        fclose(fp);
         fprintf(stderr, "Could not allocate write struct.\n");
-        return;
+        return RET_FAIL;
     }
 
     png_infop info = png_create_info_struct(png);
     if (!info) {
-        fclose(fp);
         png_destroy_write_struct(&png, NULL);
         fprintf(stderr, "Could not allocate info struct.\n");
-        return;
+        return RET_FAIL;
     }
 
     if (setjmp(png_jmpbuf(png))) {
-        fclose(fp);
         png_destroy_write_struct(&png, &info);
         fprintf(stderr, "Error during PNG creation.\n");
-        return;
+        return RET_FAIL;
     }
 
     png_init_io(png, fp);
@@ -81,15 +484,58 @@ void img_png_write(const char *filename, Image *img)
     png_set_IHDR(png, info, img->width, img->height, 8, PNG_COLOR_TYPE_RGBA,
                  PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
 
-    // Convert the pixels array to row pointers
-    png_bytep row_pointers[img->height];
+    png_set_compression_level(png, opts->store_only ? 0 : opts->level);
+    png_set_compression_strategy(png, opts->store_only ? Z_DEFAULT_STRATEGY : img_png_zlib_strategy(opts->strategy));
+    png_set_filter(png, PNG_FILTER_TYPE_BASE, png_filter_flags(opts->filter));
+
+    // Rows are written one at a time, so tall images need no row pointer array
+    png_write_info(png, info);
     for (int y = 0; y < img->height; y++) {
-        row_pointers[y] = (png_bytep) &img->pixels[y * img->width];
+        png_write_row(png, (png_const_bytep)img_row(img, y));
     }
+    png_write_end(png, NULL);
 
-    png_set_rows(png, info, row_pointers);
-    png_write_png(png, info, PNG_TRANSFORM_IDENTITY, NULL);
-
-    fclose(fp);
     png_destroy_write_struct(&png, &info);
+    return RET_SUCCESS;
+}
+
+int img_png_write_fp(FILE *fp, const Image *img, const img_write_options *opts)
+{
+    if (!fp || !img || !img->pixels) return RET_FAIL;
+
+    img_write_options o = opts ? *opts : img_write_defaults();
+    if (o.level < 1) o.level = 1;
+    if (o.level > 9) o.level = 9;
+
+    // The strips run on the shared pool, so img_set_threads() caps the request
+    int threads = img_get_threads();
+    if (o.threads > 0 && o.threads < threads) threads = o.threads;
+
+    if (threads > 1 && img->height >= 2 * IMG_PNG_STRIP_MIN_ROWS) {
+        return img_png_write_strips(fp, img, &o, threads);
+    }
+    return write_serial(fp, img, &o);
+}
+
+int img_png_write_opts(const char *filename, const Image *img, const img_write_options *opts)
+{
+    if (!filename || !img || !img->pixels) return RET_FAIL;
+    IMG_TRACE_SCOPE("img_png_write");
+
+    FILE *fp = fopen(filename, "wb");
+    if (!fp) {
+        fprintf(stderr, "Could not open file %s for writing.\n", filename);
+        return RET_FAIL;
+    }
+
+    int ret = img_png_write_fp(fp, img, opts);
+
+    IMG_TRACE_COUNT(IMG_TRACE_BYTES_WRITTEN, ftell(fp));
+    if (fclose(fp) != 0) ret = RET_FAIL;
+    return ret;
+}
+
+void img_png_write(const char *filename, Image *img)
+{
+    img_png_write_opts(filename, img, NULL);
 }
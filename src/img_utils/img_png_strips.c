@@ -0,0 +1,336 @@
+/**
+ * Parallel PNG encoder.
+ *
+ * The image is cut into horizontal strips, each filtered and deflated on its
+ * own thread. Filters only look one row up, which is always available in the
+ * source image, so a strip's filtered bytes are exactly what a serial encoder
+ * would produce. Deflate matches across the strip boundary are recovered by
+ * priming each strip with the previous strip's tail as a preset dictionary.
+ * Strips run on the shared pool behind img_parallel_for(), so img_set_threads()
+ * bounds the encoder like every other image operation.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "../../include/img_utils.h"
+#include "../../internal/img_utils/internal_img_png.h"
+#include "../../internal/img_utils/internal_img_trace.h"
+#include "../../internal/thread/parallel.h"
+
+
+#define BPP 4                     // Bytes per RGBA8 pixel
+#define DICT_SIZE 32768           // Deflate window
+#define STRIPS_PER_THREAD 4       // Extra strips even out uneven strip costs
+#define ZLIB_HEADER 2
+#define ZLIB_TRAILER 4
+#define MAX_CHUNK ((size_t)1 << 30)
+
+typedef struct {
+    const Image *img;
+    const img_write_options *opts;
+    int y0, y1;             // Rows [y0, y1)
+    int last;               // Ends the zlib stream
+    unsigned char *out;     // ZLIB_HEADER bytes of headroom, the deflate data, then ZLIB_TRAILER bytes
+    size_t out_len;         // Length of the deflate data
+    uLong adler;            // Adler-32 of the strip's filtered bytes
+    int status;
+} strip_job;
+
+int img_png_zlib_strategy(img_zlib_strategy strategy)
+{
+    switch (strategy) {
+    case IMG_ZLIB_FILTERED:     return Z_FILTERED;
+    case IMG_ZLIB_HUFFMAN_ONLY: return Z_HUFFMAN_ONLY;
+    case IMG_ZLIB_RLE:          return Z_RLE;
+    default:                    return Z_DEFAULT_STRATEGY;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* Row filters                                                               */
+/* ------------------------------------------------------------------------- */
+
+static inline unsigned char paeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    if (pa <= pb && pa <= pc) return (unsigned char)a;
+    return (unsigned char)(pb <= pc ? b : c);
+}
+
+// Writes the filter type byte and the filtered row; `prev` is NULL for the first row
+static void filter_row(int type, const unsigned char *cur, const unsigned char *prev,
+                       unsigned char *out, size_t n)
+{
+    unsigned char *dst = out + 1;
+    out[0] = (unsigned char)type;
+
+    switch (type) {
+    case IMG_PNG_FILTER_NONE:
+        memcpy(dst, cur, n);
+        break;
+    case IMG_PNG_FILTER_SUB:
+        memcpy(dst, cur, BPP);
+        for (size_t i = BPP; i < n; i++) dst[i] = cur[i] - cur[i - BPP];
+        break;
+    case IMG_PNG_FILTER_UP:
+        if (!prev) {
+            memcpy(dst, cur, n);
+        } else {
+            for (size_t i = 0; i < n; i++) dst[i] = cur[i] - prev[i];
+        }
+        break;
+    case IMG_PNG_FILTER_AVERAGE:
+        for (size_t i = 0; i < n; i++) {
+            int left = i >= BPP ? cur[i - BPP] : 0;
+            int up = prev ? prev[i] : 0;
+            dst[i] = cur[i] - (unsigned char)((left + up) >> 1);
+        }
+        break;
+    case IMG_PNG_FILTER_PAETH:
+        for (size_t i = 0; i < n; i++) {
+            int left = i >= BPP ? cur[i - BPP] : 0;
+            int up = prev ? prev[i] : 0;
+            int diag = prev && i >= BPP ? prev[i - BPP] : 0;
+            dst[i] = cur[i] - paeth(left, up, diag);
+        }
+        break;
+    }
+}
+
+// Sum of the filtered bytes read as signed values; smaller usually deflates better
+static unsigned long filter_cost(const unsigned char *row, size_t n)
+{
+    unsigned long sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        int v = (signed char)row[i];
+        sum += (unsigned long)(v < 0 ? -v : v);
+    }
+    return sum;
+}
+
+/**
+ * Filters row y into `out` (1 + n bytes). The adaptive mode tries every
+ * filter and keeps the cheapest, using `trial` (1 + n bytes) as scratch.
+ */
+static void filter_image_row(const Image *img, int y, img_png_filter filter,
+                             unsigned char *out, unsigned char *trial)
+{
+    const size_t n = (size_t)img->width * BPP;
+    const unsigned char *cur = (const unsigned char *)img_row(img, y);
+    const unsigned char *prev = y > 0 ? (const unsigned char *)img_row(img, y - 1) : NULL;
+
+    if (filter != IMG_PNG_FILTER_ADAPTIVE) {
+        filter_row(filter, cur, prev, out, n);
+        return;
+    }
+
+    filter_row(IMG_PNG_FILTER_NONE, cur, prev, out, n);
+    unsigned long best = filter_cost(out + 1, n);
+    for (int type = IMG_PNG_FILTER_SUB; type <= IMG_PNG_FILTER_PAETH; type++) {
+        filter_row(type, cur, prev, trial, n);
+        unsigned long cost = filter_cost(trial + 1, n);
+        if (cost < best) {
+            best = cost;
+            memcpy(out, trial, n + 1);
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* Strips                                                                    */
+/* ------------------------------------------------------------------------- */
+
+// Re-filters the rows before the strip so deflate can reference them
+static int prime_dictionary(z_stream *zs, const strip_job *job, unsigned char *row, unsigned char *trial)
+{
+    const size_t row_bytes = (size_t)job->img->width * BPP + 1;
+    int rows = (int)((DICT_SIZE + row_bytes - 1) / row_bytes);
+    int first = job->y0 - rows < 0 ? 0 : job->y0 - rows;
+
+    size_t size = (size_t)(job->y0 - first) * row_bytes;
+    unsigned char *dict = (unsigned char *)malloc(size);
+    if (!dict) return RET_FAIL;
+
+    for (int y = first; y < job->y0; y++) {
+        filter_image_row(job->img, y, job->opts->filter, row, trial);
+        memcpy(dict + (size_t)(y - first) * row_bytes, row, row_bytes);
+    }
+
+    size_t used = size < DICT_SIZE ? size : DICT_SIZE;
+    int ret = deflateSetDictionary(zs, dict + size - used, (uInt)used) == Z_OK ? RET_SUCCESS : RET_FAIL;
+    free(dict);
+    return ret;
+}
+
+static void encode_strip(void *arg)
+{
+    IMG_TRACE_SCOPE("png_encode_strip");
+    strip_job *job = (strip_job *)arg;
+    const img_write_options *opts = job->opts;
+    const size_t row_bytes = (size_t)job->img->width * BPP + 1;
+    const size_t raw_bytes = row_bytes * (size_t)(job->y1 - job->y0);
+
+    job->status = RET_FAIL;
+    job->adler = adler32(0L, Z_NULL, 0);
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    int level = opts->store_only ? 0 : opts->level;
+    int strategy = opts->store_only ? Z_DEFAULT_STRATEGY : img_png_zlib_strategy(opts->strategy);
+    // Raw deflate: the zlib header and trailer are written once for the whole image
+    if (deflateInit2(&zs, level, Z_DEFLATED, -15, 8, strategy) != Z_OK) return;
+
+    // Sync flushes and stored-block framing add a few bytes on top of the bound
+    size_t capacity = deflateBound(&zs, (uLong)raw_bytes) + 64;
+    unsigned char *rows = (unsigned char *)malloc(2 * row_bytes);
+    job->out = (unsigned char *)malloc(ZLIB_HEADER + capacity + ZLIB_TRAILER);
+    if (!rows || !job->out) goto done;
+
+    unsigned char *row = rows, *trial = rows + row_bytes;
+    if (job->y0 > 0 && prime_dictionary(&zs, job, row, trial) != RET_SUCCESS) goto done;
+
+    zs.next_out = job->out + ZLIB_HEADER;
+    zs.avail_out = (uInt)capacity;
+
+    for (int y = job->y0; y < job->y1; y++) {
+        filter_image_row(job->img, y, opts->filter, row, trial);
+        job->adler = adler32(job->adler, row, (uInt)row_bytes);
+
+        zs.next_in = row;
+        zs.avail_in = (uInt)row_bytes;
+        if (deflate(&zs, Z_NO_FLUSH) != Z_OK || zs.avail_in != 0) goto done;
+    }
+
+    // A sync flush ends the strip on a byte boundary without ending the stream
+    int ret = deflate(&zs, job->last ? Z_FINISH : Z_SYNC_FLUSH);
+    if (ret != (job->last ? Z_STREAM_END : Z_OK)) goto done;
+
+    job->out_len = capacity - zs.avail_out;
+    job->status = RET_SUCCESS;
+
+done:
+    deflateEnd(&zs);
+    free(rows);
+}
+
+static void encode_strips(void *ctx, int begin, int end)
+{
+    strip_job *jobs = (strip_job *)ctx;
+    for (int s = begin; s < end; s++) {
+        encode_strip(&jobs[s]);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* Chunks                                                                    */
+/* ------------------------------------------------------------------------- */
+
+static void put_u32(unsigned char *p, uint32_t v)
+{
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+static int write_chunk(FILE *fp, const char *type, const unsigned char *data, size_t len)
+{
+    unsigned char head[8], tail[4];
+    put_u32(head, (uint32_t)len);
+    memcpy(head + 4, type, 4);
+
+    uLong crc = crc32(0L, head + 4, 4);
+    if (len) crc = crc32(crc, data, (uInt)len);
+    put_u32(tail, (uint32_t)crc);
+
+    if (fwrite(head, 1, 8, fp) != 8) return RET_FAIL;
+    if (len && fwrite(data, 1, len, fp) != len) return RET_FAIL;
+    if (fwrite(tail, 1, 4, fp) != 4) return RET_FAIL;
+    return RET_SUCCESS;
+}
+
+static int write_idat(FILE *fp, const unsigned char *data, size_t len)
+{
+    while (len > 0) {
+        size_t n = len < MAX_CHUNK ? len : MAX_CHUNK;
+        if (write_chunk(fp, "IDAT", data, n) != RET_SUCCESS) return RET_FAIL;
+        data += n;
+        len -= n;
+    }
+    return RET_SUCCESS;
+}
+
+int img_png_write_strips(FILE *fp, const Image *img, const img_write_options *opts, int threads)
+{
+    int strips = threads * STRIPS_PER_THREAD;
+    if (strips > img->height / IMG_PNG_STRIP_MIN_ROWS) strips = img->height / IMG_PNG_STRIP_MIN_ROWS;
+    if (strips < 1) strips = 1;
+
+    strip_job *jobs = (strip_job *)calloc(strips, sizeof(strip_job));
+    int ret = jobs ? RET_SUCCESS : RET_FAIL;
+
+    for (int s = 0; ret == RET_SUCCESS && s < strips; s++) {
+        strip_job *job = &jobs[s];
+        job->img = img;
+        job->opts = opts;
+        job->y0 = (int)((long long)img->height * s / strips);
+        job->y1 = (int)((long long)img->height * (s + 1) / strips);
+        job->last = s == strips - 1;
+        job->status = RET_FAIL;
+    }
+    if (ret == RET_SUCCESS) img_parallel_for(strips, 1, encode_strips, jobs);
+
+    for (int s = 0; ret == RET_SUCCESS && s < strips; s++) {
+        if (jobs[s].status != RET_SUCCESS) ret = RET_FAIL;
+    }
+
+    if (ret == RET_SUCCESS) {
+        static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        unsigned char ihdr[13];
+        put_u32(ihdr, (uint32_t)img->width);
+        put_u32(ihdr + 4, (uint32_t)img->height);
+        ihdr[8] = 8;    // Bit depth
+        ihdr[9] = 6;    // Colour type: RGBA
+        ihdr[10] = 0;   // Deflate
+        ihdr[11] = 0;   // Adaptive filtering
+        ihdr[12] = 0;   // No interlace
+
+        // zlib header: deflate with a 32 KiB window, level hint, check bits
+        int level = opts->store_only ? 0 : opts->level;
+        unsigned cmf = 0x78;
+        unsigned flg = (unsigned)(level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3) << 6;
+        flg += 31 - ((cmf << 8 | flg) % 31);
+        jobs[0].out[0] = (unsigned char)cmf;
+        jobs[0].out[1] = (unsigned char)flg;
+
+        // The trailer is the Adler-32 of all the filtered bytes, combined strip by strip
+        const size_t row_bytes = (size_t)img->width * BPP + 1;
+        uLong adler = adler32(0L, Z_NULL, 0);
+        for (int s = 0; s < strips; s++) {
+            z_off_t len = (z_off_t)(row_bytes * (size_t)(jobs[s].y1 - jobs[s].y0));
+            adler = adler32_combine(adler, jobs[s].adler, len);
+        }
+        strip_job *last = &jobs[strips - 1];
+        put_u32(last->out + ZLIB_HEADER + last->out_len, (uint32_t)adler);
+
+        if (fwrite(signature, 1, 8, fp) != 8) ret = RET_FAIL;
+        if (ret == RET_SUCCESS) ret = write_chunk(fp, "IHDR", ihdr, sizeof(ihdr));
+        for (int s = 0; ret == RET_SUCCESS && s < strips; s++) {
+            const unsigned char *data = jobs[s].out + (s == 0 ? 0 : ZLIB_HEADER);
+            size_t len = jobs[s].out_len + (s == 0 ? ZLIB_HEADER : 0) + (s == strips - 1 ? ZLIB_TRAILER : 0);
+            ret = write_idat(fp, data, len);
+        }
+        if (ret == RET_SUCCESS) ret = write_chunk(fp, "IEND", NULL, 0);
+    }
+
+    if (jobs) {
+        for (int s = 0; s < strips; s++) {
+            free(jobs[s].out);
+        }
+    }
+    free(jobs);
+    return ret;
+}
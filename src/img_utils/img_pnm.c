@@ -0,0 +1,190 @@
+/**
+ * Binary Netpbm (PGM, PPM and PAM) header parsing and writers.
+ */
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../../internal/img_utils/internal_img_pnm.h"
+#include "../../internal/img_utils/internal_img_pool.h"
+#include "../../internal/img_utils/internal_img_trace.h"
+
+
+#define PAM_DATA_ALIGNMENT 64 // Samples written by img_pam_write() start on this boundary
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+} pnm_cursor;
+
+static int is_space(uint8_t c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Skips whitespace and comments, which run from '#' to the end of the line
+static void skip_blanks(pnm_cursor *c)
+{
+    while (c->p < c->end) {
+        if (*c->p == '#') {
+            while (c->p < c->end && *c->p != '\n') c->p++;
+        } else if (is_space(*c->p)) {
+            c->p++;
+        } else {
+            break;
+        }
+    }
+}
+
+// Reads a positive decimal no larger than INT_MAX; returns 0 when there is none
+static int read_number(pnm_cursor *c)
+{
+    long long value = 0;
+    const uint8_t *start = c->p;
+    while (c->p < c->end && *c->p >= '0' && *c->p <= '9') {
+        value = value * 10 + (*c->p++ - '0');
+        if (value > INT_MAX) return 0;
+    }
+    return c->p > start ? (int)value : 0;
+}
+
+// Checks whether the cursor is at `word` followed by whitespace, and steps over the word
+static int match_word(pnm_cursor *c, const char *word)
+{
+    size_t len = strlen(word);
+    if ((size_t)(c->end - c->p) <= len || memcmp(c->p, word, len) != 0 || !is_space(c->p[len])) return 0;
+    c->p += len;
+    return 1;
+}
+
+// P5 and P6: width, height and maxval, then a single whitespace byte before the samples
+static int parse_pnm_header(pnm_cursor *c, img_raw_layout *layout)
+{
+    int values[3];
+    for (int i = 0; i < 3; i++) {
+        skip_blanks(c);
+        values[i] = read_number(c);
+        if (values[i] == 0) return RET_FAIL;
+    }
+    if (c->p >= c->end || !is_space(*c->p)) return RET_FAIL;
+    c->p++;
+
+    layout->width = values[0];
+    layout->height = values[1];
+    layout->maxval = values[2];
+    return RET_SUCCESS;
+}
+
+// P7: one "KEY value" line per field, up to an ENDHDR line; TUPLTYPE is implied by DEPTH
+static int parse_pam_header(pnm_cursor *c, img_raw_layout *layout)
+{
+    layout->width = layout->height = layout->channels = layout->maxval = 0;
+    for (;;) {
+        skip_blanks(c);
+        if (c->p >= c->end) return RET_FAIL;
+
+        int *field = NULL;
+        if (match_word(c, "ENDHDR")) break;
+        if (match_word(c, "WIDTH")) field = &layout->width;
+        else if (match_word(c, "HEIGHT")) field = &layout->height;
+        else if (match_word(c, "DEPTH")) field = &layout->channels;
+        else if (match_word(c, "MAXVAL")) field = &layout->maxval;
+        else if (!match_word(c, "TUPLTYPE")) return RET_FAIL;
+
+        if (field) {
+            while (c->p < c->end && (*c->p == ' ' || *c->p == '\t')) c->p++;
+            *field = read_number(c);
+            if (*field == 0) return RET_FAIL;
+        }
+        while (c->p < c->end && *c->p != '\n') c->p++;
+    }
+
+    // The samples follow the newline ending the ENDHDR line
+    while (c->p < c->end && *c->p != '\n') c->p++;
+    if (c->p >= c->end) return RET_FAIL;
+    c->p++;
+    return layout->width && layout->height && layout->channels && layout->maxval ? RET_SUCCESS : RET_FAIL;
+}
+
+int img_pnm_parse(const uint8_t *data, size_t size, img_raw_layout *layout)
+{
+    if (size < 3 || data[0] != 'P') return RET_FAIL;
+
+    pnm_cursor c = { data + 2, data + size };
+    memset(layout, 0, sizeof(*layout));
+    int ret;
+    switch (data[1]) {
+    case '5':
+        layout->channels = 1;
+        ret = parse_pnm_header(&c, layout);
+        break;
+    case '6':
+        layout->channels = 3;
+        ret = parse_pnm_header(&c, layout);
+        break;
+    case '7':
+        ret = parse_pam_header(&c, layout);
+        break;
+    default:
+        return RET_FAIL; // Plain-text and 1-bit variants
+    }
+    if (ret != RET_SUCCESS || layout->channels > 4 || layout->maxval > 65535) return RET_FAIL;
+
+    layout->sample_bytes = layout->maxval > 255 ? 2 : 1;
+    layout->order = IMG_RAW_RGB;
+    layout->offset = (size_t)(c.p - data);
+    if ((size_t)layout->width > PTRDIFF_MAX / 8) return RET_FAIL;
+    layout->pitch = (ptrdiff_t)layout->width * layout->channels * layout->sample_bytes;
+    return img_raw_check(layout, size);
+}
+
+int img_pam_write(FILE *fp, const Image *img)
+{
+    IMG_TRACE_SCOPE("img_pam_write");
+    char header[256];
+    int len = snprintf(header, sizeof(header), "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\n",
+                       img->width, img->height);
+
+    // Pad with a comment line of at least "#\n" so ENDHDR ends on the boundary
+    static const char end[] = "ENDHDR\n";
+    int total = (len + 2 + (int)sizeof(end) - 1 + PAM_DATA_ALIGNMENT - 1) / PAM_DATA_ALIGNMENT * PAM_DATA_ALIGNMENT;
+    int pad = total - len - ((int)sizeof(end) - 1);
+    header[len] = '#';
+    memset(header + len + 1, ' ', pad - 2);
+    header[len + pad - 1] = '\n';
+    memcpy(header + len + pad, end, sizeof(end) - 1);
+
+    int ok = fwrite(header, 1, total, fp) == (size_t)total;
+    size_t row_bytes = sizeof(pixel) * (size_t)img->width;
+    if (img->stride == img->width) {
+        ok = ok && fwrite(img->pixels, row_bytes, img->height, fp) == (size_t)img->height;
+    } else {
+        for (int y = 0; ok && y < img->height; y++) {
+            ok = fwrite(img_row(img, y), 1, row_bytes, fp) == row_bytes;
+        }
+    }
+    IMG_TRACE_COUNT(IMG_TRACE_BYTES_WRITTEN, total + row_bytes * img->height);
+    return ok ? RET_SUCCESS : RET_FAIL;
+}
+
+int img_ppm_write(FILE *fp, const Image *img)
+{
+    IMG_TRACE_SCOPE("img_ppm_write");
+    size_t row_bytes = 3 * (size_t)img->width;
+    uint8_t *row = (uint8_t *)img_pool_alloc(row_bytes);
+    if (!row) return RET_FAIL;
+
+    int ok = fprintf(fp, "P6\n%d %d\n255\n", img->width, img->height) > 0;
+    for (int y = 0; ok && y < img->height; y++) {
+        const pixel *src = img_row(img, y);
+        for (int x = 0; x < img->width; x++) {
+            row[3 * x] = src[x].R;
+            row[3 * x + 1] = src[x].G;
+            row[3 * x + 2] = src[x].B;
+        }
+        ok = fwrite(row, 1, row_bytes, fp) == row_bytes;
+    }
+    img_pool_free(row);
+    IMG_TRACE_COUNT(IMG_TRACE_BYTES_WRITTEN, row_bytes * img->height);
+    return ok ? RET_SUCCESS : RET_FAIL;
+}
@@ -0,0 +1,311 @@
+/**
+ * Image buffer pool.
+ *
+ * Blocks carry a 64-byte header recording their size class, so a block can be
+ * released into the right bucket, or back to the heap, regardless of whether
+ * the pool was enabled when it was allocated. Size classes step by quarter
+ * powers of two from 64 bytes up to 1 GiB; larger requests bypass the pool.
+ * While the pool is disabled, blocks are sized exactly, rounded up to the
+ * alignment, and always go back to the heap.
+ */
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../include/img_utils.h"
+#include "../../internal/img_utils/internal_img_pool.h"
+#include "../../internal/img_utils/internal_img_trace.h"
+
+
+#define POOL_MIN_SHIFT 6       // Smallest class: 64 bytes
+#define POOL_MAX_SHIFT 30      // Requests above 1 GiB are never pooled
+#define POOL_STEPS 4           // Classes per power of two
+#define POOL_CLASSES ((POOL_MAX_SHIFT - POOL_MIN_SHIFT) * POOL_STEPS + 1)
+#define POOL_UNPOOLED (-1)
+
+#define POOL_DEFAULT_RETAINED ((size_t)256 << 20)
+#define THREAD_CACHE_BLOCKS 4  // Blocks per class a thread keeps before spilling to the shared store
+
+typedef struct pool_block {
+    struct pool_block *next; // Free-list link while cached
+    size_t capacity;         // Usable bytes after the header
+    int size_class;          // Bucket index, or POOL_UNPOOLED
+} pool_block;
+
+// The header is padded to the alignment so the payload stays 64-byte aligned
+#define HEADER_SIZE (((sizeof(pool_block) + IMG_POOL_ALIGNMENT - 1) / IMG_POOL_ALIGNMENT) * IMG_POOL_ALIGNMENT)
+
+typedef struct {
+    pool_block *head[POOL_CLASSES];
+    int count[POOL_CLASSES];
+    size_t bytes;
+} thread_cache;
+
+static atomic_int pool_enabled;
+static atomic_size_t pool_limit = POOL_DEFAULT_RETAINED;
+
+static atomic_ullong stat_hits, stat_misses, stat_releases, stat_evictions;
+static atomic_ullong stat_retained;
+
+static pthread_mutex_t shared_lock = PTHREAD_MUTEX_INITIALIZER;
+static pool_block *shared_head[POOL_CLASSES];
+
+static _Thread_local thread_cache tcache;
+static _Thread_local int tcache_registered;
+static pthread_key_t tcache_key;
+static pthread_once_t tcache_key_once = PTHREAD_ONCE_INIT;
+
+static inline pool_block* block_of(const void *ptr)
+{
+    return (pool_block *)((unsigned char *)ptr - HEADER_SIZE);
+}
+
+static inline void* payload_of(pool_block *b)
+{
+    return (unsigned char *)b + HEADER_SIZE;
+}
+
+// Rounds a request up to its class; returns POOL_UNPOOLED for oversized requests
+static int size_class(size_t size, size_t *class_size)
+{
+    if (size <= ((size_t)1 << POOL_MIN_SHIFT)) {
+        *class_size = (size_t)1 << POOL_MIN_SHIFT;
+        return 0;
+    }
+
+    int shift = 63 - __builtin_clzll((unsigned long long)(size - 1)); // size is in (2^shift, 2^(shift+1)]
+    if (shift >= POOL_MAX_SHIFT) {
+        *class_size = size;
+        return POOL_UNPOOLED;
+    }
+
+    size_t base = (size_t)1 << shift;
+    size_t step = base / POOL_STEPS;
+    size_t j = (size - base + step - 1) / step;
+    *class_size = base + j * step;
+    return (shift - POOL_MIN_SHIFT) * POOL_STEPS + (int)j;
+}
+
+static pool_block* heap_alloc(size_t capacity, int cls)
+{
+    void *mem = NULL;
+    if (capacity > SIZE_MAX - HEADER_SIZE) return NULL;
+    if (posix_memalign(&mem, IMG_POOL_ALIGNMENT, HEADER_SIZE + capacity) != 0) return NULL;
+
+    pool_block *b = (pool_block *)mem;
+    b->next = NULL;
+    b->capacity = capacity;
+    b->size_class = cls;
+    return b;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Shared store                                                              */
+/* ------------------------------------------------------------------------- */
+
+// Counts bytes as retained if they fit under the limit; the check and the add
+// are one step, so concurrent releases cannot overshoot the limit together
+static int retain(size_t bytes)
+{
+    unsigned long long retained = atomic_load(&stat_retained);
+    size_t limit = atomic_load(&pool_limit);
+    do {
+        if (retained + bytes > limit) return 0;
+    } while (!atomic_compare_exchange_weak(&stat_retained, &retained, retained + bytes));
+    return 1;
+}
+
+// Caches a block in the shared store, or frees it when over the retention limit
+static void shared_put(pool_block *b)
+{
+    if (!retain(b->capacity)) {
+        atomic_fetch_add(&stat_evictions, 1);
+        free(b);
+        return;
+    }
+
+    pthread_mutex_lock(&shared_lock);
+    b->next = shared_head[b->size_class];
+    shared_head[b->size_class] = b;
+    pthread_mutex_unlock(&shared_lock);
+}
+
+static pool_block* shared_take(int cls)
+{
+    pthread_mutex_lock(&shared_lock);
+    pool_block *b = shared_head[cls];
+    if (b) shared_head[cls] = b->next;
+    pthread_mutex_unlock(&shared_lock);
+
+    if (b) atomic_fetch_sub(&stat_retained, b->capacity);
+    return b;
+}
+
+static void shared_release_all(void)
+{
+    pthread_mutex_lock(&shared_lock);
+    for (int c = 0; c < POOL_CLASSES; c++) {
+        pool_block *b = shared_head[c];
+        shared_head[c] = NULL;
+        while (b) {
+            pool_block *next = b->next;
+            atomic_fetch_sub(&stat_retained, b->capacity);
+            free(b);
+            b = next;
+        }
+    }
+    pthread_mutex_unlock(&shared_lock);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Per-thread cache                                                          */
+/* ------------------------------------------------------------------------- */
+
+// Empties a thread cache, either into the shared store or back to the heap
+static void tcache_drain(thread_cache *tc, int to_shared)
+{
+    for (int c = 0; c < POOL_CLASSES; c++) {
+        pool_block *b = tc->head[c];
+        tc->head[c] = NULL;
+        tc->count[c] = 0;
+        while (b) {
+            pool_block *next = b->next;
+            atomic_fetch_sub(&stat_retained, b->capacity);
+            if (to_shared) {
+                shared_put(b);
+            } else {
+                free(b);
+            }
+            b = next;
+        }
+    }
+    tc->bytes = 0;
+}
+
+// Thread exit hook: hand the exiting thread's blocks to the other threads
+static void tcache_destructor(void *arg)
+{
+    tcache_drain((thread_cache *)arg, atomic_load(&pool_enabled));
+}
+
+static void tcache_key_create(void)
+{
+    pthread_key_create(&tcache_key, tcache_destructor);
+}
+
+static thread_cache* tcache_get(void)
+{
+    if (!tcache_registered) {
+        pthread_once(&tcache_key_once, tcache_key_create);
+        pthread_setspecific(tcache_key, &tcache);
+        tcache_registered = 1;
+    }
+    return &tcache;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Allocation                                                                */
+/* ------------------------------------------------------------------------- */
+
+void* img_pool_alloc(size_t size)
+{
+    size_t capacity;
+    int cls = size_class(size, &capacity);
+    IMG_TRACE_COUNT(IMG_TRACE_ALLOCS, 1);
+
+    if (!atomic_load_explicit(&pool_enabled, memory_order_relaxed)) {
+        // Blocks left behind by a disabled pool are released lazily
+        if (tcache.bytes) tcache_drain(&tcache, 0);
+        if (size > SIZE_MAX - IMG_POOL_ALIGNMENT) return NULL;
+        size_t exact = (size + IMG_POOL_ALIGNMENT - 1) & ~(size_t)(IMG_POOL_ALIGNMENT - 1);
+        pool_block *b = heap_alloc(exact, POOL_UNPOOLED);
+        return b ? payload_of(b) : NULL;
+    }
+
+    if (cls != POOL_UNPOOLED) {
+        thread_cache *tc = tcache_get();
+        pool_block *b = tc->head[cls];
+        if (b) {
+            tc->head[cls] = b->next;
+            tc->count[cls]--;
+            tc->bytes -= b->capacity;
+            atomic_fetch_sub(&stat_retained, b->capacity);
+        } else {
+            b = shared_take(cls);
+        }
+        if (b) {
+            atomic_fetch_add_explicit(&stat_hits, 1, memory_order_relaxed);
+            return payload_of(b);
+        }
+    }
+
+    atomic_fetch_add_explicit(&stat_misses, 1, memory_order_relaxed);
+    pool_block *b = heap_alloc(capacity, cls);
+    return b ? payload_of(b) : NULL;
+}
+
+void img_pool_free(void *ptr)
+{
+    if (!ptr) return;
+    pool_block *b = block_of(ptr);
+
+    if (!atomic_load_explicit(&pool_enabled, memory_order_relaxed) || b->size_class == POOL_UNPOOLED) {
+        free(b);
+        return;
+    }
+
+    atomic_fetch_add_explicit(&stat_releases, 1, memory_order_relaxed);
+
+    // Keep a few blocks per class locally; spill the rest to the shared store
+    thread_cache *tc = tcache_get();
+    size_t thread_limit = atomic_load(&pool_limit) / 8;
+    if (tc->count[b->size_class] < THREAD_CACHE_BLOCKS && tc->bytes + b->capacity <= thread_limit &&
+        retain(b->capacity)) {
+        b->next = tc->head[b->size_class];
+        tc->head[b->size_class] = b;
+        tc->count[b->size_class]++;
+        tc->bytes += b->capacity;
+        return;
+    }
+    shared_put(b);
+}
+
+size_t img_pool_block_size(const void *ptr)
+{
+    return block_of(ptr)->capacity;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+void img_pool_enable(size_t max_retained_bytes)
+{
+    atomic_store(&pool_limit, max_retained_bytes ? max_retained_bytes : POOL_DEFAULT_RETAINED);
+    atomic_store(&pool_enabled, 1);
+}
+
+void img_pool_disable(void)
+{
+    atomic_store(&pool_enabled, 0);
+    tcache_drain(&tcache, 0);
+    shared_release_all();
+}
+
+void img_pool_trim(void)
+{
+    tcache_drain(&tcache, 0);
+    shared_release_all();
+}
+
+void img_pool_get_stats(img_pool_stats *stats)
+{
+    if (!stats) return;
+    stats->hits = atomic_load(&stat_hits);
+    stats->misses = atomic_load(&stat_misses);
+    stats->releases = atomic_load(&stat_releases);
+    stats->evictions = atomic_load(&stat_evictions);
+    stats->bytes_retained = atomic_load(&stat_retained);
+}
@@ -0,0 +1,270 @@
+/**
+ * Memory-mapped loading of uncompressed image files.
+ *
+ * The file is mapped privately and parsed in place. Images whose layout
+ * matches the file are handles into the mapping, which they keep alive;
+ * everything else is converted row by row with the decoder's row kernels.
+ */
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../../internal/img_utils/internal_img_bmp.h"
+#include "../../internal/img_utils/internal_img_convert.h"
+#include "../../internal/img_utils/internal_img_pnm.h"
+#include "../../internal/img_utils/internal_img_pool.h"
+#include "../../internal/img_utils/internal_img_raw.h"
+#include "../../internal/img_utils/internal_img_storage.h"
+#include "../../internal/img_utils/internal_img_trace.h"
+
+
+int img_raw_check(const img_raw_layout *layout, size_t size)
+{
+    if (layout->width <= 0 || layout->height <= 0 || layout->channels < 1 || layout->channels > 4) return RET_FAIL;
+    if (layout->maxval < 1 || (layout->sample_bytes != 1 && layout->sample_bytes != 2)) return RET_FAIL;
+
+    size_t row_bytes = (size_t)layout->width * layout->channels * layout->sample_bytes;
+    size_t pitch = layout->pitch < 0 ? (size_t)-layout->pitch : (size_t)layout->pitch;
+    if (pitch < row_bytes || layout->offset > size || size - layout->offset < row_bytes) return RET_FAIL;
+
+    // The last row lies after the first one in top-down files and before it otherwise
+    size_t span = pitch * (size_t)(layout->height - 1);
+    if (pitch != 0 && span / pitch != (size_t)(layout->height - 1)) return RET_FAIL;
+    if (layout->pitch < 0) return span <= layout->offset ? RET_SUCCESS : RET_FAIL;
+    return span <= size - layout->offset - row_bytes ? RET_SUCCESS : RET_FAIL;
+}
+
+// Parses a file according to its magic bytes
+static int raw_parse(const uint8_t *data, size_t size, img_raw_layout *layout)
+{
+    return data[0] == 'B' ? img_bmp_parse(data, size, layout) : img_pnm_parse(data, size, layout);
+}
+
+// Maps the file behind fp and parses it
+static img_storage* raw_map(FILE *fp, img_raw_layout *layout)
+{
+    img_storage *s = img_storage_map(fileno(fp));
+    if (!s) return NULL;
+
+    if (raw_parse((const uint8_t *)s->data, s->size, layout) != RET_SUCCESS) {
+        img_storage_release(s);
+        return NULL;
+    }
+    return s;
+}
+
+static const uint8_t* raw_row(const uint8_t *data, const img_raw_layout *layout, int y)
+{
+    return data + layout->offset + (ptrdiff_t)y * layout->pitch;
+}
+
+// 8-bit samples ranging over [0, 255] need no rescaling
+static int full_range(const img_raw_layout *layout)
+{
+    return layout->sample_bytes == 1 && layout->maxval == 255;
+}
+
+// Samples already sit in the order of the native packed layout
+static int native_order(const img_raw_layout *layout)
+{
+    return !layout->opaque && (layout->channels < 3 || layout->order == IMG_RAW_RGB);
+}
+
+// Top-down 8-bit RGBA rows can back an Image directly
+static int direct_rgba(const img_raw_layout *layout)
+{
+    return full_range(layout) && layout->channels == 4 && native_order(layout) && layout->pitch > 0 &&
+           layout->pitch % sizeof(pixel) == 0 && layout->pitch / sizeof(pixel) <= INT_MAX;
+}
+
+static int direct_packed(const img_raw_layout *layout)
+{
+    return full_range(layout) && native_order(layout) && layout->pitch > 0;
+}
+
+// Scales one row of samples to [0, 255], narrowing 16-bit samples
+static void scale_samples(const img_raw_layout *layout, const uint8_t *src, uint8_t *dst, size_t n)
+{
+    if (layout->sample_bytes == 2 && layout->maxval == 65535) {
+        img_cvt_narrow16(src, dst, n);
+        return;
+    }
+    uint32_t maxval = (uint32_t)layout->maxval;
+    for (size_t i = 0; i < n; i++) {
+        uint32_t v = layout->sample_bytes == 2 ? (uint32_t)src[2 * i] << 8 | src[2 * i + 1] : src[i];
+        if (v > maxval) v = maxval; // Out-of-range samples in corrupt files
+        dst[i] = (uint8_t)((v * 255 + maxval / 2) / maxval);
+    }
+}
+
+// Brings a row to 8-bit samples in RGB order, dropping padding samples. The
+// result is in tmp unless the row needed no change
+static const uint8_t* normalize_row(const img_raw_layout *layout, const uint8_t *src, uint8_t *tmp)
+{
+    int w = layout->width;
+    if (!full_range(layout)) {
+        scale_samples(layout, src, tmp, (size_t)w * layout->channels);
+        src = tmp;
+    }
+    if (native_order(layout)) return src;
+
+    // Never wider than the input, so it may be done in place
+    int in = layout->channels, out = layout->opaque ? 3 : in;
+    int swap = layout->order == IMG_RAW_BGR;
+    for (int x = 0; x < w; x++) {
+        const uint8_t *p = src + (size_t)in * x;
+        uint8_t c0 = p[0], c1 = p[1], c2 = p[2], a = in == 4 ? p[3] : 255;
+        uint8_t *q = tmp + (size_t)out * x;
+        q[0] = swap ? c2 : c0;
+        q[1] = c1;
+        q[2] = swap ? c0 : c2;
+        if (out == 4) q[3] = a;
+    }
+    return tmp;
+}
+
+// Converts a file row to RGBA pixels
+static void convert_rgba(const img_raw_layout *layout, const uint8_t *src, uint8_t *tmp, pixel *dst)
+{
+    int w = layout->width;
+    const uint8_t *row = normalize_row(layout, src, tmp);
+    switch (layout->opaque ? 3 : layout->channels) {
+    case 1: img_cvt_gray_to_rgba(row, dst, w); break;
+    case 2: img_cvt_gray_alpha_to_rgba(row, dst, w); break;
+    case 3: img_cvt_rgb_to_rgba(row, dst, w); break;
+    default: memcpy(dst, row, sizeof(pixel) * (size_t)w); break;
+    }
+}
+
+// Scratch row for converted samples: up to 4 samples per pixel
+static uint8_t* alloc_scratch(const img_raw_layout *layout)
+{
+    return (uint8_t *)img_pool_alloc(4 * (size_t)layout->width);
+}
+
+// Builds an image over file data: in place when the data is mapped storage
+// whose layout allows it, converted into a new image otherwise
+static Image* raw_image(const uint8_t *data, const img_raw_layout *layout, img_storage *s)
+{
+    if (s && direct_rgba(layout)) {
+        pixel *pixels = (pixel *)(data + layout->offset);
+        return img_handle_new(s, pixels, layout->width, layout->height, (int)(layout->pitch / sizeof(pixel)));
+    }
+
+    Image *image = img_new(layout->width, layout->height);
+    uint8_t *tmp = image ? alloc_scratch(layout) : NULL;
+    if (!tmp) {
+        img_free(image);
+        return NULL;
+    }
+    for (int y = 0; y < layout->height; y++) {
+        convert_rgba(layout, raw_row(data, layout, y), tmp, img_row(image, y));
+    }
+    img_pool_free(tmp);
+    return image;
+}
+
+Image* img_raw_open(FILE *fp)
+{
+    IMG_TRACE_SCOPE("img_raw_open");
+    img_raw_layout layout;
+    img_storage *s = raw_map(fp, &layout);
+    if (!s) return NULL;
+
+    Image *image = raw_image((const uint8_t *)s->data, &layout, s);
+    img_storage_release(s); // The image holds its own reference when it maps the file
+    if (!image) return NULL;
+
+    IMG_TRACE_COUNT(IMG_TRACE_PIXELS, (size_t)layout.width * layout.height);
+    IMG_TRACE_COUNT(IMG_TRACE_BYTES_READ, (size_t)layout.width * layout.channels * layout.sample_bytes * layout.height);
+    return image;
+}
+
+Image* img_raw_open_mem(const void *data, size_t size)
+{
+    IMG_TRACE_SCOPE("img_raw_open_mem");
+    img_raw_layout layout;
+    if (size == 0 || raw_parse((const uint8_t *)data, size, &layout) != RET_SUCCESS) return NULL;
+
+    Image *image = raw_image((const uint8_t *)data, &layout, NULL);
+    if (image) IMG_TRACE_COUNT(IMG_TRACE_PIXELS, (size_t)layout.width * layout.height);
+    return image;
+}
+
+img_packed* img_raw_open_packed(FILE *fp)
+{
+    IMG_TRACE_SCOPE("img_raw_open_packed");
+    img_raw_layout layout;
+    img_storage *s = raw_map(fp, &layout);
+    if (!s) return NULL;
+
+    int channels = layout.opaque ? 3 : layout.channels;
+    img_packed *image = NULL;
+    if (direct_packed(&layout)) {
+        image = (img_packed *)img_pool_alloc(sizeof(img_packed));
+        if (image) {
+            image->width = layout.width;
+            image->height = layout.height;
+            image->channels = channels;
+            image->stride = (size_t)layout.pitch;
+            image->data = (unsigned char *)s->data + layout.offset;
+            image->storage = s;
+            img_storage_retain(s);
+        }
+    } else {
+        image = img_packed_new(layout.width, layout.height, channels);
+        uint8_t *tmp = image ? alloc_scratch(&layout) : NULL;
+        size_t row_bytes = (size_t)layout.width * channels;
+        for (int y = 0; tmp && y < layout.height; y++) {
+            const uint8_t *row = normalize_row(&layout, raw_row(s->data, &layout, y), tmp);
+            memcpy(image->data + y * image->stride, row, row_bytes);
+        }
+        if (!tmp) {
+            img_packed_free(image);
+            image = NULL;
+        }
+        img_pool_free(tmp);
+    }
+    img_storage_release(s);
+    if (!image) return NULL;
+
+    IMG_TRACE_COUNT(IMG_TRACE_PIXELS, (size_t)layout.width * layout.height);
+    IMG_TRACE_COUNT(IMG_TRACE_BYTES_READ, (size_t)layout.width * layout.channels * layout.sample_bytes * layout.height);
+    return image;
+}
+
+int img_raw_read_rows(FILE *fp, img_header_fn header, img_row_sink sink, void *ctx)
+{
+    IMG_TRACE_SCOPE("img_raw_read_rows");
+    img_raw_layout layout;
+    img_storage *s = raw_map(fp, &layout);
+    if (!s) return RET_FAIL;
+
+    int rows = header(ctx, layout.width, layout.height);
+    if (rows < 0) {
+        img_storage_release(s);
+        return RET_FAIL;
+    }
+    if (rows > layout.height) rows = layout.height;
+
+    // Direct rows go to the sink as they are; the others through one converted row
+    int direct = direct_rgba(&layout);
+    pixel *row = direct ? NULL : (pixel *)img_pool_alloc(sizeof(pixel) * (size_t)layout.width);
+    uint8_t *tmp = direct ? NULL : alloc_scratch(&layout);
+    int ret = direct || (row && tmp) ? RET_SUCCESS : RET_FAIL;
+    for (int y = 0; ret == RET_SUCCESS && y < rows; y++) {
+        const uint8_t *src = raw_row(s->data, &layout, y);
+        if (direct) {
+            sink(ctx, y, (const pixel *)src, layout.width);
+        } else {
+            convert_rgba(&layout, src, tmp, row);
+            sink(ctx, y, row, layout.width);
+        }
+    }
+    img_pool_free(row);
+    img_pool_free(tmp);
+    img_storage_release(s);
+
+    IMG_TRACE_COUNT(IMG_TRACE_BYTES_READ, (size_t)layout.width * layout.channels * layout.sample_bytes * rows);
+    return ret;
+}
@@ -0,0 +1,800 @@
+/**
+ * Separable resize engine.
+ *
+ * A horizontal pass resamples each needed source row into a ring of
+ * intermediate rows, and a vertical pass blends the ring rows into the
+ * destination row. Both passes use 14-bit fixed-point weights and have
+ * SSE2/AVX2/AVX-512 kernels for RGBA8 with a scalar fallback.
+ */
+#include <math.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define IMG_RESIZE_X86 1
+#endif
+
+#include "../../include/img_utils.h"
+#include "../../internal/img_utils/internal_img_cpu.h"
+#include "../../internal/img_utils/internal_img_io.h"
+#include "../../internal/img_utils/internal_img_resize.h"
+#include "../../internal/img_utils/internal_img_scratch.h"
+#include "../../internal/img_utils/internal_img_trace.h"
+#include "../../internal/thread/parallel.h"
+
+
+#define ROUND_BIAS (1 << (IMG_RESIZE_PRECISION - 1))
+
+static inline unsigned char clip8(int v)
+{
+    return v < 0 ? 0 : (v > 255 ? 255 : (unsigned char)v);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Coefficient tables                                                        */
+/* ------------------------------------------------------------------------- */
+
+// Converts float weights to fixed point so they sum to exactly 1 << IMG_RESIZE_PRECISION
+static void quantize_weights(const double *w, int16_t *out, int taps)
+{
+    int sum = 0, largest = 0;
+    for (int k = 0; k < taps; k++) {
+        out[k] = (int16_t)lround(w[k] * (1 << IMG_RESIZE_PRECISION));
+        sum += out[k];
+        if (out[k] > out[largest]) largest = k;
+    }
+    out[largest] += (1 << IMG_RESIZE_PRECISION) - sum;
+}
+
+// Widest box window, at most ceil(scale) + 1; integer factors need only ceil(scale)
+static int area_taps(int in_size, double origin, double scale, int out_size)
+{
+    int taps = 1;
+    for (int i = 0; i < out_size; i++) {
+        int first = (int)floor(origin + i * scale);
+        int last = (int)ceil(origin + (i + 1) * scale);
+        if (last > in_size) last = in_size;
+        if (last - first > taps) taps = last - first;
+    }
+    return taps;
+}
+
+// Fills one axis table resampling the window [origin, origin + extent) of in_size
+// samples; offset is the ROI origin on this axis and the window is relative to it
+static int build_axis(img_resize_axis *ax, int in_size, int offset, double origin, double extent,
+                      int out_size, img_filter filter)
+{
+    double scale = extent / out_size;
+    int taps;
+
+    if (filter == IMG_FILTER_AREA && scale <= 1.0) filter = IMG_FILTER_BILINEAR;
+
+    switch (filter) {
+    case IMG_FILTER_NEAREST:  taps = 1; break;
+    case IMG_FILTER_BILINEAR: taps = 2; break;
+    case IMG_FILTER_AREA:     taps = area_taps(in_size, origin, scale, out_size); break;
+    default: return RET_FAIL;
+    }
+    if (taps > in_size) taps = in_size;
+
+    ax->out_size = out_size;
+    ax->taps = taps;
+    ax->start = (int *)malloc(sizeof(int) * out_size);
+    ax->weights = (int16_t *)calloc((size_t)out_size * taps, sizeof(int16_t));
+    double *w = (double *)malloc(sizeof(double) * (2 * taps + 1));
+    if (!ax->start || !ax->weights || !w) {
+        free(w);
+        return RET_FAIL;
+    }
+
+    for (int i = 0; i < out_size; i++) {
+        int first = 0;   // first input sample with a non-zero weight
+        int count = 0;   // number of non-zero weights written to w
+        memset(w, 0, sizeof(double) * (taps + 1));
+
+        if (filter == IMG_FILTER_NEAREST) {
+            first = (int)(origin + (i + 0.5) * scale);
+            if (first > in_size - 1) first = in_size - 1;
+            w[0] = 1.0;
+            count = 1;
+        } else if (filter == IMG_FILTER_BILINEAR) {
+            double center = origin + (i + 0.5) * scale - 0.5;
+            first = (int)floor(center);
+            double frac = center - first;
+            if (first < 0) {
+                first = 0;
+                frac = 0.0;
+            }
+            if (first >= in_size - 1) {
+                first = in_size - 1;
+                frac = 0.0;
+            }
+            w[0] = 1.0 - frac;
+            w[1] = frac;
+            count = first + 1 < in_size ? 2 : 1;
+        } else {
+            // Box filter: weight each input sample by its overlap with [lo, hi)
+            double lo = origin + i * scale, hi = origin + (i + 1) * scale;
+            first = (int)floor(lo);
+            int last = (int)ceil(hi);
+            if (last > in_size) last = in_size;
+            for (int s = first; s < last; s++) {
+                double a = s < lo ? lo : s;
+                double b = s + 1 > hi ? hi : s + 1;
+                w[s - first] = (b - a) / scale;
+            }
+            count = last - first;
+        }
+
+        // Shift windows that would run past the end so all outputs have `taps` taps
+        int start = first;
+        if (start + taps > in_size) start = in_size - taps;
+        int shift = first - start;
+        int16_t *dst = ax->weights + (size_t)i * taps;
+        double *tmp = w + taps + 1;
+        for (int k = 0; k < taps; k++) {
+            int src = k - shift;
+            tmp[k] = (src >= 0 && src < count) ? w[src] : 0.0;
+        }
+        quantize_weights(tmp, dst, taps);
+        ax->start[i] = start + offset;
+    }
+
+    free(w);
+    return RET_SUCCESS;
+}
+
+// Fills a plan for an integer ROI and the fractional window inside it
+static int plan_setup(img_resize_plan *plan, int src_width, int src_height,
+                      int roi_x, int roi_y, int roi_width, int roi_height,
+                      double origin_x, double origin_y, double extent_x, double extent_y,
+                      int dst_width, int dst_height, img_filter filter)
+{
+    plan->src_width = src_width;
+    plan->src_height = src_height;
+    plan->roi_x = roi_x;
+    plan->roi_y = roi_y;
+    plan->roi_width = roi_width;
+    plan->roi_height = roi_height;
+    plan->dst_width = dst_width;
+    plan->dst_height = dst_height;
+    plan->filter = filter;
+
+    if (build_axis(&plan->x, roi_width, roi_x, origin_x, extent_x, dst_width, filter) != RET_SUCCESS ||
+        build_axis(&plan->y, roi_height, roi_y, origin_y, extent_y, dst_height, filter) != RET_SUCCESS) {
+        img_resize_plan_release(plan);
+        return RET_FAIL;
+    }
+    return RET_SUCCESS;
+}
+
+int img_resize_plan_init(img_resize_plan *plan, int src_width, int src_height,
+                         int roi_x, int roi_y, int roi_width, int roi_height,
+                         int dst_width, int dst_height, img_filter filter)
+{
+    memset(plan, 0, sizeof(*plan));
+    if (src_width <= 0 || src_height <= 0 || dst_width <= 0 || dst_height <= 0) return RET_FAIL;
+    if (roi_x < 0 || roi_y < 0 || roi_width <= 0 || roi_height <= 0) return RET_FAIL;
+    if (roi_x + roi_width > src_width || roi_y + roi_height > src_height) return RET_FAIL;
+
+    return plan_setup(plan, src_width, src_height, roi_x, roi_y, roi_width, roi_height,
+                      0.0, 0.0, roi_width, roi_height, dst_width, dst_height, filter);
+}
+
+int img_resize_plan_init_region(img_resize_plan *plan, int src_width, int src_height,
+                                double x0, double y0, double x1, double y1,
+                                int dst_width, int dst_height, img_filter filter)
+{
+    memset(plan, 0, sizeof(*plan));
+    if (src_width <= 0 || src_height <= 0 || dst_width <= 0 || dst_height <= 0) return RET_FAIL;
+    if (!(x0 >= 0.0 && y0 >= 0.0 && x1 > x0 && y1 > y0)) return RET_FAIL;
+    if (x1 > src_width || y1 > src_height) return RET_FAIL;
+
+    // The ROI is the pixel-aligned box around the region
+    int bx0 = (int)floor(x0), by0 = (int)floor(y0);
+    int bx1 = (int)ceil(x1), by1 = (int)ceil(y1);
+    return plan_setup(plan, src_width, src_height, bx0, by0, bx1 - bx0, by1 - by0,
+                      x0 - bx0, y0 - by0, x1 - x0, y1 - y0, dst_width, dst_height, filter);
+}
+
+void img_resize_plan_release(img_resize_plan *plan)
+{
+    if (!plan) return;
+    free(plan->x.start);
+    free(plan->x.weights);
+    free(plan->y.start);
+    free(plan->y.weights);
+    memset(plan, 0, sizeof(*plan));
+}
+
+// The last plan of each thread; its tables live in the thread's scratch block
+static _Thread_local img_resize_plan cached_plan;
+static _Thread_local img_scratch cached_tables;
+
+const img_resize_plan* img_resize_plan_cached(int src_width, int src_height,
+                                              int roi_x, int roi_y, int roi_width, int roi_height,
+                                              int dst_width, int dst_height, img_filter filter)
+{
+    img_resize_plan *p = &cached_plan;
+    if (p->x.start && p->src_width == src_width && p->src_height == src_height &&
+        p->roi_x == roi_x && p->roi_y == roi_y && p->roi_width == roi_width &&
+        p->roi_height == roi_height && p->dst_width == dst_width &&
+        p->dst_height == dst_height && p->filter == filter) {
+        return p;
+    }
+
+    // Rebuild, then move the tables into the scratch block so they go away with the thread
+    img_resize_plan plan;
+    p->x.start = NULL;
+    if (img_resize_plan_init(&plan, src_width, src_height, roi_x, roi_y, roi_width, roi_height,
+                             dst_width, dst_height, filter) != RET_SUCCESS) {
+        return NULL;
+    }
+    size_t xs = sizeof(int) * plan.x.out_size, ys = sizeof(int) * plan.y.out_size;
+    size_t xw = sizeof(int16_t) * plan.x.out_size * plan.x.taps;
+    size_t yw = sizeof(int16_t) * plan.y.out_size * plan.y.taps;
+    unsigned char *block = (unsigned char *)img_scratch_reserve(&cached_tables, xs + ys + xw + yw);
+    if (block) {
+        *p = plan;
+        p->x.start = (int *)memcpy(block, plan.x.start, xs);
+        p->y.start = (int *)memcpy(block + xs, plan.y.start, ys);
+        p->x.weights = (int16_t *)memcpy(block + xs + ys, plan.x.weights, xw);
+        p->y.weights = (int16_t *)memcpy(block + xs + ys + xw, plan.y.weights, yw);
+    }
+    img_resize_plan_release(&plan);
+    return block ? p : NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Horizontal pass                                                           */
+/* ------------------------------------------------------------------------- */
+
+static void hpass_nearest(pixel *dst, const pixel *src, const img_resize_axis *ax)
+{
+    for (int x = 0; x < ax->out_size; x++) {
+        dst[x] = src[ax->start[x]];
+    }
+}
+
+static void hpass_scalar(pixel *dst, const pixel *src, const img_resize_axis *ax)
+{
+    const int taps = ax->taps;
+    for (int x = 0; x < ax->out_size; x++) {
+        const pixel *s = src + ax->start[x];
+        const int16_t *w = ax->weights + (size_t)x * taps;
+        int r = ROUND_BIAS, g = ROUND_BIAS, b = ROUND_BIAS, a = ROUND_BIAS;
+        for (int k = 0; k < taps; k++) {
+            r += s[k].R * w[k];
+            g += s[k].G * w[k];
+            b += s[k].B * w[k];
+            a += s[k].A * w[k];
+        }
+        dst[x].R = clip8(r >> IMG_RESIZE_PRECISION);
+        dst[x].G = clip8(g >> IMG_RESIZE_PRECISION);
+        dst[x].B = clip8(b >> IMG_RESIZE_PRECISION);
+        dst[x].A = clip8(a >> IMG_RESIZE_PRECISION);
+    }
+}
+
+#ifdef IMG_RESIZE_X86
+// One output pixel per iteration; source taps are blended two at a time with pmaddwd
+__attribute__((target("sse2")))
+static void hpass_sse2(pixel *dst, const pixel *src, const img_resize_axis *ax)
+{
+    const int taps = ax->taps;
+    const __m128i zero = _mm_setzero_si128();
+
+    for (int x = 0; x < ax->out_size; x++) {
+        const pixel *s = src + ax->start[x];
+        const int16_t *w = ax->weights + (size_t)x * taps;
+        __m128i acc = _mm_set1_epi32(ROUND_BIAS);
+        int k = 0;
+
+        for (; k + 1 < taps; k += 2) {
+            // R0 G0 B0 A0 R1 G1 B1 A1 -> R0 R1 G0 G1 B0 B1 A0 A1 as 16-bit lanes
+            __m128i px = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(s + k)), zero);
+            px = _mm_unpacklo_epi16(px, _mm_srli_si128(px, 8));
+            __m128i wk = _mm_set1_epi32((uint16_t)w[k] | ((int32_t)w[k + 1] << 16));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(px, wk));
+        }
+        if (k < taps) {
+            int32_t v;
+            memcpy(&v, s + k, sizeof(v));
+            __m128i px = _mm_unpacklo_epi8(_mm_cvtsi32_si128(v), zero);
+            px = _mm_unpacklo_epi16(px, zero);
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(px, _mm_set1_epi32((uint16_t)w[k])));
+        }
+
+        acc = _mm_srai_epi32(acc, IMG_RESIZE_PRECISION);
+        acc = _mm_packs_epi32(acc, acc);
+        acc = _mm_packus_epi16(acc, acc);
+        int32_t out = _mm_cvtsi128_si32(acc);
+        memcpy(dst + x, &out, sizeof(out));
+    }
+}
+
+// Packed pair of 16-bit weights as pmaddwd consumes them
+static inline int32_t weight_pair(const int16_t *w)
+{
+    int32_t v;
+    memcpy(&v, w, sizeof(v));
+    return v;
+}
+
+// Adds taps (k, k + 1) of outputs 0/1 and 2/3, given as byte pairs R0 G0 B0 A0 R1 G1 B1 A1 per output
+__attribute__((target("avx2")))
+static inline void hpass_avx2_step(__m256i *acc0, __m256i *acc1, __m128i p01, __m128i p23, __m128i wk)
+{
+    // R0 R1 G0 G1 B0 B1 A0 A1 in each 8-byte half, then one weight pair per output and channel
+    const __m128i interleave = _mm_setr_epi8(0, 4, 1, 5, 2, 6, 3, 7, 8, 12, 9, 13, 10, 14, 11, 15);
+    const __m256i w = _mm256_castsi128_si256(wk);
+    __m256i a = _mm256_cvtepu8_epi16(_mm_shuffle_epi8(p01, interleave));
+    __m256i b = _mm256_cvtepu8_epi16(_mm_shuffle_epi8(p23, interleave));
+    const __m256i w01 = _mm256_permutevar8x32_epi32(w, _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1));
+    const __m256i w23 = _mm256_permutevar8x32_epi32(w, _mm256_setr_epi32(2, 2, 2, 2, 3, 3, 3, 3));
+    *acc0 = _mm256_add_epi32(*acc0, _mm256_madd_epi16(a, w01));
+    *acc1 = _mm256_add_epi32(*acc1, _mm256_madd_epi16(b, w23));
+}
+
+// Four output pixels per iteration, two per 256-bit pmaddwd; the sums match hpass_sse2
+__attribute__((target("avx2")))
+static void hpass_avx2(pixel *dst, const pixel *src, const img_resize_axis *ax)
+{
+    const int taps = ax->taps;
+    const int width = ax->out_size;
+    int x = 0;
+
+    for (; x + 4 <= width; x += 4) {
+        const pixel *s0 = src + ax->start[x], *s1 = src + ax->start[x + 1];
+        const pixel *s2 = src + ax->start[x + 2], *s3 = src + ax->start[x + 3];
+        const int16_t *w0 = ax->weights + (size_t)x * taps;
+        const int16_t *w1 = w0 + taps, *w2 = w1 + taps, *w3 = w2 + taps;
+        __m256i acc0 = _mm256_set1_epi32(ROUND_BIAS), acc1 = acc0;
+        int k = 0;
+
+        for (; k + 1 < taps; k += 2) {
+            __m128i p01 = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)(s0 + k)),
+                                             _mm_loadl_epi64((const __m128i *)(s1 + k)));
+            __m128i p23 = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)(s2 + k)),
+                                             _mm_loadl_epi64((const __m128i *)(s3 + k)));
+            __m128i wk = _mm_setr_epi32(weight_pair(w0 + k), weight_pair(w1 + k),
+                                        weight_pair(w2 + k), weight_pair(w3 + k));
+            hpass_avx2_step(&acc0, &acc1, p01, p23, wk);
+        }
+        if (k < taps) {
+            // Last odd tap: one pixel each with a zero second weight, never reading past the row
+            __m128i p01 = _mm_unpacklo_epi64(_mm_cvtsi32_si128(weight_pair((const int16_t *)(s0 + k))),
+                                             _mm_cvtsi32_si128(weight_pair((const int16_t *)(s1 + k))));
+            __m128i p23 = _mm_unpacklo_epi64(_mm_cvtsi32_si128(weight_pair((const int16_t *)(s2 + k))),
+                                             _mm_cvtsi32_si128(weight_pair((const int16_t *)(s3 + k))));
+            __m128i wk = _mm_setr_epi32((uint16_t)w0[k], (uint16_t)w1[k], (uint16_t)w2[k], (uint16_t)w3[k]);
+            hpass_avx2_step(&acc0, &acc1, p01, p23, wk);
+        }
+
+        acc0 = _mm256_srai_epi32(acc0, IMG_RESIZE_PRECISION);
+        acc1 = _mm256_srai_epi32(acc1, IMG_RESIZE_PRECISION);
+        // Lane-local packs leave pixels 0 2 | 1 3; restore the order before storing
+        __m256i packed = _mm256_packs_epi32(acc0, acc1);
+        packed = _mm256_packus_epi16(packed, packed);
+        packed = _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 1, 5, 0, 0, 0, 0));
+        _mm_storeu_si128((__m128i *)(dst + x), _mm256_castsi256_si128(packed));
+    }
+
+    if (x < width) {
+        // The SSE2 kernel finishes the last few outputs through a shifted view of the table
+        img_resize_axis rest = *ax;
+        rest.out_size = width - x;
+        rest.start = ax->start + x;
+        rest.weights = ax->weights + (size_t)x * taps;
+        hpass_sse2(dst + x, src, &rest);
+    }
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* Vertical pass                                                             */
+/* ------------------------------------------------------------------------- */
+
+static void vpass_scalar(pixel *dst, const pixel **rows, const int16_t *w, int taps, int width, int x0)
+{
+    const int channels = width * 4;
+    unsigned char *out = (unsigned char *)dst;
+
+    for (int c = x0 * 4; c < channels; c++) {
+        int acc = ROUND_BIAS;
+        for (int k = 0; k < taps; k++) {
+            acc += ((const unsigned char *)rows[k])[c] * w[k];
+        }
+        out[c] = clip8(acc >> IMG_RESIZE_PRECISION);
+    }
+}
+
+#ifdef IMG_RESIZE_X86
+// Four pixels (16 channels) per iteration, two source rows per pmaddwd
+__attribute__((target("sse2")))
+static void vpass_sse2(pixel *dst, const pixel **rows, const int16_t *w, int taps, int width, int x0)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int x = x0;
+
+    for (; x + 4 <= width; x += 4) {
+        __m128i acc0 = _mm_set1_epi32(ROUND_BIAS);
+        __m128i acc1 = acc0, acc2 = acc0, acc3 = acc0;
+        int k = 0;
+
+        for (; k < taps; k += 2) {
+            __m128i a = _mm_loadu_si128((const __m128i *)(rows[k] + x));
+            __m128i b = zero;
+            int32_t wpair = (uint16_t)w[k];
+            if (k + 1 < taps) {
+                b = _mm_loadu_si128((const __m128i *)(rows[k + 1] + x));
+                wpair |= (int32_t)w[k + 1] << 16;
+            }
+            __m128i wk = _mm_set1_epi32(wpair);
+            __m128i lo = _mm_unpacklo_epi8(a, b);
+            __m128i hi = _mm_unpackhi_epi8(a, b);
+            acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), wk));
+            acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), wk));
+            acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), wk));
+            acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), wk));
+        }
+
+        acc0 = _mm_srai_epi32(acc0, IMG_RESIZE_PRECISION);
+        acc1 = _mm_srai_epi32(acc1, IMG_RESIZE_PRECISION);
+        acc2 = _mm_srai_epi32(acc2, IMG_RESIZE_PRECISION);
+        acc3 = _mm_srai_epi32(acc3, IMG_RESIZE_PRECISION);
+        __m128i out = _mm_packus_epi16(_mm_packs_epi32(acc0, acc1), _mm_packs_epi32(acc2, acc3));
+        _mm_storeu_si128((__m128i *)(dst + x), out);
+    }
+    vpass_scalar(dst, rows, w, taps, width, x);
+}
+
+// Eight pixels per iteration; unpack and pack are both lane-local so the order is preserved
+__attribute__((target("avx2")))
+static void vpass_avx2(pixel *dst, const pixel **rows, const int16_t *w, int taps, int width, int x0)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    int x = x0;
+
+    for (; x + 8 <= width; x += 8) {
+        __m256i acc0 = _mm256_set1_epi32(ROUND_BIAS);
+        __m256i acc1 = acc0, acc2 = acc0, acc3 = acc0;
+        int k = 0;
+
+        for (; k < taps; k += 2) {
+            __m256i a = _mm256_loadu_si256((const __m256i *)(rows[k] + x));
+            __m256i b = zero;
+            int32_t wpair = (uint16_t)w[k];
+            if (k + 1 < taps) {
+                b = _mm256_loadu_si256((const __m256i *)(rows[k + 1] + x));
+                wpair |= (int32_t)w[k + 1] << 16;
+            }
+            __m256i wk = _mm256_set1_epi32(wpair);
+            __m256i lo = _mm256_unpacklo_epi8(a, b);
+            __m256i hi = _mm256_unpackhi_epi8(a, b);
+            acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(_mm256_unpacklo_epi8(lo, zero), wk));
+            acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(_mm256_unpackhi_epi8(lo, zero), wk));
+            acc2 = _mm256_add_epi32(acc2, _mm256_madd_epi16(_mm256_unpacklo_epi8(hi, zero), wk));
+            acc3 = _mm256_add_epi32(acc3, _mm256_madd_epi16(_mm256_unpackhi_epi8(hi, zero), wk));
+        }
+
+        acc0 = _mm256_srai_epi32(acc0, IMG_RESIZE_PRECISION);
+        acc1 = _mm256_srai_epi32(acc1, IMG_RESIZE_PRECISION);
+        acc2 = _mm256_srai_epi32(acc2, IMG_RESIZE_PRECISION);
+        acc3 = _mm256_srai_epi32(acc3, IMG_RESIZE_PRECISION);
+        __m256i out = _mm256_packus_epi16(_mm256_packs_epi32(acc0, acc1), _mm256_packs_epi32(acc2, acc3));
+        _mm256_storeu_si256((__m256i *)(dst + x), out);
+    }
+    vpass_sse2(dst, rows, w, taps, width, x);
+}
+
+// Sixteen pixels per iteration, the AVX2 kernel widened to 512 bits
+__attribute__((target("avx512f,avx512bw")))
+static void vpass_avx512(pixel *dst, const pixel **rows, const int16_t *w, int taps, int width, int x0)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    int x = x0;
+
+    for (; x + 16 <= width; x += 16) {
+        __m512i acc0 = _mm512_set1_epi32(ROUND_BIAS);
+        __m512i acc1 = acc0, acc2 = acc0, acc3 = acc0;
+        int k = 0;
+
+        for (; k < taps; k += 2) {
+            __m512i a = _mm512_loadu_si512(rows[k] + x);
+            __m512i b = zero;
+            int32_t wpair = (uint16_t)w[k];
+            if (k + 1 < taps) {
+                b = _mm512_loadu_si512(rows[k + 1] + x);
+                wpair |= (int32_t)w[k + 1] << 16;
+            }
+            __m512i wk = _mm512_set1_epi32(wpair);
+            __m512i lo = _mm512_unpacklo_epi8(a, b);
+            __m512i hi = _mm512_unpackhi_epi8(a, b);
+            acc0 = _mm512_add_epi32(acc0, _mm512_madd_epi16(_mm512_unpacklo_epi8(lo, zero), wk));
+            acc1 = _mm512_add_epi32(acc1, _mm512_madd_epi16(_mm512_unpackhi_epi8(lo, zero), wk));
+            acc2 = _mm512_add_epi32(acc2, _mm512_madd_epi16(_mm512_unpacklo_epi8(hi, zero), wk));
+            acc3 = _mm512_add_epi32(acc3, _mm512_madd_epi16(_mm512_unpackhi_epi8(hi, zero), wk));
+        }
+
+        acc0 = _mm512_srai_epi32(acc0, IMG_RESIZE_PRECISION);
+        acc1 = _mm512_srai_epi32(acc1, IMG_RESIZE_PRECISION);
+        acc2 = _mm512_srai_epi32(acc2, IMG_RESIZE_PRECISION);
+        acc3 = _mm512_srai_epi32(acc3, IMG_RESIZE_PRECISION);
+        __m512i out = _mm512_packus_epi16(_mm512_packs_epi32(acc0, acc1), _mm512_packs_epi32(acc2, acc3));
+        _mm512_storeu_si512(dst + x, out);
+    }
+    vpass_avx2(dst, rows, w, taps, width, x);
+}
+#endif
+
+typedef void (*hpass_fn)(pixel *dst, const pixel *src, const img_resize_axis *ax);
+typedef void (*vpass_fn)(pixel *dst, const pixel **rows, const int16_t *w, int taps, int width, int x0);
+
+static hpass_fn hpass_kernel;
+static vpass_fn vpass_kernel;
+
+__attribute__((constructor))
+static void bind_kernels(void)
+{
+    img_cpu_level cpu = img_cpu_get_level();
+    hpass_kernel = hpass_scalar;
+    vpass_kernel = vpass_scalar;
+#ifdef IMG_RESIZE_X86
+    if (cpu >= IMG_CPU_SSE2) {
+        hpass_kernel = hpass_sse2;
+        vpass_kernel = vpass_sse2;
+    }
+    if (cpu >= IMG_CPU_AVX2) {
+        hpass_kernel = hpass_avx2;
+        vpass_kernel = vpass_avx2;
+    }
+    if (cpu >= IMG_CPU_AVX512) vpass_kernel = vpass_avx512;
+#endif
+    (void)cpu;
+}
+
+static hpass_fn select_hpass(const img_resize_plan *plan)
+{
+    return plan->x.taps == 1 ? hpass_nearest : hpass_kernel;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Streaming resizer                                                         */
+/* ------------------------------------------------------------------------- */
+
+// Bytes of scratch memory a resizer needs for a plan
+// Ring plus output row, padded to an even pixel count so the tap table after it is pointer-aligned
+static size_t resizer_row_pixels(const img_resize_plan *plan)
+{
+    return ((size_t)plan->dst_width * (plan->y.taps + 1) + 1) & ~(size_t)1;
+}
+
+static size_t resizer_scratch_size(const img_resize_plan *plan)
+{
+    return sizeof(pixel) * resizer_row_pixels(plan) + sizeof(pixel *) * plan->y.taps;
+}
+
+// Points the resizer's ring, output row and tap table into one scratch block
+static void resizer_setup(img_resizer *rs, const img_resize_plan *plan, img_row_sink sink,
+                          void *sink_ctx, void *scratch)
+{
+    memset(rs, 0, sizeof(*rs));
+    rs->plan = plan;
+    rs->sink = sink;
+    rs->sink_ctx = sink_ctx;
+    rs->end_dst = plan->dst_height;
+    rs->ring = (pixel *)scratch;
+    rs->out_row = rs->ring + (size_t)plan->dst_width * plan->y.taps;
+    rs->taps = (const pixel **)(rs->ring + resizer_row_pixels(plan));
+}
+
+int img_resizer_init(img_resizer *rs, const img_resize_plan *plan, img_row_sink sink, void *sink_ctx)
+{
+    void *scratch = malloc(resizer_scratch_size(plan));
+    if (!scratch) return RET_FAIL;
+
+    resizer_setup(rs, plan, sink, sink_ctx, scratch);
+    return RET_SUCCESS;
+}
+
+void img_resizer_release(img_resizer *rs)
+{
+    if (!rs) return;
+    free(rs->ring); // The ring heads the scratch block
+    rs->ring = NULL;
+    rs->out_row = NULL;
+    rs->taps = NULL;
+}
+
+// Emits every destination row whose source window ends at or before `last`
+static void emit_ready_rows(img_resizer *rs, int last)
+{
+    const img_resize_plan *plan = rs->plan;
+    const int taps = plan->y.taps;
+    const int width = plan->dst_width;
+    vpass_fn vpass = vpass_kernel;
+
+    while (rs->next_dst < rs->end_dst) {
+        int y = rs->next_dst;
+        int start = plan->y.start[y];
+        if (start + taps - 1 > last) break;
+
+        const int16_t *w = plan->y.weights + (size_t)y * taps;
+        const pixel *row;
+        if (taps == 1) {
+            row = rs->ring + (size_t)(start % taps) * width;
+        } else {
+            for (int k = 0; k < taps; k++) {
+                rs->taps[k] = rs->ring + (size_t)((start + k) % taps) * width;
+            }
+            vpass(rs->out_row, rs->taps, w, taps, width, 0);
+            row = rs->out_row;
+        }
+        rs->sink(rs->sink_ctx, y, row, width);
+        rs->next_dst++;
+    }
+}
+
+void img_resizer_push_row(img_resizer *rs, const pixel *row)
+{
+    const img_resize_plan *plan = rs->plan;
+    int r = rs->next_src++;
+
+    if (rs->next_dst >= rs->end_dst) return;
+    // Windows only move forward, so a row is needed iff the next pending window has reached it
+    if (r < plan->y.start[rs->next_dst]) return;
+
+    pixel *slot = rs->ring + (size_t)(r % plan->y.taps) * plan->dst_width;
+    select_hpass(plan)(slot, row, &plan->x);
+    emit_ready_rows(rs, r);
+}
+
+int img_resize_plan_src_rows(const img_resize_plan *plan)
+{
+    return plan->y.start[plan->dst_height - 1] + plan->y.taps;
+}
+
+// Scratch block reused by img_resize_run on each thread
+static _Thread_local img_scratch run_scratch;
+
+typedef struct {
+    const img_resize_plan *plan;
+    const Image *src;
+    img_row_sink sink;
+    void *sink_ctx;
+    atomic_int failed;
+} resize_run_ctx;
+
+// Resizes destination rows [begin, end), reading only the source rows their windows cover
+static void resize_band(void *opaque, int begin, int end)
+{
+    resize_run_ctx *ctx = (resize_run_ctx *)opaque;
+    const img_resize_plan *plan = ctx->plan;
+
+    void *scratch = img_scratch_reserve(&run_scratch, resizer_scratch_size(plan));
+    if (!scratch) {
+        atomic_store(&ctx->failed, 1);
+        return;
+    }
+
+    img_resizer rs;
+    resizer_setup(&rs, plan, ctx->sink, ctx->sink_ctx, scratch);
+    rs.next_dst = begin;
+    rs.end_dst = end;
+
+    // Visit only rows some window covers; downscales skip most of the source
+    int last = plan->y.start[end - 1] + plan->y.taps;
+    for (int y = plan->y.start[begin]; y < last && rs.next_dst < rs.end_dst; y++) {
+        if (y < plan->y.start[rs.next_dst]) y = plan->y.start[rs.next_dst];
+        rs.next_src = y;
+        img_resizer_push_row(&rs, img_row(ctx->src, y));
+    }
+}
+
+int img_resize_run(const img_resize_plan *plan, const Image *src, img_row_sink sink, void *sink_ctx)
+{
+    resize_run_ctx ctx = { plan, src, sink, sink_ctx, 0 };
+
+    // Bands overlap by the filter support in source rows, so they pay for a few extra horizontal passes
+    img_parallel_for(plan->dst_height, img_parallel_grain(plan->dst_width), resize_band, &ctx);
+    return atomic_load(&ctx.failed) ? RET_FAIL : RET_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+// Row sink copying finished rows into an Image
+static void image_row_sink(void *ctx, int y, const pixel *row, int width)
+{
+    Image *dst = (Image *)ctx;
+    memcpy(img_row(dst, y), row, sizeof(pixel) * width);
+}
+
+int img_resize_into(const Image *src, Image *dst, img_filter filter)
+{
+    if (!src || !src->pixels || !dst || !dst->pixels) return RET_FAIL;
+    IMG_TRACE_SCOPE("img_resize_into");
+
+    const img_resize_plan *plan = img_resize_plan_cached(src->width, src->height,
+                                                         0, 0, src->width, src->height,
+                                                         dst->width, dst->height, filter);
+    if (!plan) return RET_FAIL;
+
+    IMG_TRACE_COUNT(IMG_TRACE_PIXELS, (size_t)dst->width * dst->height);
+    return img_resize_run(plan, src, image_row_sink, dst);
+}
+
+int img_resize_filter(Image** src, int new_width, int new_height, img_filter filter)
+{
+    if (!src || !*src) return RET_FAIL; // Check for valid source image
+    IMG_TRACE_SCOPE("img_resize_filter");
+
+    Image* resized = img_new(new_width, new_height);
+    if (!resized) return RET_FAIL;
+
+    if (img_resize_into(*src, resized, filter) != RET_SUCCESS) {
+        img_free(resized);
+        return RET_FAIL;
+    }
+
+    img_free(*src); // Free the original image
+    *src = resized; // Update the source image pointer to point to the resized image
+    return RET_SUCCESS;
+}
+
+int img_resize(Image** src, int new_width, int new_height)
+{
+    return img_resize_filter(src, new_width, new_height, IMG_FILTER_AREA);
+}
+
+typedef struct {
+    Image *dst;
+    img_filter filter;
+    img_resizer rs;
+    int started;
+} load_resized_ctx;
+
+// Builds the plan and resizer once the decoder knows the source size
+static int load_resized_header(void *opaque, int width, int height)
+{
+    load_resized_ctx *ctx = (load_resized_ctx *)opaque;
+
+    const img_resize_plan *plan = img_resize_plan_cached(width, height, 0, 0, width, height,
+                                                         ctx->dst->width, ctx->dst->height, ctx->filter);
+    if (!plan) return -1;
+    if (img_resizer_init(&ctx->rs, plan, image_row_sink, ctx->dst) != RET_SUCCESS) return -1;
+
+    ctx->started = 1;
+    return img_resize_plan_src_rows(plan);
+}
+
+static void load_resized_row(void *opaque, int y, const pixel *row, int width)
+{
+    (void)y;
+    (void)width;
+    img_resizer_push_row(&((load_resized_ctx *)opaque)->rs, row);
+}
+
+Image* img_load_resized(const char *filename, int width, int height, img_filter filter)
+{
+    if (!filename) return NULL;
+    IMG_TRACE_SCOPE("img_load_resized");
+
+    load_resized_ctx ctx = { .filter = filter, .started = 0 };
+    ctx.dst = img_new(width, height);
+    if (!ctx.dst) return NULL;
+
+    int ret = img_io_read_rows(filename, load_resized_header, load_resized_row, &ctx);
+    if (ctx.started) img_resizer_release(&ctx.rs);
+
+    if (ret != RET_SUCCESS) {
+        img_free(ctx.dst);
+        return NULL;
+    }
+    IMG_TRACE_COUNT(IMG_TRACE_PIXELS, (size_t)width * height);
+    return ctx.dst;
+}
@@ -0,0 +1,520 @@
+/**
+ * Image rotation.
+ *
+ * Arbitrary angles are inverse-mapped: every destination pixel is traced back
+ * into the source, so the output has no holes. The trig is evaluated once per
+ * call and each destination row is walked in 16.16 fixed point. The span of a
+ * row whose samples all land inside the source is solved exactly up front, so
+ * the inner loop runs without border checks. The same sampler serves any
+ * affine map (img_warp_affine) for the transform graph. Quarter turns are
+ * exact integer permutations and go through a tiled transpose instead.
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define IMG_ROTATE_X86 1
+#endif
+
+#include "../../include/img_utils.h"
+#include "../../internal/img_utils/internal_img_cpu.h"
+#include "../../internal/img_utils/internal_img_trace.h"
+#include "../../internal/img_utils/internal_img_warp.h"
+#include "../../internal/math/math_utils.h"
+#include "../../internal/thread/parallel.h"
+
+
+#define FIX_SHIFT 16
+#define FIX_ONE (1 << FIX_SHIFT)
+#define FIX_HALF (1 << (FIX_SHIFT - 1))
+
+// Bilinear weights use 7 bits so two-stage blends fit pmaddwd's 16-bit lanes
+#define FRAC_BITS 7
+#define FRAC_ONE (1 << FRAC_BITS)
+#define BLEND_SHIFT (2 * FRAC_BITS)
+#define BLEND_ROUND (1 << (BLEND_SHIFT - 1))
+
+// Destination tile edge for the quarter-turn kernels; 32x32 RGBA tiles fit in L1
+#define ROTATE_TILE 32
+
+/* ------------------------------------------------------------------------- */
+/* Border handling                                                           */
+/* ------------------------------------------------------------------------- */
+
+// Maps an out-of-range coordinate according to the border mode; -1 means "use the fill color"
+static inline int border_index(int i, int n, img_border border)
+{
+    if (i >= 0 && i < n) return i;
+
+    switch (border) {
+    case IMG_BORDER_REPLICATE:
+        return i < 0 ? 0 : n - 1;
+    case IMG_BORDER_REFLECT: {
+        int period = 2 * n;
+        i %= period;
+        if (i < 0) i += period;
+        return i < n ? i : period - 1 - i;
+    }
+    default:
+        return -1;
+    }
+}
+
+static inline pixel fetch(const Image *src, int x, int y, img_border border, pixel fill)
+{
+    x = border_index(x, src->width, border);
+    y = border_index(y, src->height, border);
+    if (x < 0 || y < 0) return fill;
+    return img_row(src, y)[x];
+}
+
+/* ------------------------------------------------------------------------- */
+/* Quarter turns                                                             */
+/* ------------------------------------------------------------------------- */
+
+/*
+ * Integer affine map from destination to source coordinates:
+ *   sx = ax * x + bx * y + cx
+ *   sy = ay * x + by * y + cy
+ * with coefficients in {-1, 0, 1}.
+ */
+typedef struct {
+    int ax, bx, cx;
+    int ay, by, cy;
+} quarter_map;
+
+typedef struct {
+    const Image *src;
+    Image *dst;
+    const quarter_map *m;
+    img_border border;
+    pixel fill;
+} quarter_ctx;
+
+// Fills tile rows [begin, end) of the destination
+static void rotate_quarter_tiles(void *opaque, int begin, int end)
+{
+    const quarter_ctx *ctx = (const quarter_ctx *)opaque;
+    const Image *src = ctx->src;
+    Image *dst = ctx->dst;
+    const quarter_map *m = ctx->m;
+    const img_border border = ctx->border;
+    const pixel fill = ctx->fill;
+    const int sw = src->width, sh = src->height;
+    const ptrdiff_t step = (ptrdiff_t)m->ay * src->stride + m->ax; // Source step per destination pixel
+
+    for (int ty = begin * ROTATE_TILE; ty < dst->height && ty < end * ROTATE_TILE; ty += ROTATE_TILE) {
+        int ye = ty + ROTATE_TILE < dst->height ? ty + ROTATE_TILE : dst->height;
+
+        for (int tx = 0; tx < dst->width; tx += ROTATE_TILE) {
+            int xe = tx + ROTATE_TILE < dst->width ? tx + ROTATE_TILE : dst->width;
+
+            // The map is affine, so the tile is inside the source iff its corners are
+            int inside = 1;
+            int corners[4][2] = { { tx, ty }, { xe - 1, ty }, { tx, ye - 1 }, { xe - 1, ye - 1 } };
+            for (int c = 0; c < 4; c++) {
+                int sx = m->ax * corners[c][0] + m->bx * corners[c][1] + m->cx;
+                int sy = m->ay * corners[c][0] + m->by * corners[c][1] + m->cy;
+                if (sx < 0 || sx >= sw || sy < 0 || sy >= sh) inside = 0;
+            }
+
+            for (int y = ty; y < ye; y++) {
+                pixel *out = img_row(dst, y);
+                int sx = m->ax * tx + m->bx * y + m->cx;
+                int sy = m->ay * tx + m->by * y + m->cy;
+
+                if (inside) {
+                    const pixel *in = img_row(src, sy) + sx;
+                    for (int x = tx; x < xe; x++, in += step) out[x] = *in;
+                } else {
+                    for (int x = tx; x < xe; x++, sx += m->ax, sy += m->ay) {
+                        out[x] = fetch(src, sx, sy, border, fill);
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void rotate_quarter(const Image *src, Image *dst, const quarter_map *m,
+                           img_border border, pixel fill)
+{
+    quarter_ctx ctx = { src, dst, m, border, fill };
+    int tile_rows = (dst->height + ROTATE_TILE - 1) / ROTATE_TILE;
+    img_parallel_for(tile_rows, img_parallel_grain(dst->width * ROTATE_TILE), rotate_quarter_tiles, &ctx);
+}
+
+// Builds the same-canvas quarter-turn map; fails when the centers do not align on whole pixels
+static int same_canvas_quarter_map(const Image *src, const Image *dst, int turns, quarter_map *m)
+{
+    int sw = src->width, sh = src->height, dw = dst->width, dh = dst->height;
+
+    // Source and destination centers must differ by whole pixels after the turn
+    if (turns % 2 == 0) {
+        if ((sw - dw) % 2 || (sh - dh) % 2) return 0;
+    } else {
+        if ((sw - dh) % 2 || (sh - dw) % 2) return 0;
+    }
+
+    switch (turns) {
+    case 0: *m = (quarter_map){ 1, 0, (sw - dw) / 2, 0, 1, (sh - dh) / 2 }; break;
+    case 1: *m = (quarter_map){ 0, 1, (sw - dh) / 2, -1, 0, (sh + dw) / 2 - 1 }; break;
+    case 2: *m = (quarter_map){ -1, 0, (sw + dw) / 2 - 1, 0, -1, (sh + dh) / 2 - 1 }; break;
+    case 3: *m = (quarter_map){ 0, -1, (sw + dh) / 2 - 1, 1, 0, (sh - dw) / 2 }; break;
+    default: return 0;
+    }
+    return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Arbitrary angles                                                          */
+/* ------------------------------------------------------------------------- */
+
+static inline int64_t floor_div(int64_t a, int64_t b)
+{
+    int64_t q = a / b;
+    if ((a % b != 0) && ((a < 0) != (b < 0))) q--;
+    return q;
+}
+
+static inline int64_t ceil_div(int64_t a, int64_t b)
+{
+    return -floor_div(-a, b);
+}
+
+// Narrows [*lo, *hi] to the x for which lo_v <= v0 + x * dv <= hi_v
+static void clip_span(int64_t v0, int64_t dv, int64_t lo_v, int64_t hi_v, int64_t *lo, int64_t *hi)
+{
+    if (dv == 0) {
+        if (v0 < lo_v || v0 > hi_v) *hi = *lo - 1;
+        return;
+    }
+
+    int64_t a, b;
+    if (dv > 0) {
+        a = ceil_div(lo_v - v0, dv);
+        b = floor_div(hi_v - v0, dv);
+    } else {
+        a = ceil_div(hi_v - v0, dv);
+        b = floor_div(lo_v - v0, dv);
+    }
+    if (a > *lo) *lo = a;
+    if (b < *hi) *hi = b;
+}
+
+static inline pixel blend_scalar(pixel p00, pixel p01, pixel p10, pixel p11, int fx, int fy)
+{
+    const unsigned char *a = &p00.R, *b = &p01.R, *c = &p10.R, *d = &p11.R;
+    pixel out;
+    unsigned char *o = &out.R;
+    for (int ch = 0; ch < 4; ch++) {
+        int top = a[ch] * (FRAC_ONE - fx) + b[ch] * fx;
+        int bottom = c[ch] * (FRAC_ONE - fx) + d[ch] * fx;
+        o[ch] = (unsigned char)((top * (FRAC_ONE - fy) + bottom * fy + BLEND_ROUND) >> BLEND_SHIFT);
+    }
+    return out;
+}
+
+// Bilinear sample with border handling; u and v are 16.16 coordinates already shifted by -0.5
+static inline pixel sample_bilinear_checked(const Image *src, int64_t u, int64_t v,
+                                            img_border border, pixel fill)
+{
+    int x0 = (int)(u >> FIX_SHIFT), y0 = (int)(v >> FIX_SHIFT);
+    int fx = (int)((u & (FIX_ONE - 1)) >> (FIX_SHIFT - FRAC_BITS));
+    int fy = (int)((v & (FIX_ONE - 1)) >> (FIX_SHIFT - FRAC_BITS));
+    return blend_scalar(fetch(src, x0, y0, border, fill), fetch(src, x0 + 1, y0, border, fill),
+                        fetch(src, x0, y0 + 1, border, fill), fetch(src, x0 + 1, y0 + 1, border, fill),
+                        fx, fy);
+}
+
+// Bilinear samples of an in-bounds span; every 2x2 neighborhood is known to be inside
+static void bilinear_span_scalar(const Image *src, pixel *out, int n, int64_t u, int64_t v,
+                                 int64_t du, int64_t dv)
+{
+    const int stride = src->stride;
+    for (int i = 0; i < n; i++, u += du, v += dv) {
+        const pixel *p = src->pixels + (size_t)(v >> FIX_SHIFT) * stride + (u >> FIX_SHIFT);
+        int fx = (int)((u & (FIX_ONE - 1)) >> (FIX_SHIFT - FRAC_BITS));
+        int fy = (int)((v & (FIX_ONE - 1)) >> (FIX_SHIFT - FRAC_BITS));
+        out[i] = blend_scalar(p[0], p[1], p[stride], p[stride + 1], fx, fy);
+    }
+}
+
+#ifdef IMG_ROTATE_X86
+// Same arithmetic as blend_scalar: horizontal blends with pmaddwd, then a vertical one
+__attribute__((target("sse2")))
+static void bilinear_span_sse2(const Image *src, pixel *out, int n, int64_t u, int64_t v,
+                               int64_t du, int64_t dv)
+{
+    const int stride = src->stride;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(BLEND_ROUND);
+
+    for (int i = 0; i < n; i++, u += du, v += dv) {
+        const pixel *p = src->pixels + (size_t)(v >> FIX_SHIFT) * stride + (u >> FIX_SHIFT);
+        int fx = (int)((u & (FIX_ONE - 1)) >> (FIX_SHIFT - FRAC_BITS));
+        int fy = (int)((v & (FIX_ONE - 1)) >> (FIX_SHIFT - FRAC_BITS));
+        __m128i wx = _mm_set1_epi32((FRAC_ONE - fx) | (fx << 16));
+        __m128i wy = _mm_set1_epi32((FRAC_ONE - fy) | (fy << 16));
+
+        // p0 p1 -> p0c p1c pairs per channel, blended into 4 int32 values per row
+        __m128i top = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)p), zero);
+        __m128i bottom = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(p + stride)), zero);
+        top = _mm_madd_epi16(_mm_unpacklo_epi16(top, _mm_srli_si128(top, 8)), wx);
+        bottom = _mm_madd_epi16(_mm_unpacklo_epi16(bottom, _mm_srli_si128(bottom, 8)), wx);
+
+        __m128i tb = _mm_packs_epi32(top, bottom);
+        tb = _mm_unpacklo_epi16(tb, _mm_srli_si128(tb, 8));
+        __m128i acc = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(tb, wy), round), BLEND_SHIFT);
+        acc = _mm_packs_epi32(acc, acc);
+        acc = _mm_packus_epi16(acc, acc);
+        int32_t px = _mm_cvtsi128_si32(acc);
+        memcpy(out + i, &px, sizeof(px));
+    }
+}
+
+// Eight samples per step: the four neighbors are gathered, then blended as in bilinear_span_sse2
+__attribute__((target("avx2")))
+static void bilinear_span_avx2(const Image *src, pixel *out, int n, int64_t u, int64_t v,
+                               int64_t du, int64_t dv)
+{
+    const int stride = src->stride;
+    int i = 0;
+
+    // 32-bit lanes hold every in-span coordinate and pixel index of images below 32K per side
+    if (n >= 8 && src->width < 32768 && src->height < 32768 && (int64_t)src->height * stride < INT32_MAX) {
+        const int *base = (const int *)src->pixels;
+        const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m256i frac = _mm256_set1_epi32(FIX_ONE - 1), one = _mm256_set1_epi32(FRAC_ONE);
+        const __m256i vstride = _mm256_set1_epi32(stride);
+        const __m256i zero = _mm256_setzero_si256(), round = _mm256_set1_epi32(BLEND_ROUND);
+        // Broadcast the weights of pixels k and k + 4 over the 128-bit halves holding them
+        const __m256i sel[4] = {
+            _mm256_setr_epi32(0, 0, 0, 0, 4, 4, 4, 4), _mm256_setr_epi32(1, 1, 1, 1, 5, 5, 5, 5),
+            _mm256_setr_epi32(2, 2, 2, 2, 6, 6, 6, 6), _mm256_setr_epi32(3, 3, 3, 3, 7, 7, 7, 7),
+        };
+        // Lane arithmetic wraps like the 64-bit values would, and every lane used is in range
+        __m256i vu = _mm256_add_epi32(_mm256_set1_epi32((int32_t)u),
+                                      _mm256_mullo_epi32(lanes, _mm256_set1_epi32((int32_t)du)));
+        __m256i vv = _mm256_add_epi32(_mm256_set1_epi32((int32_t)v),
+                                      _mm256_mullo_epi32(lanes, _mm256_set1_epi32((int32_t)dv)));
+        const __m256i step_u = _mm256_set1_epi32((int32_t)(du * 8)), step_v = _mm256_set1_epi32((int32_t)(dv * 8));
+
+        for (; i + 8 <= n; i += 8) {
+            __m256i fx = _mm256_srli_epi32(_mm256_and_si256(vu, frac), FIX_SHIFT - FRAC_BITS);
+            __m256i fy = _mm256_srli_epi32(_mm256_and_si256(vv, frac), FIX_SHIFT - FRAC_BITS);
+            __m256i wx = _mm256_or_si256(_mm256_sub_epi32(one, fx), _mm256_slli_epi32(fx, 16));
+            __m256i wy = _mm256_or_si256(_mm256_sub_epi32(one, fy), _mm256_slli_epi32(fy, 16));
+            __m256i idx = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_srai_epi32(vv, FIX_SHIFT), vstride),
+                                           _mm256_srai_epi32(vu, FIX_SHIFT));
+            __m256i p00 = _mm256_i32gather_epi32(base, idx, 4);
+            __m256i p01 = _mm256_i32gather_epi32(base + 1, idx, 4);
+            __m256i p10 = _mm256_i32gather_epi32(base + stride, idx, 4);
+            __m256i p11 = _mm256_i32gather_epi32(base + stride + 1, idx, 4);
+            vu = _mm256_add_epi32(vu, step_u);
+            vv = _mm256_add_epi32(vv, step_v);
+
+            // Left/right channel pairs of pixels k | k + 4
+            __m256i a_lo = _mm256_unpacklo_epi8(p00, zero), a_hi = _mm256_unpackhi_epi8(p00, zero);
+            __m256i b_lo = _mm256_unpacklo_epi8(p01, zero), b_hi = _mm256_unpackhi_epi8(p01, zero);
+            __m256i c_lo = _mm256_unpacklo_epi8(p10, zero), c_hi = _mm256_unpackhi_epi8(p10, zero);
+            __m256i d_lo = _mm256_unpacklo_epi8(p11, zero), d_hi = _mm256_unpackhi_epi8(p11, zero);
+            __m256i top[4] = { _mm256_unpacklo_epi16(a_lo, b_lo), _mm256_unpackhi_epi16(a_lo, b_lo),
+                               _mm256_unpacklo_epi16(a_hi, b_hi), _mm256_unpackhi_epi16(a_hi, b_hi) };
+            __m256i bottom[4] = { _mm256_unpacklo_epi16(c_lo, d_lo), _mm256_unpackhi_epi16(c_lo, d_lo),
+                                  _mm256_unpacklo_epi16(c_hi, d_hi), _mm256_unpackhi_epi16(c_hi, d_hi) };
+
+            __m256i acc[4];
+            for (int k = 0; k < 4; k++) {
+                __m256i wxk = _mm256_permutevar8x32_epi32(wx, sel[k]);
+                __m256i wyk = _mm256_permutevar8x32_epi32(wy, sel[k]);
+                __m256i tb = _mm256_packs_epi32(_mm256_madd_epi16(top[k], wxk), _mm256_madd_epi16(bottom[k], wxk));
+                tb = _mm256_unpacklo_epi16(tb, _mm256_srli_si256(tb, 8));
+                acc[k] = _mm256_srli_epi32(_mm256_add_epi32(_mm256_madd_epi16(tb, wyk), round), BLEND_SHIFT);
+            }
+            __m256i px = _mm256_packus_epi16(_mm256_packs_epi32(acc[0], acc[1]), _mm256_packs_epi32(acc[2], acc[3]));
+            _mm256_storeu_si256((__m256i *)(out + i), px);
+        }
+    }
+    bilinear_span_sse2(src, out + i, n - i, u + du * i, v + dv * i, du, dv);
+}
+#endif
+
+static void nearest_span(const Image *src, pixel *out, int n, int64_t u, int64_t v,
+                         int64_t du, int64_t dv)
+{
+    const int stride = src->stride;
+    for (int i = 0; i < n; i++, u += du, v += dv) {
+        out[i] = src->pixels[(size_t)(v >> FIX_SHIFT) * stride + (u >> FIX_SHIFT)];
+    }
+}
+
+typedef void (*span_fn)(const Image *src, pixel *out, int n, int64_t u, int64_t v, int64_t du, int64_t dv);
+
+static span_fn bilinear_span;
+
+__attribute__((constructor))
+static void bind_kernels(void)
+{
+    bilinear_span = bilinear_span_scalar;
+#ifdef IMG_ROTATE_X86
+    if (img_cpu_get_level() >= IMG_CPU_SSE2) bilinear_span = bilinear_span_sse2;
+    if (img_cpu_get_level() >= IMG_CPU_AVX2) bilinear_span = bilinear_span_avx2;
+#endif
+}
+
+void img_warp_row(const Image *src, pixel *out, int width, int y, const img_affine *m, int bilinear,
+                  img_border border, pixel fill)
+{
+    const int64_t du = llround(m->a * FIX_ONE);
+    const int64_t dv = llround(m->d * FIX_ONE);
+    // Bilinear samples are taken relative to pixel centers
+    const double shift = bilinear ? 0.5 : 0.0;
+
+    // Valid 16.16 ranges of u and v for the unchecked inner loop
+    const int64_t u_hi = ((int64_t)src->width - (bilinear ? 1 : 0)) * FIX_ONE - 1;
+    const int64_t v_hi = ((int64_t)src->height - (bilinear ? 1 : 0)) * FIX_ONE - 1;
+    span_fn fast = bilinear ? bilinear_span : nearest_span;
+
+    // Source position of the first pixel center in this row
+    double ox = 0.5 - m->px, oy = y + 0.5 - m->py;
+    int64_t u0 = llround((m->a * ox + m->b * oy + m->c - shift) * FIX_ONE);
+    int64_t v0 = llround((m->d * ox + m->e * oy + m->f - shift) * FIX_ONE);
+
+    int64_t lo = 0, hi = width - 1;
+    clip_span(u0, du, 0, u_hi, &lo, &hi);
+    clip_span(v0, dv, 0, v_hi, &lo, &hi);
+    if (hi < lo) lo = hi = width; // Nothing inside: whole row is border
+
+    int64_t u = u0, v = v0;
+    for (int x = 0; x < lo; x++, u += du, v += dv) {
+        out[x] = bilinear ? sample_bilinear_checked(src, u, v, border, fill)
+                          : fetch(src, (int)(u >> FIX_SHIFT), (int)(v >> FIX_SHIFT), border, fill);
+    }
+    if (hi >= lo && lo < width) {
+        fast(src, out + lo, (int)(hi - lo + 1), u, v, du, dv);
+        u += du * (hi - lo + 1);
+        v += dv * (hi - lo + 1);
+    }
+    for (int x = (int)(hi < lo ? lo : hi + 1); x < width; x++, u += du, v += dv) {
+        out[x] = bilinear ? sample_bilinear_checked(src, u, v, border, fill)
+                          : fetch(src, (int)(u >> FIX_SHIFT), (int)(v >> FIX_SHIFT), border, fill);
+    }
+}
+
+typedef struct {
+    const Image *src;
+    Image *dst;
+    const img_affine *m;
+    int bilinear;
+    img_border border;
+    pixel fill;
+} warp_ctx;
+
+// Samples destination rows [begin, end)
+static void warp_rows(void *opaque, int begin, int end)
+{
+    const warp_ctx *ctx = (const warp_ctx *)opaque;
+    for (int y = begin; y < end; y++) {
+        img_warp_row(ctx->src, img_row(ctx->dst, y), ctx->dst->width, y, ctx->m, ctx->bilinear,
+                     ctx->border, ctx->fill);
+    }
+}
+
+void img_warp_affine(const Image *src, Image *dst, const img_affine *m, int bilinear,
+                     img_border border, pixel fill)
+{
+    warp_ctx ctx = { src, dst, m, bilinear, border, fill };
+    img_parallel_for(dst->height, img_parallel_grain(dst->width), warp_rows, &ctx);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+int img_rotate_into(const Image *src, Image *dst, float angle, img_filter filter,
+                    img_border border, pixel fill)
+{
+    if (!src || !src->pixels || !dst || !dst->pixels || src == dst) return RET_FAIL;
+    IMG_TRACE_SCOPE("img_rotate_into");
+    IMG_TRACE_COUNT(IMG_TRACE_PIXELS, (size_t)dst->width * dst->height);
+
+    // Exact quarter turns are lossless permutations
+    double turns = fmod(angle, 360.0);
+    if (turns < 0) turns += 360.0;
+    if (fmod(turns, 90.0) == 0.0) {
+        quarter_map m;
+        if (same_canvas_quarter_map(src, dst, (int)(turns / 90.0), &m)) {
+            rotate_quarter(src, dst, &m, border, fill);
+            return RET_SUCCESS;
+        }
+    }
+
+    // Rotation about the centers: the destination center maps onto the source center
+    double cs = cos_approx(angle);
+    double sn = sin_approx(angle);
+    img_affine m = {
+        .a = cs, .b = sn, .c = src->width / 2.0,
+        .d = -sn, .e = cs, .f = src->height / 2.0,
+        .px = dst->width / 2.0, .py = dst->height / 2.0,
+    };
+    img_warp_affine(src, dst, &m, filter != IMG_FILTER_NEAREST, border, fill);
+    return RET_SUCCESS;
+}
+
+int img_rotate(Image* img, float angle)
+{
+    if (!img || !img->pixels) return RET_FAIL;
+    IMG_TRACE_SCOPE("img_rotate");
+
+    double turns = fmod(angle, 360.0);
+    if (turns == 0.0) return RET_SUCCESS;
+
+    // Render into a fresh buffer and swap it in, so no copy back is needed
+    Image *rotated = img_new(img->width, img->height);
+    if (!rotated) return RET_FAIL;
+
+    pixel transparent = { 0, 0, 0, 0 };
+    if (img_rotate_into(img, rotated, angle, IMG_FILTER_BILINEAR, IMG_BORDER_CONSTANT, transparent) != RET_SUCCESS) {
+        img_free(rotated);
+        return RET_FAIL;
+    }
+
+    // Hand the new buffer to img and let the temporary handle release the old one
+    Image tmp = *img;
+    *img = *rotated;
+    *rotated = tmp;
+    img_free(rotated);
+    return RET_SUCCESS;
+}
+
+int img_rotate90(Image **src, int quarter_turns)
+{
+    if (!src || !*src || !(*src)->pixels) return RET_FAIL;
+    IMG_TRACE_SCOPE("img_rotate90");
+
+    int turns = ((quarter_turns % 4) + 4) % 4;
+    if (turns == 0) return RET_SUCCESS;
+
+    const int w = (*src)->width, h = (*src)->height;
+    Image *rotated = (turns == 2) ? img_new(w, h) : img_new(h, w);
+    if (!rotated) return RET_FAIL;
+
+    quarter_map m;
+    switch (turns) {
+    case 1:  m = (quarter_map){ 0, 1, 0, -1, 0, h - 1 }; break;
+    case 2:  m = (quarter_map){ -1, 0, w - 1, 0, -1, h - 1 }; break;
+    default: m = (quarter_map){ 0, -1, w - 1, 1, 0, 0 }; break;
+    }
+
+    pixel transparent = { 0, 0, 0, 0 };
+    rotate_quarter(*src, rotated, &m, IMG_BORDER_CONSTANT, transparent);
+    IMG_TRACE_COUNT(IMG_TRACE_PIXELS, (size_t)w * h);
+
+    img_free(*src);
+    *src = rotated;
+    return RET_SUCCESS;
+}
@@ -0,0 +1,51 @@
+/**
+ * Per-thread scratch blocks.
+ *
+ * The blocks a thread has grown are chained into a list whose head is the
+ * value of one process-wide pthread key, so a single key destructor frees
+ * all of them when the thread exits.
+ */
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "../../internal/img_utils/internal_img_scratch.h"
+
+
+static pthread_key_t scratch_key;
+static pthread_once_t scratch_key_once = PTHREAD_ONCE_INIT;
+static _Thread_local img_scratch *scratch_list;
+
+static void scratch_destructor(void *arg)
+{
+    for (img_scratch *s = (img_scratch *)arg; s; s = s->next) {
+        free(s->data);
+        s->data = NULL;
+        s->size = 0;
+    }
+}
+
+static void scratch_key_create(void)
+{
+    pthread_key_create(&scratch_key, scratch_destructor);
+}
+
+void* img_scratch_reserve(img_scratch *s, size_t size)
+{
+    if (s->size >= size && s->data) return s->data;
+
+    // Grow without copying: callers overwrite the block anyway
+    void *data = malloc(size ? size : 1);
+    if (!data) return NULL;
+    free(s->data);
+    s->data = data;
+    s->size = size;
+
+    if (!s->registered) {
+        pthread_once(&scratch_key_once, scratch_key_create);
+        s->next = scratch_list;
+        scratch_list = s;
+        pthread_setspecific(scratch_key, scratch_list);
+        s->registered = 1;
+    }
+    return s->data;
+}
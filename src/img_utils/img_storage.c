@@ -0,0 +1,99 @@
+/**
+ * Reference-counted pixel storage and Image handles.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../../include/img_utils.h"
+#include "../../internal/img_utils/internal_img_pool.h"
+#include "../../internal/img_utils/internal_img_storage.h"
+
+
+// Header size rounded to the pool alignment so the buffer after it stays aligned
+#define STORAGE_HEADER (((sizeof(img_storage) + IMG_POOL_ALIGNMENT - 1) / IMG_POOL_ALIGNMENT) * IMG_POOL_ALIGNMENT)
+
+// Pool-backed storage lives in the same block as its buffer
+static void destroy_pooled(img_storage *s)
+{
+    img_pool_free(s);
+}
+
+img_storage* img_storage_new(size_t size)
+{
+    img_storage *s = (img_storage *)img_pool_alloc(STORAGE_HEADER + size);
+    if (!s) return NULL;
+
+    atomic_init(&s->refs, 1);
+    s->data = (unsigned char *)s + STORAGE_HEADER;
+    s->size = size;
+    s->destroy = destroy_pooled;
+    s->ctx = NULL;
+    return s;
+}
+
+img_storage* img_storage_wrap(void *data, size_t size, void (*destroy)(img_storage *s), void *ctx)
+{
+    img_storage *s = (img_storage *)img_pool_alloc(sizeof(img_storage));
+    if (!s) return NULL;
+
+    atomic_init(&s->refs, 1);
+    s->data = data;
+    s->size = size;
+    s->destroy = destroy;
+    s->ctx = ctx;
+    return s;
+}
+
+void img_storage_free_header(img_storage *s)
+{
+    img_pool_free(s);
+}
+
+static void destroy_mapped(img_storage *s)
+{
+    munmap(s->data, s->size);
+    img_storage_free_header(s);
+}
+
+img_storage* img_storage_map(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) return NULL;
+
+    size_t size = (size_t)st.st_size;
+    void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) return NULL;
+
+    img_storage *s = img_storage_wrap(data, size, destroy_mapped, NULL);
+    if (!s) munmap(data, size);
+    return s;
+}
+
+void img_storage_retain(img_storage *s)
+{
+    if (s) atomic_fetch_add_explicit(&s->refs, 1, memory_order_relaxed);
+}
+
+void img_storage_release(img_storage *s)
+{
+    if (!s) return;
+    if (atomic_fetch_sub_explicit(&s->refs, 1, memory_order_acq_rel) == 1) {
+        s->destroy(s);
+    }
+}
+
+Image* img_handle_new(img_storage *storage, pixel *pixels, int width, int height, int stride)
+{
+    Image *img = (Image *)img_pool_alloc(sizeof(Image));
+    if (!img) return NULL;
+
+    img->width = width;
+    img->height = height;
+    img->stride = stride;
+    img->pixels = pixels;
+    img->storage = storage;
+    img_storage_retain(storage);
+    return img;
+}
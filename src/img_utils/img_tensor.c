@@ -0,0 +1,206 @@
+/**
+ * Fused image to model tensor conversion.
+ *
+ * The center crop is folded into the resize plan as a source region, and the
+ * resizer's row sink drops alpha, reorders channels and applies the scale and
+ * zero point through a 256-entry lookup table while writing each tensor row.
+ */
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../include/img_utils.h"
+#include "../../internal/img_utils/internal_img_io.h"
+#include "../../internal/img_utils/internal_img_resize.h"
+#include "../../internal/img_utils/internal_img_trace.h"
+
+
+typedef struct {
+    const img_tensor_spec *spec;
+    unsigned char *out;     // Tensor base address
+    size_t row_bytes;       // Bytes per tensor row
+    int first, third;       // Byte offsets in `pixel` of the first and third output channel
+    union {
+        uint8_t u8[256];
+        int8_t s8[256];
+        float f32[256];
+    } lut;
+} tensor_sink_ctx;
+
+img_tensor_spec img_tensor_spec_mobilenet_v1_quant(void)
+{
+    img_tensor_spec spec = {
+        .width = 224,
+        .height = 224,
+        .type = IMG_TENSOR_UINT8,
+        .order = IMG_ORDER_RGB,
+        .scale = 1.0f,
+        .zero_point = 0.0f,
+        .crop_fraction = 1.0f,
+        .filter = IMG_FILTER_AREA,
+    };
+    return spec;
+}
+
+static void build_lut(tensor_sink_ctx *ctx)
+{
+    const img_tensor_spec *spec = ctx->spec;
+    for (int p = 0; p < 256; p++) {
+        float v = p * spec->scale + spec->zero_point;
+        switch (spec->type) {
+        case IMG_TENSOR_UINT8:
+            ctx->lut.u8[p] = (uint8_t)fminf(fmaxf(roundf(v), 0.0f), 255.0f);
+            break;
+        case IMG_TENSOR_INT8:
+            ctx->lut.s8[p] = (int8_t)fminf(fmaxf(roundf(v), -128.0f), 127.0f);
+            break;
+        case IMG_TENSOR_FLOAT32:
+            ctx->lut.f32[p] = v;
+            break;
+        }
+    }
+}
+
+// Row sink writing resized RGBA rows as 3-channel tensor rows
+static void tensor_row_sink(void *opaque, int y, const pixel *row, int width)
+{
+    tensor_sink_ctx *ctx = (tensor_sink_ctx *)opaque;
+    const unsigned char *src = (const unsigned char *)row;
+    const int c0 = ctx->first, c2 = ctx->third;
+
+    switch (ctx->spec->type) {
+    case IMG_TENSOR_UINT8:
+    case IMG_TENSOR_INT8: {
+        // Both 8-bit types share the byte table layout
+        const uint8_t *lut = ctx->lut.u8;
+        uint8_t *dst = ctx->out + (size_t)y * ctx->row_bytes;
+        for (int x = 0; x < width; x++, src += 4, dst += 3) {
+            dst[0] = lut[src[c0]];
+            dst[1] = lut[src[offsetof(pixel, G)]];
+            dst[2] = lut[src[c2]];
+        }
+        break;
+    }
+    case IMG_TENSOR_FLOAT32: {
+        const float *lut = ctx->lut.f32;
+        float *dst = (float *)(ctx->out + (size_t)y * ctx->row_bytes);
+        for (int x = 0; x < width; x++, src += 4, dst += 3) {
+            dst[0] = lut[src[c0]];
+            dst[1] = lut[src[offsetof(pixel, G)]];
+            dst[2] = lut[src[c2]];
+        }
+        break;
+    }
+    }
+}
+
+// Largest centered region with the tensor's aspect ratio, scaled by crop_fraction
+static void center_crop(int width, int height, const img_tensor_spec *spec, int *x, int *y, int *w, int *h)
+{
+    double aspect = (double)spec->width / spec->height;
+    double cw = width, ch = height;
+
+    if (cw / ch > aspect) {
+        cw = ch * aspect;
+    } else {
+        ch = cw / aspect;
+    }
+    cw *= spec->crop_fraction;
+    ch *= spec->crop_fraction;
+
+    *w = (int)lround(cw);
+    *h = (int)lround(ch);
+    if (*w < 1) *w = 1;
+    if (*h < 1) *h = 1;
+    *x = (width - *w) / 2;
+    *y = (height - *h) / 2;
+}
+
+// Validates the spec and prepares the row sink; returns RET_FAIL for unusable specs
+static int tensor_sink_init(tensor_sink_ctx *ctx, const img_tensor_spec *spec, void *out)
+{
+    if (!spec || !out) return RET_FAIL;
+    if (spec->width <= 0 || spec->height <= 0) return RET_FAIL;
+    if (!(spec->crop_fraction > 0.0f && spec->crop_fraction <= 1.0f)) return RET_FAIL;
+
+    size_t elem_size;
+    switch (spec->type) {
+    case IMG_TENSOR_UINT8:
+    case IMG_TENSOR_INT8:    elem_size = 1; break;
+    case IMG_TENSOR_FLOAT32: elem_size = sizeof(float); break;
+    default: return RET_FAIL;
+    }
+
+    ctx->spec = spec;
+    ctx->out = (unsigned char *)out;
+    ctx->row_bytes = (size_t)spec->width * 3 * elem_size;
+    ctx->first = spec->order == IMG_ORDER_BGR ? offsetof(pixel, B) : offsetof(pixel, R);
+    ctx->third = spec->order == IMG_ORDER_BGR ? offsetof(pixel, R) : offsetof(pixel, B);
+    build_lut(ctx);
+    return RET_SUCCESS;
+}
+
+// Center-cropped resize plan from a source of the given size into the tensor
+static const img_resize_plan* tensor_plan(int width, int height, const img_tensor_spec *spec)
+{
+    int rx, ry, rw, rh;
+    center_crop(width, height, spec, &rx, &ry, &rw, &rh);
+
+    return img_resize_plan_cached(width, height, rx, ry, rw, rh,
+                                  spec->width, spec->height, spec->filter);
+}
+
+int img_to_tensor(const Image *img, const img_tensor_spec *spec, void *out)
+{
+    if (!img || !img->pixels) return RET_FAIL;
+    IMG_TRACE_SCOPE("img_to_tensor");
+
+    tensor_sink_ctx ctx;
+    if (tensor_sink_init(&ctx, spec, out) != RET_SUCCESS) return RET_FAIL;
+
+    const img_resize_plan *plan = tensor_plan(img->width, img->height, spec);
+    if (!plan) return RET_FAIL;
+
+    IMG_TRACE_COUNT(IMG_TRACE_PIXELS, (size_t)spec->width * spec->height);
+    return img_resize_run(plan, img, tensor_row_sink, &ctx);
+}
+
+typedef struct {
+    tensor_sink_ctx sink;
+    img_resizer rs;
+    int started;
+} load_tensor_ctx;
+
+static int load_tensor_header(void *opaque, int width, int height)
+{
+    load_tensor_ctx *ctx = (load_tensor_ctx *)opaque;
+
+    const img_resize_plan *plan = tensor_plan(width, height, ctx->sink.spec);
+    if (!plan) return -1;
+    if (img_resizer_init(&ctx->rs, plan, tensor_row_sink, &ctx->sink) != RET_SUCCESS) return -1;
+
+    ctx->started = 1;
+    return img_resize_plan_src_rows(plan);
+}
+
+static void load_tensor_row(void *opaque, int y, const pixel *row, int width)
+{
+    (void)y;
+    (void)width;
+    img_resizer_push_row(&((load_tensor_ctx *)opaque)->rs, row);
+}
+
+int img_load_tensor(const char *filename, const img_tensor_spec *spec, void *out)
+{
+    if (!filename) return RET_FAIL;
+    IMG_TRACE_SCOPE("img_load_tensor");
+
+    load_tensor_ctx ctx;
+    ctx.started = 0;
+    if (tensor_sink_init(&ctx.sink, spec, out) != RET_SUCCESS) return RET_FAIL;
+
+    int ret = img_io_read_rows(filename, load_tensor_header, load_tensor_row, &ctx);
+    if (ctx.started) img_resizer_release(&ctx.rs);
+    if (ret == RET_SUCCESS) IMG_TRACE_COUNT(IMG_TRACE_PIXELS, (size_t)spec->width * spec->height);
+    return ret;
+}
@@ -0,0 +1,297 @@
+/**
+ * Multi-layout image tensors.
+ *
+ * Every conversion walks one image row at a time. A row is described by one
+ * pointer per channel (planar) or a single pointer (interleaved); changes of
+ * layout are done on 8-bit samples by the shuffle kernels, and float samples
+ * are narrowed before or widened after them through a per-thread scratch row.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../include/img_utils.h"
+#include "../../internal/img_utils/internal_img_convert.h"
+#include "../../internal/img_utils/internal_img_layout.h"
+#include "../../internal/img_utils/internal_img_pool.h"
+#include "../../internal/img_utils/internal_img_scratch.h"
+#include "../../internal/img_utils/internal_img_storage.h"
+#include "../../internal/img_utils/internal_img_trace.h"
+
+
+// One row of a tensor or image
+typedef struct {
+    unsigned char *ptr[4];  // Channel planes, or ptr[0] for interleaved rows
+    int channels;
+    int planar;
+    img_tensor_type type;
+} row_ref;
+
+static size_t element_size(img_tensor_type type)
+{
+    return type == IMG_TENSOR_FLOAT32 ? sizeof(float) : 1;
+}
+
+static row_ref tensor_row(const img_tensor *t, int index, int y)
+{
+    size_t es = element_size(t->type);
+    size_t plane = (size_t)t->height * t->width;
+    unsigned char *base = (unsigned char *)t->data + (size_t)index * plane * t->channels * es;
+
+    row_ref r = { .channels = t->channels, .planar = t->layout == IMG_LAYOUT_NCHW, .type = t->type };
+    if (r.planar) {
+        for (int c = 0; c < t->channels; c++) {
+            r.ptr[c] = base + ((size_t)c * plane + (size_t)y * t->width) * es;
+        }
+    } else {
+        r.ptr[0] = base + (size_t)y * t->width * t->channels * es;
+    }
+    return r;
+}
+
+static row_ref image_row(const Image *img, int y)
+{
+    row_ref r = { .ptr = { (unsigned char *)img_row(img, y) }, .channels = 4, .planar = 0, .type = IMG_TENSOR_UINT8 };
+    return r;
+}
+
+// Address of sample (x, c) in a row
+static unsigned char* row_at(const row_ref *r, int x, int c)
+{
+    size_t es = element_size(r->type);
+    if (r->planar) return r->ptr[c] + (size_t)x * es;
+    return r->ptr[0] + ((size_t)x * r->channels + c) * es;
+}
+
+// Sample-by-sample layout change for the cases without a dedicated kernel
+static void layout_generic(const row_ref *src, const row_ref *dst, int width)
+{
+    size_t es = element_size(src->type);
+    int shared = src->channels < dst->channels ? src->channels : dst->channels;
+    for (int x = 0; x < width; x++) {
+        for (int c = 0; c < shared; c++) memcpy(row_at(dst, x, c), row_at(src, x, c), es);
+        for (int c = shared; c < dst->channels; c++) {
+            if (es == 1) *row_at(dst, x, c) = 255;
+            else *(float *)row_at(dst, x, c) = 255.0f;
+        }
+    }
+}
+
+// Changes layout and channel count between rows of the same element type
+static void layout_row(const row_ref *src, const row_ref *dst, int width)
+{
+    int sc = src->channels, dc = dst->channels;
+    if (src->type != IMG_TENSOR_UINT8) {
+        if (!src->planar && !dst->planar && sc == dc) {
+            memcpy(dst->ptr[0], src->ptr[0], (size_t)width * sc * sizeof(float));
+        } else {
+            layout_generic(src, dst, width);
+        }
+        return;
+    }
+
+    if (!src->planar && !dst->planar) {
+        if (sc == dc) memcpy(dst->ptr[0], src->ptr[0], (size_t)width * sc);
+        else if (sc == 4 && dc == 3) img_layout_drop_alpha_u8(src->ptr[0], dst->ptr[0], width);
+        else if (sc == 3 && dc == 4) img_cvt_rgb_to_rgba(src->ptr[0], (pixel *)dst->ptr[0], width);
+        else layout_generic(src, dst, width);
+    } else if (!src->planar) {
+        if (sc == 4) {
+            img_layout_deinterleave4_u8(src->ptr[0], dst->ptr[0], dst->ptr[1], dst->ptr[2],
+                                        dc == 4 ? dst->ptr[3] : NULL, width);
+        } else if (sc == 3) {
+            img_layout_deinterleave3_u8(src->ptr[0], dst->ptr[0], dst->ptr[1], dst->ptr[2], width);
+            if (dc == 4) memset(dst->ptr[3], 255, width);
+        } else {
+            layout_generic(src, dst, width);
+        }
+    } else if (!dst->planar) {
+        if (dc == 4 && sc >= 3) {
+            img_layout_interleave4_u8(src->ptr[0], src->ptr[1], src->ptr[2],
+                                      sc == 4 ? src->ptr[3] : NULL, dst->ptr[0], width);
+        } else if (dc == 3) {
+            img_layout_interleave3_u8(src->ptr[0], src->ptr[1], src->ptr[2], dst->ptr[0], width);
+        } else {
+            layout_generic(src, dst, width);
+        }
+    } else {
+        for (int c = 0; c < dc; c++) {
+            if (c < sc) memcpy(dst->ptr[c], src->ptr[c], width);
+            else memset(dst->ptr[c], 255, width);
+        }
+    }
+}
+
+// Changes the element type between rows of the same layout and channel count
+static void type_row(const row_ref *src, const row_ref *dst, int width)
+{
+    int spans = src->planar ? src->channels : 1;
+    size_t n = src->planar ? (size_t)width : (size_t)width * src->channels;
+    for (int c = 0; c < spans; c++) {
+        if (src->type == IMG_TENSOR_UINT8) img_layout_u8_to_f32(src->ptr[c], (float *)dst->ptr[c], n);
+        else img_layout_f32_to_u8((const float *)src->ptr[c], dst->ptr[c], n);
+    }
+}
+
+// 8-bit row used between the type and layout steps on each thread
+static _Thread_local img_scratch convert_scratch;
+
+// Points an 8-bit row with the given shape at the scratch buffer
+static int scratch_row(row_ref *r, int width, int channels, int planar)
+{
+    unsigned char *data = (unsigned char *)img_scratch_reserve(&convert_scratch, (size_t)width * channels);
+    if (!data) return RET_FAIL;
+
+    r->channels = channels;
+    r->planar = planar;
+    r->type = IMG_TENSOR_UINT8;
+    for (int c = 0; c < 4; c++) {
+        r->ptr[c] = planar ? data + (size_t)(c < channels ? c : 0) * width : data;
+    }
+    return RET_SUCCESS;
+}
+
+// Converts one row; every layout change happens on 8-bit samples
+static int convert_row(const row_ref *src, const row_ref *dst, int width)
+{
+    if (src->type == dst->type) {
+        layout_row(src, dst, width);
+        return RET_SUCCESS;
+    }
+    if (src->channels == dst->channels && src->planar == dst->planar) {
+        type_row(src, dst, width);
+        return RET_SUCCESS;
+    }
+
+    row_ref mid;
+    if (src->type == IMG_TENSOR_FLOAT32) {
+        // Narrow in the source layout, then shuffle into place
+        if (scratch_row(&mid, width, src->channels, src->planar) != RET_SUCCESS) return RET_FAIL;
+        type_row(src, &mid, width);
+        layout_row(&mid, dst, width);
+    } else {
+        // Shuffle into the destination layout, then widen
+        if (scratch_row(&mid, width, dst->channels, dst->planar) != RET_SUCCESS) return RET_FAIL;
+        layout_row(src, &mid, width);
+        type_row(&mid, dst, width);
+    }
+    return RET_SUCCESS;
+}
+
+// Channel counts convert_row() accepts
+static int channels_compatible(int src, int dst)
+{
+    return src == dst || (src == 4 && dst == 3) || (src == 3 && dst == 4);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+img_tensor* img_tensor_new(int batch, int height, int width, int channels, img_layout layout, img_tensor_type type)
+{
+    if (batch <= 0 || height <= 0 || width <= 0 || channels < 1 || channels > 4) return NULL;
+    if (layout != IMG_LAYOUT_NHWC && layout != IMG_LAYOUT_NCHW) return NULL;
+    if (type != IMG_TENSOR_UINT8 && type != IMG_TENSOR_FLOAT32) return NULL;
+
+    size_t elements = (size_t)batch * height;
+    if (elements > SIZE_MAX / width) return NULL;
+    elements *= width;
+    if (elements > SIZE_MAX / (channels * element_size(type))) return NULL;
+
+    img_storage *storage = img_storage_new(elements * channels * element_size(type));
+    if (!storage) return NULL;
+
+    img_tensor *t = (img_tensor *)img_pool_alloc(sizeof(img_tensor));
+    if (!t) {
+        img_storage_release(storage);
+        return NULL;
+    }
+
+    t->batch = batch;
+    t->height = height;
+    t->width = width;
+    t->channels = channels;
+    t->layout = layout;
+    t->type = type;
+    t->data = storage->data;
+    t->storage = storage; // Takes over the initial reference
+    return t;
+}
+
+void img_tensor_free(img_tensor *t)
+{
+    if (t != NULL) {
+        img_storage_release(t->storage);
+        img_pool_free(t);
+    }
+}
+
+size_t img_tensor_bytes(const img_tensor *t)
+{
+    return (size_t)t->batch * t->height * t->width * t->channels * element_size(t->type);
+}
+
+void* img_tensor_plane(const img_tensor *t, int index, int channel)
+{
+    if (!t || t->layout != IMG_LAYOUT_NCHW) return NULL;
+    if (index < 0 || index >= t->batch || channel < 0 || channel >= t->channels) return NULL;
+    return tensor_row(t, index, 0).ptr[channel];
+}
+
+int img_tensor_from_image(const Image *src, img_tensor *dst, int index)
+{
+    if (!src || !src->pixels || !dst || !dst->data) return RET_FAIL;
+    if (index < 0 || index >= dst->batch) return RET_FAIL;
+    if (src->width != dst->width || src->height != dst->height) return RET_FAIL;
+    if (dst->channels != 3 && dst->channels != 4) return RET_FAIL;
+    IMG_TRACE_SCOPE("img_tensor_from_image");
+
+    for (int y = 0; y < src->height; y++) {
+        row_ref s = image_row(src, y), d = tensor_row(dst, index, y);
+        if (convert_row(&s, &d, src->width) != RET_SUCCESS) return RET_FAIL;
+    }
+    IMG_TRACE_COUNT(IMG_TRACE_PIXELS, (size_t)src->width * src->height);
+    return RET_SUCCESS;
+}
+
+int img_tensor_to_image(const img_tensor *src, int index, Image *dst)
+{
+    if (!src || !src->data || !dst || !dst->pixels) return RET_FAIL;
+    if (index < 0 || index >= src->batch) return RET_FAIL;
+    if (src->width != dst->width || src->height != dst->height) return RET_FAIL;
+    if (src->channels != 3 && src->channels != 4) return RET_FAIL;
+    IMG_TRACE_SCOPE("img_tensor_to_image");
+
+    for (int y = 0; y < dst->height; y++) {
+        row_ref s = tensor_row(src, index, y), d = image_row(dst, y);
+        if (convert_row(&s, &d, dst->width) != RET_SUCCESS) return RET_FAIL;
+    }
+    IMG_TRACE_COUNT(IMG_TRACE_PIXELS, (size_t)dst->width * dst->height);
+    return RET_SUCCESS;
+}
+
+int img_tensor_convert(const img_tensor *src, img_tensor *dst)
+{
+    if (!src || !src->data || !dst || !dst->data) return RET_FAIL;
+    if (src->batch != dst->batch || src->height != dst->height || src->width != dst->width) return RET_FAIL;
+    if (!channels_compatible(src->channels, dst->channels)) return RET_FAIL;
+    IMG_TRACE_SCOPE("img_tensor_convert");
+
+    // Same shape and type: the buffers are byte-identical
+    if (src->channels == dst->channels && src->type == dst->type &&
+        (src->layout == dst->layout || src->channels == 1)) {
+        memcpy(dst->data, src->data, img_tensor_bytes(src));
+        IMG_TRACE_COUNT(IMG_TRACE_PIXELS, (size_t)src->batch * src->height * src->width);
+        return RET_SUCCESS;
+    }
+
+    for (int n = 0; n < src->batch; n++) {
+        for (int y = 0; y < src->height; y++) {
+            row_ref s = tensor_row(src, n, y), d = tensor_row(dst, n, y);
+            if (convert_row(&s, &d, src->width) != RET_SUCCESS) return RET_FAIL;
+        }
+    }
+    IMG_TRACE_COUNT(IMG_TRACE_PIXELS, (size_t)src->batch * src->height * src->width);
+    return RET_SUCCESS;
+}
@@ -0,0 +1,341 @@
+/**
+ * Stage instrumentation.
+ *
+ * Every thread records its events into a private list of fixed-size chunks,
+ * so recording takes no lock except when a chunk fills up. A chunk's event
+ * count is published with release semantics, which lets the exporters read
+ * completed events while other threads keep recording.
+ */
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../include/img_utils.h"
+#include "../../internal/img_utils/internal_img_trace.h"
+
+
+#define CHUNK_EVENTS 4096
+#define MAX_THREAD_EVENTS (1 << 20) // Further events of a thread are counted as dropped
+
+typedef struct {
+    const char *name;
+    uint64_t start;
+    uint64_t duration;
+    uint64_t counters[IMG_TRACE_COUNTERS];
+} trace_event;
+
+typedef struct trace_chunk {
+    struct trace_chunk *next; // Linked under trace_lock
+    atomic_int count;         // Events readers may look at
+    trace_event events[CHUNK_EVENTS];
+} trace_chunk;
+
+typedef struct trace_thread {
+    struct trace_thread *next;
+    int tid;
+    atomic_ullong counters[IMG_TRACE_COUNTERS]; // Written by the owner only
+    trace_chunk *head;
+    trace_chunk *tail;
+    int events;
+    atomic_ullong dropped;
+} trace_thread;
+
+// Aggregate of every event sharing a name, for the summary
+typedef struct {
+    const char *name;
+    unsigned long long calls;
+    uint64_t total;
+    uint64_t max;
+    uint64_t counters[IMG_TRACE_COUNTERS];
+} trace_stat;
+
+static const char *counter_names[IMG_TRACE_COUNTERS] = { "bytes_read", "bytes_written", "pixels", "allocs" };
+
+atomic_int img_trace_active;
+
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static trace_thread *threads;
+static int thread_count;
+static atomic_uint generation; // Bumped by img_trace_reset() so threads register again
+static uint64_t epoch;         // Event timestamps are exported relative to this
+
+static _Thread_local trace_thread *self;
+static _Thread_local unsigned self_generation;
+
+static const char *exit_path;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// The calling thread's buffer, registered on first use
+static trace_thread* thread_buffer(void)
+{
+    unsigned gen = atomic_load_explicit(&generation, memory_order_acquire);
+    if (self && self_generation == gen) return self;
+
+    trace_thread *t = (trace_thread *)calloc(1, sizeof(trace_thread));
+    if (!t) return NULL;
+    pthread_mutex_lock(&trace_lock);
+    t->tid = ++thread_count;
+    t->next = threads;
+    threads = t;
+    pthread_mutex_unlock(&trace_lock);
+
+    self = t;
+    self_generation = gen;
+    return t;
+}
+
+void img_trace_open(img_trace_scope *scope)
+{
+    trace_thread *t = thread_buffer();
+    if (!t) return;
+    for (int i = 0; i < IMG_TRACE_COUNTERS; i++) {
+        scope->counters[i] = atomic_load_explicit(&t->counters[i], memory_order_relaxed);
+    }
+    scope->start = now_ns();
+}
+
+void img_trace_close(img_trace_scope *scope)
+{
+    uint64_t end = now_ns();
+    trace_thread *t = thread_buffer();
+    if (!t) return;
+    if (t->events >= MAX_THREAD_EVENTS) {
+        atomic_fetch_add_explicit(&t->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    trace_chunk *c = t->tail;
+    int n = c ? atomic_load_explicit(&c->count, memory_order_relaxed) : CHUNK_EVENTS;
+    if (n == CHUNK_EVENTS) {
+        c = (trace_chunk *)malloc(sizeof(trace_chunk));
+        if (!c) {
+            atomic_fetch_add_explicit(&t->dropped, 1, memory_order_relaxed);
+            return;
+        }
+        c->next = NULL;
+        atomic_init(&c->count, 0);
+        pthread_mutex_lock(&trace_lock);
+        if (t->tail) t->tail->next = c;
+        else t->head = c;
+        t->tail = c;
+        pthread_mutex_unlock(&trace_lock);
+        n = 0;
+    }
+
+    trace_event *e = &c->events[n];
+    e->name = scope->name;
+    e->start = scope->start;
+    e->duration = end - scope->start;
+    for (int i = 0; i < IMG_TRACE_COUNTERS; i++) {
+        e->counters[i] = atomic_load_explicit(&t->counters[i], memory_order_relaxed) - scope->counters[i];
+    }
+    atomic_store_explicit(&c->count, n + 1, memory_order_release);
+    t->events++;
+}
+
+void img_trace_add(img_trace_counter counter, uint64_t n)
+{
+    trace_thread *t = thread_buffer();
+    if (!t) return;
+    // Single writer, so a plain load and store is enough
+    uint64_t v = atomic_load_explicit(&t->counters[counter], memory_order_relaxed);
+    atomic_store_explicit(&t->counters[counter], v + n, memory_order_relaxed);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Control                                                                   */
+/* ------------------------------------------------------------------------- */
+
+void img_trace_enable(int enabled)
+{
+    pthread_mutex_lock(&trace_lock);
+    if (enabled && !epoch) epoch = now_ns();
+    atomic_store(&img_trace_active, enabled ? 1 : 0);
+    pthread_mutex_unlock(&trace_lock);
+}
+
+int img_trace_enabled(void)
+{
+    return atomic_load(&img_trace_active);
+}
+
+void img_trace_reset(void)
+{
+    pthread_mutex_lock(&trace_lock);
+    trace_thread *t = threads;
+    threads = NULL;
+    thread_count = 0;
+    epoch = atomic_load(&img_trace_active) ? now_ns() : 0;
+    atomic_fetch_add_explicit(&generation, 1, memory_order_release);
+    pthread_mutex_unlock(&trace_lock);
+
+    while (t) {
+        trace_thread *next = t->next;
+        trace_chunk *c = t->head;
+        while (c) {
+            trace_chunk *cn = c->next;
+            free(c);
+            c = cn;
+        }
+        free(t);
+        t = next;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* Export                                                                    */
+/* ------------------------------------------------------------------------- */
+
+// JSON string contents; event names are identifiers, but stay safe for any input
+static void write_json_string(FILE *fp, const char *s)
+{
+    for (; *s; s++) {
+        unsigned char ch = (unsigned char)*s;
+        if (ch == '"' || ch == '\\') fprintf(fp, "\\%c", ch);
+        else if (ch < 0x20) fprintf(fp, "\\u%04x", ch);
+        else fputc(ch, fp);
+    }
+}
+
+int img_trace_write(const char *filename)
+{
+    FILE *fp = fopen(filename, "w");
+    if (!fp) return RET_FAIL;
+
+    int pid = (int)getpid();
+    int first = 1;
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    pthread_mutex_lock(&trace_lock);
+    for (trace_thread *t = threads; t; t = t->next) {
+        fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+                first ? "" : ",\n", pid, t->tid, t->tid);
+        first = 0;
+
+        for (trace_chunk *c = t->head; c; c = c->next) {
+            int n = atomic_load_explicit(&c->count, memory_order_acquire);
+            for (int i = 0; i < n; i++) {
+                const trace_event *e = &c->events[i];
+                double ts = ((int64_t)(e->start - epoch)) / 1e3;
+                fprintf(fp, ",\n{\"name\":\"");
+                write_json_string(fp, e->name);
+                fprintf(fp, "\",\"cat\":\"neuro-lens\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{",
+                        pid, t->tid, ts, e->duration / 1e3);
+                int sep = 0;
+                for (int k = 0; k < IMG_TRACE_COUNTERS; k++) {
+                    if (!e->counters[k]) continue;
+                    fprintf(fp, "%s\"%s\":%llu", sep ? "," : "", counter_names[k], (unsigned long long)e->counters[k]);
+                    sep = 1;
+                }
+                fprintf(fp, "}}");
+            }
+        }
+    }
+    pthread_mutex_unlock(&trace_lock);
+
+    fprintf(fp, "\n]}\n");
+    return fclose(fp) == 0 ? RET_SUCCESS : RET_FAIL;
+}
+
+static int compare_stat(const void *a, const void *b)
+{
+    const trace_stat *x = (const trace_stat *)a, *y = (const trace_stat *)b;
+    return (x->total < y->total) - (x->total > y->total);
+}
+
+// Returns the aggregate for a name, adding one to the table when needed
+static trace_stat* stat_for(trace_stat **stats, int *count, int *capacity, const char *name)
+{
+    for (int i = 0; i < *count; i++) {
+        if ((*stats)[i].name == name || strcmp((*stats)[i].name, name) == 0) return &(*stats)[i];
+    }
+    if (*count == *capacity) {
+        int grown = *capacity ? *capacity * 2 : 32;
+        trace_stat *more = (trace_stat *)realloc(*stats, sizeof(trace_stat) * grown);
+        if (!more) return NULL;
+        *stats = more;
+        *capacity = grown;
+    }
+    trace_stat *s = &(*stats)[(*count)++];
+    memset(s, 0, sizeof(*s));
+    s->name = name;
+    return s;
+}
+
+void img_trace_print_summary(FILE *out)
+{
+    trace_stat *stats = NULL;
+    int count = 0, capacity = 0, thread_total = 0;
+    unsigned long long events = 0, dropped = 0;
+    uint64_t totals[IMG_TRACE_COUNTERS] = { 0 };
+
+    pthread_mutex_lock(&trace_lock);
+    for (trace_thread *t = threads; t; t = t->next) {
+        thread_total++;
+        dropped += atomic_load_explicit(&t->dropped, memory_order_relaxed);
+        for (int k = 0; k < IMG_TRACE_COUNTERS; k++) {
+            totals[k] += atomic_load_explicit(&t->counters[k], memory_order_relaxed);
+        }
+        for (trace_chunk *c = t->head; c; c = c->next) {
+            int n = atomic_load_explicit(&c->count, memory_order_acquire);
+            for (int i = 0; i < n; i++) {
+                const trace_event *e = &c->events[i];
+                trace_stat *s = stat_for(&stats, &count, &capacity, e->name);
+                if (!s) continue;
+                s->calls++;
+                s->total += e->duration;
+                if (e->duration > s->max) s->max = e->duration;
+                for (int k = 0; k < IMG_TRACE_COUNTERS; k++) s->counters[k] += e->counters[k];
+                events++;
+            }
+        }
+    }
+    pthread_mutex_unlock(&trace_lock);
+
+    qsort(stats, count, sizeof(trace_stat), compare_stat);
+
+    fprintf(out, "trace: %llu events on %d threads, %llu dropped; counters include nested scopes\n",
+            events, thread_total, dropped);
+    fprintf(out, "%-24s %8s %11s %10s %10s %9s %10s %9s %8s\n",
+            "scope", "calls", "total ms", "mean us", "max ms", "MB read", "MB written", "Mpix", "allocs");
+    for (int i = 0; i < count; i++) {
+        const trace_stat *s = &stats[i];
+        fprintf(out, "%-24s %8llu %11.3f %10.1f %10.3f %9.2f %10.2f %9.2f %8llu\n",
+                s->name, s->calls, s->total / 1e6, s->total / 1e3 / s->calls, s->max / 1e6,
+                s->counters[IMG_TRACE_BYTES_READ] / 1e6, s->counters[IMG_TRACE_BYTES_WRITTEN] / 1e6,
+                s->counters[IMG_TRACE_PIXELS] / 1e6, (unsigned long long)s->counters[IMG_TRACE_ALLOCS]);
+    }
+    fprintf(out, "%-24s %8s %11s %10s %10s %9.2f %10.2f %9.2f %8llu\n", "all threads", "", "", "", "",
+            totals[IMG_TRACE_BYTES_READ] / 1e6, totals[IMG_TRACE_BYTES_WRITTEN] / 1e6,
+            totals[IMG_TRACE_PIXELS] / 1e6, (unsigned long long)totals[IMG_TRACE_ALLOCS]);
+    free(stats);
+}
+
+static void write_at_exit(void)
+{
+    img_trace_enable(0);
+    if (img_trace_write(exit_path) != RET_SUCCESS) {
+        fprintf(stderr, "Could not write trace %s.\n", exit_path);
+    }
+    img_trace_print_summary(stderr);
+}
+
+__attribute__((constructor))
+static void enable_from_env(void)
+{
+    const char *path = getenv(IMG_TRACE_ENV);
+    if (!path || !*path) return;
+    exit_path = path;
+    img_trace_enable(1);
+    atexit(write_at_exit);
+}
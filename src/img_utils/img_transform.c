@@ -0,0 +1,287 @@
+/**
+ * Deferred geometric transforms.
+ *
+ * Recorded operations only update a 2x3 matrix mapping output coordinates
+ * back to source coordinates, so any chain costs one sampling pass. When the
+ * chain ends up axis-aligned it is run by the separable resize engine over
+ * the reachable source region (with flips applied while storing rows), or as
+ * a plain row copy when no resampling is needed at all; anything rotated goes
+ * through the inverse-mapping affine sampler.
+ */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../include/img_utils.h"
+#include "../../internal/img_utils/internal_img_cache.h"
+#include "../../internal/img_utils/internal_img_pool.h"
+#include "../../internal/img_utils/internal_img_resize.h"
+#include "../../internal/img_utils/internal_img_trace.h"
+#include "../../internal/img_utils/internal_img_warp.h"
+#include "../../internal/math/math_utils.h"
+#include "../../internal/thread/parallel.h"
+
+
+// Composed coordinates within this distance of an integer are treated as exact
+#define SNAP_EPSILON 1e-9
+
+struct img_transform {
+    int src_width;   // Size of the images the chain applies to
+    int src_height;
+    int width;       // Current output size
+    int height;
+    // Output (X, Y) to source: sx = a * X + b * Y + c, sy = d * X + e * Y + f
+    double a, b, c;
+    double d, e, f;
+};
+
+// Row sink storing resized rows into the destination, mirrored as needed
+typedef struct {
+    Image *dst;
+    int flip_x;
+    int flip_y;
+} flip_sink_ctx;
+
+static double snap(double v)
+{
+    double r = nearbyint(v);
+    return fabs(v - r) < SNAP_EPSILON ? r : v;
+}
+
+// Appends an operation given as the map from the new output coordinates to the previous ones:
+// X = g00 * X' + g01 * Y' + g02, Y = g10 * X' + g11 * Y' + g12
+static void compose(img_transform *t, double g00, double g01, double g02, double g10, double g11, double g12)
+{
+    double a = t->a * g00 + t->b * g10, b = t->a * g01 + t->b * g11, c = t->a * g02 + t->b * g12 + t->c;
+    double d = t->d * g00 + t->e * g10, e = t->d * g01 + t->e * g11, f = t->d * g02 + t->e * g12 + t->f;
+    t->a = snap(a);
+    t->b = snap(b);
+    t->c = snap(c);
+    t->d = snap(d);
+    t->e = snap(e);
+    t->f = snap(f);
+}
+
+static void flip_sink(void *ctx, int y, const pixel *row, int width)
+{
+    flip_sink_ctx *s = (flip_sink_ctx *)ctx;
+    pixel *out = img_row(s->dst, s->flip_y ? s->dst->height - 1 - y : y);
+    if (s->flip_x) {
+        for (int x = 0; x < width; x++) out[x] = row[width - 1 - x];
+    } else {
+        memcpy(out, row, sizeof(pixel) * width);
+    }
+}
+
+typedef struct {
+    const Image *src;
+    Image *dst;
+    int x0, y0;
+    int flip_x, flip_y;
+} copy_rect_ctx;
+
+// Copies destination rows [begin, end) of a source rectangle, mirrored as needed
+static void copy_rect_rows(void *opaque, int begin, int end)
+{
+    const copy_rect_ctx *c = (const copy_rect_ctx *)opaque;
+    const Image *src = c->src;
+    Image *dst = c->dst;
+
+    for (int y = begin; y < end; y++) {
+        const pixel *in = img_row(src, c->y0 + (c->flip_y ? dst->height - 1 - y : y)) + c->x0;
+        pixel *out = img_row(dst, y);
+        if (c->flip_x) {
+            for (int x = 0; x < dst->width; x++) out[x] = in[dst->width - 1 - x];
+        } else {
+            memcpy(out, in, sizeof(pixel) * dst->width);
+        }
+    }
+}
+
+// Copies a source rectangle; for chains of crops, flips and quarter turns of the canvas
+static void copy_rect(const Image *src, Image *dst, int x0, int y0, int flip_x, int flip_y)
+{
+    copy_rect_ctx ctx = { src, dst, x0, y0, flip_x, flip_y };
+    img_parallel_for(dst->height, img_parallel_grain(dst->width), copy_rect_rows, &ctx);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+img_transform* img_transform_new(int width, int height)
+{
+    if (width <= 0 || height <= 0) return NULL;
+
+    img_transform *t = (img_transform *)img_pool_alloc(sizeof(img_transform));
+    if (!t) return NULL;
+
+    t->src_width = t->width = width;
+    t->src_height = t->height = height;
+    t->a = 1.0, t->b = 0.0, t->c = 0.0;
+    t->d = 0.0, t->e = 1.0, t->f = 0.0;
+    return t;
+}
+
+void img_transform_free(img_transform *t)
+{
+    img_pool_free(t);
+}
+
+void img_transform_size(const img_transform *t, int *width, int *height)
+{
+    if (width) *width = t->width;
+    if (height) *height = t->height;
+}
+
+int img_transform_crop(img_transform *t, int x, int y, int width, int height)
+{
+    if (!t || x < 0 || y < 0 || width <= 0 || height <= 0) return RET_FAIL;
+    if (x + width > t->width || y + height > t->height) return RET_FAIL;
+
+    compose(t, 1.0, 0.0, x, 0.0, 1.0, y);
+    t->width = width;
+    t->height = height;
+    return RET_SUCCESS;
+}
+
+int img_transform_resize(img_transform *t, int width, int height)
+{
+    if (!t || width <= 0 || height <= 0) return RET_FAIL;
+
+    compose(t, (double)t->width / width, 0.0, 0.0, 0.0, (double)t->height / height, 0.0);
+    t->width = width;
+    t->height = height;
+    return RET_SUCCESS;
+}
+
+int img_transform_rotate(img_transform *t, float angle)
+{
+    if (!t) return RET_FAIL;
+
+    // Same map as img_rotate_into() with equal canvases: clockwise about the center
+    double sn, cs;
+    sincos_approx(angle, &sn, &cs);
+    if (fmod(angle, 90.0) == 0.0) {
+        sn = nearbyint(sn);
+        cs = nearbyint(cs);
+    }
+    double cx = t->width / 2.0, cy = t->height / 2.0;
+    compose(t, cs, sn, cx - cs * cx - sn * cy, -sn, cs, cy + sn * cx - cs * cy);
+    return RET_SUCCESS;
+}
+
+int img_transform_rotate90(img_transform *t, int quarter_turns)
+{
+    if (!t) return RET_FAIL;
+
+    // Same maps as img_rotate90(): the canvas follows the rotation
+    int w = t->width, h = t->height;
+    switch (((quarter_turns % 4) + 4) % 4) {
+    case 1:
+        compose(t, 0.0, 1.0, 0.0, -1.0, 0.0, h);
+        t->width = h;
+        t->height = w;
+        break;
+    case 2:
+        compose(t, -1.0, 0.0, w, 0.0, -1.0, h);
+        break;
+    case 3:
+        compose(t, 0.0, -1.0, w, 1.0, 0.0, 0.0);
+        t->width = h;
+        t->height = w;
+        break;
+    default:
+        break;
+    }
+    return RET_SUCCESS;
+}
+
+int img_transform_flip_horizontal(img_transform *t)
+{
+    if (!t) return RET_FAIL;
+    compose(t, -1.0, 0.0, t->width, 0.0, 1.0, 0.0);
+    return RET_SUCCESS;
+}
+
+int img_transform_flip_vertical(img_transform *t)
+{
+    if (!t) return RET_FAIL;
+    compose(t, 1.0, 0.0, 0.0, 0.0, -1.0, t->height);
+    return RET_SUCCESS;
+}
+
+int img_transform_apply(const img_transform *t, const Image *src, Image *dst, img_filter filter,
+                        img_border border, pixel fill)
+{
+    if (!t || !src || !src->pixels || !dst || !dst->pixels || src == dst) return RET_FAIL;
+    if (src->width != t->src_width || src->height != t->src_height) return RET_FAIL;
+    if (dst->width != t->width || dst->height != t->height) return RET_FAIL;
+    IMG_TRACE_SCOPE("img_transform_apply");
+    IMG_TRACE_COUNT(IMG_TRACE_PIXELS, (size_t)dst->width * dst->height);
+
+    if (t->b == 0.0 && t->d == 0.0) {
+        // Axis-aligned: the output covers one source rectangle, possibly mirrored
+        double x0 = t->c, x1 = t->a * t->width + t->c;
+        double y0 = t->f, y1 = t->e * t->height + t->f;
+        int flip_x = x1 < x0, flip_y = y1 < y0;
+        if (flip_x) {
+            double tmp = x0;
+            x0 = x1;
+            x1 = tmp;
+        }
+        if (flip_y) {
+            double tmp = y0;
+            y0 = y1;
+            y1 = tmp;
+        }
+        x0 = snap(x0), x1 = snap(x1), y0 = snap(y0), y1 = snap(y1);
+
+        if (x0 >= 0.0 && y0 >= 0.0 && x1 <= src->width && y1 <= src->height) {
+            // Whole pixels at scale 1 need no resampling
+            if (fabs(t->a) == 1.0 && fabs(t->e) == 1.0 && x0 == floor(x0) && y0 == floor(y0)) {
+                copy_rect(src, dst, (int)x0, (int)y0, flip_x, flip_y);
+                return RET_SUCCESS;
+            }
+
+            img_resize_plan plan;
+            if (img_resize_plan_init_region(&plan, src->width, src->height, x0, y0, x1, y1,
+                                            dst->width, dst->height, filter) != RET_SUCCESS) {
+                return RET_FAIL;
+            }
+            flip_sink_ctx ctx = { dst, flip_x, flip_y };
+            int ret = img_resize_run(&plan, src, flip_sink, &ctx);
+            img_resize_plan_release(&plan);
+            return ret;
+        }
+    }
+
+    img_affine m = { .a = t->a, .b = t->b, .c = t->c, .d = t->d, .e = t->e, .f = t->f, .px = 0.0, .py = 0.0 };
+    img_warp_affine(src, dst, &m, filter != IMG_FILTER_NEAREST, border, fill);
+    return RET_SUCCESS;
+}
+
+uint64_t img_transform_fingerprint(const img_transform *t, img_filter filter)
+{
+    // Without geometry the filter is never used
+    if (!t) return img_hash_bytes(NULL, 0, 0);
+
+    int32_t sizes[5] = { t->src_width, t->src_height, t->width, t->height, (int32_t)filter };
+    double matrix[6] = { t->a, t->b, t->c, t->d, t->e, t->f };
+    return img_hash_bytes(matrix, sizeof(matrix), img_hash_bytes(sizes, sizeof(sizes), 0));
+}
+
+Image* img_transform_render(const img_transform *t, const Image *src, img_filter filter)
+{
+    if (!t) return NULL;
+
+    Image *dst = img_new(t->width, t->height);
+    if (!dst) return NULL;
+
+    pixel transparent = { 0, 0, 0, 0 };
+    if (img_transform_apply(t, src, dst, filter, IMG_BORDER_CONSTANT, transparent) != RET_SUCCESS) {
+        img_free(dst);
+        return NULL;
+    }
+    return dst;
+}
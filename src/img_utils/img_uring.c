@@ -0,0 +1,189 @@
+/**
+ * io_uring through the raw system calls.
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "../../internal/img_utils/internal_img_uring.h"
+
+
+struct img_uring {
+    int fd;
+    unsigned entries;
+    void *sq_ring;        // Submission ring mapping; also holds the completion ring on newer kernels
+    size_t sq_ring_size;
+    void *cq_ring;        // Completion ring mapping, equal to sq_ring when shared
+    size_t cq_ring_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+    unsigned tail;        // Local submission tail, published by img_uring_submit()
+    unsigned queued;      // Entries reserved since the last submission
+};
+
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && defined(__NR_io_uring_register)
+
+// The operations the image loader issues
+static int ring_supports_ops(int fd)
+{
+    size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = (struct io_uring_probe *)calloc(1, size);
+    if (!probe) return 0;
+
+    int ok = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+    static const int ops[] = { IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ };
+    for (size_t i = 0; ok && i < sizeof(ops) / sizeof(ops[0]); i++) {
+        ok = ops[i] <= probe->last_op && (probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    return ok;
+}
+
+img_uring* img_uring_new(unsigned entries)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (fd < 0) return NULL;
+    if (!ring_supports_ops(fd)) {
+        close(fd);
+        return NULL;
+    }
+
+    img_uring *ring = (img_uring *)calloc(1, sizeof(img_uring));
+    if (!ring) {
+        close(fd);
+        return NULL;
+    }
+    ring->fd = fd;
+    ring->entries = p.sq_entries;
+    ring->sq_ring = ring->cq_ring = MAP_FAILED;
+    ring->sqes = (struct io_uring_sqe *)MAP_FAILED;
+
+    ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    int single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single && ring->cq_ring_size > ring->sq_ring_size) ring->sq_ring_size = ring->cq_ring_size;
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                         IORING_OFF_SQ_RING);
+    if (ring->sq_ring != MAP_FAILED) {
+        ring->cq_ring = single ? ring->sq_ring
+                               : mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                      fd, IORING_OFF_CQ_RING);
+    }
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    if (ring->cq_ring != MAP_FAILED) {
+        ring->sqes = (struct io_uring_sqe *)mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                                                 MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    }
+    if (ring->sqes == MAP_FAILED) {
+        img_uring_free(ring);
+        return NULL;
+    }
+
+    unsigned char *sq = (unsigned char *)ring->sq_ring, *cq = (unsigned char *)ring->cq_ring;
+    ring->sq_head = (unsigned *)(sq + p.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + p.sq_off.array);
+    ring->cq_head = (unsigned *)(cq + p.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    ring->tail = *ring->sq_tail;
+    return ring;
+}
+
+void img_uring_free(img_uring *ring)
+{
+    if (!ring) return;
+    if (ring->sqes != MAP_FAILED) munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring != MAP_FAILED && ring->cq_ring != ring->sq_ring) munmap(ring->cq_ring, ring->cq_ring_size);
+    if (ring->sq_ring != MAP_FAILED) munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->fd);
+    free(ring);
+}
+
+struct io_uring_sqe* img_uring_get_sqe(img_uring *ring)
+{
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->tail - head >= ring->entries) return NULL;
+
+    unsigned index = ring->tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    ring->tail++;
+    ring->queued++;
+    return sqe;
+}
+
+int img_uring_submit(img_uring *ring, unsigned wait)
+{
+    // Publish the new entries before the kernel reads the tail
+    __atomic_store_n(ring->sq_tail, ring->tail, __ATOMIC_RELEASE);
+    for (;;) {
+        int ret = (int)syscall(__NR_io_uring_enter, ring->fd, ring->queued, wait,
+                               wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (ret >= 0) {
+            ring->queued -= (unsigned)ret < ring->queued ? (unsigned)ret : ring->queued;
+            return RET_SUCCESS;
+        }
+        if (errno != EINTR) return RET_FAIL;
+    }
+}
+
+int img_uring_peek(img_uring *ring, uint64_t *user_data, int32_t *res)
+{
+    unsigned head = *ring->cq_head;
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) return 0;
+
+    const struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+    *user_data = cqe->user_data;
+    *res = cqe->res;
+    __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+#else // No io_uring system calls on this platform
+
+img_uring* img_uring_new(unsigned entries)
+{
+    (void)entries;
+    return NULL;
+}
+
+void img_uring_free(img_uring *ring)
+{
+    (void)ring;
+}
+
+struct io_uring_sqe* img_uring_get_sqe(img_uring *ring)
+{
+    (void)ring;
+    return NULL;
+}
+
+int img_uring_submit(img_uring *ring, unsigned wait)
+{
+    (void)ring;
+    (void)wait;
+    return RET_FAIL;
+}
+
+int img_uring_peek(img_uring *ring, uint64_t *user_data, int32_t *res)
+{
+    (void)ring;
+    (void)user_data;
+    (void)res;
+    return 0;
+}
+
+#endif
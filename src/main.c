@@ -39,14 +39,157 @@ neuro-lens/
 └── Makefile                       # Build instructions
 */
 
+#include <getopt.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "../include/img_utils.h"
+#include "../internal/batch/batch.h"
 
 #define IMG_PATH "/home/tknbr/Documents/projectes/neuro-lens/data/image.png"
 #define IMG_COPY_PATH "/home/tknbr/Documents/projectes/neuro-lens/data/resized.png"
 
 
-int main()
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s -i <input> -o <output dir> [options]\n"
+            "  -i, --input PATH     directory of images (PNG, PPM, PAM, BMP), an image, or a file\n"
+            "                       listing one path per line\n"
+            "  -o, --output DIR     directory receiving the processed images, in their input format\n"
+            "  -j, --threads N      worker threads (default: one per CPU)\n"
+            "  -q, --queue N        bound of each inter-stage queue (default: twice the threads)\n"
+            "  -s, --size WxH       resize every image to W x H\n"
+            "  -f, --filter NAME    resize filter: nearest, bilinear or area (default: area)\n"
+            "  -r, --rotate DEG     rotate every image by DEG degrees\n"
+            "  -F, --flip           flip every image horizontally\n"
+            "  -z, --level N        PNG compression level, 1 (fastest) to 9 (smallest); default 6\n"
+            "      --store          write uncompressed PNG data\n"
+            "  -c, --cache DIR      reuse decoded and transformed images cached in DIR across runs\n"
+            "  -t, --trace FILE     record a Chrome trace of the run to FILE and print a stage summary\n"
+            "       %s pack -i <input> -o <prefix> [options]\n"
+            "  -i, --input PATH     directory of images, an image, or a file listing one path per line\n"
+            "  -o, --output PREFIX  path prefix of the shard files (PREFIX-00000.nlp, ...)\n"
+            "      --raw            store decoded pixels instead of the PNG files\n"
+            "  -m, --shard-mb N     start a new shard after N MiB (default: 1024)\n"
+            "Without arguments, runs the single-image demo.\n",
+            prog, prog);
+}
+
+static int parse_filter(const char *name, img_filter *filter)
+{
+    if (strcmp(name, "nearest") == 0) *filter = IMG_FILTER_NEAREST;
+    else if (strcmp(name, "bilinear") == 0) *filter = IMG_FILTER_BILINEAR;
+    else if (strcmp(name, "area") == 0) *filter = IMG_FILTER_AREA;
+    else return RET_FAIL;
+    return RET_SUCCESS;
+}
+
+static int run_batch(int argc, char **argv)
+{
+    static const struct option long_options[] = {
+        { "input",   required_argument, NULL, 'i' },
+        { "output",  required_argument, NULL, 'o' },
+        { "threads", required_argument, NULL, 'j' },
+        { "queue",   required_argument, NULL, 'q' },
+        { "size",    required_argument, NULL, 's' },
+        { "filter",  required_argument, NULL, 'f' },
+        { "rotate",  required_argument, NULL, 'r' },
+        { "flip",    no_argument,       NULL, 'F' },
+        { "level",   required_argument, NULL, 'z' },
+        { "store",   no_argument,       NULL, 'S' },
+        { "cache",   required_argument, NULL, 'c' },
+        { "trace",   required_argument, NULL, 't' },
+        { "help",    no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 },
+    };
+
+    img_batch_options opts = img_batch_defaults();
+    const char *trace = NULL;
+    int c;
+    while ((c = getopt_long(argc, argv, "i:o:j:q:s:f:r:Fz:c:t:h", long_options, NULL)) != -1) {
+        switch (c) {
+        case 'i': opts.input = optarg; break;
+        case 'o': opts.output_dir = optarg; break;
+        case 'j': opts.threads = atoi(optarg); break;
+        case 'q': opts.queue_capacity = atoi(optarg); break;
+        case 's':
+            if (sscanf(optarg, "%dx%d", &opts.width, &opts.height) != 2 || opts.width <= 0 || opts.height <= 0) {
+                fprintf(stderr, "Invalid size %s.\n", optarg);
+                return 1;
+            }
+            break;
+        case 'f':
+            if (parse_filter(optarg, &opts.filter) != RET_SUCCESS) {
+                fprintf(stderr, "Unknown filter %s.\n", optarg);
+                return 1;
+            }
+            break;
+        case 'r': opts.rotate = strtof(optarg, NULL); break;
+        case 'F': opts.flip = 1; break;
+        case 'z': opts.write.level = atoi(optarg); break;
+        case 'S': opts.write.store_only = 1; break;
+        case 'c': opts.cache_dir = optarg; break;
+        case 't': trace = optarg; break;
+        default:
+            usage(argv[0]);
+            return c == 'h' ? 0 : 1;
+        }
+    }
+
+    if (!opts.input || !opts.output_dir || optind != argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (trace) img_trace_enable(1);
+    int ret = img_batch_run(&opts, stdout);
+    if (trace) {
+        img_trace_enable(0);
+        if (img_trace_write(trace) != RET_SUCCESS) {
+            fprintf(stderr, "Could not write trace %s.\n", trace);
+            ret = RET_FAIL;
+        }
+        img_trace_print_summary(stdout);
+    }
+    return ret == RET_SUCCESS ? 0 : 1;
+}
+
+// Arguments after the "pack" command; prog is the program name for the usage text
+static int run_pack(const char *prog, int argc, char **argv)
+{
+    static const struct option long_options[] = {
+        { "input",    required_argument, NULL, 'i' },
+        { "output",   required_argument, NULL, 'o' },
+        { "raw",      no_argument,       NULL, 'R' },
+        { "shard-mb", required_argument, NULL, 'm' },
+        { "help",     no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 },
+    };
+
+    img_pack_options opts = { NULL, NULL, 0, 0 };
+    int c;
+    while ((c = getopt_long(argc, argv, "i:o:m:h", long_options, NULL)) != -1) {
+        switch (c) {
+        case 'i': opts.input = optarg; break;
+        case 'o': opts.output = optarg; break;
+        case 'R': opts.raw = 1; break;
+        case 'm': opts.shard_bytes = (size_t)strtoul(optarg, NULL, 10) << 20; break;
+        default:
+            usage(prog);
+            return c == 'h' ? 0 : 1;
+        }
+    }
+
+    if (!opts.input || !opts.output || optind != argc) {
+        usage(prog);
+        return 1;
+    }
+    return img_batch_pack(&opts, stdout) == RET_SUCCESS ? 0 : 1;
+}
+
+static int run_demo(void)
 {
     printf("Hello, ML World!\n");
 
@@ -56,23 +199,29 @@ int main()
         return -1; // or handle error appropriately
     }
 
-    // Perform operations on the image
+    // Record the operations, then sample the whole chain once
     printf("Performing img comptuations\n");
-    if (0 != img_resize(&image, (image->width)/2, (image->height)/2 ))
+    img_transform *t = img_transform_new(image->width, image->height);
+    int w = image->width / 2, h = image->height / 2;
+    if (!t || 0 != img_transform_resize(t, w, h) ||
+        0 != img_transform_crop(t, -1 + w / 2, -1 + h / 2, w / 2, h / 2) ||
+        0 != img_transform_rotate(t, 45) ||
+        0 != img_transform_flip_horizontal(t))
     {
-        printf("Image resizing failed.\n");
+        printf("Image transform failed.\n");
+        img_transform_free(t);
         img_free(image); // Ensure resources are freed on failure
         return 1;
     }
 
-    if (0 != img_crop(&image, -1+(image->width)/2, -1+(image->height)/2, (image->width)/2, (image->height)/2 ))
-    {
-        printf("Image crop failed.\n");
-        img_free(image); // Ensure resources are freed on failure
+    Image *result = img_transform_render(t, image, IMG_FILTER_AREA);
+    img_transform_free(t);
+    img_free(image);
+    if (result == NULL) {
+        printf("Image transform failed.\n");
         return 1;
     }
-    img_rotate(image, 45);
-    img_flip_horizontal(image);
+    image = result;
 
     img_write(IMG_COPY_PATH, image);
 
@@ -83,3 +232,10 @@ int main()
 
     return 0;
 }
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "pack") == 0) return run_pack(argv[0], argc - 1, argv + 1);
+    if (argc > 1) return run_batch(argc, argv);
+    return run_demo();
+}
@@ -1,74 +1,63 @@
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../../internal/math/math_utils.h"
 
 #define PI 3.14159265358979323846
 
-#define FACTORIAL_2 2
-#define FACTORIAL_3 6
-#define FACTORIAL_4 24
-#define FACTORIAL_5 120
-#define FACTORIAL_6 720
-#define FACTORIAL_7 5040
-
-/**
- * Computes the floating-point remainder of the division of two numbers.
- * 
- * This function calculates the remainder of x divided by y, similar to the modulus operation for integers.
- * The result has the same sign as the dividend x and is less than y in magnitude.
- *
- * @param x The dividend in the division operation.
- * @param y The divisor in the division operation.
- * @return The remainder of x divided by y. If y is 0.0, the function returns 0.0, indicating an error in division by zero.
- * 
- * Note: The behavior for division by zero is simplified in this implementation. Depending on application requirements,
- *       more sophisticated error handling may be necessary.
+/*
+ * Quarter-wave table: sin(k * PI / 128) for k = 0..64, i.e. one quadrant of a
+ * 256-entry sine table. The other quadrants and the cosine follow by symmetry,
+ * which keeps sin/cos of multiples of 90 degrees exact.
  */
-static double fmod(double x, double y)
-{
-    if (y == 0.0) {
-        return 0.0; // Division by zero
-    }
+#define SINCOS_TABLE_BITS 8
+#define SINCOS_TABLE_SIZE (1 << SINCOS_TABLE_BITS)
+#define SINCOS_QUARTER (SINCOS_TABLE_SIZE / 4)
 
-    double remainder = x - (y * (long long)(x / y));
-    if (remainder * y < 0) {
-        remainder += y;
-    }
-    return remainder;
-}
+static const double quarter_sin[SINCOS_QUARTER + 1] = {
+    0, 0.024541228522912288, 0.049067674327418015,
+    0.073564563599667426, 0.098017140329560604, 0.1224106751992162,
+    0.14673047445536175, 0.17096188876030122, 0.19509032201612825,
+    0.2191012401568698, 0.24298017990326387, 0.26671275747489837,
+    0.29028467725446233, 0.31368174039889152, 0.33688985339222005,
+    0.35989503653498811, 0.38268343236508978, 0.40524131400498986,
+    0.42755509343028208, 0.44961132965460654, 0.47139673682599764,
+    0.49289819222978404, 0.51410274419322166, 0.53499761988709715,
+    0.55557023301960218, 0.57580819141784534, 0.59569930449243336,
+    0.61523159058062682, 0.63439328416364549, 0.65317284295377676,
+    0.67155895484701833, 0.68954054473706683, 0.70710678118654746,
+    0.72424708295146689, 0.74095112535495911, 0.75720884650648446,
+    0.77301045336273699, 0.78834642762660623, 0.80320753148064483,
+    0.81758481315158371, 0.83146961230254524, 0.84485356524970701,
+    0.85772861000027212, 0.87008699110871135, 0.88192126434835494,
+    0.89322430119551532, 0.90398929312344334, 0.91420975570353069,
+    0.92387953251128674, 0.93299279883473885, 0.94154406518302081,
+    0.94952818059303667, 0.95694033573220894, 0.96377606579543984,
+    0.97003125319454397, 0.97570213003852857, 0.98078528040323043,
+    0.98527764238894122, 0.98917650996478101, 0.99247953459870997,
+    0.99518472667219682, 0.99729045667869021, 0.99879545620517241,
+    0.99969881869620425, 1,
+};
 
+/*
+ * Float minimax coefficients on [-PI/4, PI/4] (Cephes sinf/cosf).
+ */
+#define SINF_C1 -1.6666654611e-1f
+#define SINF_C2  8.3321608736e-3f
+#define SINF_C3 -1.9515295891e-4f
+#define COSF_C1  4.166664568298827e-2f
+#define COSF_C2 -1.388731625493765e-3f
+#define COSF_C3  2.443315711809948e-5f
 
-/**
- * Calculates the power of a number using exponentiation by squaring.
- * 
- * This function raises x to the power of n efficiently, using an iterative method. It is optimized for 
- * non-negative integer exponents. The algorithm reduces the number of multiplications compared to the 
- * naive approach, especially for large exponents.
- *
- * @param x The base number to be raised to a power.
- * @param n The exponent to which the base number is raised. Although this implementation primarily handles
- *          non-negative integers, a simple modification is demonstrated for handling negative exponents.
- * @return The result of raising x to the power of n. Returns 1 for n = 0 by definition. For negative 
- *         exponents, it returns the reciprocal of the positive exponent result, assuming n is non-negative.
- * 
- * Note: This function assumes non-negative exponents. If negative exponents are provided, it calculates the 
- *       reciprocal of the positive exponent result, which may not be ideal for all use cases. Further
- *       enhancements may be required for comprehensive error handling and to support floating-point exponents.
+/*
+ * PI/2 split into three floats (Cody-Waite), so r = x - q * PI/2 stays exact
+ * for the first two products.
  */
-static double power(double x, int n) {
-    if (n == 0) return 1;  // Any number to the power of 0 is 1
-    if (n < 0) {
-        // Handle negative exponents if necessary.
-        return 1 / power(x, -n);
-    }
-    
-    double result = 1;
-    while (n > 0) {
-        if (n % 2 == 1) {
-            result *= x;  // If n is odd, multiply result by x
-        }
-        x *= x;  // Square x
-        n /= 2;  // Divide n by 2
-    }
-    return result;
-}
+#define PIO2F_1 1.5703125f
+#define PIO2F_2 4.837512969970703125e-4f
+#define PIO2F_3 7.54978995489188216e-8f
+#define TWO_OVER_PI_F 0.636619772367581343f
 
 // Convert degrees to radians
 double to_radians(double degrees)
@@ -76,22 +65,115 @@ double to_radians(double degrees)
     return degrees * (PI / 180.0);
 }
 
-// Approximate sine function using Taylor series expansion
+// Table lookup plus short Taylor corrections; |r| <= PI / 256 so the truncated terms are below 1e-17
+void sincos_approx(double degrees, double *s, double *c)
+{
+    // fmod is exact, so large angles keep their fractional part; it is only needed past one turn
+    if (degrees > 360.0 || degrees < -360.0) degrees = fmod(degrees, 360.0);
+    double turns = degrees * (SINCOS_TABLE_SIZE / 360.0);
+    int n = (int)(turns + (turns >= 0.0 ? 0.5 : -0.5));
+    double r = (turns - n) * (2.0 * PI / SINCOS_TABLE_SIZE);
+    int idx = n & (SINCOS_TABLE_SIZE - 1);
+
+    int q = idx / SINCOS_QUARTER, i = idx % SINCOS_QUARTER;
+    double ts, tc;
+    switch (q) {
+    case 0:  ts =  quarter_sin[i];                  tc =  quarter_sin[SINCOS_QUARTER - i]; break;
+    case 1:  ts =  quarter_sin[SINCOS_QUARTER - i]; tc = -quarter_sin[i];                  break;
+    case 2:  ts = -quarter_sin[i];                  tc = -quarter_sin[SINCOS_QUARTER - i]; break;
+    default: ts = -quarter_sin[SINCOS_QUARTER - i]; tc =  quarter_sin[i];                  break;
+    }
+
+    double r2 = r * r;
+    double sr = r * (1.0 - r2 * (1.0 / 6.0) * (1.0 - r2 * (1.0 / 20.0)));
+    double cr = 1.0 - r2 * 0.5 * (1.0 - r2 * (1.0 / 12.0) * (1.0 - r2 * (1.0 / 30.0)));
+
+    // sin(a + r) and cos(a + r) from the table angle a
+    *s = ts * cr + tc * sr;
+    *c = tc * cr - ts * sr;
+}
+
+// Approximate sine of an angle in degrees
 double sin_approx(double x)
 {
-    // Convert x to radians and normalize to the range [-PI, PI] for better accuracy
-    x = to_radians(x);
-    x = fmod(x + PI, 2 * PI) - PI;
-    
-    return x - (power(x, 3))/FACTORIAL_3 + (power(x, 5))/FACTORIAL_5 - (power(x, 7))/FACTORIAL_7;
+    double s, c;
+    sincos_approx(x, &s, &c);
+    return s;
 }
 
-// Approximate cosine function using Taylor series expansion
+// Approximate cosine of an angle in degrees
 double cos_approx(double x)
 {
-    // Convert x to radians and normalize to the range [-PI, PI] for better accuracy
-    x = to_radians(x);
-    x = fmod(x + PI, 2 * PI) - PI;
-    
-    return 1 - (power(x, 2))/FACTORIAL_2 + (power(x, 4))/FACTORIAL_4 - (power(x, 6))/FACTORIAL_6;
+    double s, c;
+    sincos_approx(x, &s, &c);
+    return c;
+}
+
+/*
+ * Branch-free float kernel shared by the batch variants: range reduction to
+ * [-PI/4, PI/4] plus both polynomials. The quadrant swap and sign flips are
+ * bit selects rather than branches, so the loops below vectorize.
+ */
+static inline int reduce_quadrant(float x, float *sr, float *cr)
+{
+    float fq = x * TWO_OVER_PI_F;
+    int q = (int)(fq + (fq >= 0.0f ? 0.5f : -0.5f));
+    float qf = (float)q;
+    float r = ((x - qf * PIO2F_1) - qf * PIO2F_2) - qf * PIO2F_3;
+
+    float z = r * r;
+    *sr = r + r * z * (SINF_C1 + z * (SINF_C2 + z * SINF_C3));
+    *cr = 1.0f - 0.5f * z + z * z * (COSF_C1 + z * (COSF_C2 + z * COSF_C3));
+    return q;
+}
+
+// Quadrant select on the bit patterns: odd quadrants swap sin/cos, the sign bit flips per quadrant
+static inline float select_sin(int q, float sr, float cr)
+{
+    uint32_t a, b, m = 0u - (uint32_t)(q & 1);
+    memcpy(&a, &sr, sizeof(a));
+    memcpy(&b, &cr, sizeof(b));
+    uint32_t v = ((a & ~m) | (b & m)) ^ ((uint32_t)(q & 2) << 30);
+    float out;
+    memcpy(&out, &v, sizeof(out));
+    return out;
+}
+
+static inline float select_cos(int q, float sr, float cr)
+{
+    uint32_t a, b, m = 0u - (uint32_t)(q & 1);
+    memcpy(&a, &sr, sizeof(a));
+    memcpy(&b, &cr, sizeof(b));
+    uint32_t v = ((b & ~m) | (a & m)) ^ ((uint32_t)((q + 1) & 2) << 30);
+    float out;
+    memcpy(&out, &v, sizeof(out));
+    return out;
+}
+
+void sincosf_batch(const float *restrict x, float *restrict s, float *restrict c, int n)
+{
+    for (int i = 0; i < n; i++) {
+        float sr, cr;
+        int q = reduce_quadrant(x[i], &sr, &cr);
+        s[i] = select_sin(q, sr, cr);
+        c[i] = select_cos(q, sr, cr);
+    }
+}
+
+void sinf_batch(const float *restrict x, float *restrict out, int n)
+{
+    for (int i = 0; i < n; i++) {
+        float sr, cr;
+        int q = reduce_quadrant(x[i], &sr, &cr);
+        out[i] = select_sin(q, sr, cr);
+    }
+}
+
+void cosf_batch(const float *restrict x, float *restrict out, int n)
+{
+    for (int i = 0; i < n; i++) {
+        float sr, cr;
+        int q = reduce_quadrant(x[i], &sr, &cr);
+        out[i] = select_cos(q, sr, cr);
+    }
 }
@@ -0,0 +1,578 @@
+/**
+ * Quantized inference kernels.
+ *
+ * Implements TFLite's uint8 asymmetric quantization: real = scale * (q - zero_point).
+ * Products are accumulated in int32 and brought back to uint8 with the
+ * fixed-point multiplier and rounding of the reference kernels, so results
+ * match TensorFlow Lite bit for bit except for softmax, which is computed in
+ * float.
+ *
+ * 2D convolutions run as a GEMM over blocks of output pixels: the input taps
+ * of each pixel are gathered into an int16 row with the input zero point
+ * subtracted, and the uint8 weights are used as stored. The weight zero point
+ * is folded in afterwards through the row sums,
+ *
+ *   sum((x - x_zp) * (w - w_zp)) = sum((x - x_zp) * w) - w_zp * sum(x - x_zp)
+ *
+ * so the inner loop is a plain int16 dot product.
+ */
+#include <math.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MODEL_INFERENCE_X86 1
+#endif
+
+#include "../../include/model_utils.h"
+#include "../../internal/img_utils/internal_img_cpu.h"
+#include "../../internal/img_utils/internal_img_trace.h"
+#include "../../internal/model_utils/internal_model_utils.h"
+
+
+/* ------------------------------------------------------------------------- */
+/* Requantization                                                            */
+/* ------------------------------------------------------------------------- */
+
+// Exact port of gemmlowp's SaturatingRoundingDoublingHighMul and RoundingDivideByPOT
+int32_t model_requantize(int32_t x, int32_t multiplier, int shift)
+{
+    int left = shift > 0 ? shift : 0;
+    int right = shift > 0 ? 0 : -shift;
+
+    int32_t a = (int32_t)((uint32_t)x << left);
+    int32_t high;
+    if (a == INT32_MIN && multiplier == INT32_MIN) {
+        high = INT32_MAX;
+    } else {
+        int64_t ab = (int64_t)a * multiplier;
+        int64_t nudge = ab >= 0 ? (1 << 30) : (1 - (1 << 30));
+        high = (int32_t)((ab + nudge) / ((int64_t)1 << 31));
+    }
+
+    int64_t mask = ((int64_t)1 << right) - 1;
+    int64_t remainder = high & mask;
+    int64_t threshold = (mask >> 1) + (high < 0);
+    return (high >> right) + (remainder > threshold);
+}
+
+#ifdef MODEL_INFERENCE_X86
+// With nudge and truncation folded together the doubling high multiply is
+// floor((a * b + 2^30) / 2^31), which needs only the low half of a logical
+// 64-bit shift. Returns the number of elements processed.
+__attribute__((target("avx2")))
+static int requantize_avx2(const int32_t *acc, int n, int32_t multiplier, int shift,
+                           int32_t zero_point, int32_t lo, int32_t hi, uint8_t *out)
+{
+    int left = shift > 0 ? shift : 0;
+    int right = shift > 0 ? 0 : -shift;
+    if (right > 30) return 0;
+
+    const __m128i vleft = _mm_cvtsi32_si128(left);
+    const __m128i vright = _mm_cvtsi32_si128(right);
+    const __m256i vmul = _mm256_set1_epi32(multiplier);
+    const __m256i round = _mm256_set1_epi64x((int64_t)1 << 30);
+    const __m256i mask = _mm256_set1_epi32((1 << right) - 1);
+    const __m256i half = _mm256_set1_epi32(((1 << right) - 1) >> 1);
+    const __m256i vzp = _mm256_set1_epi32(zero_point);
+    const __m256i vlo = _mm256_set1_epi32(lo);
+    const __m256i vhi = _mm256_set1_epi32(hi);
+    const __m256i gather = _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0);
+    const __m256i zero = _mm256_setzero_si256();
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_sll_epi32(_mm256_loadu_si256((const __m256i *)(acc + i)), vleft);
+
+        __m256i even = _mm256_add_epi64(_mm256_mul_epi32(x, vmul), round);
+        __m256i odd = _mm256_add_epi64(_mm256_mul_epi32(_mm256_srli_epi64(x, 32), vmul), round);
+        x = _mm256_blend_epi32(_mm256_srli_epi64(even, 31), _mm256_slli_epi64(odd, 1), 0xAA);
+
+        __m256i remainder = _mm256_and_si256(x, mask);
+        __m256i threshold = _mm256_sub_epi32(half, _mm256_cmpgt_epi32(zero, x));
+        x = _mm256_sub_epi32(_mm256_sra_epi32(x, vright), _mm256_cmpgt_epi32(remainder, threshold));
+
+        x = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(x, vzp), vlo), vhi);
+        __m256i bytes = _mm256_packus_epi16(_mm256_packs_epi32(x, x), zero);
+        bytes = _mm256_permutevar8x32_epi32(bytes, gather);
+        _mm_storel_epi64((__m128i *)(out + i), _mm256_castsi256_si128(bytes));
+    }
+    return i;
+}
+
+// The AVX2 kernel on 16 lanes, with mask registers for the rounding fixups
+__attribute__((target("avx512f")))
+static int requantize_avx512(const int32_t *acc, int n, int32_t multiplier, int shift,
+                             int32_t zero_point, int32_t lo, int32_t hi, uint8_t *out)
+{
+    int left = shift > 0 ? shift : 0;
+    int right = shift > 0 ? 0 : -shift;
+    if (right > 30) return 0;
+
+    const __m128i vleft = _mm_cvtsi32_si128(left);
+    const __m128i vright = _mm_cvtsi32_si128(right);
+    const __m512i vmul = _mm512_set1_epi32(multiplier);
+    const __m512i round = _mm512_set1_epi64((int64_t)1 << 30);
+    const __m512i mask = _mm512_set1_epi32((1 << right) - 1);
+    const __m512i half = _mm512_set1_epi32(((1 << right) - 1) >> 1);
+    const __m512i one = _mm512_set1_epi32(1);
+    const __m512i vzp = _mm512_set1_epi32(zero_point);
+    const __m512i vlo = _mm512_set1_epi32(lo);
+    const __m512i vhi = _mm512_set1_epi32(hi);
+    const __m512i zero = _mm512_setzero_si512();
+
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i x = _mm512_sll_epi32(_mm512_loadu_si512(acc + i), vleft);
+
+        __m512i even = _mm512_add_epi64(_mm512_mul_epi32(x, vmul), round);
+        __m512i odd = _mm512_add_epi64(_mm512_mul_epi32(_mm512_srli_epi64(x, 32), vmul), round);
+        x = _mm512_mask_blend_epi32(0xAAAA, _mm512_srli_epi64(even, 31), _mm512_slli_epi64(odd, 1));
+
+        __m512i remainder = _mm512_and_si512(x, mask);
+        __m512i threshold = _mm512_mask_add_epi32(half, _mm512_cmplt_epi32_mask(x, zero), half, one);
+        __m512i shifted = _mm512_sra_epi32(x, vright);
+        x = _mm512_mask_add_epi32(shifted, _mm512_cmpgt_epi32_mask(remainder, threshold), shifted, one);
+
+        x = _mm512_min_epi32(_mm512_max_epi32(_mm512_add_epi32(x, vzp), vlo), vhi);
+        _mm_storeu_si128((__m128i *)(out + i), _mm512_cvtepi32_epi8(x));
+    }
+    return i + requantize_avx2(acc + i, n - i, multiplier, shift, zero_point, lo, hi, out + i);
+}
+#endif
+
+// Vector requantization kernel bound at startup, or NULL for the scalar loop alone
+static int (*requantize_kernel)(const int32_t *acc, int n, int32_t multiplier, int shift,
+                                int32_t zero_point, int32_t lo, int32_t hi, uint8_t *out);
+
+// Requantizes a row of accumulators to clamped uint8 values
+static void requantize_row(const int32_t *acc, int n, int32_t multiplier, int shift,
+                           int32_t zero_point, int32_t lo, int32_t hi, uint8_t *out)
+{
+    int i = 0;
+    if (requantize_kernel) i = requantize_kernel(acc, n, multiplier, shift, zero_point, lo, hi, out);
+    for (; i < n; i++) {
+        int32_t v = model_requantize(acc[i], multiplier, shift) + zero_point;
+        out[i] = (uint8_t)(v < lo ? lo : v > hi ? hi : v);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* GEMM micro-kernels                                                        */
+/* ------------------------------------------------------------------------- */
+
+// Each kernel computes the dot products of 4 consecutive input rows with 2
+// weight rows; out[r * 2 + o] receives row r times weight row o.
+typedef void (*gemm_fn)(const int16_t *a, int k, const uint8_t *w0, const uint8_t *w1, int32_t *out);
+
+static void gemm_4x2_scalar(const int16_t *a, int k, const uint8_t *w0, const uint8_t *w1, int32_t *out)
+{
+    for (int r = 0; r < 4; r++) {
+        const int16_t *row = a + (size_t)r * k;
+        int32_t s0 = 0, s1 = 0;
+        for (int i = 0; i < k; i++) {
+            s0 += row[i] * w0[i];
+            s1 += row[i] * w1[i];
+        }
+        out[r * 2] = s0;
+        out[r * 2 + 1] = s1;
+    }
+}
+
+#ifdef MODEL_INFERENCE_X86
+__attribute__((target("sse2")))
+static __m128i sum4_sse2(__m128i a, __m128i b, __m128i c, __m128i d)
+{
+    __m128i ab_lo = _mm_unpacklo_epi32(a, b), ab_hi = _mm_unpackhi_epi32(a, b);
+    __m128i cd_lo = _mm_unpacklo_epi32(c, d), cd_hi = _mm_unpackhi_epi32(c, d);
+    __m128i s = _mm_add_epi32(_mm_unpacklo_epi64(ab_lo, cd_lo), _mm_unpackhi_epi64(ab_lo, cd_lo));
+    return _mm_add_epi32(s, _mm_add_epi32(_mm_unpacklo_epi64(ab_hi, cd_hi), _mm_unpackhi_epi64(ab_hi, cd_hi)));
+}
+
+__attribute__((target("sse2")))
+static void gemm_4x2_sse2(const int16_t *a, int k, const uint8_t *w0, const uint8_t *w1, int32_t *out)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc[8];
+    for (int j = 0; j < 8; j++) acc[j] = zero;
+
+    for (int i = 0; i < k; i += 8) {
+        __m128i b0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(w0 + i)), zero);
+        __m128i b1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(w1 + i)), zero);
+        for (int r = 0; r < 4; r++) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(a + (size_t)r * k + i));
+            acc[r * 2] = _mm_add_epi32(acc[r * 2], _mm_madd_epi16(x, b0));
+            acc[r * 2 + 1] = _mm_add_epi32(acc[r * 2 + 1], _mm_madd_epi16(x, b1));
+        }
+    }
+    _mm_storeu_si128((__m128i *)out, sum4_sse2(acc[0], acc[1], acc[2], acc[3]));
+    _mm_storeu_si128((__m128i *)(out + 4), sum4_sse2(acc[4], acc[5], acc[6], acc[7]));
+}
+
+__attribute__((target("avx2")))
+static void gemm_4x2_avx2(const int16_t *a, int k, const uint8_t *w0, const uint8_t *w1, int32_t *out)
+{
+    __m256i acc0 = _mm256_setzero_si256(), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+    __m256i acc4 = acc0, acc5 = acc0, acc6 = acc0, acc7 = acc0;
+    const int16_t *a0 = a, *a1 = a + k, *a2 = a + 2 * (size_t)k, *a3 = a + 3 * (size_t)k;
+
+    for (int i = 0; i < k; i += 16) {
+        __m256i b0 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(w0 + i)));
+        __m256i b1 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(w1 + i)));
+        __m256i x0 = _mm256_loadu_si256((const __m256i *)(a0 + i));
+        __m256i x1 = _mm256_loadu_si256((const __m256i *)(a1 + i));
+        __m256i x2 = _mm256_loadu_si256((const __m256i *)(a2 + i));
+        __m256i x3 = _mm256_loadu_si256((const __m256i *)(a3 + i));
+        acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(x0, b0));
+        acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(x0, b1));
+        acc2 = _mm256_add_epi32(acc2, _mm256_madd_epi16(x1, b0));
+        acc3 = _mm256_add_epi32(acc3, _mm256_madd_epi16(x1, b1));
+        acc4 = _mm256_add_epi32(acc4, _mm256_madd_epi16(x2, b0));
+        acc5 = _mm256_add_epi32(acc5, _mm256_madd_epi16(x2, b1));
+        acc6 = _mm256_add_epi32(acc6, _mm256_madd_epi16(x3, b0));
+        acc7 = _mm256_add_epi32(acc7, _mm256_madd_epi16(x3, b1));
+    }
+
+    // Horizontal sums: each 128-bit lane ends up with four partial totals
+    __m256i q0 = _mm256_hadd_epi32(_mm256_hadd_epi32(acc0, acc1), _mm256_hadd_epi32(acc2, acc3));
+    __m256i q1 = _mm256_hadd_epi32(_mm256_hadd_epi32(acc4, acc5), _mm256_hadd_epi32(acc6, acc7));
+    __m256i sum = _mm256_add_epi32(_mm256_permute2x128_si256(q0, q1, 0x20), _mm256_permute2x128_si256(q0, q1, 0x31));
+    _mm256_storeu_si256((__m256i *)out, sum);
+}
+
+// 32 reduction steps per iteration; k is a multiple of 16, so at most one
+// 256-bit step remains
+__attribute__((target("avx512f,avx512bw")))
+static void gemm_4x2_avx512(const int16_t *a, int k, const uint8_t *w0, const uint8_t *w1, int32_t *out)
+{
+    __m512i acc[8];
+    for (int j = 0; j < 8; j++) acc[j] = _mm512_setzero_si512();
+    const int16_t *rows[4] = { a, a + k, a + 2 * (size_t)k, a + 3 * (size_t)k };
+
+    int i = 0;
+    for (; i + 32 <= k; i += 32) {
+        __m512i b0 = _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i *)(w0 + i)));
+        __m512i b1 = _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i *)(w1 + i)));
+        for (int r = 0; r < 4; r++) {
+            __m512i x = _mm512_loadu_si512(rows[r] + i);
+            acc[r * 2] = _mm512_add_epi32(acc[r * 2], _mm512_madd_epi16(x, b0));
+            acc[r * 2 + 1] = _mm512_add_epi32(acc[r * 2 + 1], _mm512_madd_epi16(x, b1));
+        }
+    }
+
+    // Fold to 256 bits, then finish like the AVX2 kernel
+    __m256i half[8];
+    for (int j = 0; j < 8; j++) {
+        half[j] = _mm256_add_epi32(_mm512_castsi512_si256(acc[j]), _mm512_extracti64x4_epi64(acc[j], 1));
+    }
+    if (i < k) {
+        __m256i b0 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(w0 + i)));
+        __m256i b1 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(w1 + i)));
+        for (int r = 0; r < 4; r++) {
+            __m256i x = _mm256_loadu_si256((const __m256i *)(rows[r] + i));
+            half[r * 2] = _mm256_add_epi32(half[r * 2], _mm256_madd_epi16(x, b0));
+            half[r * 2 + 1] = _mm256_add_epi32(half[r * 2 + 1], _mm256_madd_epi16(x, b1));
+        }
+    }
+
+    __m256i q0 = _mm256_hadd_epi32(_mm256_hadd_epi32(half[0], half[1]), _mm256_hadd_epi32(half[2], half[3]));
+    __m256i q1 = _mm256_hadd_epi32(_mm256_hadd_epi32(half[4], half[5]), _mm256_hadd_epi32(half[6], half[7]));
+    __m256i sum = _mm256_add_epi32(_mm256_permute2x128_si256(q0, q1, 0x20), _mm256_permute2x128_si256(q0, q1, 0x31));
+    _mm256_storeu_si256((__m256i *)out, sum);
+}
+#endif
+
+static gemm_fn gemm_kernel;
+
+/* ------------------------------------------------------------------------- */
+/* Operators                                                                 */
+/* ------------------------------------------------------------------------- */
+
+static inline uint8_t* tensor_data(Model *model, int index)
+{
+    return model->arena + model->tensors[index].offset;
+}
+
+// Gathers the input taps of output pixels [p0, p0 + rows) into zero-point
+// corrected rows of k_padded int16 values; padding taps and rows beyond
+// `rows` up to `rows_padded` are zero.
+static void gather_rows(const model_op *op, const model_tensor *in, const uint8_t *src, int out_w,
+                        int p0, int rows, int rows_padded, int16_t *a, int32_t *sums)
+{
+    int in_h = in->shape[1], in_w = in->shape[2], in_c = in->shape[3];
+    int16_t zp = (int16_t)in->zero_point;
+
+    for (int r = 0; r < rows_padded; r++) {
+        int16_t *row = a + (size_t)r * op->k_padded;
+        if (r >= rows) {
+            memset(row, 0, sizeof(int16_t) * op->k_padded);
+            sums[r] = 0;
+            continue;
+        }
+
+        int oy = (p0 + r) / out_w, ox = (p0 + r) % out_w;
+        int y0 = oy * op->stride_h - op->pad_top;
+        int x0 = ox * op->stride_w - op->pad_left;
+        int16_t *dst = row;
+        for (int ky = 0; ky < op->filter_h; ky++) {
+            int iy = y0 + ky * op->dilation_h;
+            for (int kx = 0; kx < op->filter_w; kx++, dst += in_c) {
+                int ix = x0 + kx * op->dilation_w;
+                if (iy < 0 || iy >= in_h || ix < 0 || ix >= in_w) {
+                    memset(dst, 0, sizeof(int16_t) * in_c);
+                    continue;
+                }
+                const uint8_t *s = src + ((size_t)iy * in_w + ix) * in_c;
+                for (int c = 0; c < in_c; c++) dst[c] = (int16_t)(s[c] - zp);
+            }
+        }
+        memset(row + op->k, 0, sizeof(int16_t) * (op->k_padded - op->k));
+
+        int32_t sum = 0;
+        for (int i = 0; i < op->k; i++) sum += row[i];
+        sums[r] = sum;
+    }
+}
+
+static void run_conv(Model *model, const model_op *op)
+{
+    const model_tensor *in = &model->tensors[op->inputs[0]];
+    const model_tensor *out = &model->tensors[op->output];
+    const uint8_t *src = tensor_data(model, op->inputs[0]);
+    uint8_t *dst = tensor_data(model, op->output);
+
+    int out_w = out->shape[2], out_c = out->shape[3];
+    int pixels = out->shape[1] * out_w;
+    int kp = op->k_padded;
+    int32_t w_zp = model->tensors[op->inputs[1]].zero_point;
+    gemm_fn gemm = gemm_kernel;
+
+    for (int p0 = 0; p0 < pixels; p0 += op->block) {
+        int rows = pixels - p0 < op->block ? pixels - p0 : op->block;
+        int rows_padded = (rows + 3) & ~3;
+        gather_rows(op, in, src, out_w, p0, rows, rows_padded, model->gemm_a, model->gemm_sums);
+
+        // Output channels outermost: a pair of weight rows stays in L1 while
+        // the block's input rows stream past it
+        for (int o = 0; o < out_c; o += 2) {
+            const uint8_t *w0 = op->weights + (size_t)o * kp;
+            const uint8_t *w1 = o + 1 < out_c ? w0 + kp : w0;
+            int pair = o + 1 < out_c ? 2 : 1;
+            for (int r = 0; r < rows_padded; r += 4) {
+                int32_t dots[8];
+                gemm(model->gemm_a + (size_t)r * kp, kp, w0, w1, dots);
+                for (int i = 0; i < 4 && r + i < rows; i++) {
+                    int32_t *acc = model->gemm_acc + (size_t)(r + i) * out_c + o;
+                    int32_t offset = -w_zp * model->gemm_sums[r + i];
+                    for (int j = 0; j < pair; j++) acc[j] = dots[i * 2 + j] + op->bias[o + j] + offset;
+                }
+            }
+        }
+
+        requantize_row(model->gemm_acc, rows * out_c, op->multiplier, op->shift,
+                       out->zero_point, op->act_min, op->act_max, dst + (size_t)p0 * out_c);
+    }
+}
+
+#ifdef MODEL_INFERENCE_X86
+// Adds one tap of a depth multiplier 1 convolution to the channel accumulators
+__attribute__((target("avx2")))
+static int depthwise_tap_avx2(int32_t *acc, const uint8_t *x, const uint8_t *w, int channels, int32_t x_zp, int32_t w_zp)
+{
+    const __m256i vx_zp = _mm256_set1_epi32(x_zp);
+    const __m256i vw_zp = _mm256_set1_epi32(w_zp);
+    int c = 0;
+    for (; c + 8 <= channels; c += 8) {
+        __m256i xv = _mm256_sub_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(x + c))), vx_zp);
+        __m256i wv = _mm256_sub_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(w + c))), vw_zp);
+        __m256i a = _mm256_loadu_si256((const __m256i *)(acc + c));
+        _mm256_storeu_si256((__m256i *)(acc + c), _mm256_add_epi32(a, _mm256_mullo_epi32(xv, wv)));
+    }
+    return c;
+}
+
+__attribute__((target("avx512f")))
+static int depthwise_tap_avx512(int32_t *acc, const uint8_t *x, const uint8_t *w, int channels, int32_t x_zp, int32_t w_zp)
+{
+    const __m512i vx_zp = _mm512_set1_epi32(x_zp);
+    const __m512i vw_zp = _mm512_set1_epi32(w_zp);
+    int c = 0;
+    for (; c + 16 <= channels; c += 16) {
+        __m512i xv = _mm512_sub_epi32(_mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *)(x + c))), vx_zp);
+        __m512i wv = _mm512_sub_epi32(_mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *)(w + c))), vw_zp);
+        __m512i a = _mm512_loadu_si512(acc + c);
+        _mm512_storeu_si512(acc + c, _mm512_add_epi32(a, _mm512_mullo_epi32(xv, wv)));
+    }
+    return c + depthwise_tap_avx2(acc + c, x + c, w + c, channels - c, x_zp, w_zp);
+}
+#endif
+
+// Depth multiplier 1 tap kernel bound at startup, or NULL for the scalar loop alone
+static int (*depthwise_tap_kernel)(int32_t *acc, const uint8_t *x, const uint8_t *w, int channels,
+                                   int32_t x_zp, int32_t w_zp);
+
+static void run_depthwise(Model *model, const model_op *op)
+{
+    const model_tensor *in = &model->tensors[op->inputs[0]];
+    const model_tensor *out = &model->tensors[op->output];
+    const model_tensor *wt = &model->tensors[op->inputs[1]];
+    const uint8_t *src = tensor_data(model, op->inputs[0]);
+    uint8_t *dst = tensor_data(model, op->output);
+
+    int in_h = in->shape[1], in_w = in->shape[2], in_c = in->shape[3];
+    int out_h = out->shape[1], out_w = out->shape[2], out_c = out->shape[3];
+    int dm = op->depth_multiplier;
+    int32_t x_zp = in->zero_point, w_zp = wt->zero_point;
+    int32_t *acc = model->gemm_acc;
+    int (*tap)(int32_t *, const uint8_t *, const uint8_t *, int, int32_t, int32_t) = dm == 1 ? depthwise_tap_kernel : NULL;
+
+    for (int oy = 0; oy < out_h; oy++) {
+        for (int ox = 0; ox < out_w; ox++) {
+            memcpy(acc, op->bias, sizeof(int32_t) * out_c);
+
+            int y0 = oy * op->stride_h - op->pad_top;
+            int x0 = ox * op->stride_w - op->pad_left;
+            for (int ky = 0; ky < op->filter_h; ky++) {
+                int iy = y0 + ky * op->dilation_h;
+                if (iy < 0 || iy >= in_h) continue;
+                for (int kx = 0; kx < op->filter_w; kx++) {
+                    int ix = x0 + kx * op->dilation_w;
+                    if (ix < 0 || ix >= in_w) continue;
+
+                    const uint8_t *x = src + ((size_t)iy * in_w + ix) * in_c;
+                    const uint8_t *w = wt->data + ((size_t)ky * op->filter_w + kx) * out_c;
+                    int c = tap ? tap(acc, x, w, out_c, x_zp, w_zp) : 0;
+                    for (; c < out_c; c++) acc[c] += (x[c / dm] - x_zp) * (w[c] - w_zp);
+                }
+            }
+
+            requantize_row(acc, out_c, op->multiplier, op->shift, out->zero_point,
+                           op->act_min, op->act_max, dst + ((size_t)oy * out_w + ox) * out_c);
+        }
+    }
+}
+
+static void run_average_pool(Model *model, const model_op *op)
+{
+    const model_tensor *in = &model->tensors[op->inputs[0]];
+    const model_tensor *out = &model->tensors[op->output];
+    const uint8_t *src = tensor_data(model, op->inputs[0]);
+    uint8_t *dst = tensor_data(model, op->output);
+
+    int in_h = in->shape[1], in_w = in->shape[2], channels = in->shape[3];
+    int out_h = out->shape[1], out_w = out->shape[2];
+    int32_t *sum = model->gemm_acc;
+
+    for (int oy = 0; oy < out_h; oy++) {
+        for (int ox = 0; ox < out_w; ox++) {
+            int y0 = oy * op->stride_h - op->pad_top, x0 = ox * op->stride_w - op->pad_left;
+            int ys = y0 < 0 ? 0 : y0, ye = y0 + op->filter_h > in_h ? in_h : y0 + op->filter_h;
+            int xs = x0 < 0 ? 0 : x0, xe = x0 + op->filter_w > in_w ? in_w : x0 + op->filter_w;
+            int count = (ye - ys) * (xe - xs);
+
+            memset(sum, 0, sizeof(int32_t) * channels);
+            for (int y = ys; y < ye; y++) {
+                for (int x = xs; x < xe; x++) {
+                    const uint8_t *s = src + ((size_t)y * in_w + x) * channels;
+                    for (int c = 0; c < channels; c++) sum[c] += s[c];
+                }
+            }
+
+            // Only taps inside the image count, rounding half away from zero
+            uint8_t *d = dst + ((size_t)oy * out_w + ox) * channels;
+            for (int c = 0; c < channels; c++) {
+                int32_t v = count ? (sum[c] + count / 2) / count : 0;
+                d[c] = (uint8_t)(v < op->act_min ? op->act_min : v > op->act_max ? op->act_max : v);
+            }
+        }
+    }
+}
+
+// Softmax over the innermost dimension, computed in float from a table of
+// the 256 possible exponentials
+static void run_softmax(Model *model, const model_op *op)
+{
+    const model_tensor *in = &model->tensors[op->inputs[0]];
+    const model_tensor *out = &model->tensors[op->output];
+    const uint8_t *src = tensor_data(model, op->inputs[0]);
+    uint8_t *dst = tensor_data(model, op->output);
+
+    int depth = in->shape[in->dims - 1];
+    int outer = (int)(in->bytes / depth);
+    float table[256];
+    for (int d = 0; d < 256; d++) table[d] = expf(-op->beta * in->scale * d);
+
+    for (int n = 0; n < outer; n++) {
+        const uint8_t *s = src + (size_t)n * depth;
+        uint8_t *o = dst + (size_t)n * depth;
+
+        int max = 0;
+        for (int i = 0; i < depth; i++) max = s[i] > max ? s[i] : max;
+        float total = 0.0f;
+        for (int i = 0; i < depth; i++) total += table[max - s[i]];
+
+        float inv = 1.0f / (total * out->scale);
+        for (int i = 0; i < depth; i++) {
+            long q = lrintf(table[max - s[i]] * inv) + out->zero_point;
+            o[i] = (uint8_t)(q < 0 ? 0 : q > 255 ? 255 : q);
+        }
+    }
+}
+
+__attribute__((constructor))
+static void bind_kernels(void)
+{
+    img_cpu_level cpu = img_cpu_get_level();
+    gemm_kernel = gemm_4x2_scalar;
+#ifdef MODEL_INFERENCE_X86
+    if (cpu >= IMG_CPU_SSE2) gemm_kernel = gemm_4x2_sse2;
+    if (cpu >= IMG_CPU_AVX2) {
+        gemm_kernel = gemm_4x2_avx2;
+        requantize_kernel = requantize_avx2;
+        depthwise_tap_kernel = depthwise_tap_avx2;
+    }
+    if (cpu >= IMG_CPU_AVX512) {
+        gemm_kernel = gemm_4x2_avx512;
+        requantize_kernel = requantize_avx512;
+        depthwise_tap_kernel = depthwise_tap_avx512;
+    }
+#endif
+    (void)cpu;
+}
+
+void model_run_op(Model *model, const model_op *op)
+{
+    switch (op->code) {
+    case MODEL_OP_CONV_2D: {
+        IMG_TRACE_SCOPE("model_conv_2d");
+        run_conv(model, op);
+        break;
+    }
+    case MODEL_OP_DEPTHWISE_CONV_2D: {
+        IMG_TRACE_SCOPE("model_depthwise_conv_2d");
+        run_depthwise(model, op);
+        break;
+    }
+    case MODEL_OP_AVERAGE_POOL_2D: {
+        IMG_TRACE_SCOPE("model_average_pool_2d");
+        run_average_pool(model, op);
+        break;
+    }
+    case MODEL_OP_SOFTMAX: {
+        IMG_TRACE_SCOPE("model_softmax");
+        run_softmax(model, op);
+        break;
+    }
+    case MODEL_OP_RESHAPE:
+        memmove(tensor_data(model, op->output), tensor_data(model, op->inputs[0]), model->tensors[op->output].bytes);
+        break;
+    }
+}
+
+int model_invoke(Model *model)
+{
+    if (!model) return RET_FAIL;
+    IMG_TRACE_SCOPE("model_invoke");
+    for (int i = 0; i < model->op_count; i++) model_run_op(model, &model->ops[i]);
+    return RET_SUCCESS;
+}
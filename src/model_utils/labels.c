@@ -0,0 +1,127 @@
+/**
+ * Interned label tables.
+ *
+ * A table is a single allocation: the header, one string offset per label,
+ * an open-addressing hash index of the distinct names, and the names
+ * themselves, each stored once and NUL terminated.
+ */
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../../include/model_utils.h"
+
+
+struct model_labels {
+    int count;            // Number of labels
+    uint32_t buckets;     // Size of the hash index, a power of two
+    uint32_t *offsets;    // Offset of each label's name in chars
+    uint32_t *index;      // Hash index: first label index + 1 of each distinct name, 0 when empty
+    char *chars;          // The distinct names
+};
+
+// FNV-1a
+static uint32_t hash_name(const char *s, size_t length)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < length; i++) h = (h ^ (unsigned char)s[i]) * 16777619u;
+    return h;
+}
+
+// Returns the hash bucket holding `name`, or the empty bucket where it belongs
+static uint32_t find_bucket(const model_labels *labels, const char *name, size_t length)
+{
+    uint32_t mask = labels->buckets - 1;
+    uint32_t b = hash_name(name, length) & mask;
+    while (labels->index[b]) {
+        const char *s = labels->chars + labels->offsets[labels->index[b] - 1];
+        if (strncmp(s, name, length) == 0 && s[length] == '\0') break;
+        b = (b + 1) & mask;
+    }
+    return b;
+}
+
+model_labels* model_labels_load(const char *filename)
+{
+    int fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    struct stat st;
+    const char *text = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && st.st_size < INT32_MAX) {
+        text = (const char *)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (text == MAP_FAILED) return NULL;
+    size_t size = (size_t)st.st_size;
+
+    // A final line without a newline still counts
+    int count = 0;
+    for (size_t i = 0; i < size; i++) count += text[i] == '\n';
+    if (text[size - 1] != '\n') count++;
+
+    uint32_t buckets = 16;
+    while (buckets < (uint32_t)count * 2) buckets *= 2;
+
+    size_t header = (sizeof(model_labels) + sizeof(uint32_t) - 1) / sizeof(uint32_t) * sizeof(uint32_t);
+    size_t tables = ((size_t)count + buckets) * sizeof(uint32_t);
+    model_labels *labels = (model_labels *)calloc(1, header + tables + size + 1);
+    if (!labels) {
+        munmap((void *)text, size);
+        return NULL;
+    }
+    labels->count = count;
+    labels->buckets = buckets;
+    labels->offsets = (uint32_t *)((char *)labels + header);
+    labels->index = labels->offsets + count;
+    labels->chars = (char *)(labels->index + buckets);
+
+    uint32_t used = 0;
+    const char *line = text, *end = text + size;
+    for (int i = 0; i < count; i++) {
+        const char *nl = memchr(line, '\n', (size_t)(end - line));
+        if (!nl) nl = end;
+        size_t length = (size_t)(nl - line);
+        if (length && line[length - 1] == '\r') length--;
+
+        uint32_t b = find_bucket(labels, line, length);
+        if (labels->index[b]) {
+            labels->offsets[i] = labels->offsets[labels->index[b] - 1];
+        } else {
+            memcpy(labels->chars + used, line, length);
+            labels->chars[used + length] = '\0';
+            labels->offsets[i] = used;
+            labels->index[b] = (uint32_t)i + 1;
+            used += (uint32_t)length + 1;
+        }
+        line = nl + 1;
+    }
+
+    munmap((void *)text, size);
+    return labels;
+}
+
+void model_labels_free(model_labels *labels)
+{
+    free(labels);
+}
+
+int model_labels_count(const model_labels *labels)
+{
+    return labels->count;
+}
+
+const char* model_labels_name(const model_labels *labels, int index)
+{
+    if (index < 0 || index >= labels->count) return NULL;
+    return labels->chars + labels->offsets[index];
+}
+
+int model_labels_find(const model_labels *labels, const char *name)
+{
+    uint32_t b = find_bucket(labels, name, strlen(name));
+    return (int)labels->index[b] - 1;
+}
@@ -0,0 +1,684 @@
+/**
+ * TFLite model loading.
+ *
+ * The flatbuffer is memory-mapped and read with a small bounds-checked
+ * reader instead of the generated schema code: only the handful of tables an
+ * image classifier needs are resolved, and weights are never copied.
+ * Activations are packed into a single arena with a greedy-by-size planner,
+ * so tensors whose lifetimes do not overlap share memory.
+ */
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../../include/model_utils.h"
+#include "../../internal/img_utils/internal_img_pool.h"
+#include "../../internal/img_utils/internal_img_trace.h"
+#include "../../internal/model_utils/internal_model_utils.h"
+
+
+/* ------------------------------------------------------------------------- */
+/* Flatbuffer reader                                                         */
+/* ------------------------------------------------------------------------- */
+
+// TFLite schema field indices
+#define MODEL_OPERATOR_CODES 1
+#define MODEL_SUBGRAPHS      2
+#define MODEL_BUFFERS        4
+
+#define OPCODE_DEPRECATED_BUILTIN 0
+#define OPCODE_CUSTOM             1
+#define OPCODE_BUILTIN            3
+
+#define SUBGRAPH_TENSORS   0
+#define SUBGRAPH_INPUTS    1
+#define SUBGRAPH_OUTPUTS   2
+#define SUBGRAPH_OPERATORS 3
+
+#define TENSOR_SHAPE        0
+#define TENSOR_TYPE         1
+#define TENSOR_BUFFER       2
+#define TENSOR_QUANTIZATION 4
+
+#define QUANT_SCALE      2
+#define QUANT_ZERO_POINT 3
+
+#define BUFFER_DATA 0
+
+#define OPERATOR_OPCODE  0
+#define OPERATOR_INPUTS  1
+#define OPERATOR_OUTPUTS 2
+#define OPERATOR_OPTIONS 4
+
+// Flatbuffers are little-endian, like every host this library targets.
+// Reads past the end of the file set the error flag and yield zero, so
+// callers check the flag once per table instead of after every read.
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    int bad;
+} fb_reader;
+
+static int fb_check(fb_reader *fb, size_t pos, size_t bytes)
+{
+    if (pos > fb->size || bytes > fb->size - pos) {
+        fb->bad = 1;
+        return 0;
+    }
+    return 1;
+}
+
+static uint32_t fb_u32(fb_reader *fb, size_t pos)
+{
+    uint32_t v = 0;
+    if (fb_check(fb, pos, 4)) memcpy(&v, fb->data + pos, 4);
+    return v;
+}
+
+static uint16_t fb_u16(fb_reader *fb, size_t pos)
+{
+    uint16_t v = 0;
+    if (fb_check(fb, pos, 2)) memcpy(&v, fb->data + pos, 2);
+    return v;
+}
+
+// Position of a field of the table at `table`, or 0 when the field is absent
+static size_t fb_field(fb_reader *fb, size_t table, int field)
+{
+    if (!table) return 0;
+    int32_t soffset = (int32_t)fb_u32(fb, table);
+    int64_t vtable = (int64_t)table - soffset;
+    if (vtable < 0 || (size_t)vtable >= fb->size) {
+        fb->bad = 1;
+        return 0;
+    }
+    uint16_t vt_size = fb_u16(fb, (size_t)vtable);
+    size_t entry = 4 + 2 * (size_t)field;
+    if (entry + 2 > vt_size) return 0;
+    uint16_t offset = fb_u16(fb, (size_t)vtable + entry);
+    return offset ? table + offset : 0;
+}
+
+static int64_t fb_int(fb_reader *fb, size_t table, int field, int bytes, int64_t fallback)
+{
+    size_t pos = fb_field(fb, table, field);
+    if (!pos || !fb_check(fb, pos, bytes)) return fallback;
+    switch (bytes) {
+    case 1: return fb->data[pos];
+    case 2: return (int16_t)fb_u16(fb, pos);
+    default: return (int32_t)fb_u32(fb, pos);
+    }
+}
+
+static float fb_float(fb_reader *fb, size_t table, int field, float fallback)
+{
+    size_t pos = fb_field(fb, table, field);
+    if (!pos || !fb_check(fb, pos, 4)) return fallback;
+    float v;
+    memcpy(&v, fb->data + pos, 4);
+    return v;
+}
+
+// Follows an offset field to the referenced table, vector or string
+static size_t fb_deref(fb_reader *fb, size_t pos)
+{
+    if (!pos) return 0;
+    size_t target = pos + fb_u32(fb, pos);
+    return fb_check(fb, target, 4) ? target : 0;
+}
+
+static size_t fb_table(fb_reader *fb, size_t table, int field)
+{
+    return fb_deref(fb, fb_field(fb, table, field));
+}
+
+// Locates a vector field; returns the position of its first element
+static size_t fb_vector(fb_reader *fb, size_t table, int field, size_t elem_size, uint32_t *length)
+{
+    *length = 0;
+    size_t vec = fb_table(fb, table, field);
+    if (!vec) return 0;
+    uint32_t n = fb_u32(fb, vec);
+    if (!fb_check(fb, vec + 4, (size_t)n * elem_size)) return 0;
+    *length = n;
+    return vec + 4;
+}
+
+// Element i of a vector of tables
+static size_t fb_vector_table(fb_reader *fb, size_t elems, uint32_t i)
+{
+    return fb_deref(fb, elems + 4 * (size_t)i);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Graph                                                                     */
+/* ------------------------------------------------------------------------- */
+
+static size_t type_size(int type)
+{
+    switch (type) {
+    case MODEL_TYPE_UINT8: return 1;
+    case MODEL_TYPE_FLOAT32:
+    case MODEL_TYPE_INT32: return 4;
+    case MODEL_TYPE_INT64: return 8;
+    default: return 0;
+    }
+}
+
+static int parse_tensor(fb_reader *fb, size_t table, size_t buffers, uint32_t buffer_count, model_tensor *t)
+{
+    uint32_t dims;
+    size_t shape = fb_vector(fb, table, TENSOR_SHAPE, 4, &dims);
+    if (dims > MODEL_MAX_DIMS) return RET_FAIL;
+
+    t->type = (int)fb_int(fb, table, TENSOR_TYPE, 1, 0);
+    size_t elem = type_size(t->type);
+    if (!elem) return RET_FAIL;
+
+    t->dims = (int)dims;
+    size_t count = 1;
+    for (uint32_t d = 0; d < dims; d++) {
+        int32_t extent = (int32_t)fb_u32(fb, shape + 4 * d);
+        if (extent <= 0 || count > ((size_t)1 << 31) / (size_t)extent) return RET_FAIL;
+        t->shape[d] = extent;
+        count *= (size_t)extent;
+    }
+    t->bytes = count * elem;
+
+    // Only per-tensor quantization: the uint8 asymmetric scheme never uses per-channel scales
+    t->scale = 0.0f;
+    t->zero_point = 0;
+    size_t quant = fb_table(fb, table, TENSOR_QUANTIZATION);
+    if (quant) {
+        uint32_t scales, zero_points;
+        size_t scale = fb_vector(fb, quant, QUANT_SCALE, 4, &scales);
+        size_t zero_point = fb_vector(fb, quant, QUANT_ZERO_POINT, 8, &zero_points);
+        if (scales > 1 || zero_points > 1) return RET_FAIL;
+        if (scales) memcpy(&t->scale, fb->data + scale, 4);
+        if (zero_points) {
+            int64_t zp;
+            memcpy(&zp, fb->data + zero_point, 8);
+            t->zero_point = (int32_t)zp;
+        }
+    }
+
+    // A tensor backed by a non-empty buffer is a constant
+    t->data = NULL;
+    uint32_t buffer = (uint32_t)fb_int(fb, table, TENSOR_BUFFER, 4, 0);
+    if (buffer && buffer < buffer_count) {
+        uint32_t length;
+        size_t data = fb_vector(fb, fb_vector_table(fb, buffers, buffer), BUFFER_DATA, 1, &length);
+        if (length) {
+            if (length != t->bytes) return RET_FAIL;
+            t->data = fb->data + data;
+        }
+    }
+    t->first_op = -1;
+    t->last_op = -1;
+    return fb->bad ? RET_FAIL : RET_SUCCESS;
+}
+
+// Reads the builtin options of an operator; field indices follow the TFLite schema
+static int parse_options(fb_reader *fb, size_t options, model_op *op)
+{
+    op->stride_w = op->stride_h = 1;
+    op->dilation_w = op->dilation_h = 1;
+    op->depth_multiplier = 1;
+    op->activation = MODEL_ACT_NONE;
+    op->beta = 1.0f;
+
+    switch (op->code) {
+    case MODEL_OP_CONV_2D:
+        op->padding_same = fb_int(fb, options, 0, 1, 0) == 0;
+        op->stride_w = (int)fb_int(fb, options, 1, 4, 1);
+        op->stride_h = (int)fb_int(fb, options, 2, 4, 1);
+        op->activation = (int)fb_int(fb, options, 3, 1, MODEL_ACT_NONE);
+        op->dilation_w = (int)fb_int(fb, options, 4, 4, 1);
+        op->dilation_h = (int)fb_int(fb, options, 5, 4, 1);
+        break;
+    case MODEL_OP_DEPTHWISE_CONV_2D:
+        op->padding_same = fb_int(fb, options, 0, 1, 0) == 0;
+        op->stride_w = (int)fb_int(fb, options, 1, 4, 1);
+        op->stride_h = (int)fb_int(fb, options, 2, 4, 1);
+        op->depth_multiplier = (int)fb_int(fb, options, 3, 4, 1);
+        op->activation = (int)fb_int(fb, options, 4, 1, MODEL_ACT_NONE);
+        op->dilation_w = (int)fb_int(fb, options, 5, 4, 1);
+        op->dilation_h = (int)fb_int(fb, options, 6, 4, 1);
+        break;
+    case MODEL_OP_AVERAGE_POOL_2D:
+        op->padding_same = fb_int(fb, options, 0, 1, 0) == 0;
+        op->stride_w = (int)fb_int(fb, options, 1, 4, 1);
+        op->stride_h = (int)fb_int(fb, options, 2, 4, 1);
+        op->filter_w = (int)fb_int(fb, options, 3, 4, 1);
+        op->filter_h = (int)fb_int(fb, options, 4, 4, 1);
+        op->activation = (int)fb_int(fb, options, 5, 1, MODEL_ACT_NONE);
+        break;
+    case MODEL_OP_SOFTMAX:
+        op->beta = fb_float(fb, options, 0, 1.0f);
+        break;
+    case MODEL_OP_RESHAPE:
+        break;
+    default:
+        return RET_FAIL;
+    }
+
+    if (op->stride_w <= 0 || op->stride_h <= 0 || op->dilation_w <= 0 || op->dilation_h <= 0 ||
+        op->depth_multiplier <= 0 || op->activation < MODEL_ACT_NONE || op->activation > MODEL_ACT_RELU6) {
+        return RET_FAIL;
+    }
+    return RET_SUCCESS;
+}
+
+int model_parse(Model *model)
+{
+    fb_reader fb = { model->file, model->file_size, 0 };
+    if (fb.size < 8 || memcmp(fb.data + 4, "TFL3", 4) != 0) return RET_FAIL;
+
+    size_t root = fb_u32(&fb, 0);
+    if (!fb_check(&fb, root, 4)) return RET_FAIL;
+    uint32_t opcode_count, subgraph_count, buffer_count;
+    size_t opcodes = fb_vector(&fb, root, MODEL_OPERATOR_CODES, 4, &opcode_count);
+    size_t subgraphs = fb_vector(&fb, root, MODEL_SUBGRAPHS, 4, &subgraph_count);
+    size_t buffers = fb_vector(&fb, root, MODEL_BUFFERS, 4, &buffer_count);
+    if (fb.bad || subgraph_count != 1) return RET_FAIL;
+
+    // The builtin code moved to a wider field; older files only fill the deprecated one
+    int *codes = (int *)calloc(opcode_count ? opcode_count : 1, sizeof(int));
+    if (!codes) return RET_FAIL;
+    for (uint32_t i = 0; i < opcode_count; i++) {
+        size_t oc = fb_vector_table(&fb, opcodes, i);
+        int deprecated = (int)fb_int(&fb, oc, OPCODE_DEPRECATED_BUILTIN, 1, 0);
+        int builtin = (int)fb_int(&fb, oc, OPCODE_BUILTIN, 4, 0);
+        codes[i] = fb_field(&fb, oc, OPCODE_CUSTOM) ? -1 : (builtin > deprecated ? builtin : deprecated);
+    }
+
+    size_t graph = fb_vector_table(&fb, subgraphs, 0);
+    uint32_t tensor_count, op_count, input_count, output_count;
+    size_t tensors = fb_vector(&fb, graph, SUBGRAPH_TENSORS, 4, &tensor_count);
+    size_t operators = fb_vector(&fb, graph, SUBGRAPH_OPERATORS, 4, &op_count);
+    size_t inputs = fb_vector(&fb, graph, SUBGRAPH_INPUTS, 4, &input_count);
+    size_t outputs = fb_vector(&fb, graph, SUBGRAPH_OUTPUTS, 4, &output_count);
+    if (fb.bad || !tensor_count || !op_count || input_count != 1 || output_count != 1) {
+        free(codes);
+        return RET_FAIL;
+    }
+
+    model->tensors = (model_tensor *)calloc(tensor_count, sizeof(model_tensor));
+    model->ops = (model_op *)calloc(op_count, sizeof(model_op));
+    if (!model->tensors || !model->ops) {
+        free(codes);
+        return RET_FAIL;
+    }
+    model->tensor_count = (int)tensor_count;
+    model->op_count = (int)op_count;
+
+    int ret = RET_SUCCESS;
+    for (uint32_t i = 0; ret == RET_SUCCESS && i < tensor_count; i++) {
+        ret = parse_tensor(&fb, fb_vector_table(&fb, tensors, i), buffers, buffer_count, &model->tensors[i]);
+    }
+
+    for (uint32_t i = 0; ret == RET_SUCCESS && i < op_count; i++) {
+        size_t table = fb_vector_table(&fb, operators, i);
+        model_op *op = &model->ops[i];
+
+        uint32_t opcode = (uint32_t)fb_int(&fb, table, OPERATOR_OPCODE, 4, 0);
+        op->code = opcode < opcode_count ? codes[opcode] : -1;
+
+        uint32_t in_count, out_count;
+        size_t in = fb_vector(&fb, table, OPERATOR_INPUTS, 4, &in_count);
+        size_t out = fb_vector(&fb, table, OPERATOR_OUTPUTS, 4, &out_count);
+        if (!in_count || in_count > MODEL_MAX_INPUTS || out_count != 1) {
+            ret = RET_FAIL;
+            break;
+        }
+        op->input_count = (int)in_count;
+        for (int j = 0; j < MODEL_MAX_INPUTS; j++) {
+            op->inputs[j] = j < (int)in_count ? (int32_t)fb_u32(&fb, in + 4 * (size_t)j) : -1;
+            if (op->inputs[j] >= (int)tensor_count || (j < (int)in_count && op->inputs[j] < -1)) ret = RET_FAIL;
+        }
+        // Only trailing inputs such as a bias are optional (-1); every operator reads its first
+        if (op->inputs[0] < 0) ret = RET_FAIL;
+        op->output = (int32_t)fb_u32(&fb, out);
+        if (op->output < 0 || op->output >= (int)tensor_count || model->tensors[op->output].data) ret = RET_FAIL;
+
+        if (ret == RET_SUCCESS) ret = parse_options(&fb, fb_table(&fb, table, OPERATOR_OPTIONS), op);
+    }
+
+    if (ret == RET_SUCCESS) {
+        model->input = (int32_t)fb_u32(&fb, inputs);
+        model->output = (int32_t)fb_u32(&fb, outputs);
+        if (model->input < 0 || model->input >= (int)tensor_count ||
+            model->output < 0 || model->output >= (int)tensor_count) {
+            ret = RET_FAIL;
+        }
+    }
+
+    free(codes);
+    return fb.bad ? RET_FAIL : ret;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Preparation                                                               */
+/* ------------------------------------------------------------------------- */
+
+void model_quantize_multiplier(double real, int32_t *multiplier, int *shift)
+{
+    if (real == 0.0) {
+        *multiplier = 0;
+        *shift = 0;
+        return;
+    }
+    int exponent;
+    double q = frexp(real, &exponent);
+    int64_t q_fixed = (int64_t)llround(q * (double)(1LL << 31));
+    if (q_fixed == (1LL << 31)) {
+        q_fixed /= 2;
+        exponent++;
+    }
+    if (exponent < -31) {
+        exponent = 0;
+        q_fixed = 0;
+    }
+    *multiplier = (int32_t)q_fixed;
+    *shift = exponent;
+}
+
+// Clamp range of a uint8 output with a fused activation
+static void activation_range(int activation, const model_tensor *out, int32_t *lo, int32_t *hi)
+{
+    int32_t qmin = 0, qmax = 255;
+    float scale = out->scale;
+    int32_t zp = out->zero_point;
+
+    if (activation == MODEL_ACT_RELU) {
+        qmin = zp > qmin ? zp : qmin;
+    } else if (activation == MODEL_ACT_RELU6) {
+        int32_t top = zp + (int32_t)lroundf(6.0f / scale);
+        qmin = zp > qmin ? zp : qmin;
+        qmax = top < qmax ? top : qmax;
+    } else if (activation == MODEL_ACT_RELU1) {
+        int32_t bottom = zp + (int32_t)lroundf(-1.0f / scale);
+        int32_t top = zp + (int32_t)lroundf(1.0f / scale);
+        qmin = bottom > qmin ? bottom : qmin;
+        qmax = top < qmax ? top : qmax;
+    }
+    *lo = qmin;
+    *hi = qmax;
+}
+
+// SAME padding as TFLite computes it: the extra row or column goes to the bottom/right
+static int resolve_padding(int same, int in, int filter, int stride, int dilation, int *pad)
+{
+    int extent = (filter - 1) * dilation + 1;
+    int out = same ? (in + stride - 1) / stride : (in - extent + stride) / stride;
+    int total = (out - 1) * stride + extent - in;
+    *pad = same && total > 0 ? total / 2 : 0;
+    return out;
+}
+
+static int is_nhwc(const model_tensor *t)
+{
+    return t->dims == 4 && t->shape[0] == 1;
+}
+
+// Checks shapes and types, and derives the parameters of one operator
+static int prepare_op(Model *model, model_op *op, size_t *gemm_a, size_t *gemm_acc, int *gemm_rows)
+{
+    const model_tensor *in = &model->tensors[op->inputs[0]];
+    const model_tensor *out = &model->tensors[op->output];
+    if (in->type != MODEL_TYPE_UINT8 || out->type != MODEL_TYPE_UINT8) return RET_FAIL;
+
+    if (op->code == MODEL_OP_RESHAPE) {
+        return in->bytes == out->bytes && in->scale == out->scale &&
+               in->zero_point == out->zero_point ? RET_SUCCESS : RET_FAIL;
+    }
+    if (op->code == MODEL_OP_SOFTMAX) {
+        // The kernel normalizes whole rows of the last dimension
+        if (in->dims < 1 || in->shape[in->dims - 1] <= 0 || in->bytes % (size_t)in->shape[in->dims - 1] != 0) {
+            return RET_FAIL;
+        }
+        return in->bytes == out->bytes && out->scale > 0.0f ? RET_SUCCESS : RET_FAIL;
+    }
+    if (!is_nhwc(in) || !is_nhwc(out)) return RET_FAIL;
+
+    int in_h = in->shape[1], in_w = in->shape[2], in_c = in->shape[3];
+    int out_h, out_w, out_c = out->shape[3];
+    activation_range(op->activation, out, &op->act_min, &op->act_max);
+
+    // Pooling and depthwise kernels accumulate one pixel at a time in the GEMM accumulators
+    if (op->code != MODEL_OP_CONV_2D && (size_t)out_c > *gemm_acc) *gemm_acc = (size_t)out_c;
+
+    if (op->code == MODEL_OP_AVERAGE_POOL_2D) {
+        if (out_c != in_c || in->scale != out->scale || in->zero_point != out->zero_point) return RET_FAIL;
+        out_h = resolve_padding(op->padding_same, in_h, op->filter_h, op->stride_h, 1, &op->pad_top);
+        out_w = resolve_padding(op->padding_same, in_w, op->filter_w, op->stride_w, 1, &op->pad_left);
+        return out_h == out->shape[1] && out_w == out->shape[2] ? RET_SUCCESS : RET_FAIL;
+    }
+
+    // Convolutions: uint8 weights [out_c or 1, kh, kw, in_c or out_c] and an int32 bias
+    if (op->input_count != 3 || op->inputs[1] < 0 || op->inputs[2] < 0) return RET_FAIL;
+    const model_tensor *w = &model->tensors[op->inputs[1]];
+    const model_tensor *b = &model->tensors[op->inputs[2]];
+    if (w->type != MODEL_TYPE_UINT8 || !w->data || w->dims != 4 ||
+        b->type != MODEL_TYPE_INT32 || !b->data || b->bytes != (size_t)out_c * 4) {
+        return RET_FAIL;
+    }
+    op->filter_h = w->shape[1];
+    op->filter_w = w->shape[2];
+    out_h = resolve_padding(op->padding_same, in_h, op->filter_h, op->stride_h, op->dilation_h, &op->pad_top);
+    out_w = resolve_padding(op->padding_same, in_w, op->filter_w, op->stride_w, op->dilation_w, &op->pad_left);
+    if (out_h != out->shape[1] || out_w != out->shape[2]) return RET_FAIL;
+
+    if (op->code == MODEL_OP_DEPTHWISE_CONV_2D) {
+        if (w->shape[0] != 1 || w->shape[3] != out_c || out_c != in_c * op->depth_multiplier) return RET_FAIL;
+    } else if (w->shape[0] != out_c || w->shape[3] != in_c) {
+        return RET_FAIL;
+    }
+
+    // The converter aligns buffers, so the bias is normally used in place
+    if ((uintptr_t)b->data % sizeof(int32_t) == 0) {
+        op->bias = (const int32_t *)b->data;
+    } else {
+        op->bias_copy = (int32_t *)malloc((size_t)out_c * sizeof(int32_t));
+        if (!op->bias_copy) return RET_FAIL;
+        memcpy(op->bias_copy, b->data, (size_t)out_c * sizeof(int32_t));
+        op->bias = op->bias_copy;
+    }
+
+    double real = (double)in->scale * w->scale / out->scale;
+    model_quantize_multiplier(real, &op->multiplier, &op->shift);
+
+    if (op->code == MODEL_OP_DEPTHWISE_CONV_2D) return RET_SUCCESS;
+
+    // GEMM layout: the OHWI weights are already out_c rows of kh * kw * in_c bytes.
+    // Rows whose length is not a multiple of the kernel step get a padded copy.
+    op->k = op->filter_h * op->filter_w * in_c;
+    op->k_padded = (op->k + MODEL_GEMM_K_STEP - 1) / MODEL_GEMM_K_STEP * MODEL_GEMM_K_STEP;
+    if (op->k == op->k_padded) {
+        op->weights = w->data;
+    } else {
+        op->packed = (uint8_t *)calloc((size_t)out_c, (size_t)op->k_padded);
+        if (!op->packed) return RET_FAIL;
+        for (int o = 0; o < out_c; o++) {
+            memcpy(op->packed + (size_t)o * op->k_padded, w->data + (size_t)o * op->k, (size_t)op->k);
+        }
+        op->weights = op->packed;
+    }
+
+    // Blocks of output pixels sized so their input rows stay in L1 and the
+    // accumulators in L2 while every output channel streams past them
+    int block = 16384 / op->k_padded;
+    if (block > 16384 / out_c) block = 16384 / out_c;
+    if (block > 256) block = 256;
+    block &= ~3;
+    if (block < 4) block = 4;
+    op->block = block;
+
+    if ((size_t)block * op->k_padded > *gemm_a) *gemm_a = (size_t)block * op->k_padded;
+    if ((size_t)block * out_c > *gemm_acc) *gemm_acc = (size_t)block * out_c;
+    if (block > *gemm_rows) *gemm_rows = block;
+    return RET_SUCCESS;
+}
+
+// Greedy-by-size arena planning: the largest tensors are placed first, each
+// at the lowest offset that does not collide with an already placed tensor
+// alive at the same time.
+static int plan_arena(Model *model)
+{
+    model_tensor *t = model->tensors;
+    int n = model->tensor_count;
+
+    for (int i = 0; i < model->op_count; i++) {
+        const model_op *op = &model->ops[i];
+        for (int j = 0; j < op->input_count; j++) {
+            if (op->inputs[j] >= 0) t[op->inputs[j]].last_op = i;
+        }
+        if (t[op->output].first_op >= 0) return RET_FAIL; // Written twice
+        t[op->output].first_op = i;
+        t[op->output].last_op = i > t[op->output].last_op ? i : t[op->output].last_op;
+    }
+    // The input and output stay untouched between inferences
+    t[model->input].first_op = -1;
+    t[model->input].last_op = model->op_count;
+    t[model->output].last_op = model->op_count;
+    if (t[model->input].data || t[model->output].data) return RET_FAIL;
+
+    int *order = (int *)malloc(sizeof(int) * 2 * n);
+    if (!order) return RET_FAIL;
+    int *placed = order + n;
+    int count = 0, placed_count = 0;
+    for (int i = 0; i < n; i++) {
+        // Activations nothing reads or writes need no memory
+        if (!t[i].data && (t[i].last_op >= 0 || i == model->input)) order[count++] = i;
+    }
+    for (int i = 1; i < count; i++) {
+        int v = order[i], j = i;
+        for (; j > 0 && t[order[j - 1]].bytes < t[v].bytes; j--) order[j] = order[j - 1];
+        order[j] = v;
+    }
+
+    size_t arena = 0;
+    for (int i = 0; i < count; i++) {
+        model_tensor *a = &t[order[i]];
+        size_t offset = 0;
+        int moved = 1;
+        while (moved) {
+            moved = 0;
+            for (int j = 0; j < placed_count; j++) {
+                const model_tensor *b = &t[placed[j]];
+                int alive = a->first_op <= b->last_op && b->first_op <= a->last_op;
+                if (alive && offset < b->offset + b->bytes && b->offset < offset + a->bytes) {
+                    offset = (b->offset + b->bytes + MODEL_ARENA_ALIGNMENT - 1) & ~(size_t)(MODEL_ARENA_ALIGNMENT - 1);
+                    moved = 1;
+                }
+            }
+        }
+        a->offset = offset;
+        placed[placed_count++] = order[i];
+        if (offset + a->bytes > arena) arena = offset + a->bytes;
+    }
+    free(order);
+
+    model->arena_size = arena;
+    model->arena = (uint8_t *)img_pool_alloc(arena ? arena : 1);
+    return model->arena ? RET_SUCCESS : RET_FAIL;
+}
+
+int model_prepare(Model *model)
+{
+    const model_tensor *input = &model->tensors[model->input];
+    if (!is_nhwc(input) || input->type != MODEL_TYPE_UINT8) return RET_FAIL;
+
+    size_t gemm_a = 1, gemm_acc = 1;
+    int gemm_rows = 1;
+    for (int i = 0; i < model->op_count; i++) {
+        if (prepare_op(model, &model->ops[i], &gemm_a, &gemm_acc, &gemm_rows) != RET_SUCCESS) return RET_FAIL;
+    }
+    if (plan_arena(model) != RET_SUCCESS) return RET_FAIL;
+
+    model->gemm_a = (int16_t *)img_pool_alloc(gemm_a * sizeof(int16_t));
+    model->gemm_sums = (int32_t *)img_pool_alloc((size_t)gemm_rows * sizeof(int32_t));
+    model->gemm_acc = (int32_t *)img_pool_alloc(gemm_acc * sizeof(int32_t));
+    return model->gemm_a && model->gemm_sums && model->gemm_acc ? RET_SUCCESS : RET_FAIL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+// Maps a file read-only; the mapping outlives the descriptor
+static const uint8_t* map_file(const char *filename, size_t *size)
+{
+    int fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+
+    void *data = MAP_FAILED;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        *size = (size_t)st.st_size;
+    }
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+
+    // Parsing touches only the metadata; let the kernel read the weights ahead
+    madvise(data, *size, MADV_WILLNEED);
+    return (const uint8_t *)data;
+}
+
+Model* model_load(const char *filename)
+{
+    IMG_TRACE_SCOPE("model_load");
+    Model *model = (Model *)calloc(1, sizeof(Model));
+    if (!model) return NULL;
+
+    model->file = map_file(filename, &model->file_size);
+    if (!model->file || model_parse(model) != RET_SUCCESS || model_prepare(model) != RET_SUCCESS) {
+        fprintf(stderr, "Unsupported or invalid model: %s\n", filename);
+        model_free(model);
+        return NULL;
+    }
+    return model;
+}
+
+void model_free(Model *model)
+{
+    if (!model) return;
+    for (int i = 0; model->ops && i < model->op_count; i++) {
+        free(model->ops[i].bias_copy);
+        free(model->ops[i].packed);
+    }
+    img_pool_free(model->gemm_a);
+    img_pool_free(model->gemm_sums);
+    img_pool_free(model->gemm_acc);
+    img_pool_free(model->arena);
+    free(model->ops);
+    free(model->tensors);
+    if (model->file) munmap((void *)model->file, model->file_size);
+    free(model);
+}
+
+void model_input_shape(const Model *model, int *height, int *width, int *channels)
+{
+    const model_tensor *t = &model->tensors[model->input];
+    if (height) *height = t->shape[1];
+    if (width) *width = t->shape[2];
+    if (channels) *channels = t->shape[3];
+}
+
+unsigned char* model_input(Model *model)
+{
+    return model->arena + model->tensors[model->input].offset;
+}
+
+const unsigned char* model_output(const Model *model, int *count)
+{
+    const model_tensor *t = &model->tensors[model->output];
+    if (count) *count = (int)t->bytes;
+    return model->arena + t->offset;
+}
@@ -0,0 +1,43 @@
+/**
+ * Classification results.
+ */
+#include "../../include/model_utils.h"
+#include "../../internal/img_utils/internal_img_trace.h"
+#include "../../internal/model_utils/internal_model_utils.h"
+
+
+int model_top_k(const Model *model, int k, model_prediction *out)
+{
+    int count;
+    const unsigned char *scores = model_output(model, &count);
+    const model_tensor *t = &model->tensors[model->output];
+    if (k > count) k = count;
+    if (k <= 0) return 0;
+
+    // Insertion into a sorted list of k; a strict comparison keeps the lower index first on ties
+    int found = 0;
+    for (int i = 0; i < count; i++) {
+        if (found == k && scores[i] <= scores[out[k - 1].index]) continue;
+        int j = found < k ? found++ : k - 1;
+        for (; j > 0 && scores[i] > scores[out[j - 1].index]; j--) out[j] = out[j - 1];
+        out[j].index = i;
+    }
+
+    for (int i = 0; i < k; i++) out[i].score = t->scale * (scores[out[i].index] - t->zero_point);
+    return k;
+}
+
+int model_classify(Model *model, const Image *img, int k, model_prediction *out)
+{
+    IMG_TRACE_SCOPE("model_classify");
+    int height, width, channels;
+    model_input_shape(model, &height, &width, &channels);
+    if (channels != 3) return -1;
+
+    img_tensor_spec spec = img_tensor_spec_mobilenet_v1_quant();
+    spec.width = width;
+    spec.height = height;
+    if (img_to_tensor(img, &spec, model_input(model)) != RET_SUCCESS) return -1;
+    if (model_invoke(model) != RET_SUCCESS) return -1;
+    return model_top_k(model, k, out);
+}
@@ -0,0 +1,200 @@
+/**
+ * In-image data parallelism.
+ *
+ * A parallel loop submits up to threads - 1 helper tasks to the shared pool;
+ * the helpers and the calling thread then claim bands from an atomic counter
+ * until none are left. The caller therefore never waits on a busy pool for
+ * work it could do itself, and it only blocks for helpers still finishing
+ * their last band.
+ *
+ * Loops hold a reference to the pool they submit to, so img_set_threads()
+ * may swap the pool while loops are running; the old one is freed by
+ * whichever of them finishes last.
+ */
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../../include/img_utils.h"
+#include "../../internal/img_utils/internal_img_trace.h"
+#include "../../internal/thread/parallel.h"
+#include "../../internal/thread/thread_pool.h"
+
+
+// Bands per thread, so uneven bands still balance out
+#define BANDS_PER_THREAD 4
+
+typedef struct {
+    img_range_fn fn;
+    void *ctx;
+    int count;
+    int band;             // Rows per band
+    int bands;
+    atomic_int next;      // Next unclaimed band
+    int helpers;          // Helper tasks still running, guarded by lock
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+} parallel_job;
+
+// A pool and the loops using it, plus one reference while it is the current pool
+typedef struct {
+    img_thread_pool *pool;
+    int refs;             // Guarded by pool_lock
+} shared_pool;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static shared_pool *pool;        // Started on first use with threads - 1 workers
+static atomic_int thread_count;  // 0 until resolved from the environment or img_set_threads()
+
+static int online_cpus(void)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (int)cpus : 1;
+}
+
+static int resolve_threads(void)
+{
+    int threads = atomic_load_explicit(&thread_count, memory_order_relaxed);
+    if (threads > 0) return threads;
+
+    threads = online_cpus();
+    const char *env = getenv(IMG_THREADS_ENV);
+    if (env && *env) {
+        char *end;
+        long n = strtol(env, &end, 10);
+        if (*end == '\0' && n >= 0 && n <= 1024) threads = n > 0 ? (int)n : online_cpus();
+        else fprintf(stderr, "Ignoring invalid %s value: %s\n", IMG_THREADS_ENV, env);
+    }
+
+    // Losing the race to img_set_threads() keeps the explicit setting
+    int expected = 0;
+    atomic_compare_exchange_strong(&thread_count, &expected, threads);
+    return atomic_load(&thread_count);
+}
+
+static shared_pool* acquire_pool(int threads)
+{
+    pthread_mutex_lock(&pool_lock);
+    if (!pool) {
+        shared_pool *sp = (shared_pool *)malloc(sizeof(shared_pool));
+        if (sp) sp->pool = img_thread_pool_new(threads - 1);
+        if (sp && sp->pool) {
+            sp->refs = 1;
+            pool = sp;
+        } else {
+            free(sp);
+        }
+    }
+    shared_pool *p = pool;
+    if (p) p->refs++;
+    pthread_mutex_unlock(&pool_lock);
+    return p;
+}
+
+static void release_pool(shared_pool *p)
+{
+    if (!p) return;
+    pthread_mutex_lock(&pool_lock);
+    int last = --p->refs == 0;
+    pthread_mutex_unlock(&pool_lock);
+    if (!last) return;
+
+    img_thread_pool_free(p->pool);
+    free(p);
+}
+
+static void run_bands(parallel_job *job)
+{
+    for (;;) {
+        int b = atomic_fetch_add_explicit(&job->next, 1, memory_order_relaxed);
+        if (b >= job->bands) break;
+        int begin = b * job->band;
+        int end = begin + job->band < job->count ? begin + job->band : job->count;
+        job->fn(job->ctx, begin, end);
+    }
+}
+
+static void helper_main(void *arg)
+{
+    parallel_job *job = (parallel_job *)arg;
+    {
+        IMG_TRACE_SCOPE("img_parallel_band");
+        run_bands(job);
+    }
+
+    pthread_mutex_lock(&job->lock);
+    if (--job->helpers == 0) pthread_cond_signal(&job->done);
+    pthread_mutex_unlock(&job->lock);
+}
+
+void img_parallel_for(int count, int grain, img_range_fn fn, void *ctx)
+{
+    if (count <= 0) return;
+    if (grain < 1) grain = 1;
+
+    int threads = resolve_threads();
+    shared_pool *p = NULL;
+    if (threads > 1 && count >= 2 * grain && !img_thread_pool_in_worker()) p = acquire_pool(threads);
+    if (!p) {
+        fn(ctx, 0, count);
+        return;
+    }
+
+    parallel_job job;
+    job.fn = fn;
+    job.ctx = ctx;
+    job.count = count;
+    job.bands = count / grain;
+    if (job.bands > threads * BANDS_PER_THREAD) job.bands = threads * BANDS_PER_THREAD;
+    job.band = (count + job.bands - 1) / job.bands;
+    job.bands = (count + job.band - 1) / job.band;
+    atomic_init(&job.next, 0);
+    job.helpers = 0;
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.done, NULL);
+
+    int helpers = job.bands - 1 < threads - 1 ? job.bands - 1 : threads - 1;
+    pthread_mutex_lock(&job.lock);
+    for (int i = 0; i < helpers; i++) {
+        if (img_thread_pool_submit(p->pool, helper_main, &job) != RET_SUCCESS) break;
+        job.helpers++;
+    }
+    pthread_mutex_unlock(&job.lock);
+
+    run_bands(&job);
+
+    // Helpers may still be inside their last band and hold a pointer to the job
+    pthread_mutex_lock(&job.lock);
+    while (job.helpers > 0) pthread_cond_wait(&job.done, &job.lock);
+    pthread_mutex_unlock(&job.lock);
+    pthread_cond_destroy(&job.done);
+    pthread_mutex_destroy(&job.lock);
+    release_pool(p);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+int img_set_threads(int threads)
+{
+    if (threads < 0) return RET_FAIL;
+    if (threads == 0) threads = online_cpus();
+
+    // The workers are restarted lazily at the new size; running loops keep the old pool
+    pthread_mutex_lock(&pool_lock);
+    atomic_store(&thread_count, threads);
+    shared_pool *old = pool;
+    pool = NULL;
+    pthread_mutex_unlock(&pool_lock);
+
+    release_pool(old);
+    return RET_SUCCESS;
+}
+
+int img_get_threads(void)
+{
+    return resolve_threads();
+}
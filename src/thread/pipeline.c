@@ -0,0 +1,208 @@
+/**
+ * Bounded staged pipeline.
+ *
+ * All scheduling state lives under one mutex that is only held for queue
+ * bookkeeping, never while a stage runs.
+ */
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../../include/img_utils.h"
+#include "../../internal/img_utils/internal_img_trace.h"
+#include "../../internal/thread/pipeline.h"
+
+
+typedef struct {
+    void **ring;        // queue_capacity slots; unused for the first stage
+    int head;
+    int count;
+    int running;        // Items the stage is working on
+    double area;        // Integral of count over time
+    double last_change; // Time of the last change of count
+} stage_queue;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t finished_cond;
+    img_thread_pool *pool;
+    const img_stage *stages;
+    int stage_count;
+    int capacity;
+    void *ctx;
+    void **input;
+    int input_count;
+    int next_input;
+    int finished;       // Items that left the pipeline, done or dropped
+    stage_queue *queues;
+    img_stage_stats *stats;
+} pipeline;
+
+typedef struct {
+    pipeline *p;
+    int stage;
+    void *item;
+} stage_task;
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void queue_account(stage_queue *q, double now)
+{
+    q->area += q->count * (now - q->last_change);
+    q->last_change = now;
+}
+
+static void queue_push(pipeline *p, int k, void *item)
+{
+    stage_queue *q = &p->queues[k];
+    queue_account(q, now_seconds());
+    q->ring[(q->head + q->count) % p->capacity] = item;
+    q->count++;
+    if (q->count > p->stats[k].queue_max) p->stats[k].queue_max = q->count;
+}
+
+static void* queue_pop(pipeline *p, int k)
+{
+    stage_queue *q = &p->queues[k];
+    queue_account(q, now_seconds());
+    void *item = q->ring[q->head];
+    q->head = (q->head + 1) % p->capacity;
+    q->count--;
+    return item;
+}
+
+static void run_stage(void *arg);
+
+// Starts every item that can move; downstream first so the pipeline drains. Lock held.
+static void pump(pipeline *p)
+{
+    for (int k = p->stage_count - 1; k >= 0; k--) {
+        stage_queue *q = &p->queues[k];
+        for (;;) {
+            int available = k == 0 ? p->next_input < p->input_count : q->count > 0;
+            if (!available) break;
+            // Items in the stage hold a reserved slot in the queue they feed
+            if (k < p->stage_count - 1 && q->running + p->queues[k + 1].count >= p->capacity) break;
+
+            void *item = k == 0 ? p->input[p->next_input++] : queue_pop(p, k);
+            stage_task *t = (stage_task *)malloc(sizeof(stage_task));
+            if (t) {
+                t->p = p;
+                t->stage = k;
+                t->item = item;
+            }
+            if (!t || img_thread_pool_submit(p->pool, run_stage, t) != RET_SUCCESS) {
+                free(t);
+                p->stats[k].failed++;
+                p->finished++;
+                continue;
+            }
+            q->running++;
+        }
+    }
+}
+
+static void run_stage(void *arg)
+{
+    stage_task *t = (stage_task *)arg;
+    pipeline *p = t->p;
+    const int k = t->stage;
+
+    double start = now_seconds();
+    int ret;
+    {
+        IMG_TRACE_SCOPE(p->stages[k].name);
+        ret = p->stages[k].fn(p->ctx, t->item);
+    }
+    double end = now_seconds();
+
+    pthread_mutex_lock(&p->lock);
+    p->queues[k].running--;
+    p->stats[k].busy_seconds += end - start;
+    if (ret != RET_SUCCESS) {
+        p->stats[k].failed++;
+        p->finished++;
+    } else {
+        p->stats[k].done++;
+        if (k == p->stage_count - 1) {
+            p->finished++;
+        } else {
+            queue_push(p, k + 1, t->item);
+        }
+    }
+    pump(p);
+    if (p->finished == p->input_count) pthread_cond_signal(&p->finished_cond);
+    pthread_mutex_unlock(&p->lock);
+
+    free(t);
+}
+
+int img_pipeline_run(img_thread_pool *pool, const img_stage *stages, int stage_count,
+                     void **items, int item_count, int queue_capacity, void *ctx,
+                     img_stage_stats *stats, double *wall_seconds)
+{
+    if (!pool || !stages || stage_count <= 0 || item_count < 0 || queue_capacity < 1) return RET_FAIL;
+    if (item_count > 0 && !items) return RET_FAIL;
+
+    pipeline p;
+    memset(&p, 0, sizeof(p));
+    p.pool = pool;
+    p.stages = stages;
+    p.stage_count = stage_count;
+    p.capacity = queue_capacity;
+    p.ctx = ctx;
+    p.input = items;
+    p.input_count = item_count;
+
+    p.queues = (stage_queue *)calloc(stage_count, sizeof(stage_queue));
+    p.stats = (img_stage_stats *)calloc(stage_count, sizeof(img_stage_stats));
+    void **rings = (void **)malloc(sizeof(void *) * queue_capacity * stage_count);
+    if (!p.queues || !p.stats || !rings) {
+        free(p.queues);
+        free(p.stats);
+        free(rings);
+        return RET_FAIL;
+    }
+
+    double start = now_seconds();
+    for (int k = 0; k < stage_count; k++) {
+        p.queues[k].ring = rings + (size_t)k * queue_capacity;
+        p.queues[k].last_change = start;
+        p.stats[k].queue_capacity = k == 0 ? 0 : queue_capacity;
+    }
+
+    pthread_mutex_init(&p.lock, NULL);
+    pthread_cond_init(&p.finished_cond, NULL);
+
+    pthread_mutex_lock(&p.lock);
+    pump(&p);
+    while (p.finished < p.input_count) {
+        pthread_cond_wait(&p.finished_cond, &p.lock);
+    }
+    pthread_mutex_unlock(&p.lock);
+
+    double wall = now_seconds() - start;
+    for (int k = 1; k < stage_count; k++) {
+        queue_account(&p.queues[k], start + wall);
+        p.stats[k].queue_mean = wall > 0 ? p.queues[k].area / wall : 0.0;
+    }
+
+    // The last task may still be unwinding after signalling; let it leave the lock
+    img_thread_pool_wait(pool);
+
+    if (stats) memcpy(stats, p.stats, sizeof(img_stage_stats) * stage_count);
+    if (wall_seconds) *wall_seconds = wall;
+
+    pthread_cond_destroy(&p.finished_cond);
+    pthread_mutex_destroy(&p.lock);
+    free(rings);
+    free(p.stats);
+    free(p.queues);
+    return RET_SUCCESS;
+}
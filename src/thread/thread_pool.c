@@ -0,0 +1,293 @@
+/**
+ * Work-stealing thread pool.
+ *
+ * Deques are small mutex-protected rings: the owner pushes and pops at the
+ * back, thieves take from the front. A pool-wide count of queued tasks lets
+ * workers decide to sleep without scanning every deque under a global lock.
+ */
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../../include/img_utils.h"
+#include "../../internal/thread/thread_pool.h"
+
+
+#define DEQUE_INITIAL 64
+
+typedef struct {
+    img_task_fn fn;
+    void *arg;
+} task;
+
+typedef struct {
+    pthread_mutex_t lock;
+    task *ring;
+    int head;     // Index of the front task
+    int count;
+    int capacity; // Power of two
+} deque;
+
+struct img_thread_pool {
+    int threads;
+    int started;           // Workers actually running
+    pthread_t *workers;
+    deque *deques;         // One per worker, then the injection queue
+    atomic_int queued;     // Tasks sitting in deques
+    atomic_int pending;    // Tasks submitted and not yet finished
+    pthread_mutex_t lock;  // Guards sleeping/stop and the condition variables
+    pthread_cond_t wake;
+    pthread_cond_t idle;
+    int sleeping;
+    int stop;
+};
+
+typedef struct {
+    img_thread_pool *pool;
+    int index;
+} worker_arg;
+
+// Pool and deque index of the calling worker thread
+static _Thread_local img_thread_pool *current_pool;
+static _Thread_local int current_index;
+
+/* ------------------------------------------------------------------------- */
+/* Deques                                                                    */
+/* ------------------------------------------------------------------------- */
+
+static int deque_init(deque *d)
+{
+    d->ring = (task *)malloc(sizeof(task) * DEQUE_INITIAL);
+    if (!d->ring) return RET_FAIL;
+    d->head = 0;
+    d->count = 0;
+    d->capacity = DEQUE_INITIAL;
+    pthread_mutex_init(&d->lock, NULL);
+    return RET_SUCCESS;
+}
+
+static void deque_release(deque *d)
+{
+    pthread_mutex_destroy(&d->lock);
+    free(d->ring);
+}
+
+static int deque_push_back(deque *d, task t)
+{
+    pthread_mutex_lock(&d->lock);
+    if (d->count == d->capacity) {
+        // Unroll the ring into a buffer twice the size
+        task *ring = (task *)malloc(sizeof(task) * d->capacity * 2);
+        if (!ring) {
+            pthread_mutex_unlock(&d->lock);
+            return RET_FAIL;
+        }
+        for (int i = 0; i < d->count; i++) {
+            ring[i] = d->ring[(d->head + i) & (d->capacity - 1)];
+        }
+        free(d->ring);
+        d->ring = ring;
+        d->head = 0;
+        d->capacity *= 2;
+    }
+    d->ring[(d->head + d->count) & (d->capacity - 1)] = t;
+    d->count++;
+    pthread_mutex_unlock(&d->lock);
+    return RET_SUCCESS;
+}
+
+static int deque_pop_back(deque *d, task *t)
+{
+    int found = 0;
+    pthread_mutex_lock(&d->lock);
+    if (d->count > 0) {
+        d->count--;
+        *t = d->ring[(d->head + d->count) & (d->capacity - 1)];
+        found = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return found;
+}
+
+static int deque_pop_front(deque *d, task *t)
+{
+    int found = 0;
+    pthread_mutex_lock(&d->lock);
+    if (d->count > 0) {
+        *t = d->ring[d->head];
+        d->head = (d->head + 1) & (d->capacity - 1);
+        d->count--;
+        found = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return found;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Workers                                                                   */
+/* ------------------------------------------------------------------------- */
+
+// Own deque first (newest task), then the injection queue, then the other workers (oldest task)
+static int find_task(img_thread_pool *pool, int self, task *t)
+{
+    if (deque_pop_back(&pool->deques[self], t)) return 1;
+    if (deque_pop_front(&pool->deques[pool->threads], t)) return 1;
+    for (int i = 1; i < pool->threads; i++) {
+        if (deque_pop_front(&pool->deques[(self + i) % pool->threads], t)) return 1;
+    }
+    return 0;
+}
+
+static void* worker_main(void *opaque)
+{
+    worker_arg *arg = (worker_arg *)opaque;
+    img_thread_pool *pool = arg->pool;
+    const int self = arg->index;
+    free(arg);
+
+    current_pool = pool;
+    current_index = self;
+
+    for (;;) {
+        task t;
+        if (find_task(pool, self, &t)) {
+            atomic_fetch_sub(&pool->queued, 1);
+            t.fn(t.arg);
+            if (atomic_fetch_sub(&pool->pending, 1) == 1) {
+                pthread_mutex_lock(&pool->lock);
+                pthread_cond_broadcast(&pool->idle);
+                pthread_mutex_unlock(&pool->lock);
+            }
+            continue;
+        }
+
+        // Submitters bump `queued` before signalling under the lock, so no wakeup is lost
+        pthread_mutex_lock(&pool->lock);
+        while (atomic_load(&pool->queued) == 0 && !pool->stop) {
+            pool->sleeping++;
+            pthread_cond_wait(&pool->wake, &pool->lock);
+            pool->sleeping--;
+        }
+        int stop = pool->stop && atomic_load(&pool->queued) == 0;
+        pthread_mutex_unlock(&pool->lock);
+        if (stop) break;
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+img_thread_pool* img_thread_pool_new(int threads)
+{
+    if (threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (int)cpus : 1;
+    }
+
+    img_thread_pool *pool = (img_thread_pool *)calloc(1, sizeof(img_thread_pool));
+    if (!pool) return NULL;
+
+    pool->threads = threads;
+    pool->workers = (pthread_t *)calloc(threads, sizeof(pthread_t));
+    pool->deques = (deque *)calloc(threads + 1, sizeof(deque));
+    if (!pool->workers || !pool->deques) {
+        free(pool->workers);
+        free(pool->deques);
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+
+    int ready = 0;
+    while (ready <= threads && deque_init(&pool->deques[ready]) == RET_SUCCESS) ready++;
+
+    if (ready == threads + 1) {
+        for (; pool->started < threads; pool->started++) {
+            worker_arg *arg = (worker_arg *)malloc(sizeof(worker_arg));
+            if (!arg) break;
+            arg->pool = pool;
+            arg->index = pool->started;
+            if (pthread_create(&pool->workers[pool->started], NULL, worker_main, arg) != 0) {
+                free(arg);
+                break;
+            }
+        }
+    }
+
+    if (pool->started < threads) {
+        // Stop whatever was started and undo the rest
+        img_thread_pool_free(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+int img_thread_pool_size(const img_thread_pool *pool)
+{
+    return pool->threads;
+}
+
+int img_thread_pool_submit(img_thread_pool *pool, img_task_fn fn, void *arg)
+{
+    task t = { fn, arg };
+    int index = current_pool == pool ? current_index : pool->threads;
+
+    atomic_fetch_add(&pool->pending, 1);
+    if (deque_push_back(&pool->deques[index], t) != RET_SUCCESS) {
+        atomic_fetch_sub(&pool->pending, 1);
+        return RET_FAIL;
+    }
+    atomic_fetch_add(&pool->queued, 1);
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->sleeping > 0) pthread_cond_signal(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    return RET_SUCCESS;
+}
+
+int img_thread_pool_in_worker(void)
+{
+    return current_pool != NULL;
+}
+
+void img_thread_pool_wait(img_thread_pool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    while (atomic_load(&pool->pending) > 0) {
+        pthread_cond_wait(&pool->idle, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void img_thread_pool_free(img_thread_pool *pool)
+{
+    if (!pool) return;
+
+    img_thread_pool_wait(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->started; i++) {
+        pthread_join(pool->workers[i], NULL);
+    }
+
+    // calloc leaves never-initialised deques with a NULL ring
+    for (int i = 0; i < pool->threads + 1; i++) {
+        if (pool->deques[i].ring) deque_release(&pool->deques[i]);
+    }
+    pthread_cond_destroy(&pool->idle);
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->deques);
+    free(pool->workers);
+    free(pool);
+}
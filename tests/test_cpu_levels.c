@@ -0,0 +1,354 @@
+/**
+ * Differential test of the dispatched SIMD kernels.
+ *
+ * The decode conversions, layout shuffles, resize passes, normalization,
+ * colour space conversions and the inference GEMM are run on the same
+ * pseudo-random inputs once per CPU level, each in a child process started
+ * with NEURO_LENS_CPU capping the level, and every level must produce the
+ * same bytes as the scalar kernels. Levels above what the host supports are
+ * clamped to its own level by the dispatcher, so they repeat that run.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/img_utils.h"
+#include "../include/model_utils.h"
+#include "../internal/img_utils/internal_img_convert.h"
+#include "../internal/img_utils/internal_img_cpu.h"
+#include "../internal/img_utils/internal_img_layout.h"
+
+#define MODEL_PATH "bin/models/mobilenet_v1_1.0_224_quant.tflite"
+#define MAX_FAMILIES 8
+#define LINE_SIZE 256
+
+// Odd lengths hit the scalar tails of every vector width
+static const int lengths[] = { 1, 3, 7, 15, 16, 17, 31, 33, 63, 64, 65, 127, 255, 1000, 4099 };
+#define LENGTH_COUNT (int)(sizeof(lengths) / sizeof(lengths[0]))
+#define MAX_LENGTH 4099
+
+static const char *const levels[] = { "scalar", "sse2", "ssse3", "avx2", "avx512" };
+#define LEVEL_COUNT (int)(sizeof(levels) / sizeof(levels[0]))
+
+/* ------------------------------------------------------------------------- */
+/* Inputs and digests                                                        */
+/* ------------------------------------------------------------------------- */
+
+static uint64_t rng_state;
+
+static void rng_seed(uint64_t seed)
+{
+    rng_state = seed ? seed : 1;
+}
+
+static uint32_t rng_next(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (uint32_t)(rng_state >> 16);
+}
+
+static void fill_bytes(void *dst, size_t n)
+{
+    unsigned char *p = (unsigned char *)dst;
+    for (size_t i = 0; i < n; i++) p[i] = (unsigned char)rng_next();
+}
+
+static Image* random_image(int width, int height)
+{
+    Image *img = img_new(width, height);
+    if (img) fill_bytes(img->pixels, sizeof(pixel) * (size_t)width * height);
+    return img;
+}
+
+// FNV-1a, folded over every output byte of a kernel family
+static void digest(uint64_t *h, const void *data, size_t n)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i = 0; i < n; i++) *h = (*h ^ p[i]) * 1099511628211ULL;
+}
+
+static void digest_image(uint64_t *h, const Image *img)
+{
+    for (int y = 0; y < img->height; y++) digest(h, img_row(img, y), sizeof(pixel) * img->width);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Kernel families                                                           */
+/* ------------------------------------------------------------------------- */
+
+static int run_convert(uint64_t *h)
+{
+    static uint8_t src[4 * MAX_LENGTH], narrow[2 * MAX_LENGTH];
+    static pixel out[MAX_LENGTH], lut[256];
+    rng_seed(1);
+    fill_bytes(lut, sizeof(lut));
+
+    for (int i = 0; i < LENGTH_COUNT; i++) {
+        int n = lengths[i];
+        fill_bytes(src, sizeof(src));
+        img_cvt_gray_to_rgba(src, out, n);
+        digest(h, out, sizeof(pixel) * n);
+        img_cvt_gray_alpha_to_rgba(src, out, n);
+        digest(h, out, sizeof(pixel) * n);
+        img_cvt_rgb_to_rgba(src, out, n);
+        digest(h, out, sizeof(pixel) * n);
+        img_cvt_palette_to_rgba(src, lut, out, n);
+        digest(h, out, sizeof(pixel) * n);
+        img_cvt_narrow16(src, narrow, (size_t)n);
+        digest(h, narrow, n);
+        for (int depth = 1; depth <= 4; depth *= 2) {
+            img_cvt_unpack_bits(src, narrow, n, depth, 1);
+            digest(h, narrow, n);
+            img_cvt_unpack_bits(src, narrow, n, depth, 255 / ((1 << depth) - 1));
+            digest(h, narrow, n);
+        }
+    }
+    return RET_SUCCESS;
+}
+
+static int run_layout(uint64_t *h)
+{
+    static uint8_t src[4 * MAX_LENGTH], dst[4 * MAX_LENGTH], planes[4][MAX_LENGTH];
+    static float wide[4 * MAX_LENGTH];
+    rng_seed(2);
+
+    for (int i = 0; i < LENGTH_COUNT; i++) {
+        int n = lengths[i];
+        fill_bytes(src, sizeof(src));
+        img_layout_deinterleave4_u8(src, planes[0], planes[1], planes[2], planes[3], n);
+        digest(h, planes, sizeof(planes));
+        img_layout_interleave4_u8(planes[0], planes[1], planes[2], planes[3], dst, n);
+        digest(h, dst, 4 * (size_t)n);
+        img_layout_deinterleave3_u8(src, planes[0], planes[1], planes[2], n);
+        digest(h, planes, sizeof(planes));
+        img_layout_interleave3_u8(planes[0], planes[1], planes[2], dst, n);
+        digest(h, dst, 3 * (size_t)n);
+        img_layout_drop_alpha_u8(src, dst, n);
+        digest(h, dst, 3 * (size_t)n);
+        img_layout_u8_to_f32(src, wide, (size_t)n);
+        digest(h, wide, sizeof(float) * n);
+
+        // Halves and out-of-range values pin down rounding and saturation
+        for (int k = 0; k < n; k++) wide[k] = (float)((int)(rng_next() % 1400) - 400) * 0.5f;
+        img_layout_f32_to_u8(wide, dst, (size_t)n);
+        digest(h, dst, n);
+    }
+    return RET_SUCCESS;
+}
+
+static int run_resize(uint64_t *h)
+{
+    static const int sizes[][4] = {
+        { 1920, 1080, 960, 540 }, { 1000, 700, 333, 211 }, { 37, 29, 5, 3 }, { 640, 480, 1280, 960 },
+        { 4032, 3024, 224, 224 }, { 17, 9, 17, 9 }, { 300, 200, 299, 201 }, { 7, 5, 3, 2 },
+    };
+    rng_seed(3);
+
+    int ret = RET_SUCCESS;
+    for (int s = 0; ret == RET_SUCCESS && s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++) {
+        Image *src = random_image(sizes[s][0], sizes[s][1]);
+        Image *dst = img_new(sizes[s][2], sizes[s][3]);
+        for (int f = IMG_FILTER_NEAREST; ret == RET_SUCCESS && f <= IMG_FILTER_AREA; f++) {
+            ret = src && dst ? img_resize_into(src, dst, (img_filter)f) : RET_FAIL;
+            if (ret == RET_SUCCESS) digest_image(h, dst);
+        }
+        img_free(src);
+        img_free(dst);
+    }
+    return ret;
+}
+
+static int run_normalization(uint64_t *h)
+{
+    static const img_layout layouts[] = { IMG_LAYOUT_NHWC, IMG_LAYOUT_NCHW };
+    static const img_tensor_type types[] = { IMG_TENSOR_UINT8, IMG_TENSOR_INT8, IMG_TENSOR_FLOAT32 };
+    static const img_norm_method methods[] = { IMG_NORM_MINMAX, IMG_NORM_STANDARDIZE, IMG_NORM_REQUANTIZE };
+    rng_seed(4);
+
+    Image *img = random_image(257, 31);
+    float *out = (float *)malloc(sizeof(float) * 4 * 257 * 31);
+    int ret = img && out ? RET_SUCCESS : RET_FAIL;
+
+    for (int m = 0; ret == RET_SUCCESS && m < 3; m++) {
+        for (int l = 0; ret == RET_SUCCESS && l < 2; l++) {
+            for (int t = 0; ret == RET_SUCCESS && t < 3; t++) {
+                for (int channels = 1; ret == RET_SUCCESS && channels <= 4; channels++) {
+                    img_norm_spec spec = img_norm_defaults();
+                    spec.method = methods[m];
+                    spec.layout = layouts[l];
+                    spec.type = types[t];
+                    spec.channels = channels;
+                    spec.out_min = -1.0f;
+                    spec.in_scale = 0.0173f;
+                    spec.in_zero_point = 114.0f;
+                    spec.scale = types[t] == IMG_TENSOR_FLOAT32 ? 1.0f : 0.0121f;
+                    spec.zero_point = types[t] == IMG_TENSOR_INT8 ? -3.0f : 7.0f;
+                    for (int c = 0; c < 4; c++) {
+                        spec.mean[c] = 100.0f + 10.0f * c;
+                        spec.std[c] = 50.0f + 7.0f * c;
+                    }
+                    ret = img_normalize(img, &spec, out);
+                    size_t bytes = (size_t)257 * 31 * channels * (types[t] == IMG_TENSOR_FLOAT32 ? 4 : 1);
+                    if (ret == RET_SUCCESS) digest(h, out, bytes);
+                }
+            }
+        }
+    }
+
+    img_channel_stats stats;
+    img_stats_init(&stats);
+    if (ret == RET_SUCCESS) ret = img_stats_accumulate(&stats, img);
+    digest(h, &stats, sizeof(stats));
+
+    free(out);
+    img_free(img);
+    return ret;
+}
+
+static int run_color(uint64_t *h)
+{
+    rng_seed(5);
+    Image *src = random_image(1001, 9);
+    Image *dst = img_new(1001, 9);
+    uint8_t *buffer = (uint8_t *)malloc((size_t)3 * 1001 * 9);
+    int ret = src && dst && buffer ? RET_SUCCESS : RET_FAIL;
+
+    uint8_t *const planes[3] = { buffer, buffer + 1001 * 9, buffer + 2 * 1001 * 9 };
+    for (int space = IMG_COLOR_GRAY; ret == RET_SUCCESS && space <= IMG_COLOR_HSV; space++) {
+        ret = img_rgb_to_color(src, dst, (img_color_space)space);
+        if (ret == RET_SUCCESS) digest_image(h, dst);
+        if (ret == RET_SUCCESS) ret = img_color_to_rgb(src, dst, (img_color_space)space);
+        if (ret == RET_SUCCESS) digest_image(h, dst);
+        if (ret == RET_SUCCESS) ret = img_rgb_to_color_planes(src, (img_color_space)space, planes, 1001);
+        if (ret == RET_SUCCESS) digest(h, buffer, (size_t)3 * 1001 * 9);
+        if (ret == RET_SUCCESS) {
+            ret = img_color_planes_to_rgb((const uint8_t *const *)planes, 1001, (img_color_space)space, dst);
+        }
+        if (ret == RET_SUCCESS) digest_image(h, dst);
+    }
+
+    free(buffer);
+    img_free(src);
+    img_free(dst);
+    return ret;
+}
+
+// Every convolution goes through the GEMM kernel, so the logits cover it
+static int run_gemm(uint64_t *h)
+{
+    if (access(MODEL_PATH, R_OK) != 0) {
+        digest(h, "skipped", 7);
+        return RET_SUCCESS;
+    }
+
+    Model *model = model_load(MODEL_PATH);
+    if (!model) return RET_FAIL;
+    int height, width, channels;
+    model_input_shape(model, &height, &width, &channels);
+
+    rng_seed(6);
+    int ret = RET_SUCCESS;
+    for (int run = 0; ret == RET_SUCCESS && run < 2; run++) {
+        fill_bytes(model_input(model), (size_t)height * width * channels);
+        ret = model_invoke(model);
+        int count = 0;
+        const unsigned char *logits = model_output(model, &count);
+        if (ret == RET_SUCCESS) digest(h, logits, count);
+    }
+    model_free(model);
+    return ret;
+}
+
+typedef struct {
+    const char *name;
+    int (*run)(uint64_t *h);
+} family;
+
+static const family families[] = {
+    { "convert", run_convert },
+    { "layout", run_layout },
+    { "resize", run_resize },
+    { "normalization", run_normalization },
+    { "color", run_color },
+    { "gemm", run_gemm },
+};
+#define FAMILY_COUNT (int)(sizeof(families) / sizeof(families[0]))
+
+/* ------------------------------------------------------------------------- */
+/* Driver                                                                    */
+/* ------------------------------------------------------------------------- */
+
+// Child mode: prints the level in use, then one digest per family
+static int print_digests(void)
+{
+    printf("%s\n", img_cpu_level_name(img_cpu_get_level()));
+    for (int f = 0; f < FAMILY_COUNT; f++) {
+        uint64_t h = 1469598103934665603ULL;
+        if (families[f].run(&h) != RET_SUCCESS) {
+            printf("%s failed\n", families[f].name);
+            continue;
+        }
+        printf("%s %016llx\n", families[f].name, (unsigned long long)h);
+    }
+    return 0;
+}
+
+// Runs this binary capped at `level` and reads back its digest lines
+static int collect(const char *self, const char *level, char lines[MAX_FAMILIES + 1][LINE_SIZE])
+{
+    char command[4096];
+    if (setenv(IMG_CPU_ENV, level, 1) != 0) return RET_FAIL;
+    if (snprintf(command, sizeof(command), "'%s' --digests", self) >= (int)sizeof(command)) return RET_FAIL;
+
+    FILE *child = popen(command, "r");
+    if (!child) return RET_FAIL;
+    int count = 0;
+    while (count < FAMILY_COUNT + 1 && fgets(lines[count], LINE_SIZE, child)) {
+        lines[count][strcspn(lines[count], "\n")] = '\0';
+        count++;
+    }
+    int status = pclose(child);
+    return status == 0 && count == FAMILY_COUNT + 1 ? RET_SUCCESS : RET_FAIL;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--digests") == 0) return print_digests();
+
+    static char reference[MAX_FAMILIES + 1][LINE_SIZE], lines[MAX_FAMILIES + 1][LINE_SIZE];
+    if (collect(argv[0], levels[0], reference) != RET_SUCCESS) {
+        printf("cpu levels: the scalar run failed\n");
+        return 1;
+    }
+    printf("cpu levels: host kernels %s\n", img_cpu_kernels());
+
+    int failures = 0;
+    for (int f = 1; f <= FAMILY_COUNT; f++) {
+        if (strstr(reference[f], " failed")) {
+            printf("  scalar: %s\n", reference[f]);
+            failures++;
+        }
+    }
+    for (int l = 1; l < LEVEL_COUNT; l++) {
+        if (collect(argv[0], levels[l], lines) != RET_SUCCESS) {
+            printf("  %-7s run failed\n", levels[l]);
+            failures++;
+            continue;
+        }
+        int mismatches = 0;
+        for (int f = 1; f <= FAMILY_COUNT; f++) {
+            if (strcmp(lines[f], reference[f]) != 0) {
+                printf("  %-7s (ran as %s) %s differs from scalar %s\n", levels[l], lines[0], lines[f], reference[f]);
+                mismatches++;
+            }
+        }
+        if (!mismatches) printf("  %-7s (ran as %s) matches scalar\n", levels[l], lines[0]);
+        failures += mismatches;
+    }
+    printf("cpu levels: %s\n", failures ? "FAIL" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,220 @@
+/**
+ * Model parser and kernel test.
+ *
+ * Loads the bundled MobileNet into memory and checks that the parser rejects
+ * truncated copies and an operator whose first input is missing, that a
+ * softmax over a tensor without dimensions is refused at preparation, and
+ * that the intact model classifies a synthetic image as it always has.
+ *
+ * The model is read from bin/models (extracted by `make test`).
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/img_utils.h"
+#include "../include/model_utils.h"
+#include "../internal/model_utils/internal_model_utils.h"
+
+#define MODEL_PATH "bin/models/mobilenet_v1_1.0_224_quant.tflite"
+#define LABELS_PATH "models/labels_mobilenet_quant_v1_224.txt"
+#define EXPECTED_TOP1 "whistle"
+
+// Flatbuffer fields used to locate the first operator
+#define MODEL_SUBGRAPHS    2
+#define SUBGRAPH_OPERATORS 3
+#define OPERATOR_INPUTS    1
+
+static int failures;
+
+static void check(int ok, const char *what)
+{
+    printf("  %-48s %s\n", what, ok ? "ok" : "FAIL");
+    if (!ok) failures++;
+}
+
+static uint8_t* read_file(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    uint8_t *data = NULL;
+    long length = -1;
+    if (fseek(f, 0, SEEK_END) == 0) length = ftell(f);
+    if (length > 0 && fseek(f, 0, SEEK_SET) == 0) {
+        data = (uint8_t *)malloc((size_t)length);
+        if (data && fread(data, 1, (size_t)length, f) != (size_t)length) {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(f);
+    *size = data ? (size_t)length : 0;
+    return data;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Models built over an in-memory buffer                                     */
+/* ------------------------------------------------------------------------- */
+
+// Parses a buffer the way model_load() parses a mapped file; prepare is optional
+static int load_buffer(const uint8_t *data, size_t size, int prepare, Model **out)
+{
+    Model *model = (Model *)calloc(1, sizeof(Model));
+    if (!model) return RET_FAIL;
+    model->file = data;
+    model->file_size = size;
+
+    int ret = model_parse(model);
+    if (ret == RET_SUCCESS && prepare) ret = model_prepare(model);
+
+    // model_free() unmaps the file; the buffer belongs to the caller
+    model->file = NULL;
+    if (ret == RET_SUCCESS && out) {
+        *out = model;
+    } else {
+        model_free(model);
+    }
+    return ret;
+}
+
+static uint32_t read_u32(const uint8_t *data, size_t pos)
+{
+    uint32_t v;
+    memcpy(&v, data + pos, 4);
+    return v;
+}
+
+// Follows a field of a table to the table or vector it references; the buffer is known to be valid
+static size_t field_target(const uint8_t *data, size_t table, int field)
+{
+    size_t vtable = table - (size_t)(int32_t)read_u32(data, table);
+    uint16_t offset;
+    memcpy(&offset, data + vtable + 4 + 2 * (size_t)field, 2);
+    size_t pos = table + offset;
+    return pos + read_u32(data, pos);
+}
+
+// Position of the first input index of the first operator
+static size_t first_op_input(const uint8_t *data)
+{
+    size_t root = read_u32(data, 0);
+    size_t subgraphs = field_target(data, root, MODEL_SUBGRAPHS);
+    size_t graph = subgraphs + 4 + read_u32(data, subgraphs + 4);
+    size_t operators = field_target(data, graph, SUBGRAPH_OPERATORS);
+    size_t op = operators + 4 + read_u32(data, operators + 4);
+    return field_target(data, op, OPERATOR_INPUTS) + 4;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Cases                                                                     */
+/* ------------------------------------------------------------------------- */
+
+static void test_truncated(const uint8_t *data, size_t size)
+{
+    // From the header alone to a file missing the tail of its last buffer; only
+    // alignment padding follows the weights, so a single byte is not enough
+    const size_t lengths[] = { 0, 4, 8, 64, 1024, size / 4, size / 2, size - 4096 };
+    int rejected = 1;
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        if (load_buffer(data, lengths[i], 1, NULL) == RET_SUCCESS) {
+            printf("  a copy truncated to %zu of %zu bytes was accepted\n", lengths[i], size);
+            rejected = 0;
+        }
+    }
+    check(rejected, "truncated model is rejected");
+}
+
+static void test_missing_input(const uint8_t *data, size_t size)
+{
+    uint8_t *copy = (uint8_t *)malloc(size);
+    if (!copy) {
+        check(0, "operator without its first input is rejected");
+        return;
+    }
+    memcpy(copy, data, size);
+    uint32_t missing = UINT32_MAX; // -1, the schema's absent tensor
+    memcpy(copy + first_op_input(copy), &missing, 4);
+    check(load_buffer(copy, size, 0, NULL) == RET_FAIL, "operator without its first input is rejected");
+    free(copy);
+}
+
+static void test_scalar_softmax(const uint8_t *data, size_t size)
+{
+    Model *model = NULL;
+    int ret = load_buffer(data, size, 0, &model);
+    if (ret != RET_SUCCESS) {
+        check(0, "softmax over a 0-dim tensor is rejected");
+        return;
+    }
+
+    // Keep the byte count so only the softmax can object, not the reshape feeding it
+    int found = 0;
+    for (int i = 0; i < model->op_count; i++) {
+        if (model->ops[i].code == MODEL_OP_SOFTMAX) {
+            model->tensors[model->ops[i].inputs[0]].dims = 0;
+            found = 1;
+        }
+    }
+    check(found && model_prepare(model) == RET_FAIL, "softmax over a 0-dim tensor is rejected");
+    model_free(model);
+}
+
+// Smooth gradients with a few edges, the image bench_inference reports on
+static Image* make_image(int width, int height)
+{
+    Image *img = img_new(width, height);
+    if (!img) return NULL;
+
+    for (int y = 0; y < height; y++) {
+        pixel *row = img_row(img, y);
+        for (int x = 0; x < width; x++) {
+            int band = ((x / 40) + (y / 30)) & 1;
+            row[x].R = (unsigned char)((x * 255) / width);
+            row[x].G = (unsigned char)((y * 255) / height);
+            row[x].B = (unsigned char)(band ? 200 : 40);
+            row[x].A = 255;
+        }
+    }
+    return img;
+}
+
+static void test_top1(void)
+{
+    Model *model = model_load(MODEL_PATH);
+    model_labels *labels = model_labels_load(LABELS_PATH);
+    Image *img = make_image(640, 480);
+    model_prediction top;
+    int ok = model && labels && img && model_classify(model, img, 1, &top) == 1;
+
+    const char *name = ok ? model_labels_name(labels, top.index) : NULL;
+    if (name && strcmp(name, EXPECTED_TOP1) != 0) printf("  top-1 is %s (%.3f)\n", name, top.score);
+    check(name && strcmp(name, EXPECTED_TOP1) == 0, "MobileNet top-1 of the test image is " EXPECTED_TOP1);
+
+    img_free(img);
+    model_labels_free(labels);
+    model_free(model);
+}
+
+int main(void)
+{
+    size_t size;
+    uint8_t *data = read_file(MODEL_PATH, &size);
+    if (!data) {
+        printf("model: cannot read %s\n", MODEL_PATH);
+        return 1;
+    }
+
+    printf("model:\n");
+    Model *intact = NULL;
+    check(load_buffer(data, size, 1, &intact) == RET_SUCCESS, "intact model parses and prepares");
+    model_free(intact);
+    test_truncated(data, size);
+    test_missing_input(data, size);
+    test_scalar_softmax(data, size);
+    test_top1();
+    free(data);
+
+    printf("model: %s\n", failures ? "FAIL" : "ok");
+    return failures ? 1 : 0;
+}